@@ -0,0 +1,116 @@
+"""Tree shape analysis shared by the lldb.py and gdb.py commands.
+
+Mirrors AvlTree_shape_report, but runs in the debugger so that it needs
+nothing from the inferior except its memory.
+"""
+
+
+CACHE_LINE_SIZE = 64
+PAGE_SIZE = 4096
+
+# Mirrors AVL_MAX_HEIGHT in bloodhound.h; no balanced tree is deeper.
+AVL_MAX_HEIGHT = 96
+
+
+def shape_of(root, node_size, read_links):
+    """Measures a tree like AvlTree_shape_report, reading nothing but
+    the links of each node, so it also works on core files.
+
+    read_links(address) must return the (left, right) addresses of the
+    AvlNode at address, with 0 for a missing child.
+
+    Links that revisit a node or lead deeper than AVL_MAX_HEIGHT are not
+    followed but counted in num_cut_links, so a corrupt tree still
+    yields a report instead of looping or exhausting memory.
+    """
+    depths = []
+    visited = set([root])
+    cut = 0
+    lines = set()
+    straddling = 0
+    links = 0
+    same_line = 0
+    same_page = 0
+    stack = [(root, 1, 0)] if root else []
+
+    while stack:
+        address, depth, parent = stack.pop()
+        line = address // CACHE_LINE_SIZE
+
+        depths.append(depth)
+        lines.add(line)
+
+        if (address + node_size - 1) // CACHE_LINE_SIZE != line:
+            straddling += 1
+
+        if parent:
+            links += 1
+            same_line += parent // CACHE_LINE_SIZE == line
+            same_page += parent // PAGE_SIZE == address // PAGE_SIZE
+
+        for child in read_links(address):
+            if not child:
+                continue
+
+            if depth >= AVL_MAX_HEIGHT or child in visited:
+                cut += 1
+            else:
+                visited.add(child)
+                stack.append((child, depth + 1, address))
+
+    histogram = [0] * max(depths or [0])
+
+    for depth in depths:
+        histogram[depth - 1] += 1
+
+    min_total = 0
+    remaining = len(depths)
+    level = 1
+
+    for depth in range(1, len(histogram) + 1):
+        min_total += min(remaining, level) * depth
+        remaining -= min(remaining, level)
+        level *= 2
+
+    return {
+        'len': len(depths),
+        'histogram': histogram,
+        'mean_depth': sum(depths) / float(len(depths) or 1),
+        'min_mean_depth': min_total / float(len(depths) or 1),
+        'num_cache_lines': len(lines),
+        'num_straddling_nodes': straddling,
+        'num_links': links,
+        'num_same_line_links': same_line,
+        'num_same_page_links': same_page,
+        'num_cut_links': cut,
+    }
+
+
+def format_shape(shape):
+    def percent(count, total):
+        return 100.0 * count / total if total else 0.0
+
+    lines = [
+        'len: {}, height: {}'.format(shape['len'], len(shape['histogram'])),
+        'comparisons per hit: {:.2f} (balanced: {:.2f})'.format(
+            shape['mean_depth'], shape['min_mean_depth']),
+        'nodes per {}-byte line: {:.2f}, straddling nodes: {:.1f}%'.format(
+            CACHE_LINE_SIZE,
+            shape['len'] / float(shape['num_cache_lines'] or 1),
+            percent(shape['num_straddling_nodes'], shape['len'])),
+        'parent-child links in the same line: {:.1f}%, page: {:.1f}%'.format(
+            percent(shape['num_same_line_links'], shape['num_links']),
+            percent(shape['num_same_page_links'], shape['num_links'])),
+    ]
+
+    if shape['num_cut_links']:
+        lines.append('corrupt: {} links not followed (cycle or deeper than {})'.format(
+            shape['num_cut_links'], AVL_MAX_HEIGHT))
+
+    lines.append('depth histogram:')
+
+    for depth, count in enumerate(shape['histogram'], 1):
+        lines.append('  {:3d}: {}'.format(depth, count))
+
+    return '\n'.join(lines)
+
@@ -0,0 +1,677 @@
+//  MIT License
+//
+//  Copyright (c) 2019 Gregory Meyer
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//  files (the "Software"), to deal in the Software without
+//  restriction, including without limitation the rights to use, copy,
+//  modify, merge, publish, distribute, sublicense, and/or sell copies
+//  of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice (including
+//  the next paragraph) shall be included in all copies or substantial
+//  portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+//  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+//  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+//  IN THE SOFTWARE.
+
+// Compares avl::Map, avl::Set, AvlCompactTree, AvlFrozenTree,
+// AvlIndexTree and the raw C API against std::map and std::set on int
+// keys. Every container allocates one
+// node per key with the default allocator, except AvlIndexTree, which
+// keeps its nodes in one growing array. Construction and destruction
+// of the containers are not timed.
+//
+// usage: bench_bloodhound [n...]
+// prints one "container,workload,n,ops_per_sec" line per run
+
+#include "avl_map.h"
+#include "avl_set.h"
+#include "bloodhound.h"
+#include "int_node.h"
+#include "util.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <random>
+#include <set>
+#include <vector>
+
+namespace {
+
+// skew of the Zipfian workload, as used by YCSB
+constexpr double ZIPF_THETA = 0.99;
+
+// number of keys per AvlTree_get_many call
+constexpr std::size_t GET_MANY_BATCH = 128;
+
+// fractions of the mixed workload that insert and remove; the rest are
+// lookups
+constexpr double MIXED_INSERT_RATIO = 0.1;
+constexpr double MIXED_REMOVE_RATIO = 0.1;
+
+volatile long sink;
+
+// Draws ranks in [0, n) where rank i is drawn with probability
+// proportional to 1 / (i + 1)^theta. From Gray et al., "Quickly
+// Generating Billion-Record Synthetic Databases".
+class Zipfian {
+public:
+    Zipfian(std::size_t n, double theta)
+    : n_(static_cast<double>(n)), theta_(theta), alpha_(1.0 / (1.0 - theta)),
+      zetan_(zeta(n, theta)),
+      eta_((1.0 - std::pow(2.0 / n_, 1.0 - theta)) / (1.0 - zeta(2, theta) / zetan_)) { }
+
+    template <typename URBG>
+    std::size_t operator()(URBG &urbg) {
+        const double u = std::uniform_real_distribution<double>()(urbg);
+        const double uz = u * zetan_;
+
+        if (uz < 1.0) {
+            return 0;
+        } else if (uz < 1.0 + std::pow(0.5, theta_)) {
+            return 1;
+        }
+
+        const auto rank = static_cast<std::size_t>(n_ * std::pow(eta_ * u - eta_ + 1.0, alpha_));
+        const auto max_rank = static_cast<std::size_t>(n_) - 1;
+
+        return (rank < max_rank) ? rank : max_rank;
+    }
+
+private:
+    static double zeta(std::size_t n, double theta) {
+        double sum = 0.0;
+
+        for (std::size_t i = 1; i <= n; ++i) {
+            sum += 1.0 / std::pow(static_cast<double>(i), theta);
+        }
+
+        return sum;
+    }
+
+    double n_;
+    double theta_;
+    double alpha_;
+    double zetan_;
+    double eta_;
+};
+
+enum class Op { Get, Insert, Remove };
+
+struct MixedOp {
+    Op op;
+    int key;
+};
+
+// keys and operation sequences shared by every container for one n
+struct Workloads {
+    template <typename URBG>
+    Workloads(std::size_t n, URBG &urbg)
+    : sequential(iota(n)), random(shuffled(std::vector<int>(sequential), urbg)),
+      lookups(shuffled(std::vector<int>(sequential), urbg)) {
+        Zipfian zipfian(n, ZIPF_THETA);
+        zipfian_lookups.reserve(n);
+
+        // hot keys are scattered over the tree rather than adjacent
+        for (std::size_t i = 0; i < n; ++i) {
+            zipfian_lookups.push_back(random[zipfian(urbg)]);
+        }
+
+        std::uniform_int_distribution<int> key_dist(0, static_cast<int>(2 * n - 1));
+        std::uniform_real_distribution<double> op_dist;
+        mixed.reserve(n);
+
+        for (std::size_t i = 0; i < n; ++i) {
+            const double p = op_dist(urbg);
+            const Op op = (p < MIXED_INSERT_RATIO) ? Op::Insert
+                        : (p < MIXED_INSERT_RATIO + MIXED_REMOVE_RATIO) ? Op::Remove
+                        : Op::Get;
+
+            mixed.push_back({op, key_dist(urbg)});
+        }
+    }
+
+    std::vector<int> sequential;
+    std::vector<int> random;
+    std::vector<int> lookups;
+    std::vector<int> zipfian_lookups;
+    std::vector<MixedOp> mixed;
+};
+
+class CTree {
+public:
+    static constexpr const char *NAME = "AvlTree";
+
+    CTree() noexcept {
+        AvlTree_new(&tree_, IntNode_compare, nullptr, CTree::deleter, nullptr);
+    }
+
+    CTree(const CTree &other) = delete;
+
+    ~CTree() {
+        AvlTree_drop(&tree_);
+    }
+
+    CTree& operator=(const CTree &other) = delete;
+
+    void insert(int key) {
+        IntNode *const node = new IntNode();
+        node->key = key;
+
+        AvlNode *const previous = AvlTree_insert(&tree_, &node->node);
+
+        if (previous) {
+            deleter(previous, nullptr);
+        }
+    }
+
+    bool get(int key) const noexcept {
+        return AvlTree_get(&tree_, &key, IntNode_het_compare, nullptr);
+    }
+
+    bool remove(int key) noexcept {
+        AvlNode *const removed = AvlTree_remove(&tree_, &key, IntNode_het_compare, nullptr);
+
+        if (!removed) {
+            return false;
+        }
+
+        deleter(removed, nullptr);
+
+        return true;
+    }
+
+    long scan() const noexcept {
+        AvlCursor cursor;
+        long sum = 0;
+
+        for (AvlCursor_first(&cursor, &tree_); AvlCursor_get(&cursor); AvlCursor_next(&cursor)) {
+            sum += IntNode_key(AvlCursor_get(&cursor));
+        }
+
+        return sum;
+    }
+
+private:
+    static void deleter(AvlNode *node, void*) {
+        delete reinterpret_cast<IntNode*>(node);
+    }
+
+    AvlTree tree_;
+};
+
+class CompactTree {
+public:
+    static constexpr const char *NAME = "AvlCompactTree";
+
+    CompactTree() noexcept {
+        AvlCompactTree_new(&tree_, CompactTree::compare, nullptr, CompactTree::deleter, nullptr);
+    }
+
+    CompactTree(const CompactTree &other) = delete;
+
+    ~CompactTree() {
+        AvlCompactTree_drop(&tree_);
+    }
+
+    CompactTree& operator=(const CompactTree &other) = delete;
+
+    void insert(int key) {
+        Node *const node = new Node();
+        node->key = key;
+
+        AvlCompactNode *const previous = AvlCompactTree_insert(&tree_, &node->node);
+
+        if (previous) {
+            deleter(previous, nullptr);
+        }
+    }
+
+    bool get(int key) const noexcept {
+        return AvlCompactTree_get(&tree_, &key, CompactTree::het_compare, nullptr);
+    }
+
+    bool remove(int key) noexcept {
+        AvlCompactNode *const removed =
+            AvlCompactTree_remove(&tree_, &key, CompactTree::het_compare, nullptr);
+
+        if (!removed) {
+            return false;
+        }
+
+        deleter(removed, nullptr);
+
+        return true;
+    }
+
+private:
+    struct Node {
+        AvlCompactNode node;
+        int key;
+    };
+
+    static int key_of(const AvlCompactNode *node) noexcept {
+        return reinterpret_cast<const Node*>(node)->key;
+    }
+
+    static int compare(const AvlCompactNode *lhs, const AvlCompactNode *rhs, void*) {
+        return (key_of(lhs) > key_of(rhs)) - (key_of(lhs) < key_of(rhs));
+    }
+
+    static int het_compare(const void *lhs_v, const AvlCompactNode *rhs, void*) {
+        const int lhs = *static_cast<const int*>(lhs_v);
+
+        return (lhs > key_of(rhs)) - (lhs < key_of(rhs));
+    }
+
+    static void deleter(AvlCompactNode *node, void*) {
+        delete reinterpret_cast<Node*>(node);
+    }
+
+    AvlCompactTree tree_;
+};
+
+// removed entries are recycled through a free list
+class IndexTree {
+public:
+    static constexpr const char *NAME = "AvlIndexTree";
+
+    IndexTree() {
+        entries_.reserve(INITIAL_CAPACITY);
+        AvlIndexTree_new(&tree_, entries_.data(), sizeof(Entry), IndexTree::compare, nullptr);
+    }
+
+    void insert(int key) {
+        AvlIndex index;
+
+        if (!free_.empty()) {
+            index = free_.back();
+            free_.pop_back();
+        } else {
+            if (entries_.size() == entries_.capacity()) {
+                grow();
+            }
+
+            index = static_cast<AvlIndex>(entries_.size());
+            entries_.emplace_back();
+        }
+
+        entries_[index].key = key;
+        const AvlIndex previous = AvlIndexTree_insert(&tree_, index);
+
+        if (previous != AVL_INDEX_NIL) {
+            free_.push_back(previous);
+        }
+    }
+
+    bool get(int key) const noexcept {
+        return AvlIndexTree_get(&tree_, &key, IndexTree::het_compare, nullptr) != AVL_INDEX_NIL;
+    }
+
+    bool remove(int key) {
+        const AvlIndex removed = AvlIndexTree_remove(&tree_, &key, IndexTree::het_compare, nullptr);
+
+        if (removed == AVL_INDEX_NIL) {
+            return false;
+        }
+
+        free_.push_back(removed);
+
+        return true;
+    }
+
+private:
+    static constexpr std::size_t INITIAL_CAPACITY = 1024;
+
+    struct Entry {
+        AvlIndexNode node;
+        int key;
+    };
+
+    static int key_of(const AvlIndexNode *node) noexcept {
+        return reinterpret_cast<const Entry*>(node)->key;
+    }
+
+    static int compare(const AvlIndexNode *lhs, const AvlIndexNode *rhs, void*) {
+        return (key_of(lhs) > key_of(rhs)) - (key_of(lhs) < key_of(rhs));
+    }
+
+    static int het_compare(const void *lhs_v, const AvlIndexNode *rhs, void*) {
+        const int lhs = *static_cast<const int*>(lhs_v);
+
+        return (lhs > key_of(rhs)) - (lhs < key_of(rhs));
+    }
+
+    // links are indices, so the tree survives the entries moving
+    void grow() {
+        entries_.reserve(2 * entries_.capacity());
+        tree_.nodes = reinterpret_cast<char*>(entries_.data());
+    }
+
+    AvlIndexTree tree_;
+    std::vector<Entry> entries_;
+    std::vector<AvlIndex> free_;
+};
+
+// avl::Map and avl::Set have no iteration, so they skip the scan
+class CxxMap {
+public:
+    static constexpr const char *NAME = "avl::Map";
+
+    void insert(int key) {
+        map_.insert(key, key);
+    }
+
+    bool get(int key) const noexcept {
+        return map_.get(key);
+    }
+
+    bool remove(int key) {
+        return map_.remove(key);
+    }
+
+private:
+    avl::Map<int, int> map_;
+};
+
+class CxxSet {
+public:
+    static constexpr const char *NAME = "avl::Set";
+
+    void insert(int key) {
+        set_.insert(key);
+    }
+
+    bool get(int key) const noexcept {
+        return set_.get(key);
+    }
+
+    bool remove(int key) {
+        return set_.remove(key);
+    }
+
+private:
+    avl::Set<int> set_;
+};
+
+class StdMap {
+public:
+    static constexpr const char *NAME = "std::map";
+
+    void insert(int key) {
+        map_[key] = key;
+    }
+
+    bool get(int key) const {
+        return map_.find(key) != map_.end();
+    }
+
+    bool remove(int key) {
+        return map_.erase(key) != 0;
+    }
+
+    long scan() const noexcept {
+        long sum = 0;
+
+        for (const auto &kv : map_) {
+            sum += kv.first;
+        }
+
+        return sum;
+    }
+
+private:
+    std::map<int, int> map_;
+};
+
+class StdSet {
+public:
+    static constexpr const char *NAME = "std::set";
+
+    void insert(int key) {
+        set_.insert(key);
+    }
+
+    bool get(int key) const {
+        return set_.find(key) != set_.end();
+    }
+
+    bool remove(int key) {
+        return set_.erase(key) != 0;
+    }
+
+    long scan() const noexcept {
+        long sum = 0;
+
+        for (int key : set_) {
+            sum += key;
+        }
+
+        return sum;
+    }
+
+private:
+    std::set<int> set_;
+};
+
+template <typename F>
+double ops_per_sec(std::size_t num_ops, F &&f) {
+    const auto start = std::chrono::steady_clock::now();
+    std::forward<F>(f)();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    return static_cast<double>(num_ops) / elapsed.count();
+}
+
+template <typename C>
+std::unique_ptr<C> filled(const std::vector<int> &keys) {
+    std::unique_ptr<C> container(new C());
+
+    for (int key : keys) {
+        container->insert(key);
+    }
+
+    return container;
+}
+
+void report(const char *container, const char *workload, std::size_t n, double rate) {
+    std::printf("%s,%s,%zu,%.0f\n", container, workload, n, rate);
+    std::fflush(stdout);
+}
+
+template <typename C, typename = decltype(std::declval<const C&>().scan())>
+void run_scan(const Workloads &w, int) {
+    const std::size_t n = w.random.size();
+    const auto container = filled<C>(w.random);
+
+    report(C::NAME, "scan", n, ops_per_sec(n, [&] { sink = container->scan(); }));
+}
+
+template <typename C>
+void run_scan(const Workloads&, long) { }
+
+template <typename C>
+void run_insert(const char *workload, const std::vector<int> &keys) {
+    std::unique_ptr<C> container(new C());
+
+    report(C::NAME, workload, keys.size(), ops_per_sec(keys.size(), [&] {
+        for (int key : keys) {
+            container->insert(key);
+        }
+    }));
+}
+
+template <typename C>
+void run_get(const char *workload, const Workloads &w, const std::vector<int> &keys) {
+    const auto container = filled<C>(w.random);
+
+    report(C::NAME, workload, keys.size(), ops_per_sec(keys.size(), [&] {
+        long found = 0;
+
+        for (int key : keys) {
+            found += container->get(key);
+        }
+
+        sink = found;
+    }));
+}
+
+template <typename C>
+void run_all(const Workloads &w) {
+    const std::size_t n = w.random.size();
+
+    run_insert<C>("insert_sequential", w.sequential);
+    run_insert<C>("insert_random", w.random);
+    run_get<C>("get_random", w, w.lookups);
+    run_get<C>("get_zipfian", w, w.zipfian_lookups);
+
+    {
+        const auto container = filled<C>(w.random);
+
+        report(C::NAME, "remove_random", n, ops_per_sec(n, [&] {
+            for (int key : w.lookups) {
+                container->remove(key);
+            }
+        }));
+    }
+
+    {
+        const auto container = filled<C>(w.random);
+
+        report(C::NAME, "mixed", n, ops_per_sec(n, [&] {
+            long found = 0;
+
+            for (const MixedOp &op : w.mixed) {
+                switch (op.op) {
+                case Op::Get: found += container->get(op.key); break;
+                case Op::Insert: container->insert(op.key); break;
+                case Op::Remove: found += container->remove(op.key); break;
+                }
+            }
+
+            sink = found;
+        }));
+    }
+
+    run_scan<C>(w, 0);
+}
+
+// frozen trees and batched lookups only read, so they get their own
+// runner
+void run_frozen(const Workloads &w) {
+    std::vector<IntNode> nodes(w.random.size());
+    AvlTree tree;
+    AvlFrozenTree frozen;
+
+    AvlTree_new(&tree, IntNode_compare, nullptr, IntNode_delete, nullptr);
+
+    for (std::size_t i = 0; i < nodes.size(); ++i) {
+        nodes[i].key = w.random[i];
+        AvlTree_insert(&tree, &nodes[i].node);
+    }
+
+    const auto run_get = [&](const char *name, const char *workload,
+                             const std::vector<int> &keys) {
+        report(name, workload, keys.size(), ops_per_sec(keys.size(), [&] {
+            long found = 0;
+
+            for (int key : keys) {
+                found += AvlFrozenTree_get(&frozen, &key, IntNode_het_compare, nullptr) != nullptr;
+            }
+
+            sink = found;
+        }));
+    };
+
+    // batches the size of one request's worth of keys
+    const auto run_get_many = [&](const char *name, const char *workload,
+                                  const std::vector<int> &keys, bool is_frozen) {
+        std::vector<const void*> key_ptrs;
+        std::vector<const AvlNode*> found(GET_MANY_BATCH);
+
+        for (const int &key : keys) {
+            key_ptrs.push_back(&key);
+        }
+
+        report(name, workload, keys.size(), ops_per_sec(keys.size(), [&] {
+            long num_found = 0;
+
+            for (std::size_t first = 0; first < keys.size(); first += GET_MANY_BATCH) {
+                const std::size_t n = std::min(GET_MANY_BATCH, keys.size() - first);
+
+                if (is_frozen) {
+                    AvlFrozenTree_get_many(&frozen, &key_ptrs[first], n, IntNode_het_compare,
+                                           nullptr, found.data());
+                } else {
+                    AvlTree_get_many(&tree, &key_ptrs[first], n, IntNode_het_compare, nullptr,
+                                     found.data());
+                }
+
+                num_found += found[0] != nullptr;
+            }
+
+            sink = num_found;
+        }));
+    };
+
+    run_get_many("AvlTree", "get_many_random", w.lookups, false);
+    run_get_many("AvlTree", "get_many_zipfian", w.zipfian_lookups, false);
+
+    AvlTree_freeze(&tree, &frozen);
+    run_get("AvlFrozenTree", "get_random", w.lookups);
+    run_get("AvlFrozenTree", "get_zipfian", w.zipfian_lookups);
+    AvlFrozenTree_drop(&frozen);
+
+    AvlTree_freeze_copies(&tree, &frozen, sizeof(IntNode));
+    run_get("AvlFrozenTree(copies)", "get_random", w.lookups);
+    run_get("AvlFrozenTree(copies)", "get_zipfian", w.zipfian_lookups);
+    run_get_many("AvlFrozenTree(copies)", "get_many_random", w.lookups, true);
+    run_get_many("AvlFrozenTree(copies)", "get_many_zipfian", w.zipfian_lookups, true);
+    AvlFrozenTree_drop(&frozen);
+    AvlTree_drop(&tree);
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::vector<std::size_t> sizes;
+
+    for (int i = 1; i < argc; ++i) {
+        sizes.push_back(static_cast<std::size_t>(std::strtoull(argv[i], nullptr, 10)));
+    }
+
+    if (sizes.empty()) {
+        sizes = {1000, 10000, 100000, 1000000};
+    }
+
+    const auto urbg_ptr = make_urbg();
+    std::printf("container,workload,n,ops_per_sec\n");
+
+    for (std::size_t n : sizes) {
+        const Workloads w(n, *urbg_ptr);
+
+        run_all<CTree>(w);
+        run_frozen(w);
+        run_all<CompactTree>(w);
+        run_all<IndexTree>(w);
+        run_all<CxxMap>(w);
+        run_all<CxxSet>(w);
+        run_all<StdMap>(w);
+        run_all<StdSet>(w);
+    }
+}
@@ -0,0 +1,114 @@
+//  MIT License
+//
+//  Copyright (c) 2019 Gregory Meyer
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//  files (the "Software"), to deal in the Software without
+//  restriction, including without limitation the rights to use, copy,
+//  modify, merge, publish, distribute, sublicense, and/or sell copies
+//  of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice (including
+//  the next paragraph) shall be included in all copies or substantial
+//  portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+//  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+//  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+//  IN THE SOFTWARE.
+
+// Measures AvlTree_remove throughput on the raw C API. Nodes live in a
+// preallocated vector and the deleter is a no-op, so the only
+// allocations that could show up here are the library's own.
+//
+// usage: remove_bench [n...]
+// prints one "order,n,removals_per_sec" line per workload
+
+#include "bloodhound.h"
+#include "util.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+struct Node {
+    AvlNode node;
+    int key;
+};
+
+int compare(const AvlNode *lhs_v, const AvlNode *rhs_v, void*) {
+    const int lhs = reinterpret_cast<const Node*>(lhs_v)->key;
+    const int rhs = reinterpret_cast<const Node*>(rhs_v)->key;
+
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+int het_compare(const void *lhs_v, const AvlNode *rhs_v, void*) {
+    const int lhs = *static_cast<const int*>(lhs_v);
+    const int rhs = reinterpret_cast<const Node*>(rhs_v)->key;
+
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+void deleter(AvlNode*, void*) { }
+
+double removals_per_sec(const std::vector<int> &to_insert, const std::vector<int> &to_remove) {
+    std::vector<Node> nodes(to_insert.size());
+    AvlTree tree;
+
+    AvlTree_new(&tree, compare, nullptr, deleter, nullptr);
+
+    for (std::size_t i = 0; i < to_insert.size(); ++i) {
+        nodes[i].key = to_insert[i];
+        AvlTree_insert(&tree, &nodes[i].node);
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    for (int key : to_remove) {
+        if (!AvlTree_remove(&tree, &key, het_compare, nullptr)) {
+            std::fprintf(stderr, "remove_bench: key %d not found\n", key);
+            std::abort();
+        }
+    }
+
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    AvlTree_drop(&tree);
+
+    return static_cast<double>(to_remove.size()) / elapsed.count();
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    std::vector<std::size_t> sizes;
+
+    for (int i = 1; i < argc; ++i) {
+        sizes.push_back(static_cast<std::size_t>(std::strtoul(argv[i], nullptr, 10)));
+    }
+
+    if (sizes.empty()) {
+        sizes = {1000, 10000, 100000, 1000000};
+    }
+
+    const auto urbg_ptr = make_urbg();
+    std::printf("order,n,removals_per_sec\n");
+
+    for (std::size_t n : sizes) {
+        const std::vector<int> keys = rand_iota(n, *urbg_ptr);
+
+        std::printf("sorted,%zu,%.0f\n", n, removals_per_sec(keys, sorted(std::vector<int>(keys))));
+        std::printf("random,%zu,%.0f\n", n,
+                    removals_per_sec(keys, shuffled(std::vector<int>(keys), *urbg_ptr)));
+    }
+}
@@ -0,0 +1,39 @@
+import os
+import sys
+
+import gdb
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+
+from avl_shape import format_shape, shape_of
+
+
+class AvlShapeCommand(gdb.Command):
+    """usage: avl-shape <AvlTree expression>
+
+    Prints the height, depth histogram and memory layout of an AvlTree.
+    """
+
+    def __init__(self):
+        super(AvlShapeCommand, self).__init__('avl-shape', gdb.COMMAND_DATA,
+                                              gdb.COMPLETE_EXPRESSION)
+
+    def invoke(self, argument, from_tty):
+        tree = gdb.parse_and_eval(argument)
+
+        if tree.type.strip_typedefs().code == gdb.TYPE_CODE_PTR:
+            tree = tree.dereference()
+
+        node_type = gdb.lookup_type('AvlNode')
+        node_pointer_type = node_type.pointer()
+
+        def read_links(address):
+            node = gdb.Value(address).cast(node_pointer_type).dereference()
+
+            return [int(node[name]) for name in ('left', 'right')]
+
+        shape = shape_of(int(tree['root']), node_type.sizeof, read_links)
+        gdb.write(format_shape(shape) + '\n')
+
+
+AvlShapeCommand()
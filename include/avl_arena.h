@@ -0,0 +1,248 @@
+//  MIT License
+//
+//  Copyright (c) 2019 Gregory Meyer
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//  files (the "Software"), to deal in the Software without
+//  restriction, including without limitation the rights to use, copy,
+//  modify, merge, publish, distribute, sublicense, and/or sell copies
+//  of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice (including
+//  the next paragraph) shall be included in all copies or substantial
+//  portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+//  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+//  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+//  IN THE SOFTWARE.
+
+#ifndef AVL_ARENA_H
+#define AVL_ARENA_H
+
+#include <cassert>
+#include <cstddef>
+#include <limits>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace avl {
+
+// Hands out fixed-size chunks from large contiguous blocks. Freed chunks
+// go on a free list for their size and are reused before the current
+// block is advanced, so insert/remove churn does not grow the arena.
+// release() returns every block at once, in O(blocks) time.
+class Arena {
+public:
+    static constexpr std::size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+
+    explicit Arena(std::size_t block_size = DEFAULT_BLOCK_SIZE) noexcept
+    : block_size_(block_size) { }
+
+    Arena(const Arena &other) = delete;
+
+    ~Arena() {
+        release();
+    }
+
+    Arena& operator=(const Arena &other) = delete;
+
+    // alignment is that of std::max_align_t
+    void* allocate(std::size_t size) {
+        size = chunk_size(size);
+        FreeList &list = free_list(size);
+
+        if (list.head) {
+            FreeChunk *const chunk = list.head;
+            list.head = chunk->next;
+
+            return chunk;
+        }
+
+        if (static_cast<std::size_t>(end_ - cursor_) < size) {
+            grow(size);
+        }
+
+        void *const chunk = cursor_;
+        cursor_ += size;
+
+        return chunk;
+    }
+
+    // ptr must have been returned by allocate(size) on this arena
+    void deallocate(void *ptr, std::size_t size) noexcept {
+        assert(ptr);
+
+        size = chunk_size(size);
+
+        for (FreeList &list : free_lists_) {
+            if (list.size == size) {
+                FreeChunk *const chunk = ::new (ptr) FreeChunk;
+                chunk->next = list.head;
+                list.head = chunk;
+
+                return;
+            }
+        }
+
+        assert(false && "ptr was not allocated by this arena");
+    }
+
+    // invalidates every chunk allocated from this arena
+    void release() noexcept {
+        while (blocks_) {
+            Block *const next = blocks_->next;
+            ::operator delete(blocks_);
+            blocks_ = next;
+        }
+
+        for (FreeList &list : free_lists_) {
+            list.head = nullptr;
+        }
+
+        cursor_ = nullptr;
+        end_ = nullptr;
+        num_blocks_ = 0;
+    }
+
+    std::size_t num_blocks() const noexcept {
+        return num_blocks_;
+    }
+
+private:
+    struct FreeChunk {
+        FreeChunk *next;
+    };
+
+    struct FreeList {
+        std::size_t size;
+        FreeChunk *head;
+    };
+
+    struct Block {
+        Block *next;
+    };
+
+    static constexpr std::size_t ALIGNMENT = alignof(std::max_align_t);
+
+    static constexpr std::size_t round_up(std::size_t size) noexcept {
+        return (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+
+    static std::size_t chunk_size(std::size_t size) noexcept {
+        return round_up((size < sizeof(FreeChunk)) ? sizeof(FreeChunk) : size);
+    }
+
+    // usually there is only one size, so a linear search is fastest
+    FreeList& free_list(std::size_t size) {
+        for (FreeList &list : free_lists_) {
+            if (list.size == size) {
+                return list;
+            }
+        }
+
+        free_lists_.push_back(FreeList{size, nullptr});
+
+        return free_lists_.back();
+    }
+
+    void grow(std::size_t min_size) {
+        const std::size_t header_size = round_up(sizeof(Block));
+
+        if (min_size > std::numeric_limits<std::size_t>::max() - header_size) {
+            throw std::bad_alloc();
+        }
+
+        const std::size_t size = (block_size_ < min_size + header_size) ? min_size + header_size
+                                                                        : block_size_;
+        char *const data = static_cast<char*>(::operator new(size));
+        Block *const block = ::new (data) Block;
+
+        block->next = blocks_;
+        blocks_ = block;
+        ++num_blocks_;
+
+        cursor_ = data + header_size;
+        end_ = data + size;
+    }
+
+    std::vector<FreeList> free_lists_;
+    Block *blocks_ = nullptr;
+    char *cursor_ = nullptr;
+    char *end_ = nullptr;
+    std::size_t block_size_;
+    std::size_t num_blocks_ = 0;
+};
+
+// Allocator over a shared Arena. A default-constructed ArenaAllocator
+// creates a new arena; copies and rebound copies share it.
+template <typename T>
+class ArenaAllocator {
+public:
+    static_assert(alignof(T) <= alignof(std::max_align_t),
+                  "ArenaAllocator does not support over-aligned types");
+
+    using value_type = T;
+
+    ArenaAllocator() : arena_(std::make_shared<Arena>()) { }
+
+    explicit ArenaAllocator(std::size_t block_size)
+    : arena_(std::make_shared<Arena>(block_size)) { }
+
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) noexcept : arena_(other.arena_) { }
+
+    T* allocate(std::size_t n) {
+        if (n > std::numeric_limits<std::size_t>::max() / sizeof(T)) {
+            throw std::bad_alloc();
+        }
+
+        return static_cast<T*>(arena_->allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T *ptr, std::size_t n) noexcept {
+        arena_->deallocate(ptr, n * sizeof(T));
+    }
+
+    // frees every block of the arena if no other allocator shares it
+    bool try_release() noexcept {
+        if (arena_.use_count() != 1) {
+            return false;
+        }
+
+        arena_->release();
+
+        return true;
+    }
+
+    Arena& arena() const noexcept {
+        return *arena_;
+    }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U> &other) const noexcept {
+        return arena_ == other.arena_;
+    }
+
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U> &other) const noexcept {
+        return arena_ != other.arena_;
+    }
+
+private:
+    template <typename U>
+    friend class ArenaAllocator;
+
+    std::shared_ptr<Arena> arena_;
+};
+
+} // namespace avl
+
+#endif
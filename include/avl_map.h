@@ -0,0 +1,337 @@
+//  MIT License
+//
+//  Copyright (c) 2019 Gregory Meyer
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//  files (the "Software"), to deal in the Software without
+//  restriction, including without limitation the rights to use, copy,
+//  modify, merge, publish, distribute, sublicense, and/or sell copies
+//  of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice (including
+//  the next paragraph) shall be included in all copies or substantial
+//  portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+//  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+//  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+//  IN THE SOFTWARE.
+
+#ifndef AVL_MAP_H
+#define AVL_MAP_H
+
+#include <avl_tree.h>
+#include <bloodhound.h>
+
+#include <cassert>
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace avl {
+
+struct Less {
+    template <typename T, typename U,
+              typename = decltype(std::declval<const T&>() < std::declval<const U&>())>
+    bool operator()(const T &lhs, const U &rhs) const noexcept {
+        return static_cast<bool>(lhs < rhs);
+    }
+};
+
+// Nodes are allocated through A rebound to the node type. If A has a
+// try_release() member, like avl::ArenaAllocator, and K and V are
+// trivially destructible, clear() hands all memory back in one call
+// instead of visiting every node.
+template <typename K, typename V, typename A = std::allocator<std::pair<const K, V>>>
+class Map {
+public:
+    using allocator_type = A;
+
+    Map() noexcept(std::is_nothrow_default_constructible<A>::value) : Map(A()) { }
+
+    explicit Map(const A &alloc) : node_alloc_(alloc) {
+        AvlTree_new(&impl_, Map::comparator, &comparator_, Map::deleter, &node_alloc_);
+    }
+
+    // impl_ points into this object, so it can't be copied or moved
+    Map(const Map &other) = delete;
+
+    ~Map() {
+        clear();
+        AvlTree_drop(&impl_);
+    }
+
+    Map& operator=(const Map &other) = delete;
+
+    class Entry;
+
+    // Searches for key once. If it isn't found, the returned Entry can
+    // insert it without searching again; either way, nothing is
+    // allocated until then. Any other modification of the map
+    // invalidates the Entry.
+    template <typename L,
+              typename = decltype(std::declval<const L&>() < std::declval<const K&>()),
+              typename = decltype(std::declval<const K&>() < std::declval<const L&>())>
+    Entry entry(const L &key) {
+        Entry result(*this);
+
+        result.node_ = reinterpret_cast<Node*>(
+            avl::entry(impl_, key, KeyCompare<L>{comparator_}, result.found_)
+        );
+
+        return result;
+    }
+
+    // Returns true if key was already present. Its value is then
+    // assigned in place if V can be assigned from value and key can be
+    // compared to K without constructing one; otherwise the old node is
+    // replaced by a new one.
+    template <typename L, typename W,
+              typename std::enable_if<std::is_constructible<K, L>::value
+                                      && std::is_constructible<V, W>::value, int>::type = 0>
+    std::pair<std::pair<K, V>&, bool> insert(L &&key, W &&value) {
+        return insert_impl(std::forward<L>(key), std::forward<W>(value), 0);
+    }
+
+    template <typename L, typename W,
+              typename std::enable_if<std::is_constructible<K, L>::value
+                                      && std::is_constructible<V, W>::value
+                                      && std::is_assignable<V&, W>::value, int>::type = 0,
+              typename = decltype(std::declval<const typename std::decay<L>::type&>()
+                                  < std::declval<const K&>()),
+              typename = decltype(std::declval<const K&>()
+                                  < std::declval<const typename std::decay<L>::type&>())>
+    std::pair<std::pair<K, V>&, bool> insert_or_assign(L &&key, W &&value) {
+        Entry found = entry(static_cast<const typename std::decay<L>::type&>(key));
+
+        if (std::pair<K, V> *const existing = found.get()) {
+            existing->second = std::forward<W>(value);
+
+            return {*existing, false};
+        }
+
+        return {found.insert(std::forward<L>(key), std::forward<W>(value)), true};
+    }
+
+    bool remove(const K &key) {
+        Node *const previous = reinterpret_cast<Node*>(
+            avl::remove(impl_, key, KeyCompare<K>{comparator_})
+        );
+
+        if (previous) {
+            destroy_node(node_alloc_, previous);
+
+            return true;
+        }
+
+        return false;
+    }
+
+    V* get(const K &key) noexcept {
+        Node *const node = reinterpret_cast<Node*>(
+            avl::find(impl_, key, KeyCompare<K>{comparator_})
+        );
+
+        if (!node) {
+            return nullptr;
+        } else {
+            return &node->kv.second;
+        }
+    }
+
+    const V* get(const K &key) const noexcept {
+        const Node *const node = reinterpret_cast<const Node*>(
+            avl::find(impl_, key, KeyCompare<K>{comparator_})
+        );
+
+        if (!node) {
+            return nullptr;
+        } else {
+            return &node->kv.second;
+        }
+    }
+
+    std::size_t size() const noexcept {
+        return impl_.len;
+    }
+
+    void clear() noexcept {
+        constexpr bool is_trivial = std::is_trivially_destructible<K>::value
+                                    && std::is_trivially_destructible<V>::value;
+
+        // the nodes' memory is gone after try_release, so forget them
+        if (is_trivial && try_release(node_alloc_, 0)) {
+            AvlTree_clear_with(&impl_, nullptr, nullptr);
+        } else {
+            AvlTree_clear(&impl_);
+        }
+    }
+
+    A get_allocator() const {
+        return A(node_alloc_);
+    }
+
+private:
+    struct Node;
+
+    using NodeAllocator = typename std::allocator_traits<A>::template rebind_alloc<Node>;
+    using NodeTraits = std::allocator_traits<NodeAllocator>;
+
+    static_assert(std::is_same<typename NodeTraits::pointer, Node*>::value,
+                  "avl::Map does not support fancy pointers");
+
+    template <typename... Args>
+    static Node* make_node(NodeAllocator &alloc, Args &&...args) {
+        Node *const node = NodeTraits::allocate(alloc, 1);
+
+        try {
+            NodeTraits::construct(alloc, node, std::forward<Args>(args)...);
+        } catch (...) {
+            NodeTraits::deallocate(alloc, node, 1);
+
+            throw;
+        }
+
+        return node;
+    }
+
+    static void destroy_node(NodeAllocator &alloc, Node *node) noexcept {
+        NodeTraits::destroy(alloc, node);
+        NodeTraits::deallocate(alloc, node, 1);
+    }
+
+    template <typename L, typename W,
+              typename = decltype(std::declval<V&>() = std::declval<W>()),
+              typename = decltype(std::declval<const typename std::decay<L>::type&>()
+                                  < std::declval<const K&>()),
+              typename = decltype(std::declval<const K&>()
+                                  < std::declval<const typename std::decay<L>::type&>())>
+    std::pair<std::pair<K, V>&, bool> insert_impl(L &&key, W &&value, int) {
+        Entry found = entry(static_cast<const typename std::decay<L>::type&>(key));
+
+        if (std::pair<K, V> *const existing = found.get()) {
+            existing->second = std::forward<W>(value);
+
+            return {*existing, true};
+        }
+
+        return {found.insert(std::forward<L>(key), std::forward<W>(value)), false};
+    }
+
+    template <typename L, typename W>
+    std::pair<std::pair<K, V>&, bool> insert_impl(L &&key, W &&value, long) {
+        Node *const node = make_node(node_alloc_, std::forward<L>(key), std::forward<W>(value));
+        Node *const previous = reinterpret_cast<Node*>(
+            avl::insert(impl_, node->kv.first, &node->node, KeyCompare<K>{comparator_})
+        );
+
+        if (previous) {
+            destroy_node(node_alloc_, previous);
+
+            return {node->kv, true};
+        }
+
+        return {node->kv, false};
+    }
+
+    template <typename B>
+    static auto try_release(B &alloc, int) noexcept -> decltype(alloc.try_release()) {
+        return alloc.try_release();
+    }
+
+    template <typename B>
+    static bool try_release(B&, long) noexcept {
+        return false;
+    }
+
+    static void deleter(AvlNode *node, void *alloc_v) {
+        destroy_node(*static_cast<NodeAllocator*>(alloc_v), reinterpret_cast<Node*>(node));
+    }
+
+    // passed by value to the avl_tree.h templates so the calls inline
+    template <typename L>
+    struct KeyCompare {
+        const Less &comparator;
+
+        int operator()(const L &lhs, const AvlNode *rhs_v) const {
+            const Node &rhs = *reinterpret_cast<const Node*>(rhs_v);
+
+            if (comparator(lhs, rhs.kv.first)) { // lhs < rhs
+                return -1;
+            } else if (comparator(rhs.kv.first, lhs)) { // rhs < lhs
+                return 1;
+            } else {
+                return 0;
+            }
+        }
+    };
+
+    // still needed by the C API, which compares nodes against nodes
+    static int comparator(const AvlNode *lhs_v, const AvlNode *rhs_v, void *comparator_v) {
+        const Node &lhs = *reinterpret_cast<const Node*>(lhs_v);
+
+        return KeyCompare<K>{*static_cast<Less*>(comparator_v)}(lhs.kv.first, rhs_v);
+    }
+
+    struct Node {
+        template <typename L, typename W,
+                  typename std::enable_if<std::is_constructible<K, L>::value
+                                          && std::is_constructible<V, W>::value, int>::type = 0>
+        Node(L &&l, W &&w)
+        noexcept(std::is_nothrow_constructible<K, L>::value
+                 && std::is_nothrow_constructible<V, W>::value)
+        : kv(std::forward<L>(l), std::forward<W>(w)) { }
+
+        AvlNode node = {nullptr, nullptr, 0};
+        std::pair<K, V> kv;
+    };
+
+    AvlTree impl_;
+    Less comparator_;
+    NodeAllocator node_alloc_;
+};
+
+// The result of Map::entry.
+template <typename K, typename V, typename A>
+class Map<K, V, A>::Entry {
+public:
+    // The pair whose key compared equal to the one searched for, if
+    // there was one, or the one inserted since.
+    std::pair<K, V>* get() const noexcept {
+        return node_ ? &node_->kv : nullptr;
+    }
+
+    // Constructs a pair in the slot the search found empty and links it
+    // into the map. key must compare equal to the one searched for.
+    template <typename L, typename W,
+              typename std::enable_if<std::is_constructible<K, L>::value
+                                      && std::is_constructible<V, W>::value, int>::type = 0>
+    std::pair<K, V>& insert(L &&key, W &&value) {
+        assert(!node_);
+
+        node_ = make_node(map_->node_alloc_, std::forward<L>(key), std::forward<W>(value));
+        AvlTree_insert_entry(&map_->impl_, &found_, &node_->node);
+
+        return node_->kv;
+    }
+
+private:
+    friend class Map;
+
+    explicit Entry(Map &map) noexcept : map_(&map) { }
+
+    Map *map_;
+    Node *node_ = nullptr;
+    AvlEntry found_;
+};
+
+} // namespace avl
+
+#endif
@@ -0,0 +1,247 @@
+//  MIT License
+//
+//  Copyright (c) 2019 Gregory Meyer
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//  files (the "Software"), to deal in the Software without
+//  restriction, including without limitation the rights to use, copy,
+//  modify, merge, publish, distribute, sublicense, and/or sell copies
+//  of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice (including
+//  the next paragraph) shall be included in all copies or substantial
+//  portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+//  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+//  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+//  IN THE SOFTWARE.
+
+#ifndef AVL_MULTI_INDEX_H
+#define AVL_MULTI_INDEX_H
+
+#include <avl_map.h>
+#include <avl_tree.h>
+#include <bloodhound.h>
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace avl {
+
+// One index of a MultiIndex: the AvlNode member of T that links records
+// into it, and a functor that returns the key of a record, which is
+// ordered by avl::Less.
+template <typename T, AvlNode T::*Member, typename KeyOf>
+struct Index {
+    // measured once, on first use
+    static std::size_t node_offset() noexcept {
+        static const std::size_t offset = measure_node_offset();
+
+        return offset;
+    }
+
+    static auto key(const T &record) -> decltype(KeyOf()(record)) {
+        return KeyOf()(record);
+    }
+
+    static const AvlNode& node_of(const T &record) noexcept {
+        return record.*Member;
+    }
+
+    static AvlNode& node_of(T &record) noexcept {
+        return record.*Member;
+    }
+
+    static const T* container(const AvlNode *node) noexcept {
+        return reinterpret_cast<const T*>(reinterpret_cast<const char*>(node) - node_offset());
+    }
+
+    static T* container(AvlNode *node) noexcept {
+        return const_cast<T*>(container(static_cast<const AvlNode*>(node)));
+    }
+
+private:
+    // offsetof only takes member names, so apply the member pointer to an
+    // aligned address that no T lives at; only the address of the member
+    // is taken, so nothing is read through it
+    static std::size_t measure_node_offset() noexcept {
+        const T *const record = reinterpret_cast<const T*>(static_cast<std::uintptr_t>(alignof(T)));
+
+        return static_cast<std::size_t>(reinterpret_cast<std::uintptr_t>(&(record->*Member))
+                                        - reinterpret_cast<std::uintptr_t>(record));
+    }
+};
+
+// Records of type T that are linked into one AvlTree per Index at once,
+// through the AvlNode members the Indexes name, so a record is
+// allocated once no matter how many orders it can be found by. Keys are
+// unique within each index. Records are not owned: insert() and
+// remove() only link and unlink them, and they must outlive their
+// membership.
+template <typename T, typename... Indexes>
+class MultiIndex {
+public:
+    static constexpr std::size_t NUM_INDEXES = sizeof...(Indexes);
+
+    static_assert(NUM_INDEXES > 0, "avl::MultiIndex needs at least one index");
+
+    template <std::size_t I>
+    using IndexAt = typename std::tuple_element<I, std::tuple<Indexes...>>::type;
+
+    MultiIndex() noexcept {
+        init_trees(Constant<0>());
+    }
+
+    // trees_ point into this object, so it can't be copied or moved
+    MultiIndex(const MultiIndex &other) = delete;
+
+    ~MultiIndex() {
+        clear();
+    }
+
+    MultiIndex& operator=(const MultiIndex &other) = delete;
+
+    // Links record into every index, unless one of them already has a
+    // record with an equal key, which is returned with false; record is
+    // then left out of every index. Searches each index once.
+    std::pair<T*, bool> insert(T &record) {
+        AvlEntry entries[NUM_INDEXES];
+
+        if (T *const existing = find_entries(record, entries, Constant<0>())) {
+            return {existing, false};
+        }
+
+        insert_entries(record, entries, Constant<0>());
+
+        return {&record, true};
+    }
+
+    // record must have been inserted and not removed since.
+    void remove(T &record) {
+        remove_from(record, Constant<0>());
+    }
+
+    // The record whose key in index I compares equal to key, if any.
+    template <std::size_t I, typename Key>
+    T* find(const Key &key) noexcept {
+        AvlNode *const node = avl::find(trees_[I], key, KeyCompare<I>{});
+
+        return node ? IndexAt<I>::container(node) : nullptr;
+    }
+
+    template <std::size_t I, typename Key>
+    const T* find(const Key &key) const noexcept {
+        const AvlNode *const node = avl::find(trees_[I], key, KeyCompare<I>{});
+
+        return node ? IndexAt<I>::container(node) : nullptr;
+    }
+
+    // For cursors and the rest of the C API; nodes are turned back into
+    // records by IndexAt<I>::container. Must not be modified.
+    template <std::size_t I>
+    const AvlTree& index() const noexcept {
+        return trees_[I];
+    }
+
+    std::size_t size() const noexcept {
+        return trees_[0].len;
+    }
+
+    // Unlinks every record without visiting them.
+    void clear() noexcept {
+        for (AvlTree &tree : trees_) {
+            AvlTree_clear_with(&tree, nullptr, nullptr);
+        }
+    }
+
+private:
+    template <std::size_t I>
+    using Constant = std::integral_constant<std::size_t, I>;
+
+    // passed by value to the avl_tree.h templates so the calls inline
+    template <std::size_t I>
+    struct KeyCompare {
+        template <typename Key>
+        int operator()(const Key &key, const AvlNode *node) const {
+            const auto &other = IndexAt<I>::key(*IndexAt<I>::container(node));
+
+            if (Less()(key, other)) {
+                return -1;
+            } else if (Less()(other, key)) {
+                return 1;
+            } else {
+                return 0;
+            }
+        }
+    };
+
+    // still needed by the C API, which compares records against records
+    template <std::size_t I>
+    static int compare_records(const void *lhs, const void *rhs_v, void*) {
+        const T &rhs = *static_cast<const T*>(rhs_v);
+
+        return KeyCompare<I>()(IndexAt<I>::key(*static_cast<const T*>(lhs)),
+                               &IndexAt<I>::node_of(rhs));
+    }
+
+    static void forget(void*, void*) noexcept { }
+
+    void init_trees(Constant<NUM_INDEXES>) noexcept { }
+
+    template <std::size_t I>
+    void init_trees(Constant<I>) noexcept {
+        AvlTree_new_with_offset(&trees_[I], IndexAt<I>::node_offset(), compare_records<I>,
+                                nullptr, forget, nullptr);
+        init_trees(Constant<I + 1>());
+    }
+
+    T* find_entries(const T&, AvlEntry*, Constant<NUM_INDEXES>) noexcept {
+        return nullptr;
+    }
+
+    template <std::size_t I>
+    T* find_entries(const T &record, AvlEntry *entries, Constant<I>) {
+        if (AvlNode *const found = avl::entry(trees_[I], IndexAt<I>::key(record), KeyCompare<I>{},
+                                              entries[I])) {
+            return IndexAt<I>::container(found);
+        }
+
+        return find_entries(record, entries, Constant<I + 1>());
+    }
+
+    void insert_entries(T&, AvlEntry*, Constant<NUM_INDEXES>) noexcept { }
+
+    template <std::size_t I>
+    void insert_entries(T &record, AvlEntry *entries, Constant<I>) noexcept {
+        AvlTree_insert_entry(&trees_[I], &entries[I], &IndexAt<I>::node_of(record));
+        insert_entries(record, entries, Constant<I + 1>());
+    }
+
+    void remove_from(T&, Constant<NUM_INDEXES>) noexcept { }
+
+    template <std::size_t I>
+    void remove_from(T &record, Constant<I>) {
+        AvlNode *const removed = avl::remove(trees_[I], IndexAt<I>::key(record), KeyCompare<I>{});
+
+        assert(removed == &IndexAt<I>::node_of(record));
+        static_cast<void>(removed);
+        remove_from(record, Constant<I + 1>());
+    }
+
+    AvlTree trees_[NUM_INDEXES];
+};
+
+} // namespace avl
+
+#endif
@@ -0,0 +1,170 @@
+//  MIT License
+//
+//  Copyright (c) 2019 Gregory Meyer
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//  files (the "Software"), to deal in the Software without
+//  restriction, including without limitation the rights to use, copy,
+//  modify, merge, publish, distribute, sublicense, and/or sell copies
+//  of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice (including
+//  the next paragraph) shall be included in all copies or substantial
+//  portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+//  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+//  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+//  IN THE SOFTWARE.
+
+#ifndef AVL_TREE_H
+#define AVL_TREE_H
+
+#include <bloodhound.h>
+
+#include <cassert>
+#include <utility>
+
+// Searches an AvlTree with a comparator known at compile time, so it
+// can be inlined instead of called through a function pointer once per
+// level. Only the search lives here; rebalancing is done by the
+// AvlTree_*_at functions, so trees can be shared freely with the C API.
+//
+// Every comparator is invoked as compare(key, node) and must return a
+// negative, zero or positive int as key compares less than, equal to
+// or greater than node, just like an AvlHetComparator. It must form
+// the same total ordering as the one passed to AvlTree_new.
+namespace avl {
+
+// Finds the node that compares equal to key, if there is one.
+template <typename Key, typename Compare>
+const AvlNode* find(const AvlTree &tree, const Key &key, Compare compare) {
+    const AvlNode *current = tree.root;
+
+    while (current) {
+        const int ordering = compare(key, static_cast<const AvlNode*>(current));
+
+        if (ordering < 0) {
+            current = current->left;
+        } else if (ordering > 0) {
+            current = current->right;
+        } else {
+            break;
+        }
+    }
+
+    return current;
+}
+
+template <typename Key, typename Compare>
+AvlNode* find(AvlTree &tree, const Key &key, Compare compare) {
+    return const_cast<AvlNode*>(find(static_cast<const AvlTree&>(tree), key, compare));
+}
+
+// Fills cursor with the path from the root to the node that compares
+// equal to key or, if there isn't one, to the node that would become
+// its parent. Returns the ordering of key against the last node on the
+// path, which is 0 if it compared equal or if tree is empty.
+template <typename Key, typename Compare>
+int descend(const AvlTree &tree, const Key &key, Compare compare, AvlCursor &cursor) {
+    AvlNode *current = tree.root;
+    int ordering = 0;
+
+    cursor.len = 0;
+
+    while (current) {
+        assert(cursor.len < AVL_MAX_HEIGHT);
+        cursor.path[cursor.len++] = current;
+        ordering = compare(key, static_cast<const AvlNode*>(current));
+
+        if (ordering < 0) {
+            current = current->left;
+        } else if (ordering > 0) {
+            current = current->right;
+        } else {
+            break;
+        }
+    }
+
+    return ordering;
+}
+
+// Fills found with the result of one search for key, like
+// AvlTree_entry. Returns the node that compares equal to key or, if
+// there isn't one, nullptr, in which case AvlTree_insert_entry can link
+// a new node into the slot found reserves without searching again.
+template <typename Key, typename Compare>
+AvlNode* entry(AvlTree &tree, const Key &key, Compare compare, AvlEntry &found) {
+    found.ordering = descend(tree, key, compare, found.cursor);
+
+    if (found.cursor.len == 0 || found.ordering != 0) {
+        return nullptr;
+    }
+
+    return found.cursor.path[found.cursor.len - 1];
+}
+
+// Inserts node, which must compare equal to key, replacing any node
+// that already compares equal to it. Returns the replaced node, if
+// there was one.
+template <typename Key, typename Compare>
+AvlNode* insert(AvlTree &tree, const Key &key, AvlNode *node, Compare compare) {
+    AvlCursor cursor;
+    const int ordering = descend(tree, key, compare, cursor);
+
+    assert(node);
+
+    if (cursor.len > 0 && ordering == 0) {
+        return AvlTree_replace_at(&tree, &cursor, node);
+    }
+
+    AvlTree_insert_at(&tree, &cursor, ordering, node);
+
+    return nullptr;
+}
+
+// Returns the node that compares equal to key and false or, if there
+// isn't one, inserts the node returned by make() and returns it and
+// true. make() must return a node that compares equal to key and may
+// throw, in which case the tree is left unchanged.
+template <typename Key, typename Compare, typename Make>
+std::pair<AvlNode*, bool> get_or_insert(AvlTree &tree, const Key &key, Compare compare,
+                                        Make &&make) {
+    AvlEntry found;
+    AvlNode *const existing = entry(tree, key, compare, found);
+
+    if (existing) {
+        return {existing, false};
+    }
+
+    AvlNode *const node = std::forward<Make>(make)();
+
+    assert(node);
+    AvlTree_insert_entry(&tree, &found, node);
+
+    return {node, true};
+}
+
+// Removes the node that compares equal to key, if there is one, and
+// returns it.
+template <typename Key, typename Compare>
+AvlNode* remove(AvlTree &tree, const Key &key, Compare compare) {
+    AvlCursor cursor;
+    const int ordering = descend(tree, key, compare, cursor);
+
+    if (cursor.len == 0 || ordering != 0) {
+        return nullptr;
+    }
+
+    return AvlTree_remove_at(&tree, &cursor);
+}
+
+} // namespace avl
+
+#endif
@@ -34,6 +34,7 @@
  *  intrusive nodes.
  */
 
+#include <limits.h>
 #include <stddef.h>
 
 #ifdef __cplusplus
@@ -97,23 +98,1543 @@ typedef struct AvlTree AvlTree;
  */
 typedef struct AvlNode AvlNode;
 
+/**
+ *  Intrusive AVL tree node that also counts the nodes in its subtree.
+ *
+ *  Trees initialized by AvlTree_new_ranked or AvlTree_from_sorted_ranked
+ *  keep the count of every node up to date, which lets AvlTree_select
+ *  and AvlTree_rank run in O(log n) time. Every node inserted into such
+ *  a tree must be the node member of an AvlRankNode, for example:
+ *
+ *  @code{.c}
+ *  typedef struct Sample {
+ *      AvlRankNode node;
+ *      double latency;
+ *  } Sample;
+ *  @endcode
+ *
+ *  Trees that don't need ranks should keep using plain AvlNode, which
+ *  is one word smaller.
+ */
+typedef struct AvlRankNode AvlRankNode;
+
+/**
+ *  Bidirectional in-order cursor over an AvlTree.
+ *
+ *  A cursor holds the path from the root of a tree to the node it
+ *  points to, so stepping to the next or previous node takes
+ *  amortized constant time and never allocates. Cursors are
+ *  invalidated by any modification of the tree they point into.
+ *
+ *  @code{.c}
+ *  AvlCursor cursor;
+ *
+ *  for (AvlCursor_first(&cursor, &map); AvlCursor_get(&cursor);
+ *       AvlCursor_next(&cursor)) {
+ *      const Node *const node = (const Node*) AvlCursor_get(&cursor);
+ *  }
+ *  @endcode
+ */
+typedef struct AvlCursor AvlCursor;
+
+/**
+ *  Result of a search that a caller can insert into without searching
+ *  again.
+ *
+ *  Filled by AvlTree_entry and consumed by AvlTree_insert_entry.
+ *
+ *  @code{.c}
+ *  AvlEntry entry;
+ *  Counter *counter = (Counter*) AvlTree_entry(&counters, &entry, name,
+ *                                              compare, NULL);
+ *
+ *  if (counter) {
+ *      ++counter->count;
+ *  } else {
+ *      AvlTree_insert_entry(&counters, &entry, &make_counter(name)->node);
+ *  }
+ *  @endcode
+ */
+typedef struct AvlEntry AvlEntry;
+
+/**
+ *  Counts of the work an AvlTree has done since it was initialized.
+ *
+ *  Only counted if libbloodhound is built with BLOODHOUND_STATS
+ *  defined; otherwise AvlTree_stats reports zeroes. Every AvlTree has
+ *  room for its counters either way, so code built without the macro
+ *  can link against a library built with it. Searches made by the
+ *  templates in avl_tree.h are not counted, but the rebalancing they
+ *  hand to AvlTree_insert_at and AvlTree_remove_at is.
+ *
+ *  Operations that modify a tree count into the tree itself with plain
+ *  adds, since only one thread may modify a tree at a time. Lookups,
+ *  which may run on one tree from many threads at once, only count
+ *  into the AvlTreeStats given to AvlTree_set_lookup_stats. With GCC
+ *  and Clang those counts are atomic, so they are safe to keep while
+ *  readers share a tree under a read lock.
+ *
+ *  The average search depth is total_search_depth / num_searches.
+ */
+typedef struct AvlTreeStats AvlTreeStats;
+
+/**
+ *  Shape and memory layout of an AvlTree, as AvlTree_shape_report
+ *  measures it.
+ *
+ *  Taken together with AvlTreeStats, it tells why lookups got slower.
+ *  A mean_depth well above min_mean_depth means the tree is taller than
+ *  it needs to be, such as after AvlTree_relax. Few nodes per cache
+ *  line or few parent-child links within one page mean the nodes are
+ *  scattered by their allocator and each step down is a cache or TLB
+ *  miss. If neither holds, the time goes into the comparator.
+ */
+typedef struct AvlShapeReport AvlShapeReport;
+
+/**
+ *  Hooks through which libbloodhound allocates memory of its own.
+ *
+ *  Nodes are never allocated by the library. What it does allocate is
+ *  the slots of frozen snapshots, which come from the allocator of the
+ *  AvlTree they were frozen from, and the scratch stacks of tree
+ *  operations, which live on the C stack and only spill to the
+ *  allocator of their tree past AVL_MAX_HEIGHT levels. Trees without an
+ *  allocator of their own use the default, which uses malloc unless
+ *  AvlAllocator_set_default installs another.
+ *
+ *  Every allocator, the default included, counts the bytes the library
+ *  holds through it and their high-water mark. The counts are kept with
+ *  relaxed atomics if built with GCC or Clang, so threads that share an
+ *  allocator may allocate at once; otherwise they are kept without
+ *  synchronization.
+ *  A hook that returns NULL makes the library abort, as malloc does.
+ */
+typedef struct AvlAllocator AvlAllocator;
+
+/**
+ *  Read-only snapshot of an AvlTree laid out for fast lookups.
+ *
+ *  A frozen tree is an array in Eytzinger (breadth-first) order, so the
+ *  first levels of every search share a few cache lines and each step
+ *  down prefetches the levels below it instead of chasing a child
+ *  pointer. The same comparators as for AvlTree_get are used.
+ *
+ *  AvlTree_freeze stores pointers to the nodes of the tree, which keeps
+ *  the snapshot small but still visits one node per level.
+ *  AvlTree_freeze_copies stores byte-for-byte copies of the nodes
+ *  instead, so a lookup touches nothing but the snapshot; it suits
+ *  nodes whose keys are stored inline. Either way, a snapshot is
+ *  not updated by later insertions or removals on its AvlTree and must
+ *  be rebuilt by AvlFrozenTree_refreeze.
+ *
+ *  A snapshot of copies has no pointers of its own, so the same layout
+ *  doubles as an on-disk format: AvlTree_write_image saves it and
+ *  AvlFrozenTree_from_image queries a saved or mapped image in place.
+ *
+ *  @code{.c}
+ *  AvlFrozenTree frozen;
+ *
+ *  AvlTree_freeze_copies(&routes, &frozen, sizeof(Route));
+ *  route = (const Route*) AvlFrozenTree_get(&frozen, &addr, compare, NULL);
+ *  AvlFrozenTree_drop(&frozen);
+ *  @endcode
+ */
+typedef struct AvlFrozenTree AvlFrozenTree;
+
+/**
+ *  Upper bound on the height of an AvlTree.
+ *
+ *  An AvlTree with 2^64 - 1 nodes is at most 92 nodes tall, so paths
+ *  from the root can always be stored in fixed-size buffers of this
+ *  length.
+ */
+#define AVL_MAX_HEIGHT 96
+
+/**
+ *  Finds the struct that an intrusive node is a member of.
+ *
+ *  NODE must be an AvlNode*; for the const AvlNode* that lookups
+ *  return, use AVL_CONST_CONTAINER_OF.
+ *
+ *  @code{.c}
+ *  Order *const order = AVL_CONTAINER_OF(node, Order, by_price);
+ *  @endcode
+ */
+#define AVL_CONTAINER_OF(NODE, TYPE, MEMBER) \
+    ((TYPE*) (void*) ((char*) (NODE) - offsetof(TYPE, MEMBER)))
+
+/**
+ *  Finds the const struct that an intrusive node is a member of.
+ *
+ *  @code{.c}
+ *  const Order *const order = AVL_CONST_CONTAINER_OF(node, Order, by_price);
+ *  @endcode
+ */
+#define AVL_CONST_CONTAINER_OF(NODE, TYPE, MEMBER) \
+    ((const TYPE*) (const void*) ((const char*) (NODE) - offsetof(TYPE, MEMBER)))
+
+/**
+ *  Number of searches that AvlTree_get_many and AvlFrozenTree_get_many
+ *  run in lockstep.
+ */
+#define AVL_GET_MANY_LANES 8
+
+/**
+ *  AVL tree whose nodes live in one caller-provided array and link to
+ *  each other by 32-bit index.
+ *
+ *  Each AvlIndexNode is 8 bytes instead of the 24 of an AvlNode, so
+ *  three times as many links fit in each cache line on the way down a
+ *  search. An AvlIndexTree holds at most AVL_INDEX_NIL nodes and never
+ *  allocates or frees; the array is owned by the caller.
+ *
+ *  @code{.c}
+ *  typedef struct Entry {
+ *      AvlIndexNode node;
+ *      unsigned key;
+ *  } Entry;
+ *
+ *  Entry entries[1024];
+ *  AvlIndexTree tree;
+ *
+ *  AvlIndexTree_new(&tree, entries, sizeof(Entry), compare, NULL);
+ *  entries[0].key = 42;
+ *  AvlIndexTree_insert(&tree, 0);
+ *  @endcode
+ */
+typedef struct AvlIndexTree AvlIndexTree;
+
+/**
+ *  Intrusive node of an AvlIndexTree.
+ *
+ *  Like AvlNode, AvlIndexNode should be the first member of the
+ *  element type and should not be modified by users.
+ */
+typedef struct AvlIndexNode AvlIndexNode;
+
+/** Index of a node in the array of an AvlIndexTree. */
+#if UINT_MAX >= 0xffffffffUL
+typedef unsigned int AvlIndex;
+#else
+typedef unsigned long AvlIndex;
+#endif
+
+/**
+ *  The index that marks a missing node. Node indices must be less than
+ *  this, since bits 30 and 31 of each AvlIndexNode link are reserved
+ *  for its balance factor.
+ */
+#define AVL_INDEX_NIL ((AvlIndex) 0x3fffffffUL)
+
+/**
+ *  AVL tree of intrusive nodes that keep their balance factor in the
+ *  low bits of their child pointers.
+ *
+ *  AvlCompactNode is two pointers, 16 bytes on LP64, where AvlNode is
+ *  padded to 24. The tree is otherwise used like an AvlTree, but has
+ *  only the core operations: get, insert, remove and clear.
+ *
+ *  @code{.c}
+ *  typedef struct Counter {
+ *      AvlCompactNode node;
+ *      int key;
+ *      int count;
+ *  } Counter;
+ *  @endcode
+ */
+typedef struct AvlCompactTree AvlCompactTree;
+
+/**
+ *  Intrusive node of an AvlCompactTree.
+ *
+ *  Like AvlNode, AvlCompactNode should be the first member of the
+ *  element type and should not be modified by users. Nodes must be at
+ *  least 2-byte aligned, which any struct holding a pointer is on the
+ *  platforms bloodhound supports.
+ */
+typedef struct AvlCompactNode AvlCompactNode;
+
+/**
+ *  Persistent AVL tree: one version of a tree whose versions share
+ *  nodes.
+ *
+ *  AvlPersistentTree_snapshot makes a new version in O(1) time. An
+ *  insertion or removal on a version copies only the nodes on the
+ *  path from its root that are still shared with another version,
+ *  using the cloner passed to AvlPersistentTree_new, so each change
+ *  costs O(log n) time and memory. Nodes are reference counted and
+ *  passed to the deleter once no version reaches them.
+ *
+ *  Each version must only be used by one thread at a time, but
+ *  versions that share nodes may be used and dropped from different
+ *  threads at once when compiled with GCC or Clang, which provide the
+ *  atomic builtins used for reference counts. Otherwise, all versions
+ *  that share nodes must be used from one thread.
+ *
+ *  @code{.c}
+ *  AvlPersistentTree snapshot;
+ *
+ *  AvlPersistentTree_snapshot(&accounts, &snapshot);
+ *  AvlPersistentTree_insert(&accounts, &updated->node.node);
+ *  old = (const Account*) AvlPersistentTree_get(&snapshot, &id, compare, NULL);
+ *  AvlPersistentTree_drop(&snapshot);
+ *  @endcode
+ */
+typedef struct AvlPersistentTree AvlPersistentTree;
+
+/**
+ *  Intrusive node of an AvlPersistentTree.
+ *
+ *  Like AvlNode, AvlPersistentNode should be the first member of the
+ *  element type and should not be modified by users. Nodes in an
+ *  AvlPersistentTree are shared between versions, so their contents
+ *  must not change once inserted.
+ */
+typedef struct AvlPersistentNode AvlPersistentNode;
+
+/**
+ *  AVL tree whose nodes link to their parents.
+ *
+ *  Parent links let a node be removed by pointer without searching for
+ *  it or calling the comparator, and let a traversal step from a node
+ *  to its neighbors without a cursor. This suits nodes that are also
+ *  reachable from elsewhere, such as an eviction list, at the cost of
+ *  one more pointer per node and a few more writes per rotation.
+ *
+ *  @code{.c}
+ *  typedef struct Entry {
+ *      AvlParentNode node;
+ *      struct Entry *lru_next;
+ *      int key;
+ *  } Entry;
+ *
+ *  AvlParentTree_remove_node(&entries, &oldest->node.node);
+ *  @endcode
+ */
+typedef struct AvlParentTree AvlParentTree;
+
+/**
+ *  Intrusive node of an AvlParentTree.
+ *
+ *  Like AvlNode, AvlParentNode should be the first member of the
+ *  element type and should not be modified by users.
+ */
+typedef struct AvlParentNode AvlParentNode;
+
+/**
+ *  Builds an AvlTree from a stream of nodes in ascending order.
+ *
+ *  Unlike AvlTree_from_sorted, a builder does not need to know how many
+ *  nodes there are or to see them all at once: nodes are linked into
+ *  the tree as they are pushed, and apart from the tree the builder
+ *  only holds the path to its greatest node. This suits merging sorted
+ *  runs or loading a sorted file one record at a time.
+ *
+ *  @code{.c}
+ *  AvlBuilder builder;
+ *  AvlTree tree;
+ *
+ *  AvlBuilder_new(&builder, compare, NULL, deleter, NULL);
+ *
+ *  while ((record = read_record(file))) {
+ *      AvlBuilder_push(&builder, &record->node);
+ *  }
+ *
+ *  AvlBuilder_finish(&builder, &tree);
+ *  AvlBuilder_drop(&builder);
+ *  @endcode
+ */
+typedef struct AvlBuilder AvlBuilder;
+
 /* int compare(const AvlNode *lhs, const AvlNode *rhs, void *arg); */
 typedef int (*AvlComparator)(const AvlNode*, const AvlNode*, void*);
 
-/* int compare(const void *lhs, const AvlNode *rhs, void *arg); */
-typedef int (*AvlHetComparator)(const void*, const AvlNode*, void*);
+/* int compare(const void *lhs, const AvlNode *rhs, void *arg); */
+typedef int (*AvlHetComparator)(const void*, const AvlNode*, void*);
+
+/* void traverse(void *context, const AvlNode *node); */
+typedef void (*AvlTraverseCb)(void*, const AvlNode*);
+
+/* void traverse_mut(void *context, AvlNode *node); */
+typedef void (*AvlTraverseMutCb)(void*, AvlNode*);
+
+/* void delete(AvlNode *node, void *arg); */
+typedef void (*AvlDeleter)(AvlNode*, void*);
+
+/* int compare(const void *lhs, const void *rhs, void *arg); */
+typedef int (*AvlContainerComparator)(const void*, const void*, void*);
+
+/* void delete(void *container, void *arg); */
+typedef void (*AvlContainerDeleter)(void*, void*);
+
+/* void *alloc(size_t size, void *ctx); */
+typedef void* (*AvlAllocFn)(size_t, void*);
+
+/* void *realloc(void *ptr, size_t old_size, size_t new_size, void *ctx); */
+typedef void* (*AvlReallocFn)(void*, size_t, size_t, void*);
+
+/* void free(void *ptr, size_t size, void *ctx); */
+typedef void (*AvlFreeFn)(void*, size_t, void*);
+
+/* int compare(const AvlCompactNode *lhs, const AvlCompactNode *rhs, void *arg); */
+typedef int (*AvlCompactComparator)(const AvlCompactNode*, const AvlCompactNode*, void*);
+
+/* int compare(const void *lhs, const AvlCompactNode *rhs, void *arg); */
+typedef int (*AvlCompactHetComparator)(const void*, const AvlCompactNode*, void*);
+
+/* void delete(AvlCompactNode *node, void *arg); */
+typedef void (*AvlCompactDeleter)(AvlCompactNode*, void*);
+
+/* AvlNode* clone(const AvlNode *node, void *arg); */
+typedef AvlNode* (*AvlCloner)(const AvlNode*, void*);
+
+/* int compare(const AvlIndexNode *lhs, const AvlIndexNode *rhs, void *arg); */
+typedef int (*AvlIndexComparator)(const AvlIndexNode*, const AvlIndexNode*, void*);
+
+/* int compare(const void *lhs, const AvlIndexNode *rhs, void *arg); */
+typedef int (*AvlIndexHetComparator)(const void*, const AvlIndexNode*, void*);
+
+/**
+ *  Initializes an empty AvlTree.
+ *
+ *  @param self Must not be NULL. Must not be initialized.
+ *  @param compare Must not be NULL. Will be invoked to compare nodes
+ *                 by compare(lhs, rhs, compare_arg). Return values
+ *                 should have the same meaning as strcmp and should
+ *                 form a total ordering over the set of nodes.
+ *  @param deleter Must not be NULL. Will be used to free nodes when
+ *                 they are no longer usable by the tree as if by
+ *                 deleter(node, deleter_arg).
+ */
+void AvlTree_new(AvlTree *self, AvlComparator compare, void *compare_arg,
+                 AvlDeleter deleter, void *deleter_arg);
+
+/**
+ *  Initializes an empty AvlTree of AvlRankNodes.
+ *
+ *  Equivalent to AvlTree_new, except that the tree maintains the size
+ *  of every subtree so that AvlTree_select and AvlTree_rank may be
+ *  used. Every node inserted must be the node member of an
+ *  AvlRankNode.
+ *
+ *  @param self Must not be NULL. Must not be initialized.
+ *  @param compare Must not be NULL. Will be invoked to compare nodes
+ *                 by compare(lhs, rhs, compare_arg). Return values
+ *                 should have the same meaning as strcmp and should
+ *                 form a total ordering over the set of nodes.
+ *  @param deleter Must not be NULL. Will be used to free nodes when
+ *                 they are no longer usable by the tree as if by
+ *                 deleter(node, deleter_arg).
+ */
+void AvlTree_new_ranked(AvlTree *self, AvlComparator compare, void *compare_arg,
+                        AvlDeleter deleter, void *deleter_arg);
+
+/**
+ *  Initializes an empty AvlTree of nodes that are members of a larger
+ *  struct at a known offset.
+ *
+ *  compare and deleter are passed the containing structs rather than
+ *  the nodes, so a struct with several AvlNode members can be in one
+ *  tree per member, each with its own order, without a wrapper
+ *  allocation per tree or per-comparator pointer arithmetic. Other
+ *  functions still take and return AvlNode pointers, which
+ *  AVL_CONTAINER_OF and AVL_CONST_CONTAINER_OF turn back into
+ *  containers.
+ *
+ *  self passes itself to compare and deleter, so it must not be copied
+ *  or moved while it is initialized.
+ *
+ *  @param self Must not be NULL. Must not be initialized.
+ *  @param node_offset The offset of the AvlNode member of each
+ *                     container, as given by offsetof.
+ *  @param compare Must not be NULL. Will be invoked to compare
+ *                 containers by compare(lhs, rhs, compare_arg). Return
+ *                 values should have the same meaning as strcmp and
+ *                 should form a total ordering over the set of nodes.
+ *  @param deleter Must not be NULL. Will be used to free containers
+ *                 when their nodes are no longer usable by the tree as
+ *                 if by deleter(container, deleter_arg).
+ */
+void AvlTree_new_with_offset(AvlTree *self, size_t node_offset,
+                             AvlContainerComparator compare, void *compare_arg,
+                             AvlContainerDeleter deleter, void *deleter_arg);
+
+/**
+ *  Initializes an AvlTree from an array of nodes in ascending order.
+ *
+ *  Builds a perfectly balanced tree in O(n) time without invoking
+ *  compare.
+ *
+ *  @param self Must not be NULL. Must not be initialized.
+ *  @param nodes Must not be NULL if num_nodes > 0. Must be sorted in
+ *               strictly ascending order according to compare. The
+ *               array itself is not retained.
+ *  @param compare Must not be NULL. Will be invoked to compare nodes
+ *                 by compare(lhs, rhs, compare_arg). Return values
+ *                 should have the same meaning as strcmp and should
+ *                 form a total ordering over the set of nodes.
+ *  @param deleter Must not be NULL. Will be used to free nodes when
+ *                 they are no longer usable by the tree as if by
+ *                 deleter(node, deleter_arg).
+ */
+void AvlTree_from_sorted(AvlTree *self, AvlNode **nodes, size_t num_nodes,
+                         AvlComparator compare, void *compare_arg,
+                         AvlDeleter deleter, void *deleter_arg);
+
+/**
+ *  Initializes an AvlTree of AvlRankNodes from an array of nodes in
+ *  ascending order.
+ *
+ *  Equivalent to AvlTree_from_sorted, except that the tree is ranked
+ *  as if by AvlTree_new_ranked.
+ *
+ *  @param self Must not be NULL. Must not be initialized.
+ *  @param nodes Must not be NULL if num_nodes > 0. Must be sorted in
+ *               strictly ascending order according to compare. Each
+ *               element must be the node member of an AvlRankNode.
+ *  @param compare Must not be NULL.
+ *  @param deleter Must not be NULL.
+ */
+void AvlTree_from_sorted_ranked(AvlTree *self, AvlNode **nodes, size_t num_nodes,
+                                AvlComparator compare, void *compare_arg,
+                                AvlDeleter deleter, void *deleter_arg);
+
+/**
+ *  Initializes an empty AvlBuilder.
+ *
+ *  @param self Must not be NULL. Must not be initialized.
+ *  @param compare Must not be NULL. Will be passed on to the tree
+ *                 built by AvlBuilder_finish, and is only invoked by
+ *                 AvlBuilder_push to check its precondition when
+ *                 assertions are enabled.
+ *  @param deleter Must not be NULL. Will be used to free nodes when
+ *                 they are no longer usable by the builder or its tree
+ *                 as if by deleter(node, deleter_arg).
+ */
+void AvlBuilder_new(AvlBuilder *self, AvlComparator compare, void *compare_arg,
+                    AvlDeleter deleter, void *deleter_arg);
+
+/**
+ *  Initializes an empty AvlBuilder of AvlRankNodes.
+ *
+ *  Equivalent to AvlBuilder_new, except that AvlBuilder_finish yields
+ *  a tree ranked as if by AvlTree_new_ranked. Each push then also
+ *  updates the sizes along the right spine, so it takes O(log n) time.
+ *
+ *  @param self Must not be NULL. Must not be initialized.
+ *  @param compare Must not be NULL.
+ *  @param deleter Must not be NULL.
+ */
+void AvlBuilder_new_ranked(AvlBuilder *self, AvlComparator compare, void *compare_arg,
+                           AvlDeleter deleter, void *deleter_arg);
+
+/**
+ *  Drops an AvlBuilder, deleting every node pushed since it was
+ *  initialized or last finished.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ */
+void AvlBuilder_drop(AvlBuilder *self);
+
+/**
+ *  Appends a node that compares greater than every node pushed so far.
+ *
+ *  The node becomes the right child of the greatest node, then the
+ *  right spine is rebalanced exactly as AvlTree_insert_at would, so
+ *  pushes take amortized O(1) time and never invoke compare outside
+ *  of assertions.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param node Must not be NULL. Must compare strictly greater than
+ *              the node pushed before it. Must be the node member of
+ *              an AvlRankNode if self was initialized by
+ *              AvlBuilder_new_ranked.
+ */
+void AvlBuilder_push(AvlBuilder *self, AvlNode *node);
+
+/**
+ *  Moves every node pushed into an AvlBuilder into a new AvlTree.
+ *
+ *  Runs in O(1) time: the builder keeps a valid AvlTree at all times,
+ *  so there is nothing left to link or rebalance. Afterwards self is
+ *  empty and will build another tree with the same comparator and
+ *  deleter.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param tree Must not be NULL. Must not be initialized. Will be
+ *              initialized with every node pushed into self and with
+ *              the comparator and deleter of self.
+ */
+void AvlBuilder_finish(AvlBuilder *self, AvlTree *tree);
+
+/**
+ *  Drops an AvlTree, removing all members.
+ *
+ *  Equivalent to AvlTree_clear.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ */
+void AvlTree_drop(AvlTree *self);
+
+/**
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @returns A pointer to the node that compares equal to key, if
+ *           there is one.
+ */
+const AvlNode* AvlTree_get(const AvlTree *self, const void *key,
+                           AvlHetComparator compare, void *arg);
+
+/**
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @returns A mutable pointer to the node that compares equal to key,
+ *           if there is one.
+ */
+AvlNode* AvlTree_get_mut(AvlTree *self, const void *key, AvlHetComparator compare, void *arg);
+
+/**
+ *  Looks up a batch of keys, interleaving their searches.
+ *
+ *  Runs up to AVL_GET_MANY_LANES searches in lockstep, prefetching
+ *  the next node of each while the others are compared, so the cache
+ *  misses of one search overlap with work on the rest. Equivalent to
+ *  calling AvlTree_get on each key.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param keys Must not be NULL if num_keys > 0. Each element is
+ *              passed to compare as the key to look up.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @param found Must not be NULL if num_keys > 0. Element i will be
+ *               set to the node that compares equal to keys[i], or
+ *               NULL if there is none.
+ */
+void AvlTree_get_many(const AvlTree *self, const void *const *keys, size_t num_keys,
+                      AvlHetComparator compare, void *arg, const AvlNode **found);
+
+/**
+ *  Finds the node with a given position in the in-order sequence of a
+ *  ranked AvlTree.
+ *
+ *  Runs in O(log n) time.
+ *
+ *  @param self Must not be NULL. Must be initialized by
+ *              AvlTree_new_ranked or AvlTree_from_sorted_ranked.
+ *  @param index The number of nodes that compare less than the node to
+ *               find.
+ *  @returns A pointer to the node, or NULL if index >= self->len.
+ */
+const AvlNode* AvlTree_select(const AvlTree *self, size_t index);
+
+/**
+ *  Finds the node with a given position in the in-order sequence of a
+ *  ranked AvlTree.
+ *
+ *  Runs in O(log n) time.
+ *
+ *  @param self Must not be NULL. Must be initialized by
+ *              AvlTree_new_ranked or AvlTree_from_sorted_ranked.
+ *  @param index The number of nodes that compare less than the node to
+ *               find.
+ *  @returns A mutable pointer to the node, or NULL if
+ *           index >= self->len.
+ */
+AvlNode* AvlTree_select_mut(AvlTree *self, size_t index);
+
+/**
+ *  Counts the nodes of a ranked AvlTree that compare less than a key.
+ *
+ *  Runs in O(log n) time. If a node compares equal to key,
+ *  AvlTree_select with the result finds that node.
+ *
+ *  @param self Must not be NULL. Must be initialized by
+ *              AvlTree_new_ranked or AvlTree_from_sorted_ranked.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlTree_new_ranked. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @returns The number of nodes that compare less than key.
+ */
+size_t AvlTree_rank(const AvlTree *self, const void *key, AvlHetComparator compare, void *arg);
+
+/**
+ *  Points a cursor at the least node that does not compare less than
+ *  a key.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @param cursor Must not be NULL. Will point to the least node such
+ *                that compare(key, node, arg) <= 0, or past the end if
+ *                there is no such node.
+ */
+void AvlTree_lower_bound(const AvlTree *self, const void *key, AvlHetComparator compare,
+                         void *arg, AvlCursor *cursor);
+
+/**
+ *  Points a cursor at the least node that compares greater than a
+ *  key.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @param cursor Must not be NULL. Will point to the least node such
+ *                that compare(key, node, arg) < 0, or past the end if
+ *                there is no such node.
+ */
+void AvlTree_upper_bound(const AvlTree *self, const void *key, AvlHetComparator compare,
+                         void *arg, AvlCursor *cursor);
+
+/**
+ *  Finds the range of nodes that compare equal to a key.
+ *
+ *  Since compare only needs to be consistent with the ordering of the
+ *  tree, this doubles as a range query: a comparator that returns 0
+ *  for every node inside [lower, upper] and orders the key before or
+ *  after every other node will yield exactly those nodes. Visiting k
+ *  nodes this way takes O(log n + k) time.
+ *
+ *  @code{.c}
+ *  AvlCursor first;
+ *  AvlCursor last;
+ *
+ *  AvlTree_equal_range(&map, &window, window_compare, NULL, &first, &last);
+ *
+ *  for (; AvlCursor_get(&first) != AvlCursor_get(&last); AvlCursor_next(&first)) {
+ *      const Node *const node = (const Node*) AvlCursor_get(&first);
+ *  }
+ *  @endcode
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @param first Must not be NULL. Will be initialized as if by
+ *               AvlTree_lower_bound.
+ *  @param last Must not be NULL. Will be initialized as if by
+ *              AvlTree_upper_bound.
+ */
+void AvlTree_equal_range(const AvlTree *self, const void *key, AvlHetComparator compare,
+                         void *arg, AvlCursor *first, AvlCursor *last);
+
+/**
+ *  Inserts an element into an AvlTree.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param node Must not be NULL.
+ *  @returns The previous element that compares equal to node, if there
+ *           was one.
+ */
+AvlNode* AvlTree_insert(AvlTree *self, AvlNode *node);
+
+/**
+ *  Inserts an array of elements into an AvlTree.
+ *
+ *  Equivalent to calling AvlTree_insert on each node in order, but
+ *  each search starts from the path to the previously inserted node
+ *  and only climbs as far as needed to find a subtree that contains
+ *  the next node. Batches of nearby or sorted keys skip most of the
+ *  comparisons and cache misses near the root; unsorted batches are
+ *  still correct, but gain little.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param nodes Must not be NULL if num_nodes > 0. Each element must
+ *               not be NULL and will be replaced with the previous
+ *               element that compared equal to it, if there was one,
+ *               or NULL otherwise.
+ */
+void AvlTree_insert_batch(AvlTree *self, AvlNode **nodes, size_t num_nodes);
+
+/**
+ *  Inserts an element into an AvlTree if no element with a matching
+ *  key is found.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlTree_new. Will be invoked by
+ *                 compare(key, node, compare_arg).
+ *  @param insert Must not be NULL. If no element that compares equal
+ *                to key is found, will be invoked by
+ *                insert(key, insert_arg) to obtain a new node. Its
+ *                return value must compare equal to key.
+ *  @param inserted If not NULL, will be set to 1 if insert was called.
+ *                  Otherwise will be set to 0.
+ *  @returns The element that compares equal to key or was just
+ *           inserted.
+ */
+AvlNode* AvlTree_get_or_insert(AvlTree *self, const void *key, AvlHetComparator compare,
+                               void *compare_arg, AvlNode* (*insert)(const void*, void*),
+                               void *insert_arg, int *inserted);
+
+/**
+ *  Removes the node that compares equal to a key.
+ *
+ *  @param self Must not be NULL.
+ *  @param compare Must not be NULL. Must form the same total
+ *                 ordering over the set of nodes as the one
+ *                 passed to AvlTree_new. Will be invoked to compare
+ *                 the key to nodes by compare(key, node, arg).
+ *  @returns The node that compared equal to key, if there was one.
+ */
+AvlNode* AvlTree_remove(AvlTree *self, const void *key, AvlHetComparator compare, void *arg);
+
+/**
+ *  Makes AvlTree_insert and AvlTree_remove defer rebalancing.
+ *
+ *  A relaxed write only links or unlinks its node and marks the nodes
+ *  above it as stale, so it does a search and a few stores but never
+ *  rotates or retraces. Lookups and cursors stay correct and only get
+ *  slower as the tree drifts out of balance, but no other function may
+ *  modify self, and AvlTree_select and AvlTree_rank may be wrong, until
+ *  it is repaired by AvlTree_rebalance_step or AvlTree_rebalance. A
+ *  write that would make self too tall for an AvlCursor repairs it
+ *  first.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ */
+void AvlTree_relax(AvlTree *self);
+
+/**
+ *  Repairs some of the nodes made stale by relaxed writes.
+ *
+ *  Stale nodes are repaired from the bottom up by joining their
+ *  already balanced subtrees, so each takes O(log n) time and a call
+ *  takes O(budget log n) time. self stays relaxed.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param budget The most stale nodes to repair.
+ *  @returns Nonzero if self is balanced.
+ */
+int AvlTree_rebalance_step(AvlTree *self, size_t budget);
+
+/**
+ *  Repairs every node made stale by relaxed writes and makes later
+ *  writes rebalance as usual.
+ *
+ *  Takes O(k log n) time, where k is the number of nodes on the paths
+ *  written to since self was last balanced.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ */
+void AvlTree_rebalance(AvlTree *self);
+
+/**
+ *  Inserts a node below the end of a path found by the caller.
+ *
+ *  Lets callers that search the tree themselves, such as the C++
+ *  templates in avl_tree.h, reuse the rebalancing of AvlTree_insert.
+ *  Runs in O(log n) time without invoking any comparator.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param parent Must not be NULL. Must hold the path from the root of
+ *                self to the node that will become the parent of node,
+ *                or be empty if self is empty. Will be invalidated.
+ *  @param ordering If negative, node becomes the left child of the
+ *                  node parent points to; if positive, its right
+ *                  child. That child must be NULL. Ignored if self is
+ *                  empty.
+ *  @param node Must not be NULL. Must compare between the neighbors of
+ *              the slot it is inserted into.
+ */
+void AvlTree_insert_at(AvlTree *self, AvlCursor *parent, int ordering, AvlNode *node);
+
+/**
+ *  Replaces the node a cursor points to with an equal node.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param cursor Must not be NULL. Must point to a node of self.
+ *  @param node Must not be NULL. Must compare equal to the node cursor
+ *              points to, which it takes the place of in self and in
+ *              cursor.
+ *  @returns The node that was replaced.
+ */
+AvlNode* AvlTree_replace_at(AvlTree *self, AvlCursor *cursor, AvlNode *node);
+
+/**
+ *  Removes the node a cursor points to.
+ *
+ *  Lets callers that search the tree themselves reuse the rebalancing
+ *  of AvlTree_remove. Runs in O(log n) time without invoking any
+ *  comparator.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param cursor Must not be NULL. Must point to a node of self. Will
+ *                be left pointing past the end.
+ *  @returns The node that was removed.
+ */
+AvlNode* AvlTree_remove_at(AvlTree *self, AvlCursor *cursor);
+
+/**
+ *  Removes the node a cursor points to and passes it to the deleter.
+ *
+ *  Runs in O(log n) time without invoking any comparator.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param cursor Must not be NULL. Must point to a node of self. Will
+ *                be left pointing past the end.
+ */
+void AvlTree_erase_at(AvlTree *self, AvlCursor *cursor);
+
+/**
+ *  Finds the node that compares equal to a key, starting from where a
+ *  previous search left off.
+ *
+ *  Only climbs from the end of finger as far as needed to find a
+ *  subtree that contains key, then descends from there. finger is a
+ *  path from the root with no links between neighbors, so a key next
+ *  to the last one but across a high ancestor still takes O(log n)
+ *  comparisons in the worst case. Over a monotone sweep through
+ *  consecutive keys, each step takes amortized O(1) comparisons.
+ *  Equivalent to AvlTree_get otherwise.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param finger Must not be NULL. Must be past the end or point to a
+ *                node of self, and self must not have been modified
+ *                since except through functions that were passed
+ *                finger. Will be left pointing at the node that
+ *                compares equal to key or, if there isn't one, the
+ *                node that would become its parent.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @returns The node that compares equal to key, if there is one.
+ */
+const AvlNode* AvlTree_get_from(const AvlTree *self, AvlCursor *finger, const void *key,
+                                AvlHetComparator compare, void *arg);
+
+/**
+ *  Inserts an element into an AvlTree, starting the search from where
+ *  a previous one left off.
+ *
+ *  Equivalent to AvlTree_insert, but only climbs from the end of
+ *  finger as far as needed, like AvlTree_get_from: O(log n) time in
+ *  the worst case, amortized O(1) per step of a monotone sweep.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param finger Must not be NULL. Must be past the end or point to a
+ *                node of self, and self must not have been modified
+ *                since except through functions that were passed
+ *                finger. Will be left pointing at node or one of its
+ *                ancestors.
+ *  @param node Must not be NULL.
+ *  @returns The previous element that compares equal to node, if there
+ *           was one.
+ */
+AvlNode* AvlTree_insert_from(AvlTree *self, AvlCursor *finger, AvlNode *node);
+
+/**
+ *  Removes the node that compares equal to a key, starting the search
+ *  from where a previous one left off.
+ *
+ *  Equivalent to AvlTree_remove, but only climbs from the end of
+ *  finger as far as needed, like AvlTree_get_from: O(log n) time in
+ *  the worst case, amortized O(1) per step of a monotone sweep.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param finger Must not be NULL. Must be past the end or point to a
+ *                node of self, and self must not have been modified
+ *                since except through functions that were passed
+ *                finger. Will be left pointing at a node near the one
+ *                that was removed, or past the end.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @returns The node that compared equal to key, if there was one.
+ */
+AvlNode* AvlTree_remove_from(AvlTree *self, AvlCursor *finger, const void *key,
+                             AvlHetComparator compare, void *arg);
+
+/**
+ *  Searches an AvlTree once, for a later insertion or replacement.
+ *
+ *  Lets a caller decide what to do about a key after a single search:
+ *  if a node compares equal to key, it can be updated in place or
+ *  passed with entry->cursor to AvlTree_replace_at or
+ *  AvlTree_remove_at; otherwise a node can be built only then and
+ *  linked by AvlTree_insert_entry without searching again. Either way,
+ *  nothing has to be allocated up front and thrown away.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param entry Must not be NULL. Will be filled with the path from the
+ *               root to the node that compares equal to key or, if
+ *               there isn't one, to the node that would become its
+ *               parent. Invalidated by any modification of self except
+ *               through functions that are passed entry.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @returns The node that compares equal to key, if there is one.
+ */
+AvlNode* AvlTree_entry(AvlTree *self, AvlEntry *entry, const void *key,
+                       AvlHetComparator compare, void *arg);
+
+/**
+ *  Inserts a node into the slot a search by AvlTree_entry found empty.
+ *
+ *  Runs in O(log n) time without invoking any comparator.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param entry Must not be NULL. Must have been filled by
+ *               AvlTree_entry, which must have returned NULL, and self
+ *               must not have been modified since. Will be
+ *               invalidated.
+ *  @param node Must not be NULL. Must compare equal to the key that was
+ *              passed to AvlTree_entry.
+ */
+void AvlTree_insert_entry(AvlTree *self, AvlEntry *entry, AvlNode *node);
+
+/**
+ *  Splits an AvlTree around a key in O(log n) time if it is ranked, or
+ *  O(log n + min(l, r)) time otherwise, where l and r are the number
+ *  of nodes on either side of key.
+ *
+ *  An unranked tree counts the nodes of the smaller half to keep len
+ *  accurate; a ranked one reads the counts from the subtree sizes.
+ *
+ *  @param self Must not be NULL. Must be initialized. Will retain the
+ *              nodes that compare less than key.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @param right Must not be NULL. Must not be initialized. Will be
+ *               initialized with the same comparator and deleter as
+ *               self and will receive the nodes that compare greater
+ *               than key.
+ *  @returns The node that compared equal to key, if there was one. It
+ *           is in neither tree and is not passed to the deleter.
+ */
+AvlNode* AvlTree_split(AvlTree *self, const void *key, AvlHetComparator compare, void *arg,
+                       AvlTree *right);
+
+/**
+ *  Appends a pivot and every node of another AvlTree to an AvlTree.
+ *
+ *  Runs in O(log n) time.
+ *
+ *  @param self Must not be NULL. Must be initialized. Every node in
+ *              self must compare less than pivot and every node in
+ *              right.
+ *  @param pivot If not NULL, must compare less than every node in
+ *               right and must not be in self or right.
+ *  @param right Must not be NULL. Must be initialized. Must form the
+ *               same ordering as self. Will be left empty.
+ */
+void AvlTree_join(AvlTree *self, AvlNode *pivot, AvlTree *right);
+
+/**
+ *  Removes and deletes every node in a range of an AvlTree.
+ *
+ *  Cuts the range out with two splits and a join instead of removing
+ *  its nodes one by one, so restructuring the tree takes O(log n) time
+ *  and O(log n) comparisons however long the range is. Deleting the
+ *  nodes adds O(k) time for a range of k nodes.
+ *
+ *  @param self Must not be NULL. Must be initialized. Nodes in the
+ *              range are passed to its deleter.
+ *  @param first Must not be NULL. Must point to a node of self or past
+ *               the end. The first node to remove.
+ *  @param last Must not be NULL. Must point to a node of self that
+ *              does not compare less than the one first points to, or
+ *              past the end. The first node after the range, which is
+ *              kept. Both cursors are invalidated.
+ *  @returns The number of nodes removed.
+ */
+size_t AvlTree_erase_range(AvlTree *self, const AvlCursor *first, const AvlCursor *last);
+
+/**
+ *  Moves every node of another AvlTree into an AvlTree.
+ *
+ *  Runs in O(m log(n / m + 1)) time, where m is the number of nodes in
+ *  the smaller tree and n is the number of nodes in the larger tree.
+ *
+ *  @param self Must not be NULL. Must be initialized. If a node in self
+ *              compares equal to a node in other, the node in self is
+ *              kept.
+ *  @param other Must not be NULL. Must be initialized. Must form the
+ *               same ordering as self. Will be left empty. Nodes that
+ *               compare equal to a node in self are passed to the
+ *               deleter of other.
+ */
+void AvlTree_union(AvlTree *self, AvlTree *other);
+
+/**
+ *  Removes every node of an AvlTree that does not compare equal to a
+ *  node in another AvlTree.
+ *
+ *  Runs in O(m log(n / m + 1)) time, plus the cost of deleting nodes,
+ *  where m is the number of nodes in the smaller tree and n is the
+ *  number of nodes in the larger tree.
+ *
+ *  @param self Must not be NULL. Must be initialized. Nodes that do
+ *              not compare equal to a node in other are passed to the
+ *              deleter of self.
+ *  @param other Must not be NULL. Must be initialized. Must form the
+ *               same ordering as self. Will be left empty; all of its
+ *               nodes are passed to its deleter.
+ */
+void AvlTree_intersection(AvlTree *self, AvlTree *other);
+
+/**
+ *  Removes every node of an AvlTree that compares equal to a node in
+ *  another AvlTree.
+ *
+ *  Runs in O(m log(n / m + 1)) time, plus the cost of deleting nodes,
+ *  where m is the number of nodes in the smaller tree and n is the
+ *  number of nodes in the larger tree.
+ *
+ *  @param self Must not be NULL. Must be initialized. Nodes that
+ *              compare equal to a node in other are passed to the
+ *              deleter of self.
+ *  @param other Must not be NULL. Must be initialized. Must form the
+ *               same ordering as self. Will be left empty; all of its
+ *               nodes are passed to its deleter.
+ */
+void AvlTree_difference(AvlTree *self, AvlTree *other);
+
+/**
+ *  Clears the tree, removing all members.
+ *
+ *  Equivalent to AvlTree_clear_with(self, self->deleter,
+ *  self->deleter_arg).
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ */
+void AvlTree_clear(AvlTree *self);
+
+/**
+ *  Clears the tree, removing all members, with a different deleter.
+ *
+ *  Nodes are visited in pre-order by chasing child pointers and are
+ *  never written to, so the deleter may free them immediately.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param deleter If NULL, the tree is reset in O(1) time and its
+ *                 nodes are not visited; use this when they are owned
+ *                 elsewhere, such as by an arena. Otherwise, will be
+ *                 invoked on each node as if by deleter(node,
+ *                 deleter_arg).
+ */
+void AvlTree_clear_with(AvlTree *self, AvlDeleter deleter, void *deleter_arg);
+
+/**
+ *  Invokes a callback on each node of an AvlTree in order.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param traverse Must not be NULL. Will be invoked on each node as
+ *                  if by traverse(arg, node). Must not modify self.
+ */
+void AvlTree_traverse(const AvlTree *self, AvlTraverseCb traverse, void *arg);
+
+/**
+ *  Invokes a callback on each node of an AvlTree in order.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param traverse Must not be NULL. Will be invoked on each node as
+ *                  if by traverse(arg, node). May modify the contents
+ *                  of each node, but must not change its ordering
+ *                  relative to the other nodes or modify self.
+ */
+void AvlTree_traverse_mut(AvlTree *self, AvlTraverseMutCb traverse, void *arg);
+
+/**
+ *  Reads the counters of the operations that modified an AvlTree.
+ *
+ *  Lookups are not included; see AvlTree_set_lookup_stats.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param stats Must not be NULL. Will be set to the counters of self,
+ *               or to all zeroes if BLOODHOUND_STATS is not defined.
+ */
+void AvlTree_stats(const AvlTree *self, AvlTreeStats *stats);
+
+/**
+ *  Makes the lookups on an AvlTree count into caller-owned counters.
+ *
+ *  Counted lookups are the functions that search a tree without
+ *  modifying it, such as AvlTree_get, AvlTree_get_many, AvlTree_get_from
+ *  and AvlTree_lower_bound. Counts are only kept if libbloodhound is
+ *  built with BLOODHOUND_STATS defined. With GCC and Clang they are
+ *  added atomically, so lookups on different threads may share one
+ *  sink; read it with __atomic_load_n while they run. Otherwise
+ *  lookups that share a sink must not run concurrently.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param lookup_stats If NULL, lookups are not counted. Otherwise
+ *                      must be initialized, such as to all zeroes, and
+ *                      must outlive its use by self and by the trees
+ *                      AvlTree_split splits from it.
+ */
+void AvlTree_set_lookup_stats(AvlTree *self, AvlTreeStats *lookup_stats);
+
+/**
+ *  Measures the shape and memory layout of an AvlTree.
+ *
+ *  Visits every node once, so it runs in O(n log n) time (to count the
+ *  cache lines nodes occupy) and should not be used on hot paths. Only
+ *  node addresses are read; node contents are never dereferenced past
+ *  their AvlNode member. Relaxed trees are measured as they are.
+ *  Scratch space comes from the allocator of self.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param report Must not be NULL. Will be set to the shape of self.
+ */
+void AvlTree_shape_report(const AvlTree *self, AvlShapeReport *report);
+
+/**
+ *  Initializes an AvlAllocator with zeroed counters.
+ *
+ *  @param self Must not be NULL. Must not be initialized.
+ *  @param alloc_fn Must not be NULL. Will be invoked by
+ *                  alloc_fn(size, ctx) to allocate memory aligned for
+ *                  any object.
+ *  @param realloc_fn Must not be NULL. Will be invoked by
+ *                    realloc_fn(ptr, old_size, new_size, ctx) to resize
+ *                    memory it or alloc_fn returned, preserving its
+ *                    contents as realloc() does.
+ *  @param free_fn Must not be NULL. Will be invoked by free_fn(ptr,
+ *                 size, ctx) to release memory alloc_fn or realloc_fn
+ *                 returned, where size is the size it was last
+ *                 requested with.
+ */
+void AvlAllocator_new(AvlAllocator *self, AvlAllocFn alloc_fn, AvlReallocFn realloc_fn,
+                      AvlFreeFn free_fn, void *ctx);
+
+/**
+ *  Installs the allocator for memory not tied to a particular AvlTree.
+ *
+ *  Must not be called while any tree is in use, and memory must be
+ *  freed by the allocator that allocated it, so no snapshot frozen
+ *  from a tree without an allocator of its own may still be live.
+ *
+ *  @param allocator If NULL, the malloc-based default is restored.
+ *                   Otherwise must be initialized and must outlive its
+ *                   use as the default.
+ */
+void AvlAllocator_set_default(AvlAllocator *allocator);
+
+/**
+ *  @returns The allocator for memory not tied to a particular AvlTree,
+ *           including the malloc-based one that is installed unless
+ *           AvlAllocator_set_default says otherwise.
+ */
+AvlAllocator* AvlAllocator_get_default(void);
+
+/**
+ *  Makes snapshots of an AvlTree, and the scratch stacks of its
+ *  operations, allocate through an allocator.
+ *
+ *  @param self Must not be NULL. Must be initialized. Must not be in
+ *              the middle of an operation.
+ *  @param allocator If NULL, the allocator that is the default when
+ *                   memory is allocated is used. Otherwise must be
+ *                   initialized and must outlive every snapshot of
+ *                   self.
+ */
+void AvlTree_set_allocator(AvlTree *self, AvlAllocator *allocator);
+
+/**
+ *  Points a cursor at the least node of an AvlTree.
+ *
+ *  @param self Must not be NULL.
+ *  @param tree Must not be NULL. Must be initialized. If empty, self
+ *              will point past the end.
+ */
+void AvlCursor_first(AvlCursor *self, const AvlTree *tree);
+
+/**
+ *  Points a cursor at the greatest node of an AvlTree.
+ *
+ *  @param self Must not be NULL.
+ *  @param tree Must not be NULL. Must be initialized. If empty, self
+ *              will point past the end.
+ */
+void AvlCursor_last(AvlCursor *self, const AvlTree *tree);
+
+/**
+ *  Advances a cursor to the in-order successor of its node.
+ *
+ *  @param self Must not be NULL. Must be initialized. If it points to
+ *              the greatest node, it will point past the end. If it
+ *              already points past the end, this is a noop.
+ */
+void AvlCursor_next(AvlCursor *self);
+
+/**
+ *  Moves a cursor to the in-order predecessor of its node.
+ *
+ *  @param self Must not be NULL. Must be initialized. If it points to
+ *              the least node, it will point past the end. If it
+ *              already points past the end, this is a noop.
+ */
+void AvlCursor_prev(AvlCursor *self);
+
+/**
+ *  @param self Must not be NULL. Must be initialized.
+ *  @returns The node self points to, or NULL if self points past the
+ *           end.
+ */
+const AvlNode* AvlCursor_get(const AvlCursor *self);
+
+/**
+ *  @param self Must not be NULL. Must be initialized.
+ *  @returns A mutable pointer to the node self points to, or NULL if
+ *           self points past the end.
+ */
+AvlNode* AvlCursor_get_mut(AvlCursor *self);
+
+/**
+ *  Takes a read-only snapshot of the nodes of an AvlTree.
+ *
+ *  Runs in O(n) time and allocates one pointer per node. Lookups on
+ *  frozen return the nodes of self, which must outlive it.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param frozen Must not be NULL. Must not be initialized.
+ */
+void AvlTree_freeze(const AvlTree *self, AvlFrozenTree *frozen);
+
+/**
+ *  Takes a read-only snapshot of copies of the nodes of an AvlTree.
+ *
+ *  Runs in O(n) time and allocates node_size bytes per node. Lookups
+ *  on frozen return pointers to the copies, which the comparators
+ *  and the caller may read as if they were the original nodes.
+ *
+ *  @param self Must not be NULL. Must be initialized. Must not have
+ *              been initialized by AvlTree_new_with_offset with a
+ *              nonzero node_offset, since its nodes are not at the
+ *              start of their containers; freeze it with
+ *              AvlTree_freeze instead.
+ *  @param frozen Must not be NULL. Must not be initialized.
+ *  @param node_size The size of the type that contains each node, such
+ *                   as sizeof(Node). Every node must be at the start
+ *                   of an object of that size that can be copied with
+ *                   memcpy.
+ */
+void AvlTree_freeze_copies(const AvlTree *self, AvlFrozenTree *frozen, size_t node_size);
+
+/**
+ *  Rebuilds a snapshot after its AvlTree was modified.
+ *
+ *  Reuses the memory of self if it is large enough. Snapshots of
+ *  copies stay snapshots of copies.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param tree Must not be NULL. Must be initialized. Need not be the
+ *              tree self was frozen from. If self holds copies, must
+ *              be a tree AvlTree_freeze_copies accepts.
+ */
+void AvlFrozenTree_refreeze(AvlFrozenTree *self, const AvlTree *tree);
+
+/**
+ *  Drops a snapshot. The nodes it points to are not affected.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ */
+void AvlFrozenTree_drop(AvlFrozenTree *self);
+
+/**
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param node_size As for AvlTree_freeze_copies.
+ *  @returns The number of bytes AvlTree_write_image writes for self.
+ */
+size_t AvlTree_image_size(const AvlTree *self, size_t node_size);
+
+/**
+ *  Writes a relocatable image of copies of the nodes of an AvlTree.
+ *
+ *  The image holds the same Eytzinger-ordered slots as a snapshot by
+ *  AvlTree_freeze_copies, which link to each other by position rather
+ *  than by pointer, so it can be saved to a file and later mapped at
+ *  any address and queried through AvlFrozenTree_from_image without
+ *  being parsed. Nodes are copied during one in-order pass of a
+ *  cursor, straight into their slots, so nothing is allocated. The
+ *  AvlNode member of each copy is zeroed; the rest must not hold
+ *  pointers if the image is to outlive the process.
+ *
+ *  @param self Must not be NULL. Must be initialized. As for
+ *              AvlTree_freeze_copies, its nodes must be at the start
+ *              of their containers.
+ *  @param node_size As for AvlTree_freeze_copies.
+ *  @param image Must not be NULL. Must point to
+ *               AvlTree_image_size(self, node_size) writable bytes,
+ *               aligned for the type that contains each node.
+ */
+void AvlTree_write_image(const AvlTree *self, size_t node_size, void *image);
+
+/**
+ *  Views an image written by AvlTree_write_image as a snapshot.
+ *
+ *  Runs in O(1) time and neither copies nor allocates: lookups read
+ *  the image in place and return pointers into it, so a mapped file
+ *  is only paged in as lookups touch it, and processes that map the
+ *  same file share its pages.
+ *
+ *  @param self Must not be NULL. Must not be initialized. Will be
+ *              initialized as a snapshot of copies that must be
+ *              dropped before the image is unmapped or freed, and
+ *              that AvlFrozenTree_refreeze moves into new memory.
+ *  @param image Must not be NULL. Is only read, so it may be a
+ *               read-only mapping. Must be aligned for the type that
+ *               contains each node.
+ *  @param size The number of bytes readable at image.
+ *  @returns Nonzero if image holds a valid image written on a machine
+ *           with the same byte order and word size, in which case self
+ *           is initialized; otherwise self is left uninitialized.
+ */
+int AvlFrozenTree_from_image(AvlFrozenTree *self, const void *image, size_t size);
+
+/**
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @returns A pointer to the node that compares equal to key, if
+ *           there is one.
+ */
+const AvlNode* AvlFrozenTree_get(const AvlFrozenTree *self, const void *key,
+                                 AvlHetComparator compare, void *arg);
+
+/**
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @returns A pointer to the least node such that
+ *           compare(key, node, arg) <= 0, if there is one.
+ */
+const AvlNode* AvlFrozenTree_lower_bound(const AvlFrozenTree *self, const void *key,
+                                         AvlHetComparator compare, void *arg);
+
+/**
+ *  Looks up a batch of keys, interleaving their searches.
+ *
+ *  Equivalent to calling AvlFrozenTree_get on each key, but runs up to
+ *  AVL_GET_MANY_LANES searches in lockstep like AvlTree_get_many.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param keys Must not be NULL if num_keys > 0. Each element is
+ *              passed to compare as the key to look up.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @param found Must not be NULL if num_keys > 0. Element i will be
+ *               set to the node that compares equal to keys[i], or
+ *               NULL if there is none.
+ */
+void AvlFrozenTree_get_many(const AvlFrozenTree *self, const void *const *keys,
+                            size_t num_keys, AvlHetComparator compare, void *arg,
+                            const AvlNode **found);
+
+/**
+ *  Initializes an empty AvlIndexTree over an array of nodes.
+ *
+ *  @param self Must not be NULL. Must not be initialized.
+ *  @param nodes Must not be NULL. Must point to an array of elements
+ *               that each begin with an AvlIndexNode. Must outlive
+ *               self. Since links are indices, the array may be moved
+ *               as long as self->nodes is updated to its new address.
+ *  @param stride The size in bytes of each element of nodes. Must be
+ *                at least sizeof(AvlIndexNode).
+ *  @param compare Must not be NULL. Will be invoked to compare nodes
+ *                 by compare(lhs, rhs, compare_arg). Return values
+ *                 should have the same meaning as strcmp and should
+ *                 form a total ordering over the set of nodes.
+ */
+void AvlIndexTree_new(AvlIndexTree *self, void *nodes, size_t stride,
+                      AvlIndexComparator compare, void *compare_arg);
+
+/**
+ *  Finds the node of an AvlIndexTree that compares equal to a key.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlIndexTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @returns The index of the matching node, or AVL_INDEX_NIL if there
+ *           is none.
+ */
+AvlIndex AvlIndexTree_get(const AvlIndexTree *self, const void *key,
+                          AvlIndexHetComparator compare, void *arg);
+
+/**
+ *  Inserts a node into an AvlIndexTree or replaces the node that
+ *  compares equal to it.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param index Must be less than AVL_INDEX_NIL. The node at index in
+ *               the array passed to AvlIndexTree_new must not already
+ *               be in the tree. Its links will be overwritten.
+ *  @returns The index of the replaced node, or AVL_INDEX_NIL if no
+ *           node compared equal to the inserted one.
+ */
+AvlIndex AvlIndexTree_insert(AvlIndexTree *self, AvlIndex index);
+
+/**
+ *  Removes the node of an AvlIndexTree that compares equal to a key.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlIndexTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @returns The index of the removed node, or AVL_INDEX_NIL if no node
+ *           compared equal to key.
+ */
+AvlIndex AvlIndexTree_remove(AvlIndexTree *self, const void *key,
+                             AvlIndexHetComparator compare, void *arg);
+
+/**
+ *  Removes every node from an AvlIndexTree in O(1) time.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ */
+void AvlIndexTree_clear(AvlIndexTree *self);
 
-/* void traverse(void *context, const AvlNode *node); */
-typedef void (*AvlTraverseCb)(void*, const AvlNode*);
+/**
+ *  @param self Must not be NULL. Must be in an AvlIndexTree.
+ *  @returns The index of the left child of self, or AVL_INDEX_NIL.
+ */
+AvlIndex AvlIndexNode_left(const AvlIndexNode *self);
 
-/* void traverse_mut(void *context, AvlNode *node); */
-typedef void (*AvlTraverseMutCb)(void*, AvlNode*);
+/**
+ *  @param self Must not be NULL. Must be in an AvlIndexTree.
+ *  @returns The index of the right child of self, or AVL_INDEX_NIL.
+ */
+AvlIndex AvlIndexNode_right(const AvlIndexNode *self);
 
-/* void delete(AvlNode *node, void *arg); */
-typedef void (*AvlDeleter)(AvlNode*, void*);
+/**
+ *  @param self Must not be NULL. Must be in an AvlIndexTree.
+ *  @returns The height of the right subtree of self minus the height
+ *           of its left subtree, which is one of {-1, 0, 1}.
+ */
+int AvlIndexNode_balance_factor(const AvlIndexNode *self);
 
 /**
- *  Initializes an empty AvlTree.
+ *  Initializes an empty AvlCompactTree.
  *
  *  @param self Must not be NULL. Must not be initialized.
  *  @param compare Must not be NULL. Will be invoked to compare nodes
@@ -124,91 +1645,343 @@ typedef void (*AvlDeleter)(AvlNode*, void*);
  *                 they are no longer usable by the tree as if by
  *                 deleter(node, deleter_arg).
  */
-void AvlTree_new(AvlTree *self, AvlComparator compare, void *compare_arg,
-                 AvlDeleter deleter, void *deleter_arg);
+void AvlCompactTree_new(AvlCompactTree *self, AvlCompactComparator compare, void *compare_arg,
+                        AvlCompactDeleter deleter, void *deleter_arg);
 
 /**
- *  Drops an AvlTree, removing all members.
+ *  Drops an AvlCompactTree, removing all members.
  *
- *  Equivalent to AvlTree_clear.
+ *  Equivalent to AvlCompactTree_clear.
  *
  *  @param self Must not be NULL. Must be initialized.
  */
-void AvlTree_drop(AvlTree *self);
+void AvlCompactTree_drop(AvlCompactTree *self);
 
 /**
  *  @param self Must not be NULL. Must be initialized.
  *  @param compare Must not be NULL. Must form the same total ordering
  *                 over the contained elements as the one formed by one
- *                 passed to AvlTree_new. Will be invoked by
+ *                 passed to AvlCompactTree_new. Will be invoked by
  *                 compare(key, node, arg).
  *  @returns A pointer to the node that compares equal to key, if
  *           there is one.
  */
-const AvlNode* AvlTree_get(const AvlTree *self, const void *key,
-                           AvlHetComparator compare, void *arg);
+const AvlCompactNode* AvlCompactTree_get(const AvlCompactTree *self, const void *key,
+                                         AvlCompactHetComparator compare, void *arg);
 
 /**
  *  @param self Must not be NULL. Must be initialized.
  *  @param compare Must not be NULL. Must form the same total ordering
  *                 over the contained elements as the one formed by one
- *                 passed to AvlTree_new. Will be invoked by
+ *                 passed to AvlCompactTree_new. Will be invoked by
  *                 compare(key, node, arg).
  *  @returns A mutable pointer to the node that compares equal to key,
  *           if there is one.
  */
-AvlNode* AvlTree_get_mut(AvlTree *self, const void *key, AvlHetComparator compare, void *arg);
+AvlCompactNode* AvlCompactTree_get_mut(AvlCompactTree *self, const void *key,
+                                       AvlCompactHetComparator compare, void *arg);
 
 /**
- *  Inserts an element into an AvlTree.
+ *  Inserts a node into an AvlCompactTree or replaces the node that
+ *  compares equal to it.
  *
  *  @param self Must not be NULL. Must be initialized.
- *  @param node Must not be NULL.
- *  @returns The previous element that compares equal to node, if there
- *           was one.
+ *  @param node Must not be NULL. Must not already be in self. Its
+ *              links will be overwritten.
+ *  @returns The replaced node, if there was one. Ownership is
+ *           transferred to the caller.
  */
-AvlNode* AvlTree_insert(AvlTree *self, AvlNode *node);
+AvlCompactNode* AvlCompactTree_insert(AvlCompactTree *self, AvlCompactNode *node);
 
 /**
- *  Inserts an element into an AvlTree if no element with a matching
- *  key is found.
+ *  Removes the node of an AvlCompactTree that compares equal to a key.
  *
  *  @param self Must not be NULL. Must be initialized.
  *  @param compare Must not be NULL. Must form the same total ordering
  *                 over the contained elements as the one formed by one
- *                 passed to AvlTree_new. Will be invoked by
- *                 compare(key, node, compare_arg).
- *  @param insert Must not be NULL. If no element that compares equal
- *                to key is found, will be invoked by
- *                insert(key, insert_arg) to obtain a new node. Its
- *                return value must compare equal to key.
- *  @param inserted If not NULL, will be set to 1 if insert was called.
- *                  Otherwise will be set to 0.
- *  @returns The element that compares equal to key or was just
- *           inserted.
+ *                 passed to AvlCompactTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @returns The removed node, if there was one. Ownership is
+ *           transferred to the caller.
  */
-AvlNode* AvlTree_get_or_insert(AvlTree *self, const void *key, AvlHetComparator compare,
-                               void *compare_arg, AvlNode* (*insert)(const void*, void*),
-                               void *insert_arg, int *inserted);
+AvlCompactNode* AvlCompactTree_remove(AvlCompactTree *self, const void *key,
+                                      AvlCompactHetComparator compare, void *arg);
+
+/**
+ *  Removes every node from an AvlCompactTree, passing each to the
+ *  deleter.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ */
+void AvlCompactTree_clear(AvlCompactTree *self);
+
+/**
+ *  @param self Must not be NULL. Must be in an AvlCompactTree.
+ *  @returns The left child of self, if it has one.
+ */
+const AvlCompactNode* AvlCompactNode_left(const AvlCompactNode *self);
+
+/**
+ *  @param self Must not be NULL. Must be in an AvlCompactTree.
+ *  @returns The right child of self, if it has one.
+ */
+const AvlCompactNode* AvlCompactNode_right(const AvlCompactNode *self);
+
+/**
+ *  @param self Must not be NULL. Must be in an AvlCompactTree.
+ *  @returns The height of the right subtree of self minus the height
+ *           of its left subtree, which is one of {-1, 0, 1}.
+ */
+int AvlCompactNode_balance_factor(const AvlCompactNode *self);
+
+/**
+ *  Initializes an empty AvlPersistentTree.
+ *
+ *  @param self Must not be NULL. Must not be initialized.
+ *  @param compare Must not be NULL. Will be invoked to compare nodes
+ *                 by compare(lhs, rhs, compare_arg). Return values
+ *                 should have the same meaning as strcmp and should
+ *                 form a total ordering over the set of nodes.
+ *  @param clone Must not be NULL. Will be invoked to copy a node that
+ *               is shared with another version before changing its
+ *               links as if by clone(node, clone_arg). Must return the
+ *               node member of a new AvlPersistentNode whose element
+ *               compares equal to node. Its links are overwritten.
+ *  @param deleter Must not be NULL. Will be used to free nodes when
+ *                 no version reaches them any more as if by
+ *                 deleter(node, deleter_arg).
+ */
+void AvlPersistentTree_new(AvlPersistentTree *self, AvlComparator compare, void *compare_arg,
+                           AvlCloner clone, void *clone_arg, AvlDeleter deleter,
+                           void *deleter_arg);
+
+/**
+ *  Makes a new version of an AvlPersistentTree that shares every node
+ *  with it.
+ *
+ *  Runs in O(1) time. Changes to either version are not visible in
+ *  the other.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param snapshot Must not be NULL. Must not be initialized. Will be
+ *                  initialized with the nodes, comparator, cloner and
+ *                  deleter of self and must be dropped separately.
+ */
+void AvlPersistentTree_snapshot(const AvlPersistentTree *self, AvlPersistentTree *snapshot);
+
+/**
+ *  Drops a version of an AvlPersistentTree, passing each node that no
+ *  other version reaches to the deleter.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ */
+void AvlPersistentTree_drop(AvlPersistentTree *self);
+
+/**
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlPersistentTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @returns A pointer to the node that compares equal to key, if
+ *           there is one. Valid until no version reaches it.
+ */
+const AvlNode* AvlPersistentTree_get(const AvlPersistentTree *self, const void *key,
+                                     AvlHetComparator compare, void *arg);
+
+/**
+ *  Inserts a node into a version of an AvlPersistentTree or replaces
+ *  the node that compares equal to it.
+ *
+ *  Copies the nodes on the path to node that are shared with another
+ *  version.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param node Must not be NULL. Must be the node member of an
+ *              AvlPersistentNode that is in no tree. Its links and
+ *              reference count will be overwritten.
+ *  @returns Nonzero if a node was replaced. The replaced node is
+ *           passed to the deleter once no version reaches it.
+ */
+int AvlPersistentTree_insert(AvlPersistentTree *self, AvlNode *node);
+
+/**
+ *  Removes the node of a version of an AvlPersistentTree that compares
+ *  equal to a key.
+ *
+ *  Copies the nodes on the path to the removed node and to its
+ *  successor that are shared with another version, as well as any
+ *  shared node that is rotated while rebalancing.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlPersistentTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @returns Nonzero if a node was removed. The removed node is passed
+ *           to the deleter once no version reaches it.
+ */
+int AvlPersistentTree_remove(AvlPersistentTree *self, const void *key,
+                             AvlHetComparator compare, void *arg);
+
+/**
+ *  Traverses a version of an AvlPersistentTree in-order.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param traverse Must not be NULL. Will be invoked on each node as
+ *                  if by traverse(arg, node).
+ */
+void AvlPersistentTree_traverse(const AvlPersistentTree *self, AvlTraverseCb traverse,
+                                void *arg);
+
+/**
+ *  Initializes an empty AvlParentTree.
+ *
+ *  @param self Must not be NULL. Must not be initialized.
+ *  @param compare Must not be NULL. Will be invoked to compare nodes
+ *                 by compare(lhs, rhs, compare_arg). Return values
+ *                 should have the same meaning as strcmp and should
+ *                 form a total ordering over the set of nodes.
+ *  @param deleter Must not be NULL. Will be used to free nodes when
+ *                 they are no longer usable by the tree as if by
+ *                 deleter(node, deleter_arg).
+ */
+void AvlParentTree_new(AvlParentTree *self, AvlComparator compare, void *compare_arg,
+                       AvlDeleter deleter, void *deleter_arg);
+
+/**
+ *  Drops an AvlParentTree, passing each of its nodes to the deleter.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ */
+void AvlParentTree_drop(AvlParentTree *self);
+
+/**
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlParentTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @returns The node member of the AvlParentNode that compares equal
+ *           to key, if there is one.
+ */
+const AvlNode* AvlParentTree_get(const AvlParentTree *self, const void *key,
+                                 AvlHetComparator compare, void *arg);
+
+/**
+ *  Inserts an element into an AvlParentTree.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param node Must not be NULL. Must be the node member of an
+ *              AvlParentNode.
+ *  @returns The previous element that compares equal to node, if there
+ *           was one. It is no longer in self.
+ */
+AvlNode* AvlParentTree_insert(AvlParentTree *self, AvlNode *node);
 
 /**
  *  Removes the node that compares equal to a key.
  *
- *  @param self Must not be NULL.
- *  @param compare Must not be NULL. Must form the same total
- *                 ordering over the set of nodes as the one
- *                 passed to AvlTree_new. Will be invoked to compare
- *                 the key to nodes by compare(key, node, arg).
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlParentTree_new. Will be invoked by
+ *                 compare(key, node, arg).
  *  @returns The node that compared equal to key, if there was one.
  */
-AvlNode* AvlTree_remove(AvlTree *self, const void *key, AvlHetComparator compare, void *arg);
+AvlNode* AvlParentTree_remove(AvlParentTree *self, const void *key, AvlHetComparator compare,
+                              void *arg);
 
 /**
- *  Clears the tree, removing all members.
+ *  Removes a node without searching for it.
+ *
+ *  Makes no comparisons. A node with two children is first swapped
+ *  with its successor, found by walking down its right subtree. The
+ *  tree is then retraced upward through parent links for as long as
+ *  balance factors change. Runs in O(log n) time in the worst case;
+ *  the rebalancing alone is amortized O(1) over a sequence of
+ *  removals.
  *
  *  @param self Must not be NULL. Must be initialized.
+ *  @param node Must not be NULL. Must be the node member of an
+ *              AvlParentNode in self.
  */
-void AvlTree_clear(AvlTree *self);
+void AvlParentTree_remove_node(AvlParentTree *self, AvlNode *node);
+
+/**
+ *  @param self Must not be NULL. Must be initialized.
+ *  @returns The least node of self, if it is not empty.
+ */
+const AvlNode* AvlParentTree_first(const AvlParentTree *self);
+
+/**
+ *  @param self Must not be NULL. Must be initialized.
+ *  @returns The greatest node of self, if it is not empty.
+ */
+const AvlNode* AvlParentTree_last(const AvlParentTree *self);
+
+/**
+ *  Finds the next node in order without a stack.
+ *
+ *  Runs in O(1) amortized time over a traversal of the whole tree.
+ *
+ *  @param self Must not be NULL. Must be the node member of an
+ *              AvlParentNode in an AvlParentTree.
+ *  @returns The least node that compares greater than self, if there
+ *           is one.
+ */
+const AvlNode* AvlParentNode_next(const AvlNode *self);
+
+/**
+ *  Finds the previous node in order without a stack.
+ *
+ *  Runs in O(1) amortized time over a traversal of the whole tree.
+ *
+ *  @param self Must not be NULL. Must be the node member of an
+ *              AvlParentNode in an AvlParentTree.
+ *  @returns The greatest node that compares less than self, if there
+ *           is one.
+ */
+const AvlNode* AvlParentNode_prev(const AvlNode *self);
+
+struct AvlTreeStats {
+    size_t num_comparisons; /* comparator calls */
+    size_t num_searches; /* descents from the root */
+    size_t total_search_depth; /* nodes on the paths of all searches */
+    size_t max_search_depth; /* nodes on the longest search path */
+    size_t num_single_rotations;
+    size_t num_double_rotations;
+    size_t num_rebalances; /* insertions and removals that updated balance factors */
+    size_t total_rebalance_length; /* balance factors updated by all of them */
+    size_t num_allocations; /* search paths that outgrew their stack buffer */
+};
+
+/** Shape and memory layout of an AvlTree. */
+struct AvlShapeReport {
+    size_t len;
+    int height;
+    size_t depth_histogram[AVL_MAX_HEIGHT]; /* nodes at depth i + 1; the root is at depth 1 */
+    size_t total_depth; /* comparisons to find every node once */
+    double mean_depth; /* comparisons per successful lookup */
+    double min_mean_depth; /* the same for a perfectly balanced tree of len nodes */
+    size_t cache_line_size; /* that the counts below assume */
+    size_t page_size;
+    size_t num_cache_lines; /* distinct lines that an AvlNode starts in */
+    size_t num_straddling_nodes; /* whose AvlNode spans two lines */
+    size_t num_links; /* from a parent to a child, len - 1 */
+    size_t num_same_line_links; /* whose nodes start in the same line */
+    size_t num_same_page_links; /* whose nodes start in the same page, including the above */
+};
+
+/** Hooks through which libbloodhound allocates memory of its own. */
+struct AvlAllocator {
+    AvlAllocFn alloc;
+    AvlReallocFn realloc;
+    AvlFreeFn free;
+    void *ctx;
+    size_t bytes_held; /* by the library through this allocator */
+    size_t peak_bytes_held;
+};
 
 /**
  *  AVL self-balancing binary search tree.
@@ -227,6 +2000,16 @@ struct AvlTree {
     void *compare_arg;
     AvlDeleter deleter;
     void *deleter_arg;
+    int is_ranked; /* nonzero if every node is an AvlRankNode */
+    int is_relaxed; /* nonzero if writes defer rebalancing */
+    size_t node_offset; /* of the AvlNode in each container, if set */
+    AvlContainerComparator container_compare; /* NULL unless new_with_offset */
+    void *container_compare_arg;
+    AvlContainerDeleter container_deleter;
+    void *container_deleter_arg;
+    AvlAllocator *allocator; /* for snapshots, or NULL for the default */
+    AvlTreeStats stats; /* of modifications, if BLOODHOUND_STATS is defined */
+    AvlTreeStats *lookup_stats; /* where lookups count, or NULL */
 };
 
 /**
@@ -278,6 +2061,155 @@ struct AvlNode {
     signed char balance_factor; /* one of {-2, -1, 0, 1, -2} */
 };
 
+/**
+ *  Intrusive AVL tree node that also counts the nodes in its subtree.
+ *
+ *  Users should treat size as read-only; ranked trees update it on
+ *  every insertion, removal and rotation.
+ */
+struct AvlRankNode {
+    AvlNode node;
+    size_t size; /* number of nodes in the subtree rooted here */
+};
+
+/**
+ *  Bidirectional in-order cursor over an AvlTree.
+ *
+ *  A cursor holds the path from the root of a tree to the node it
+ *  points to, so stepping to the next or previous node takes
+ *  amortized constant time and never allocates. Cursors are
+ *  invalidated by any modification of the tree they point into.
+ *
+ *  @code{.c}
+ *  AvlCursor cursor;
+ *
+ *  for (AvlCursor_first(&cursor, &map); AvlCursor_get(&cursor);
+ *       AvlCursor_next(&cursor)) {
+ *      const Node *const node = (const Node*) AvlCursor_get(&cursor);
+ *  }
+ *  @endcode
+ */
+struct AvlCursor {
+    AvlNode *path[AVL_MAX_HEIGHT]; /* path[len - 1] is the current node */
+    size_t len;
+};
+
+/**
+ *  Result of a search that a caller can insert into without searching
+ *  again.
+ */
+struct AvlEntry {
+    AvlCursor cursor; /* to the node found, or the parent of its slot */
+    int ordering; /* of the key against the end of cursor, 0 if found */
+};
+
+/** Builds an AvlTree from a stream of nodes in ascending order. */
+struct AvlBuilder {
+    AvlTree tree;
+    AvlCursor spine; /* from the root of tree to its greatest node */
+};
+
+/**
+ *  Read-only snapshot of an AvlTree laid out for fast lookups.
+ *
+ *  Slot k starts at slots + k * stride. Slot 1 is the root, the
+ *  children of slot k are slots 2k and 2k + 1 and slot 0 is unused.
+ *  Each slot holds a const AvlNode* or, if is_copy is nonzero, a copy
+ *  of a node.
+ */
+struct AvlFrozenTree {
+    const char *slots; /* in buffer or in an image owned by the caller */
+    char *buffer; /* allocated from allocator, or NULL */
+    size_t stride;
+    size_t len;
+    size_t capacity; /* in slots */
+    int is_copy;
+    int is_image; /* slots point into an image owned by the caller */
+    AvlAllocator *allocator; /* that slots came from */
+};
+
+/**
+ *  AVL tree of intrusive nodes that keep their balance factor in the
+ *  low bits of their child pointers.
+ */
+struct AvlCompactTree {
+    AvlCompactNode *root;
+    size_t len;
+    AvlCompactComparator compare;
+    void *compare_arg;
+    AvlCompactDeleter deleter;
+    void *deleter_arg;
+};
+
+/**
+ *  Intrusive node of an AvlCompactTree.
+ *
+ *  The low bit of left is set if the left subtree is taller and the
+ *  low bit of right is set if the right subtree is taller.
+ */
+struct AvlCompactNode {
+    AvlCompactNode *left;
+    AvlCompactNode *right;
+};
+
+/** One version of a persistent AVL tree. */
+struct AvlPersistentTree {
+    AvlNode *root; /* the node member of an AvlPersistentNode */
+    size_t len;
+    AvlComparator compare;
+    void *compare_arg;
+    AvlCloner clone;
+    void *clone_arg;
+    AvlDeleter deleter;
+    void *deleter_arg;
+};
+
+/** Intrusive node of an AvlPersistentTree. */
+struct AvlPersistentNode {
+    AvlNode node;
+    size_t refcount; /* parent links and versions that reach this node */
+};
+
+/** AVL tree whose nodes link to their parents. */
+struct AvlParentTree {
+    AvlNode *root; /* the node member of an AvlParentNode */
+    size_t len;
+    AvlComparator compare;
+    void *compare_arg;
+    AvlDeleter deleter;
+    void *deleter_arg;
+};
+
+/** Intrusive node of an AvlParentTree. */
+struct AvlParentNode {
+    AvlNode node;
+    AvlNode *parent; /* the node member of the parent, or NULL at the root */
+};
+
+/**
+ *  AVL tree whose nodes live in one caller-provided array and link to
+ *  each other by 32-bit index.
+ */
+struct AvlIndexTree {
+    char *nodes;
+    size_t stride;
+    AvlIndex root;
+    size_t len;
+    AvlIndexComparator compare;
+    void *compare_arg;
+};
+
+/**
+ *  Intrusive node of an AvlIndexTree.
+ *
+ *  The low 30 bits of left and right are child indices; bits 30 and
+ *  31 of left hold the balance factor plus one.
+ */
+struct AvlIndexNode {
+    AvlIndex left;
+    AvlIndex right;
+};
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -0,0 +1,259 @@
+/*  MIT License
+ *
+ *  Copyright (c) 2019 Gregory Meyer
+ *
+ *  Permission is hereby granted, free of charge, to any person
+ *  obtaining a copy of this software and associated documentation
+ *  files (the "Software"), to deal in the Software without
+ *  restriction, including without limitation the rights to use, copy,
+ *  modify, merge, publish, distribute, sublicense, and/or sell copies
+ *  of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including
+ *  the next paragraph) shall be included in all copies or substantial
+ *  portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ *  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ *  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ *  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ *  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ */
+
+#ifndef BLOODHOUND_CONCURRENT_H
+#define BLOODHOUND_CONCURRENT_H
+
+/**
+ *  @file bloodhound_concurrent.h
+ *
+ *  Optional concurrency layer over bloodhound.h. An AvlConcurrentTree
+ *  lets any number of threads look up and scan nodes without locks
+ *  while one thread at a time inserts or removes.
+ *
+ *  A write never changes a node that readers can reach. Like
+ *  AvlPersistentTree, which it is built on, it copies the nodes on the
+ *  path it changes and the nodes it rotates, relinks the copies, and
+ *  then publishes the new root with a single release store. Lookups
+ *  and scans load the root once and walk that version to the end, so
+ *  they are wait-free: they never wait for a writer, never retry and
+ *  never hold writers up, and a scan is a consistent snapshot.
+ *
+ *  Each write costs O(log n) copies made with the cloner. The versions
+ *  a write replaces, and with them the nodes it removed, replaced or
+ *  copied, are not dropped until every reader that might still see
+ *  them has left its read section (epoch-based reclamation), so nodes
+ *  stay valid across lookups for as long as the section lasts.
+ *
+ *  Built as part of bloodhound_parallel.
+ */
+
+#include <bloodhound.h>
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ *  AVL tree that many threads may read without locks while one writes
+ *  at a time.
+ *
+ *  Writers are serialized by an internal mutex. Readers never see a
+ *  node being relinked, and comparators are never invoked on a node
+ *  that has been passed to the deleter.
+ */
+typedef struct AvlConcurrentTree AvlConcurrentTree;
+
+/**
+ *  A registered reader of an AvlConcurrentTree.
+ *
+ *  Each thread that reads a tree should have its own AvlReader. Nodes
+ *  returned to a reader remain valid until it calls AvlReader_exit.
+ *
+ *  @code{.c}
+ *  AvlReader *const reader = AvlReader_new(tree);
+ *
+ *  AvlReader_enter(reader);
+ *  route = (const Route*) AvlConcurrentTree_get(tree, reader, &addr, compare, NULL);
+ *  ... use route ...
+ *  AvlReader_exit(reader);
+ *
+ *  AvlReader_drop(reader);
+ *  @endcode
+ */
+typedef struct AvlReader AvlReader;
+
+/**
+ *  Creates an empty AvlConcurrentTree.
+ *
+ *  Aborts if memory could not be allocated.
+ *
+ *  @param compare Must not be NULL. Will be invoked to compare nodes
+ *                 by compare(lhs, rhs, compare_arg). Return values
+ *                 should have the same meaning as strcmp and should
+ *                 form a total ordering over the set of nodes.
+ *  @param clone Must not be NULL. Will be invoked by writers to copy a
+ *               node that readers may see before changing its links as
+ *               if by clone(node, clone_arg). Must return the node
+ *               member of a new AvlPersistentNode whose element
+ *               compares equal to node. Is only invoked while the
+ *               write lock is held.
+ *  @param deleter Must not be NULL. Will be used to free nodes,
+ *                 including copies, when no reader can still see them
+ *                 as if by deleter(node, deleter_arg). Is only invoked
+ *                 while the write lock is held.
+ *  @returns A tree to be dropped with AvlConcurrentTree_drop.
+ */
+AvlConcurrentTree* AvlConcurrentTree_new(AvlComparator compare, void *compare_arg,
+                                         AvlCloner clone, void *clone_arg, AvlDeleter deleter,
+                                         void *deleter_arg);
+
+/**
+ *  Drops an AvlConcurrentTree, passing every node it still holds to
+ *  the deleter.
+ *
+ *  @param self May be NULL. No other call using self may be in
+ *              progress and every reader of self must have been
+ *              dropped.
+ */
+void AvlConcurrentTree_drop(AvlConcurrentTree *self);
+
+/**
+ *  Registers a reader of an AvlConcurrentTree.
+ *
+ *  Takes the write lock, so readers should be created once per thread
+ *  rather than once per lookup. Aborts if memory could not be
+ *  allocated.
+ *
+ *  @param tree Must not be NULL.
+ *  @returns A reader outside of any read section, to be dropped with
+ *           AvlReader_drop before tree is.
+ */
+AvlReader* AvlReader_new(AvlConcurrentTree *tree);
+
+/**
+ *  Unregisters a reader.
+ *
+ *  @param self May be NULL. Must not be in a read section.
+ */
+void AvlReader_drop(AvlReader *self);
+
+/**
+ *  Starts a read section, during which no node that was reachable
+ *  from the tree at any point of the section will be deleted.
+ *
+ *  Writers cannot reclaim memory while any reader stays in its read
+ *  section, so sections should be short.
+ *
+ *  @param self Must not be NULL. Must not already be in a read
+ *              section.
+ */
+void AvlReader_enter(AvlReader *self);
+
+/**
+ *  Ends a read section. Nodes obtained during it may no longer be
+ *  accessed.
+ *
+ *  @param self Must not be NULL. Must be in a read section.
+ */
+void AvlReader_exit(AvlReader *self);
+
+/**
+ *  Finds the node that compares equal to a key in the latest version
+ *  of an AvlConcurrentTree, without locks or retries.
+ *
+ *  Loads the root once with acquire semantics and searches the version
+ *  it belongs to, so writes in progress neither delay the search nor
+ *  are delayed by it.
+ *
+ *  @param self Must not be NULL.
+ *  @param reader Must not be NULL. Must be a reader of self that is in
+ *                a read section.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlConcurrentTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @returns A pointer to the node that compared equal to key in the
+ *           version that was latest when the call began, if there was
+ *           one. Valid until reader leaves its read section.
+ */
+const AvlNode* AvlConcurrentTree_get(const AvlConcurrentTree *self, const AvlReader *reader,
+                                     const void *key, AvlHetComparator compare, void *arg);
+
+/**
+ *  Collects nodes in order from the latest version of an
+ *  AvlConcurrentTree, starting from the least node that does not
+ *  compare less than a key, without locks or retries.
+ *
+ *  Like AvlConcurrentTree_get, walks the version that was latest when
+ *  the call began, however long the scan may be. The nodes are a
+ *  consistent snapshot: all of them were in the tree at the same
+ *  moment and no node between them was missing.
+ *
+ *  @param self Must not be NULL.
+ *  @param reader Must not be NULL. Must be a reader of self that is in
+ *                a read section.
+ *  @param key The lower bound of the scan. If NULL, the scan starts at
+ *             the least node and compare is not invoked.
+ *  @param compare Must not be NULL if key is not NULL. Will be invoked
+ *                 by compare(key, node, arg).
+ *  @param nodes Must not be NULL if max_nodes > 0. The first elements
+ *               will be set to the nodes found, which are valid until
+ *               reader leaves its read section.
+ *  @param max_nodes The maximum number of nodes to collect.
+ *  @returns The number of nodes written to nodes.
+ */
+size_t AvlConcurrentTree_scan(const AvlConcurrentTree *self, const AvlReader *reader,
+                              const void *key, AvlHetComparator compare, void *arg,
+                              const AvlNode **nodes, size_t max_nodes);
+
+/**
+ *  Inserts a node or replaces the node that compares equal to it.
+ *
+ *  Takes the write lock and copies the O(log n) nodes it would change.
+ *  A replaced node is passed to the deleter once no reader can see it
+ *  any more.
+ *
+ *  @param self Must not be NULL.
+ *  @param node Must not be NULL. Must be the node member of an
+ *              AvlPersistentNode that is in no tree. Its links and
+ *              reference count will be overwritten. Its contents must
+ *              not change while it is in self.
+ *  @returns Nonzero if a node was replaced.
+ */
+int AvlConcurrentTree_insert(AvlConcurrentTree *self, AvlNode *node);
+
+/**
+ *  Removes the node that compares equal to a key.
+ *
+ *  Takes the write lock and copies the O(log n) nodes it would change.
+ *  The removed node is passed to the deleter once no reader can see it
+ *  any more.
+ *
+ *  @param self Must not be NULL.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlConcurrentTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @returns Nonzero if a node was removed.
+ */
+int AvlConcurrentTree_remove(AvlConcurrentTree *self, const void *key,
+                             AvlHetComparator compare, void *arg);
+
+/**
+ *  @param self Must not be NULL.
+ *  @returns The number of nodes in self as of the last completed
+ *           write.
+ */
+size_t AvlConcurrentTree_len(const AvlConcurrentTree *self);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
@@ -0,0 +1,163 @@
+/*  MIT License
+ *
+ *  Copyright (c) 2019 Gregory Meyer
+ *
+ *  Permission is hereby granted, free of charge, to any person
+ *  obtaining a copy of this software and associated documentation
+ *  files (the "Software"), to deal in the Software without
+ *  restriction, including without limitation the rights to use, copy,
+ *  modify, merge, publish, distribute, sublicense, and/or sell copies
+ *  of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including
+ *  the next paragraph) shall be included in all copies or substantial
+ *  portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ *  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ *  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ *  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ *  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ */
+
+#ifndef BLOODHOUND_PARALLEL_H
+#define BLOODHOUND_PARALLEL_H
+
+/**
+ *  @file bloodhound_parallel.h
+ *
+ *  Optional fork-join layer over bloodhound.h. Set operations and bulk
+ *  construction are split into independent subproblems that run on a
+ *  work-stealing thread pool.
+ *
+ *  Comparators and deleters passed to these functions are invoked
+ *  concurrently from several threads, so they must be safe to call
+ *  that way. Results are identical to the sequential functions.
+ */
+
+#include <bloodhound.h>
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ *  Work-stealing thread pool.
+ *
+ *  Each worker owns a deque of tasks. Workers pop their own newest
+ *  tasks and steal the oldest tasks of other workers when they run
+ *  out. A pool may be shared by any number of calls, including
+ *  concurrent calls from different threads.
+ */
+typedef struct AvlThreadPool AvlThreadPool;
+
+/**
+ *  Creates a thread pool.
+ *
+ *  Aborts if the pool or its threads could not be created.
+ *
+ *  @param num_threads The number of worker threads to start. If 0, one
+ *                     worker is started per hardware thread. The
+ *                     calling thread also runs tasks while it waits,
+ *                     so a pool with 0 workers is never created.
+ *  @returns A pool to be dropped with AvlThreadPool_drop.
+ */
+AvlThreadPool* AvlThreadPool_new(size_t num_threads);
+
+/**
+ *  Stops and frees a thread pool.
+ *
+ *  @param self May be NULL. No call using self may be in progress.
+ */
+void AvlThreadPool_drop(AvlThreadPool *self);
+
+/**
+ *  Returns the number of worker threads in a thread pool.
+ *
+ *  @param self Must not be NULL.
+ */
+size_t AvlThreadPool_num_threads(const AvlThreadPool *self);
+
+/**
+ *  Moves every node of an AvlTree into another AvlTree in parallel.
+ *
+ *  Equivalent to AvlTree_union. The recursion forks at each level
+ *  until a subproblem's other subtree is small enough to finish
+ *  sequentially.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param other Must not be NULL. Must be initialized. Must form the
+ *               same ordering as self. Will be left empty.
+ *  @param pool Must not be NULL.
+ *  @param grain_size Subproblems covering about grain_size nodes or
+ *                    fewer of other run sequentially. 0 is treated as
+ *                    1.
+ */
+void AvlTree_par_union(AvlTree *self, AvlTree *other, AvlThreadPool *pool,
+                       size_t grain_size);
+
+/**
+ *  Removes every node of an AvlTree that does not compare equal to a
+ *  node in another AvlTree in parallel.
+ *
+ *  Equivalent to AvlTree_intersection.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param other Must not be NULL. Must be initialized. Must form the
+ *               same ordering as self. Will be left empty.
+ *  @param pool Must not be NULL.
+ *  @param grain_size Subproblems covering about grain_size nodes or
+ *                    fewer of other run sequentially. 0 is treated as
+ *                    1.
+ */
+void AvlTree_par_intersection(AvlTree *self, AvlTree *other, AvlThreadPool *pool,
+                              size_t grain_size);
+
+/**
+ *  Removes every node of an AvlTree that compares equal to a node in
+ *  another AvlTree in parallel.
+ *
+ *  Equivalent to AvlTree_difference.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param other Must not be NULL. Must be initialized. Must form the
+ *               same ordering as self. Will be left empty.
+ *  @param pool Must not be NULL.
+ *  @param grain_size Subproblems covering about grain_size nodes or
+ *                    fewer of other run sequentially. 0 is treated as
+ *                    1.
+ */
+void AvlTree_par_difference(AvlTree *self, AvlTree *other, AvlThreadPool *pool,
+                            size_t grain_size);
+
+/**
+ *  Initializes an AvlTree from an array of nodes in ascending order in
+ *  parallel.
+ *
+ *  Equivalent to AvlTree_from_sorted, and builds the same shape.
+ *
+ *  @param self Must not be NULL. Must not be initialized.
+ *  @param nodes Must not be NULL if num_nodes > 0. Must be sorted in
+ *               strictly ascending order according to compare.
+ *  @param compare Must not be NULL.
+ *  @param deleter Must not be NULL.
+ *  @param pool Must not be NULL.
+ *  @param grain_size Ranges of grain_size nodes or fewer are built
+ *                    sequentially. 0 is treated as 1.
+ */
+void AvlTree_par_from_sorted(AvlTree *self, AvlNode **nodes, size_t num_nodes,
+                             AvlComparator compare, void *compare_arg,
+                             AvlDeleter deleter, void *deleter_arg,
+                             AvlThreadPool *pool, size_t grain_size);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
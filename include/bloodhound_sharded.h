@@ -0,0 +1,197 @@
+/*  MIT License
+ *
+ *  Copyright (c) 2019 Gregory Meyer
+ *
+ *  Permission is hereby granted, free of charge, to any person
+ *  obtaining a copy of this software and associated documentation
+ *  files (the "Software"), to deal in the Software without
+ *  restriction, including without limitation the rights to use, copy,
+ *  modify, merge, publish, distribute, sublicense, and/or sell copies
+ *  of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including
+ *  the next paragraph) shall be included in all copies or substantial
+ *  portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ *  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ *  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ *  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ *  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ */
+
+#ifndef BLOODHOUND_SHARDED_H
+#define BLOODHOUND_SHARDED_H
+
+/**
+ *  @file bloodhound_sharded.h
+ *
+ *  Optional striped-locking layer over bloodhound.h. An
+ *  AvlShardedTree partitions its key space by range across several
+ *  AvlTrees, each with its own lock, so writes to different ranges
+ *  proceed in parallel.
+ *
+ *  Shard boundaries are nodes of the tree. When a shard grows past
+ *  twice the average, it is split at its root with AvlTree_split into
+ *  an empty shard, shifting the shards in between over by one, and the
+ *  boundary moves to that root. Once no shard is empty, it instead
+ *  hands a much smaller neighbor nodes from that side with
+ *  AvlTree_split and AvlTree_join.
+ *
+ *  Each shard is a ranked AvlTree, so every node must be the node
+ *  member of an AvlRankNode and both of those run in O(log n) time.
+ *
+ *  Built as part of bloodhound_parallel.
+ */
+
+#include <bloodhound.h>
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ *  Set of nodes ordered by a comparator that may be written by several
+ *  threads at once.
+ *
+ *  Every function takes the lock of each shard it touches, so
+ *  comparators and deleters are invoked concurrently from several
+ *  threads and must be safe to call that way. A node obtained from
+ *  AvlShardedTree_get stays valid until a node that compares equal to
+ *  it is inserted or removed; coordinating that is up to the caller.
+ */
+typedef struct AvlShardedTree AvlShardedTree;
+
+/**
+ *  Callback for AvlShardedTree_traverse_from.
+ *
+ *  Invoked by visit(arg, node). Should return nonzero to stop the
+ *  traversal.
+ */
+typedef int (*AvlShardedVisitor)(void*, const AvlNode*);
+
+/**
+ *  Creates an empty AvlShardedTree.
+ *
+ *  Aborts if memory could not be allocated.
+ *
+ *  @param num_shards Must be positive. The number of independently
+ *                    locked AvlTrees, which bounds how many writers
+ *                    can make progress at once.
+ *  @param compare Must not be NULL. Will be invoked to compare nodes
+ *                 by compare(lhs, rhs, compare_arg). Return values
+ *                 should have the same meaning as strcmp and should
+ *                 form a total ordering over the set of nodes.
+ *  @param deleter Must not be NULL. Will be used to free removed and
+ *                 replaced nodes as if by deleter(node, deleter_arg).
+ *                 Every node passed to it is the node member of an
+ *                 AvlRankNode.
+ *  @returns A tree to be dropped with AvlShardedTree_drop.
+ */
+AvlShardedTree* AvlShardedTree_new(size_t num_shards, AvlComparator compare, void *compare_arg,
+                                   AvlDeleter deleter, void *deleter_arg);
+
+/**
+ *  Drops an AvlShardedTree, passing every node it still holds to the
+ *  deleter.
+ *
+ *  @param self May be NULL. No other call using self may be in
+ *              progress.
+ */
+void AvlShardedTree_drop(AvlShardedTree *self);
+
+/**
+ *  Finds the node that compares equal to a key.
+ *
+ *  @param self Must not be NULL.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlShardedTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @returns A pointer to the node that compared equal to key, if there
+ *           was one.
+ */
+const AvlNode* AvlShardedTree_get(AvlShardedTree *self, const void *key,
+                                  AvlHetComparator compare, void *arg);
+
+/**
+ *  Visits nodes in order, starting from the least node that does not
+ *  compare less than a key.
+ *
+ *  Holds the lock of the shard being visited and of the next one while
+ *  moving between them, so no node is visited twice and every node
+ *  that stays in the tree for the whole traversal is visited.
+ *
+ *  @param self Must not be NULL.
+ *  @param key The lower bound of the traversal. If NULL, the traversal
+ *             starts at the least node and compare is not invoked.
+ *  @param compare Must not be NULL if key is not NULL. Will be invoked
+ *                 by compare(key, node, arg).
+ *  @param visit Must not be NULL. Will be invoked by
+ *               visit(visit_arg, node) for each node in order until it
+ *               returns nonzero. Must not call any function using
+ *               self.
+ */
+void AvlShardedTree_traverse_from(AvlShardedTree *self, const void *key,
+                                  AvlHetComparator compare, void *arg,
+                                  AvlShardedVisitor visit, void *visit_arg);
+
+/**
+ *  Inserts a node, replacing the node that compares equal to it.
+ *
+ *  @param self Must not be NULL.
+ *  @param node Must not be NULL. Must not be in any tree. Must be the
+ *              node member of an AvlRankNode.
+ *  @returns Nonzero if a node was replaced, in which case the replaced
+ *           node is (possibly later) passed to the deleter.
+ */
+int AvlShardedTree_insert(AvlShardedTree *self, AvlNode *node);
+
+/**
+ *  Removes the node that compares equal to a key.
+ *
+ *  @param self Must not be NULL.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlShardedTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @returns Nonzero if a node was removed, in which case it is
+ *           (possibly later) passed to the deleter. A node that is a
+ *           shard boundary is kept until the boundary moves so that
+ *           concurrent calls can still compare against it.
+ */
+int AvlShardedTree_remove(AvlShardedTree *self, const void *key, AvlHetComparator compare,
+                          void *arg);
+
+/**
+ *  @param self Must not be NULL.
+ *  @returns The number of nodes in self. Only exact if no write is in
+ *           progress.
+ */
+size_t AvlShardedTree_len(const AvlShardedTree *self);
+
+/**
+ *  @param self Must not be NULL.
+ *  @returns The number of shards self was created with.
+ */
+size_t AvlShardedTree_num_shards(const AvlShardedTree *self);
+
+/**
+ *  @param self Must not be NULL.
+ *  @param index Must be less than the number of shards of self.
+ *  @returns The number of nodes in a shard. Only exact if no write is
+ *           in progress.
+ */
+size_t AvlShardedTree_shard_len(const AvlShardedTree *self, size_t index);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
@@ -1,6 +1,8 @@
 import lldb
 import lldb.formatters.Logger
 
+from avl_shape import format_shape, shape_of
+
 
 class NodeStackSyntheticChildProvider(object):
     def __init__(self, valobj, dict):
@@ -40,3 +42,52 @@ class NodeStackSyntheticChildProvider(object):
         self.data_size = self.data_type.GetByteSize()
 
         return True
+
+
+def avl_shape(debugger, command, result, internal_dict):
+    """usage: avl_shape <AvlTree expression>
+
+    Prints the height, depth histogram and memory layout of an AvlTree.
+    """
+    frame = debugger.GetSelectedTarget().GetProcess() \
+        .GetSelectedThread().GetSelectedFrame()
+    tree = frame.EvaluateExpression(command)
+
+    if not tree.IsValid() or tree.GetError().Fail():
+        result.SetError('avl_shape: cannot evaluate "{}"'.format(command))
+
+        return
+
+    if tree.GetType().IsPointerType():
+        tree = tree.Dereference()
+
+    root = tree.GetChildMemberWithName('root')
+    node_type = root.GetType().GetPointeeType()
+    process = tree.GetProcess()
+    error = lldb.SBError()
+    offsets = {}
+
+    for i in range(node_type.GetNumberOfFields()):
+        field = node_type.GetFieldAtIndex(i)
+        offsets[field.GetName()] = field.GetOffsetInBytes()
+
+    def read_links(address):
+        return [process.ReadPointerFromMemory(address + offsets[name], error)
+                for name in ('left', 'right')]
+
+    shape = shape_of(root.GetValueAsUnsigned(0), node_type.GetByteSize(),
+                     read_links)
+
+    if error.Fail():
+        result.SetError('avl_shape: {}'.format(error.GetCString()))
+
+        return
+
+    result.AppendMessage(format_shape(shape))
+
+
+def __lldb_init_module(debugger, internal_dict):
+    debugger.HandleCommand('type synthetic add NodeStack -l {}.'
+                           'NodeStackSyntheticChildProvider'.format(__name__))
+    debugger.HandleCommand('command script add -f {}.avl_shape avl_shape'
+                           .format(__name__))
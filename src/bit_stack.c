@@ -31,6 +31,7 @@
 #include <assert.h>
 #include <limits.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define BITS_PER_WORD (CHAR_BIT * sizeof(unsigned long))
 
@@ -38,14 +39,17 @@
  *  Initializes an empty BitStack.
  *
  *  @param self Must not be NULL. Must not be initialized.
+ *  @param allocator Will be used for every allocation the stack makes.
+ *                   If NULL, the default allocator is used.
  */
-void BitStack_new(BitStack *self) {
+void BitStack_new(BitStack *self, AvlAllocator *allocator) {
     assert(self);
 
     self->data = NULL;
     self->len = 0;
     self->capacity = 0;
     self->is_owned = 1;
+    self->allocator = allocator;
 }
 
 static size_t div_towards_inf(size_t x, size_t y) {
@@ -64,18 +68,27 @@ static size_t div_towards_inf(size_t x, size_t y) {
  *  bits.
  *
  *  @param self Must not be NULL. Must not be initialized.
+ *  @param allocator Will be used for every allocation the stack makes.
+ *                   If NULL, the default allocator is used.
  */
-void BitStack_with_capacity(BitStack *self, size_t capacity) {
+void BitStack_with_capacity(BitStack *self, AvlAllocator *allocator, size_t capacity) {
     size_t num_words;
 
     assert(self);
 
     num_words = div_towards_inf(capacity, BITS_PER_WORD);
 
-    self->data = checked_malloc(sizeof(unsigned long) * num_words);
+    if (num_words == 0) {
+        BitStack_new(self, allocator);
+
+        return;
+    }
+
+    self->data = allocator_malloc(allocator, sizeof(unsigned long) * num_words);
     self->len = 0;
     self->capacity = num_words * BITS_PER_WORD;
     self->is_owned = 1;
+    self->allocator = allocator;
 }
 
 /**
@@ -83,11 +96,14 @@ void BitStack_with_capacity(BitStack *self, size_t capacity) {
  *  slice of memory until it fills up.
  *
  *  @param self Must not be NULL. Must not be initialized.
+ *  @param allocator Will be used for every allocation the stack makes.
+ *                   If NULL, the default allocator is used.
  *  @param data Must point to a buffer at least len * sizeof(unsigned
  *              long) bytes long.
  *  @param len Must be > 0.
  */
-void BitStack_from_adopted_slice(BitStack *self, unsigned long *data, size_t len) {
+void BitStack_from_adopted_slice(BitStack *self, AvlAllocator *allocator, unsigned long *data,
+                                 size_t len) {
     assert(self);
     assert(data);
 
@@ -95,6 +111,7 @@ void BitStack_from_adopted_slice(BitStack *self, unsigned long *data, size_t len
     self->len = 0;
     self->capacity = len * BITS_PER_WORD;
     self->is_owned = 0;
+    self->allocator = allocator;
 }
 
 /**
@@ -106,7 +123,8 @@ void BitStack_drop(BitStack *self) {
     assert(self);
 
     if (self->is_owned) {
-        free(self->data);
+        allocator_free(self->allocator, self->data,
+                       self->capacity / BITS_PER_WORD * sizeof(unsigned long));
     }
 }
 
@@ -166,15 +184,22 @@ static void grow_if_full(BitStack *self) {
     }
 
     if (!self->data) {
-        self->data = checked_malloc(sizeof(unsigned long));
+        self->data = allocator_malloc(self->allocator, sizeof(unsigned long));
         self->capacity = BITS_PER_WORD; /* at least 32, this is plenty */
     } else {
         const size_t new_word_count = (self->capacity / BITS_PER_WORD + 1) * 3 / 2;
 
         if (self->is_owned) {
-            self->data = checked_realloc(self->data, sizeof(unsigned long) * new_word_count);
+            self->data = allocator_realloc(self->allocator, self->data,
+                                           self->capacity / BITS_PER_WORD * sizeof(unsigned long),
+                                           sizeof(unsigned long) * new_word_count);
         } else {
-            self->data = checked_malloc(sizeof(unsigned long) * new_word_count);
+            unsigned long *const data =
+                allocator_malloc(self->allocator, sizeof(unsigned long) * new_word_count);
+            memcpy(data, self->data, self->capacity / BITS_PER_WORD * sizeof(unsigned long));
+
+            self->data = data;
+            self->is_owned = 1;
         }
 
         self->capacity = new_word_count * BITS_PER_WORD;
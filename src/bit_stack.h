@@ -27,6 +27,8 @@
 #ifndef BLOODHOUND_IMPL_BIT_STACK_H
 #define BLOODHOUND_IMPL_BIT_STACK_H
 
+#include <bloodhound.h>
+
 #include <stddef.h>
 
 #ifdef __cplusplus
@@ -40,27 +42,34 @@ typedef struct BitStack BitStack;
  *  Initializes an empty BitStack.
  *
  *  @param self Must not be NULL. Must not be initialized.
+ *  @param allocator Will be used for every allocation the stack makes.
+ *                   If NULL, the default allocator is used.
  */
-void BitStack_new(BitStack *self);
+void BitStack_new(BitStack *self, AvlAllocator *allocator);
 
 /**
  *  Initializes an empty BitStack with space for at least capacity
  *  bits.
  *
  *  @param self Must not be NULL. Must not be initialized.
+ *  @param allocator Will be used for every allocation the stack makes.
+ *                   If NULL, the default allocator is used.
  */
-void BitStack_with_capacity(BitStack *self, size_t capacity);
+void BitStack_with_capacity(BitStack *self, AvlAllocator *allocator, size_t capacity);
 
 /**
  *  Initializes an empty BitStack that will initially use the adopted
  *  slice of memory until it fills up.
  *
  *  @param self Must not be NULL. Must not be initialized.
+ *  @param allocator Will be used for every allocation the stack makes.
+ *                   If NULL, the default allocator is used.
  *  @param data Must point to a buffer at least len * sizeof(unsigned
  *              long) bytes long.
  *  @param len Must be > 0.
  */
-void BitStack_from_adopted_slice(BitStack *self, unsigned long *data, size_t len);
+void BitStack_from_adopted_slice(BitStack *self, AvlAllocator *allocator, unsigned long *data,
+                                 size_t len);
 
 /**
  *  Drops a BitStack, deallocating all owned resources.
@@ -120,6 +129,7 @@ struct BitStack {
     size_t len;
     size_t capacity;
     int is_owned;
+    AvlAllocator *allocator; /* or NULL for the default */
 };
 
 #ifdef __cplusplus
@@ -0,0 +1,151 @@
+/*  MIT License
+ *
+ *  Copyright (c) 2019 Gregory Meyer
+ *
+ *  Permission is hereby granted, free of charge, to any person
+ *  obtaining a copy of this software and associated documentation
+ *  files (the "Software"), to deal in the Software without
+ *  restriction, including without limitation the rights to use, copy,
+ *  modify, merge, publish, distribute, sublicense, and/or sell copies
+ *  of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including
+ *  the next paragraph) shall be included in all copies or substantial
+ *  portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ *  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ *  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ *  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ *  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ */
+
+
+#include <bloodhound.h>
+
+#include <assert.h>
+#include <stddef.h>
+
+/**
+ *  Initializes an empty AvlBuilder.
+ *
+ *  @param self Must not be NULL. Must not be initialized.
+ *  @param compare Must not be NULL. Will be passed on to the tree
+ *                 built by AvlBuilder_finish, and is only invoked by
+ *                 AvlBuilder_push to check its precondition when
+ *                 assertions are enabled.
+ *  @param deleter Must not be NULL. Will be used to free nodes when
+ *                 they are no longer usable by the builder or its tree
+ *                 as if by deleter(node, deleter_arg).
+ */
+void AvlBuilder_new(AvlBuilder *self, AvlComparator compare, void *compare_arg,
+                    AvlDeleter deleter, void *deleter_arg) {
+    assert(self);
+    assert(compare);
+    assert(deleter);
+
+    AvlTree_new(&self->tree, compare, compare_arg, deleter, deleter_arg);
+    self->spine.len = 0;
+}
+
+/**
+ *  Initializes an empty AvlBuilder of AvlRankNodes.
+ *
+ *  Equivalent to AvlBuilder_new, except that AvlBuilder_finish yields
+ *  a tree ranked as if by AvlTree_new_ranked. Each push then also
+ *  updates the sizes along the right spine, so it takes O(log n) time.
+ *
+ *  @param self Must not be NULL. Must not be initialized.
+ *  @param compare Must not be NULL.
+ *  @param deleter Must not be NULL.
+ */
+void AvlBuilder_new_ranked(AvlBuilder *self, AvlComparator compare, void *compare_arg,
+                           AvlDeleter deleter, void *deleter_arg) {
+    assert(self);
+    assert(compare);
+    assert(deleter);
+
+    AvlTree_new_ranked(&self->tree, compare, compare_arg, deleter, deleter_arg);
+    self->spine.len = 0;
+}
+
+/**
+ *  Drops an AvlBuilder, deleting every node pushed since it was
+ *  initialized or last finished.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ */
+void AvlBuilder_drop(AvlBuilder *self) {
+    assert(self);
+
+    AvlTree_drop(&self->tree);
+}
+
+/**
+ *  Appends a node that compares greater than every node pushed so far.
+ *
+ *  The node becomes the right child of the greatest node, then the
+ *  right spine is rebalanced exactly as AvlTree_insert_at would, so
+ *  pushes take amortized O(1) time and never invoke compare outside
+ *  of assertions.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param node Must not be NULL. Must compare strictly greater than
+ *              the node pushed before it. Must be the node member of
+ *              an AvlRankNode if self was initialized by
+ *              AvlBuilder_new_ranked.
+ */
+void AvlBuilder_push(AvlBuilder *self, AvlNode *node) {
+    AvlCursor *const spine = &self->spine;
+    AvlNode *last;
+
+    assert(self);
+    assert(node);
+    assert(spine->len == 0
+           || self->tree.compare(node, spine->path[spine->len - 1],
+                                 self->tree.compare_arg) > 0);
+
+    AvlTree_insert_at(&self->tree, spine, 1, node);
+
+    /* a rotation leaves the spine ending at the root of the rotated subtree */
+    for (last = spine->path[spine->len - 1]; last->right; last = last->right) {
+        assert(spine->len < AVL_MAX_HEIGHT);
+        spine->path[spine->len++] = last->right;
+    }
+}
+
+/**
+ *  Moves every node pushed into an AvlBuilder into a new AvlTree.
+ *
+ *  Runs in O(1) time: the builder keeps a valid AvlTree at all times,
+ *  so there is nothing left to link or rebalance. Afterwards self is
+ *  empty and will build another tree with the same comparator and
+ *  deleter.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param tree Must not be NULL. Must not be initialized. Will be
+ *              initialized with every node pushed into self and with
+ *              the comparator and deleter of self.
+ */
+void AvlBuilder_finish(AvlBuilder *self, AvlTree *tree) {
+    AvlTree *const built = &self->tree;
+
+    assert(self);
+    assert(tree);
+
+    *tree = *built;
+
+    if (tree->is_ranked) {
+        AvlTree_new_ranked(built, tree->compare, tree->compare_arg, tree->deleter,
+                           tree->deleter_arg);
+    } else {
+        AvlTree_new(built, tree->compare, tree->compare_arg, tree->deleter,
+                    tree->deleter_arg);
+    }
+
+    self->spine.len = 0;
+}
@@ -0,0 +1,532 @@
+/*  MIT License
+ *
+ *  Copyright (c) 2019 Gregory Meyer
+ *
+ *  Permission is hereby granted, free of charge, to any person
+ *  obtaining a copy of this software and associated documentation
+ *  files (the "Software"), to deal in the Software without
+ *  restriction, including without limitation the rights to use, copy,
+ *  modify, merge, publish, distribute, sublicense, and/or sell copies
+ *  of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including
+ *  the next paragraph) shall be included in all copies or substantial
+ *  portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ *  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ *  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ *  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ *  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ */
+
+#include <bloodhound.h>
+
+#include <assert.h>
+#include <stddef.h>
+
+/* set in the link to the taller child, if there is one */
+#define TALLER_BIT ((size_t) 1)
+
+static AvlCompactNode* untag(const AvlCompactNode *link);
+
+static AvlCompactNode* left_of(const AvlCompactNode *node);
+
+static AvlCompactNode* right_of(const AvlCompactNode *node);
+
+static void set_left(AvlCompactNode *node, AvlCompactNode *child);
+
+static void set_right(AvlCompactNode *node, AvlCompactNode *child);
+
+static void set_balance_factor(AvlCompactNode *node, int balance_factor);
+
+static void set_child(AvlCompactTree *self, AvlCompactNode *const *path,
+                      const unsigned char *is_right, size_t depth, AvlCompactNode *child);
+
+static AvlCompactNode* rebalance(AvlCompactNode *root, int balance_factor);
+
+static AvlCompactNode* find(const AvlCompactTree *self, const void *key,
+                            AvlCompactHetComparator compare, void *arg);
+
+static void delete_compact_subtree(AvlCompactNode *root, AvlCompactDeleter deleter, void *arg);
+
+/**
+ *  Initializes an empty AvlCompactTree.
+ *
+ *  @param self Must not be NULL. Must not be initialized.
+ *  @param compare Must not be NULL. Will be invoked to compare nodes
+ *                 by compare(lhs, rhs, compare_arg). Return values
+ *                 should have the same meaning as strcmp and should
+ *                 form a total ordering over the set of nodes.
+ *  @param deleter Must not be NULL. Will be used to free nodes when
+ *                 they are no longer usable by the tree as if by
+ *                 deleter(node, deleter_arg).
+ */
+void AvlCompactTree_new(AvlCompactTree *self, AvlCompactComparator compare, void *compare_arg,
+                        AvlCompactDeleter deleter, void *deleter_arg) {
+    assert(self);
+    assert(compare);
+    assert(deleter);
+    assert(sizeof(size_t) >= sizeof(AvlCompactNode*));
+
+    self->root = NULL;
+    self->len = 0;
+    self->compare = compare;
+    self->compare_arg = compare_arg;
+    self->deleter = deleter;
+    self->deleter_arg = deleter_arg;
+}
+
+/**
+ *  Drops an AvlCompactTree, removing all members.
+ *
+ *  Equivalent to AvlCompactTree_clear.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ */
+void AvlCompactTree_drop(AvlCompactTree *self) {
+    assert(self);
+
+    AvlCompactTree_clear(self);
+}
+
+/**
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlCompactTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @returns A pointer to the node that compares equal to key, if
+ *           there is one.
+ */
+const AvlCompactNode* AvlCompactTree_get(const AvlCompactTree *self, const void *key,
+                                         AvlCompactHetComparator compare, void *arg) {
+    assert(self);
+    assert(compare);
+
+    return find(self, key, compare, arg);
+}
+
+/**
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlCompactTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @returns A mutable pointer to the node that compares equal to key,
+ *           if there is one.
+ */
+AvlCompactNode* AvlCompactTree_get_mut(AvlCompactTree *self, const void *key,
+                                       AvlCompactHetComparator compare, void *arg) {
+    assert(self);
+    assert(compare);
+
+    return find(self, key, compare, arg);
+}
+
+/**
+ *  Inserts a node into an AvlCompactTree or replaces the node that
+ *  compares equal to it.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param node Must not be NULL. Must not already be in self. Its
+ *              links will be overwritten.
+ *  @returns The replaced node, if there was one. Ownership is
+ *           transferred to the caller.
+ */
+AvlCompactNode* AvlCompactTree_insert(AvlCompactTree *self, AvlCompactNode *node) {
+    AvlCompactNode *path[AVL_MAX_HEIGHT];
+    unsigned char is_right[AVL_MAX_HEIGHT];
+    size_t depth = 0;
+    AvlCompactNode *current;
+
+    assert(self);
+    assert(node);
+    assert(((size_t) node & TALLER_BIT) == 0);
+
+    current = self->root;
+
+    while (current) {
+        const int ordering = self->compare(node, current, self->compare_arg);
+
+        if (ordering == 0) { /* node takes over the links and balance of current */
+            node->left = current->left;
+            node->right = current->right;
+            set_child(self, path, is_right, depth, node);
+
+            return current;
+        }
+
+        assert(depth < AVL_MAX_HEIGHT);
+        path[depth] = current;
+        is_right[depth] = (unsigned char) (ordering > 0);
+        ++depth;
+
+        if (ordering < 0) {
+            current = left_of(current);
+        } else {
+            current = right_of(current);
+        }
+    }
+
+    node->left = NULL;
+    node->right = NULL;
+    set_child(self, path, is_right, depth, node);
+    ++self->len;
+
+    /* walk back up until a subtree's height stops changing */
+    while (depth > 0) {
+        AvlCompactNode *parent;
+        int balance_factor;
+
+        --depth;
+        parent = path[depth];
+        balance_factor = AvlCompactNode_balance_factor(parent) + (is_right[depth] ? 1 : -1);
+
+        if (balance_factor == 2 || balance_factor == -2) {
+            set_child(self, path, is_right, depth, rebalance(parent, balance_factor));
+
+            break;
+        }
+
+        set_balance_factor(parent, balance_factor);
+
+        if (balance_factor == 0) {
+            break;
+        }
+    }
+
+    return NULL;
+}
+
+/**
+ *  Removes the node of an AvlCompactTree that compares equal to a key.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlCompactTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @returns The removed node, if there was one. Ownership is
+ *           transferred to the caller.
+ */
+AvlCompactNode* AvlCompactTree_remove(AvlCompactTree *self, const void *key,
+                                      AvlCompactHetComparator compare, void *arg) {
+    AvlCompactNode *path[AVL_MAX_HEIGHT];
+    unsigned char is_right[AVL_MAX_HEIGHT];
+    size_t depth = 0;
+    AvlCompactNode *target;
+
+    assert(self);
+    assert(compare);
+
+    target = self->root;
+
+    while (target) {
+        const int ordering = compare(key, target, arg);
+
+        if (ordering == 0) {
+            break;
+        }
+
+        assert(depth < AVL_MAX_HEIGHT);
+        path[depth] = target;
+        is_right[depth] = (unsigned char) (ordering > 0);
+        ++depth;
+
+        if (ordering < 0) {
+            target = left_of(target);
+        } else {
+            target = right_of(target);
+        }
+    }
+
+    if (!target) {
+        return NULL;
+    }
+
+    if (!left_of(target)) {
+        set_child(self, path, is_right, depth, right_of(target));
+    } else if (!right_of(target)) {
+        set_child(self, path, is_right, depth, left_of(target));
+    } else { /* the in-order successor moves into target's position */
+        const size_t target_depth = depth;
+        AvlCompactNode *successor;
+
+        path[depth] = target;
+        is_right[depth] = 1;
+        ++depth;
+        successor = right_of(target);
+
+        while (left_of(successor)) {
+            assert(depth < AVL_MAX_HEIGHT);
+            path[depth] = successor;
+            is_right[depth] = 0;
+            ++depth;
+            successor = left_of(successor);
+        }
+
+        set_child(self, path, is_right, depth, right_of(successor));
+
+        successor->left = target->left;
+        successor->right = target->right;
+        set_child(self, path, is_right, target_depth, successor);
+        path[target_depth] = successor;
+    }
+
+    --self->len;
+
+    /* walk back up until a subtree's height stops changing */
+    while (depth > 0) {
+        AvlCompactNode *parent;
+        int balance_factor;
+
+        --depth;
+        parent = path[depth];
+        balance_factor = AvlCompactNode_balance_factor(parent) + (is_right[depth] ? -1 : 1);
+
+        if (balance_factor == 2 || balance_factor == -2) {
+            AvlCompactNode *const new_root = rebalance(parent, balance_factor);
+
+            set_child(self, path, is_right, depth, new_root);
+
+            if (AvlCompactNode_balance_factor(new_root) != 0) {
+                break;
+            }
+        } else {
+            set_balance_factor(parent, balance_factor);
+
+            if (balance_factor != 0) {
+                break;
+            }
+        }
+    }
+
+    return target;
+}
+
+/**
+ *  Removes every node from an AvlCompactTree, passing each to the
+ *  deleter.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ */
+void AvlCompactTree_clear(AvlCompactTree *self) {
+    assert(self);
+
+    delete_compact_subtree(self->root, self->deleter, self->deleter_arg);
+    self->root = NULL;
+    self->len = 0;
+}
+
+/**
+ *  @param self Must not be NULL. Must be in an AvlCompactTree.
+ *  @returns The left child of self, if it has one.
+ */
+const AvlCompactNode* AvlCompactNode_left(const AvlCompactNode *self) {
+    assert(self);
+
+    return left_of(self);
+}
+
+/**
+ *  @param self Must not be NULL. Must be in an AvlCompactTree.
+ *  @returns The right child of self, if it has one.
+ */
+const AvlCompactNode* AvlCompactNode_right(const AvlCompactNode *self) {
+    assert(self);
+
+    return right_of(self);
+}
+
+/**
+ *  @param self Must not be NULL. Must be in an AvlCompactTree.
+ *  @returns The height of the right subtree of self minus the height
+ *           of its left subtree, which is one of {-1, 0, 1}.
+ */
+int AvlCompactNode_balance_factor(const AvlCompactNode *self) {
+    assert(self);
+
+    return (int) ((size_t) self->right & TALLER_BIT) - (int) ((size_t) self->left & TALLER_BIT);
+}
+
+static AvlCompactNode* untag(const AvlCompactNode *link) {
+    return (AvlCompactNode*) ((size_t) link & ~TALLER_BIT);
+}
+
+static AvlCompactNode* left_of(const AvlCompactNode *node) {
+    assert(node);
+
+    return untag(node->left);
+}
+
+static AvlCompactNode* right_of(const AvlCompactNode *node) {
+    assert(node);
+
+    return untag(node->right);
+}
+
+static void set_left(AvlCompactNode *node, AvlCompactNode *child) {
+    assert(node);
+    assert(((size_t) child & TALLER_BIT) == 0);
+
+    node->left = (AvlCompactNode*) ((size_t) child | ((size_t) node->left & TALLER_BIT));
+}
+
+static void set_right(AvlCompactNode *node, AvlCompactNode *child) {
+    assert(node);
+    assert(((size_t) child & TALLER_BIT) == 0);
+
+    node->right = (AvlCompactNode*) ((size_t) child | ((size_t) node->right & TALLER_BIT));
+}
+
+static void set_balance_factor(AvlCompactNode *node, int balance_factor) {
+    assert(node);
+    assert(balance_factor >= -1 && balance_factor <= 1);
+
+    node->left = (AvlCompactNode*) ((size_t) left_of(node)
+                                    | ((balance_factor < 0) ? TALLER_BIT : 0));
+    node->right = (AvlCompactNode*) ((size_t) right_of(node)
+                                     | ((balance_factor > 0) ? TALLER_BIT : 0));
+}
+
+/* points the link to path[depth] at child; depth 0 is the root */
+static void set_child(AvlCompactTree *self, AvlCompactNode *const *path,
+                      const unsigned char *is_right, size_t depth, AvlCompactNode *child) {
+    assert(self);
+
+    if (depth == 0) {
+        self->root = child;
+    } else if (is_right[depth - 1]) {
+        set_right(path[depth - 1], child);
+    } else {
+        set_left(path[depth - 1], child);
+    }
+}
+
+/**
+ *  Restores the AVL condition at a node whose subtrees differ in
+ *  height by two.
+ *
+ *  The balance factor of root is passed in because +/-2 can't be
+ *  stored in the tag bits.
+ *
+ *  @returns The new root of the subtree.
+ */
+static AvlCompactNode* rebalance(AvlCompactNode *root, int balance_factor) {
+    assert(root);
+    assert(balance_factor == 2 || balance_factor == -2);
+
+    if (balance_factor == 2) {
+        AvlCompactNode *const child = right_of(root);
+        const int child_balance_factor = AvlCompactNode_balance_factor(child);
+
+        if (child_balance_factor >= 0) { /* rotate left */
+            set_right(root, left_of(child));
+            set_left(child, root);
+
+            if (child_balance_factor == 0) { /* only after a removal */
+                set_balance_factor(root, 1);
+                set_balance_factor(child, -1);
+            } else {
+                set_balance_factor(root, 0);
+                set_balance_factor(child, 0);
+            }
+
+            return child;
+        } else { /* rotate right at child, then left at root */
+            AvlCompactNode *const grandchild = left_of(child);
+            const int grandchild_balance_factor = AvlCompactNode_balance_factor(grandchild);
+
+            set_right(root, left_of(grandchild));
+            set_left(child, right_of(grandchild));
+            set_left(grandchild, root);
+            set_right(grandchild, child);
+
+            set_balance_factor(root, (grandchild_balance_factor > 0) ? -1 : 0);
+            set_balance_factor(child, (grandchild_balance_factor < 0) ? 1 : 0);
+            set_balance_factor(grandchild, 0);
+
+            return grandchild;
+        }
+    } else {
+        AvlCompactNode *const child = left_of(root);
+        const int child_balance_factor = AvlCompactNode_balance_factor(child);
+
+        if (child_balance_factor <= 0) { /* rotate right */
+            set_left(root, right_of(child));
+            set_right(child, root);
+
+            if (child_balance_factor == 0) { /* only after a removal */
+                set_balance_factor(root, -1);
+                set_balance_factor(child, 1);
+            } else {
+                set_balance_factor(root, 0);
+                set_balance_factor(child, 0);
+            }
+
+            return child;
+        } else { /* rotate left at child, then right at root */
+            AvlCompactNode *const grandchild = right_of(child);
+            const int grandchild_balance_factor = AvlCompactNode_balance_factor(grandchild);
+
+            set_left(root, right_of(grandchild));
+            set_right(child, left_of(grandchild));
+            set_right(grandchild, root);
+            set_left(grandchild, child);
+
+            set_balance_factor(root, (grandchild_balance_factor < 0) ? 1 : 0);
+            set_balance_factor(child, (grandchild_balance_factor > 0) ? -1 : 0);
+            set_balance_factor(grandchild, 0);
+
+            return grandchild;
+        }
+    }
+}
+
+static AvlCompactNode* find(const AvlCompactTree *self, const void *key,
+                            AvlCompactHetComparator compare, void *arg) {
+    AvlCompactNode *current;
+
+    assert(self);
+    assert(compare);
+
+    current = self->root;
+
+    while (current) {
+        const int ordering = compare(key, current, arg);
+
+        if (ordering == 0) {
+            break;
+        } else if (ordering < 0) {
+            current = left_of(current);
+        } else {
+            current = right_of(current);
+        }
+    }
+
+    return current;
+}
+
+/* recursion depth is bounded by the height of the tree */
+static void delete_compact_subtree(AvlCompactNode *root, AvlCompactDeleter deleter, void *arg) {
+    AvlCompactNode *left;
+    AvlCompactNode *right;
+
+    assert(deleter);
+
+    if (!root) {
+        return;
+    }
+
+    left = left_of(root);
+    right = right_of(root);
+    deleter(root, arg);
+
+    delete_compact_subtree(left, deleter, arg);
+    delete_compact_subtree(right, deleter, arg);
+}
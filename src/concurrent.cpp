@@ -0,0 +1,495 @@
+//  MIT License
+//
+//  Copyright (c) 2019 Gregory Meyer
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//  files (the "Software"), to deal in the Software without
+//  restriction, including without limitation the rights to use, copy,
+//  modify, merge, publish, distribute, sublicense, and/or sell copies
+//  of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice (including
+//  the next paragraph) shall be included in all copies or substantial
+//  portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+//  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+//  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+//  IN THE SOFTWARE.
+
+#include <bloodhound_concurrent.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <exception>
+#include <mutex>
+#include <new>
+#include <vector>
+
+namespace {
+
+// keeps data written by different threads on different cache lines;
+// C++11 has no over-aligned new, so this is done with padding
+constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+// retired nodes are reclaimed in batches of about this many
+constexpr std::size_t RECLAIM_THRESHOLD = 64;
+
+[[noreturn]] void die(const char *function, const std::exception &e) noexcept {
+    std::fprintf(stderr, "%s: %s\n", function, e.what());
+    std::abort();
+}
+
+} // namespace
+
+struct AvlReader {
+    explicit AvlReader(AvlConcurrentTree &t) noexcept : epoch(0), tree(t) { }
+
+    char padding_before[CACHE_LINE_SIZE];
+
+    // the global epoch seen on entry, or 0 outside of a read section
+    std::atomic<unsigned long> epoch;
+
+    char padding_after[CACHE_LINE_SIZE];
+    AvlConcurrentTree &tree;
+};
+
+struct AvlConcurrentTree {
+public:
+    AvlConcurrentTree(AvlComparator compare, void *compare_arg, AvlCloner clone,
+                      void *clone_arg, AvlDeleter deleter, void *deleter_arg) noexcept;
+
+    AvlConcurrentTree(const AvlConcurrentTree &other) = delete;
+
+    ~AvlConcurrentTree();
+
+    void add_reader(AvlReader &reader);
+
+    void remove_reader(AvlReader &reader) noexcept;
+
+    void enter(AvlReader &reader) const noexcept;
+
+    const AvlNode* get(const void *key, AvlHetComparator compare, void *arg) const noexcept;
+
+    std::size_t scan(const void *key, AvlHetComparator compare, void *arg,
+                     const AvlNode **nodes, std::size_t max_nodes) const noexcept;
+
+    bool insert(AvlNode *node);
+
+    bool remove(const void *key, AvlHetComparator compare, void *arg);
+
+    std::size_t len() const noexcept {
+        return len_.load(std::memory_order_relaxed);
+    }
+
+private:
+    // a version that readers may still be walking
+    struct Retired {
+        AvlPersistentTree version;
+        unsigned long epoch;
+    };
+
+    // runs a change to impl_ on copies of the nodes it touches, then
+    // publishes the result; mutex_ must be held
+    template <typename F>
+    auto write(F &&f) -> decltype(f());
+
+    void retire(const AvlPersistentTree &version);
+
+    void try_reclaim() noexcept;
+
+    // the root of the latest version; nothing reachable from it is
+    // written again until it is reclaimed
+    std::atomic<const AvlNode*> root_;
+    std::atomic<unsigned long> epoch_;
+    std::atomic<std::size_t> len_;
+
+    // readers never touch anything below here
+    char padding_[CACHE_LINE_SIZE];
+    std::mutex mutex_;
+    AvlPersistentTree impl_;
+    std::vector<AvlReader*> readers_;
+    std::vector<Retired> retired_;
+};
+
+AvlConcurrentTree::AvlConcurrentTree(AvlComparator compare, void *compare_arg,
+                                     AvlCloner clone, void *clone_arg, AvlDeleter deleter,
+                                     void *deleter_arg) noexcept
+: root_(nullptr), epoch_(1), len_(0) {
+    AvlPersistentTree_new(&impl_, compare, compare_arg, clone, clone_arg, deleter,
+                          deleter_arg);
+}
+
+AvlConcurrentTree::~AvlConcurrentTree() {
+    assert(readers_.empty());
+
+    for (Retired &retired : retired_) {
+        AvlPersistentTree_drop(&retired.version);
+    }
+
+    AvlPersistentTree_drop(&impl_);
+}
+
+void AvlConcurrentTree::add_reader(AvlReader &reader) {
+    const std::lock_guard<std::mutex> guard(mutex_);
+
+    readers_.push_back(&reader);
+}
+
+void AvlConcurrentTree::remove_reader(AvlReader &reader) noexcept {
+    const std::lock_guard<std::mutex> guard(mutex_);
+
+    assert(reader.epoch.load(std::memory_order_relaxed) == 0);
+    readers_.erase(std::find(readers_.begin(), readers_.end(), &reader));
+}
+
+void AvlConcurrentTree::enter(AvlReader &reader) const noexcept {
+    reader.epoch.store(epoch_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+    // pairs with the fence in try_reclaim: either the writer sees this
+    // reader's epoch, or this reader never sees the nodes it retired
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+}
+
+const AvlNode* AvlConcurrentTree::get(const void *key, AvlHetComparator compare,
+                                      void *arg) const noexcept {
+    const AvlNode *current = root_.load(std::memory_order_acquire);
+
+    while (current) {
+        const int ordering = compare(key, current, arg);
+
+        if (ordering == 0) {
+            return current;
+        }
+
+        current = (ordering < 0) ? current->left : current->right;
+    }
+
+    return nullptr;
+}
+
+std::size_t AvlConcurrentTree::scan(const void *key, AvlHetComparator compare, void *arg,
+                                    const AvlNode **nodes,
+                                    std::size_t max_nodes) const noexcept {
+    // the nodes not yet visited whose left subtrees are done
+    const AvlNode *path[AVL_MAX_HEIGHT];
+    std::size_t path_len = 0;
+    std::size_t num_nodes = 0;
+    const AvlNode *current = root_.load(std::memory_order_acquire);
+
+    while (current) {
+        if (!key || compare(key, current, arg) <= 0) {
+            assert(path_len < AVL_MAX_HEIGHT);
+            path[path_len++] = current;
+            current = current->left;
+        } else {
+            current = current->right;
+        }
+    }
+
+    while (path_len > 0 && num_nodes < max_nodes) {
+        const AvlNode *const node = path[--path_len];
+
+        nodes[num_nodes++] = node;
+        current = node->right;
+
+        while (current) {
+            assert(path_len < AVL_MAX_HEIGHT);
+            path[path_len++] = current;
+            current = current->left;
+        }
+    }
+
+    return num_nodes;
+}
+
+bool AvlConcurrentTree::insert(AvlNode *node) {
+    const std::lock_guard<std::mutex> guard(mutex_);
+
+    return write([&] { return AvlPersistentTree_insert(&impl_, node) != 0; });
+}
+
+bool AvlConcurrentTree::remove(const void *key, AvlHetComparator compare, void *arg) {
+    const std::lock_guard<std::mutex> guard(mutex_);
+
+    return write([&] { return AvlPersistentTree_remove(&impl_, key, compare, arg) != 0; });
+}
+
+template <typename F>
+auto AvlConcurrentTree::write(F &&f) -> decltype(f()) {
+    AvlPersistentTree previous;
+
+    // shares every published node with previous, so f copies each one
+    // it would change instead of relinking it under a reader
+    AvlPersistentTree_snapshot(&impl_, &previous);
+
+    const auto result = std::forward<F>(f)();
+
+    if (impl_.root == previous.root) {
+        AvlPersistentTree_drop(&previous);
+
+        return result;
+    }
+
+    // pairs with the acquire loads in get and scan, which then see
+    // every link f wrote
+    root_.store(impl_.root, std::memory_order_release);
+    len_.store(impl_.len, std::memory_order_relaxed);
+    retire(previous);
+
+    return result;
+}
+
+void AvlConcurrentTree::retire(const AvlPersistentTree &version) {
+    retired_.push_back({version, epoch_.load(std::memory_order_relaxed)});
+
+    if (retired_.size() >= RECLAIM_THRESHOLD) {
+        try_reclaim();
+    }
+}
+
+// a version retired at epoch e is unreachable for readers that entered
+// after it, so once every reader has been seen at e + 1 it is free;
+// dropping it passes the nodes no later version shares to the deleter
+void AvlConcurrentTree::try_reclaim() noexcept {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    const unsigned long epoch = epoch_.load(std::memory_order_relaxed);
+    const bool can_advance = std::all_of(readers_.begin(), readers_.end(),
+                                         [epoch](const AvlReader *reader) {
+        const unsigned long reader_epoch = reader->epoch.load(std::memory_order_acquire);
+
+        return reader_epoch == 0 || reader_epoch == epoch;
+    });
+
+    if (can_advance) {
+        epoch_.store(epoch + 1, std::memory_order_relaxed);
+    }
+
+    const unsigned long current = epoch_.load(std::memory_order_relaxed);
+    const auto is_reclaimable = [current](const Retired &retired) {
+        return retired.epoch + 2 <= current;
+    };
+
+    for (Retired &retired : retired_) {
+        if (is_reclaimable(retired)) {
+            AvlPersistentTree_drop(&retired.version);
+        }
+    }
+
+    retired_.erase(std::remove_if(retired_.begin(), retired_.end(), is_reclaimable),
+                   retired_.end());
+}
+
+/**
+ *  Creates an empty AvlConcurrentTree.
+ *
+ *  @param compare Must not be NULL.
+ *  @param clone Must not be NULL.
+ *  @param deleter Must not be NULL.
+ *  @returns A tree to be dropped with AvlConcurrentTree_drop.
+ */
+AvlConcurrentTree* AvlConcurrentTree_new(AvlComparator compare, void *compare_arg,
+                                         AvlCloner clone, void *clone_arg, AvlDeleter deleter,
+                                         void *deleter_arg) {
+    assert(compare);
+    assert(clone);
+    assert(deleter);
+
+    try {
+        return new AvlConcurrentTree(compare, compare_arg, clone, clone_arg, deleter,
+                                     deleter_arg);
+    } catch (const std::bad_alloc &e) {
+        die("AvlConcurrentTree_new", e);
+    }
+}
+
+/**
+ *  Drops an AvlConcurrentTree, passing every node it still holds to
+ *  the deleter.
+ *
+ *  @param self May be NULL. No other call using self may be in
+ *              progress and every reader of self must have been
+ *              dropped.
+ */
+void AvlConcurrentTree_drop(AvlConcurrentTree *self) {
+    delete self;
+}
+
+/**
+ *  Registers a reader of an AvlConcurrentTree.
+ *
+ *  @param tree Must not be NULL.
+ *  @returns A reader outside of any read section, to be dropped with
+ *           AvlReader_drop before tree is.
+ */
+AvlReader* AvlReader_new(AvlConcurrentTree *tree) {
+    assert(tree);
+
+    try {
+        AvlReader *const reader = new AvlReader(*tree);
+
+        try {
+            tree->add_reader(*reader);
+        } catch (...) {
+            delete reader;
+
+            throw;
+        }
+
+        return reader;
+    } catch (const std::exception &e) {
+        die("AvlReader_new", e);
+    }
+}
+
+/**
+ *  Unregisters a reader.
+ *
+ *  @param self May be NULL. Must not be in a read section.
+ */
+void AvlReader_drop(AvlReader *self) {
+    if (!self) {
+        return;
+    }
+
+    self->tree.remove_reader(*self);
+    delete self;
+}
+
+/**
+ *  Starts a read section.
+ *
+ *  @param self Must not be NULL. Must not already be in a read
+ *              section.
+ */
+void AvlReader_enter(AvlReader *self) {
+    assert(self);
+    assert(self->epoch.load(std::memory_order_relaxed) == 0);
+
+    self->tree.enter(*self);
+}
+
+/**
+ *  Ends a read section.
+ *
+ *  @param self Must not be NULL. Must be in a read section.
+ */
+void AvlReader_exit(AvlReader *self) {
+    assert(self);
+    assert(self->epoch.load(std::memory_order_relaxed) != 0);
+
+    self->epoch.store(0, std::memory_order_release);
+}
+
+/**
+ *  Finds the node that compares equal to a key in the latest version
+ *  of an AvlConcurrentTree, without locks or retries.
+ *
+ *  @param self Must not be NULL.
+ *  @param reader Must not be NULL. Must be a reader of self that is in
+ *                a read section.
+ *  @param compare Must not be NULL.
+ *  @returns A pointer to the node that compared equal to key in the
+ *           version that was latest when the call began, if there was
+ *           one.
+ */
+const AvlNode* AvlConcurrentTree_get(const AvlConcurrentTree *self, const AvlReader *reader,
+                                     const void *key, AvlHetComparator compare, void *arg) {
+    assert(self);
+    assert(reader);
+    assert(&reader->tree == self);
+    assert(reader->epoch.load(std::memory_order_relaxed) != 0);
+    assert(compare);
+
+    // the read section keeps the nodes alive; the walk itself needs no reader
+    (void) reader;
+
+    return self->get(key, compare, arg);
+}
+
+/**
+ *  Collects nodes in order from the latest version of an
+ *  AvlConcurrentTree, starting from the least node that does not
+ *  compare less than a key, without locks or retries.
+ *
+ *  @param self Must not be NULL.
+ *  @param reader Must not be NULL. Must be a reader of self that is in
+ *                a read section.
+ *  @param compare Must not be NULL if key is not NULL.
+ *  @param nodes Must not be NULL if max_nodes > 0.
+ *  @returns The number of nodes written to nodes.
+ */
+std::size_t AvlConcurrentTree_scan(const AvlConcurrentTree *self, const AvlReader *reader,
+                                   const void *key, AvlHetComparator compare, void *arg,
+                                   const AvlNode **nodes, std::size_t max_nodes) {
+    assert(self);
+    assert(reader);
+    assert(&reader->tree == self);
+    assert(reader->epoch.load(std::memory_order_relaxed) != 0);
+    assert(!key || compare);
+    assert(max_nodes == 0 || nodes);
+
+    (void) reader;
+
+    return self->scan(key, compare, arg, nodes, max_nodes);
+}
+
+/**
+ *  Inserts a node or replaces the node that compares equal to it.
+ *
+ *  @param self Must not be NULL.
+ *  @param node Must not be NULL. Must be the node member of an
+ *              AvlPersistentNode that is in no tree.
+ *  @returns Nonzero if a node was replaced.
+ */
+int AvlConcurrentTree_insert(AvlConcurrentTree *self, AvlNode *node) {
+    assert(self);
+    assert(node);
+
+    try {
+        return self->insert(node);
+    } catch (const std::exception &e) {
+        die("AvlConcurrentTree_insert", e);
+    }
+}
+
+/**
+ *  Removes the node that compares equal to a key.
+ *
+ *  @param self Must not be NULL.
+ *  @param compare Must not be NULL.
+ *  @returns Nonzero if a node was removed.
+ */
+int AvlConcurrentTree_remove(AvlConcurrentTree *self, const void *key,
+                             AvlHetComparator compare, void *arg) {
+    assert(self);
+    assert(compare);
+
+    try {
+        return self->remove(key, compare, arg);
+    } catch (const std::exception &e) {
+        die("AvlConcurrentTree_remove", e);
+    }
+}
+
+/**
+ *  @param self Must not be NULL.
+ *  @returns The number of nodes in self as of the last completed
+ *           write.
+ */
+std::size_t AvlConcurrentTree_len(const AvlConcurrentTree *self) {
+    assert(self);
+
+    return self->len();
+}
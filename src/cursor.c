@@ -0,0 +1,281 @@
+/*  MIT License
+ *
+ *  Copyright (c) 2019 Gregory Meyer
+ *
+ *  Permission is hereby granted, free of charge, to any person
+ *  obtaining a copy of this software and associated documentation
+ *  files (the "Software"), to deal in the Software without
+ *  restriction, including without limitation the rights to use, copy,
+ *  modify, merge, publish, distribute, sublicense, and/or sell copies
+ *  of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including
+ *  the next paragraph) shall be included in all copies or substantial
+ *  portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ *  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ *  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ *  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ *  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ */
+
+#include <bloodhound.h>
+
+#include "stats.h"
+
+#include <assert.h>
+#include <stddef.h>
+
+static void push_leftmost(AvlCursor *self, AvlNode *node);
+
+static void push_rightmost(AvlCursor *self, AvlNode *node);
+
+/**
+ *  Points a cursor at the least node of an AvlTree.
+ *
+ *  @param self Must not be NULL.
+ *  @param tree Must not be NULL. Must be initialized. If empty, self
+ *              will point past the end.
+ */
+void AvlCursor_first(AvlCursor *self, const AvlTree *tree) {
+    assert(self);
+    assert(tree);
+
+    self->len = 0;
+    push_leftmost(self, tree->root);
+}
+
+/**
+ *  Points a cursor at the greatest node of an AvlTree.
+ *
+ *  @param self Must not be NULL.
+ *  @param tree Must not be NULL. Must be initialized. If empty, self
+ *              will point past the end.
+ */
+void AvlCursor_last(AvlCursor *self, const AvlTree *tree) {
+    assert(self);
+    assert(tree);
+
+    self->len = 0;
+    push_rightmost(self, tree->root);
+}
+
+/**
+ *  Advances a cursor to the in-order successor of its node.
+ *
+ *  @param self Must not be NULL. Must be initialized. If it points to
+ *              the greatest node, it will point past the end. If it
+ *              already points past the end, this is a noop.
+ */
+void AvlCursor_next(AvlCursor *self) {
+    AvlNode *current;
+
+    assert(self);
+
+    if (self->len == 0) {
+        return;
+    }
+
+    current = self->path[self->len - 1];
+
+    if (current->right) {
+        push_leftmost(self, current->right);
+
+        return;
+    }
+
+    /* climb until we leave a left subtree */
+    while (1) {
+        AvlNode *const child = self->path[--self->len];
+
+        if (self->len == 0 || self->path[self->len - 1]->left == child) {
+            return;
+        }
+    }
+}
+
+/**
+ *  Moves a cursor to the in-order predecessor of its node.
+ *
+ *  @param self Must not be NULL. Must be initialized. If it points to
+ *              the least node, it will point past the end. If it
+ *              already points past the end, this is a noop.
+ */
+void AvlCursor_prev(AvlCursor *self) {
+    AvlNode *current;
+
+    assert(self);
+
+    if (self->len == 0) {
+        return;
+    }
+
+    current = self->path[self->len - 1];
+
+    if (current->left) {
+        push_rightmost(self, current->left);
+
+        return;
+    }
+
+    /* climb until we leave a right subtree */
+    while (1) {
+        AvlNode *const child = self->path[--self->len];
+
+        if (self->len == 0 || self->path[self->len - 1]->right == child) {
+            return;
+        }
+    }
+}
+
+/**
+ *  @param self Must not be NULL. Must be initialized.
+ *  @returns The node self points to, or NULL if self points past the
+ *           end.
+ */
+const AvlNode* AvlCursor_get(const AvlCursor *self) {
+    assert(self);
+
+    if (self->len == 0) {
+        return NULL;
+    }
+
+    return self->path[self->len - 1];
+}
+
+/**
+ *  @param self Must not be NULL. Must be initialized.
+ *  @returns A mutable pointer to the node self points to, or NULL if
+ *           self points past the end.
+ */
+AvlNode* AvlCursor_get_mut(AvlCursor *self) {
+    assert(self);
+
+    if (self->len == 0) {
+        return NULL;
+    }
+
+    return self->path[self->len - 1];
+}
+
+static void find_bound(const AvlTree *self, const void *key, AvlHetComparator compare,
+                       void *arg, AvlCursor *cursor, int is_upper);
+
+/**
+ *  Points a cursor at the least node that does not compare less than
+ *  a key.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @param cursor Must not be NULL. Will point to the least node such
+ *                that compare(key, node, arg) <= 0, or past the end if
+ *                there is no such node.
+ */
+void AvlTree_lower_bound(const AvlTree *self, const void *key, AvlHetComparator compare,
+                         void *arg, AvlCursor *cursor) {
+    find_bound(self, key, compare, arg, cursor, 0);
+}
+
+/**
+ *  Points a cursor at the least node that compares greater than a
+ *  key.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @param cursor Must not be NULL. Will point to the least node such
+ *                that compare(key, node, arg) < 0, or past the end if
+ *                there is no such node.
+ */
+void AvlTree_upper_bound(const AvlTree *self, const void *key, AvlHetComparator compare,
+                         void *arg, AvlCursor *cursor) {
+    find_bound(self, key, compare, arg, cursor, 1);
+}
+
+/**
+ *  Finds the range of nodes that compare equal to a key.
+ *
+ *  Since compare only needs to be consistent with the ordering of the
+ *  tree, this doubles as a range query: a comparator that returns 0
+ *  for every node inside [lower, upper] and orders the key before or
+ *  after every other node will yield exactly those nodes. Visiting k
+ *  nodes this way takes O(log n + k) time.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @param first Must not be NULL. Will be initialized as if by
+ *               AvlTree_lower_bound.
+ *  @param last Must not be NULL. Will be initialized as if by
+ *              AvlTree_upper_bound.
+ */
+void AvlTree_equal_range(const AvlTree *self, const void *key, AvlHetComparator compare,
+                         void *arg, AvlCursor *first, AvlCursor *last) {
+    find_bound(self, key, compare, arg, first, 0);
+    find_bound(self, key, compare, arg, last, 1);
+}
+
+/* the bound is the last node on the search path where we went left */
+static void find_bound(const AvlTree *self, const void *key, AvlHetComparator compare,
+                       void *arg, AvlCursor *cursor, int is_upper) {
+    AvlNode *current;
+    size_t bound_len = 0;
+
+    assert(self);
+    assert(compare);
+    assert(cursor);
+
+    cursor->len = 0;
+
+    for (current = self->root; current;) {
+        const int ordering = compare(key, current, arg);
+
+        assert(cursor->len < AVL_MAX_HEIGHT);
+        cursor->path[cursor->len] = current;
+        ++cursor->len;
+
+        if (ordering < 0 || (ordering == 0 && !is_upper)) { /* current is a candidate */
+            bound_len = cursor->len;
+            current = current->left;
+        } else {
+            current = current->right;
+        }
+    }
+
+    SHARED_STATS_SEARCH(LOOKUP_STATS(self), cursor->len);
+    cursor->len = bound_len;
+}
+
+static void push_leftmost(AvlCursor *self, AvlNode *node) {
+    assert(self);
+
+    for (; node; node = node->left) {
+        assert(self->len < AVL_MAX_HEIGHT);
+
+        self->path[self->len] = node;
+        ++self->len;
+    }
+}
+
+static void push_rightmost(AvlCursor *self, AvlNode *node) {
+    assert(self);
+
+    for (; node; node = node->right) {
+        assert(self->len < AVL_MAX_HEIGHT);
+
+        self->path[self->len] = node;
+        ++self->len;
+    }
+}
@@ -0,0 +1,489 @@
+/*  MIT License
+ *
+ *  Copyright (c) 2019 Gregory Meyer
+ *
+ *  Permission is hereby granted, free of charge, to any person
+ *  obtaining a copy of this software and associated documentation
+ *  files (the "Software"), to deal in the Software without
+ *  restriction, including without limitation the rights to use, copy,
+ *  modify, merge, publish, distribute, sublicense, and/or sell copies
+ *  of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including
+ *  the next paragraph) shall be included in all copies or substantial
+ *  portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ *  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ *  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ *  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ *  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ */
+
+#include <bloodhound.h>
+
+#include "mem.h"
+#include "node.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <string.h>
+
+/**
+ *  How far ahead of the current slot lookups prefetch. The four
+ *  descendants of slot k two levels down are contiguous, so one
+ *  prefetch covers a whole level of pointers or the start of a level
+ *  of copies. Looking further ahead measured slower.
+ */
+#define PREFETCH_AHEAD 4
+
+/*
+ *  An image is this header padded to IMAGE_HEADER_SIZE bytes, then the
+ *  slots of a snapshot of copies from slot 0 on. The header records
+ *  what the slots depend on, so an image from a machine with a
+ *  different byte order or word size is rejected instead of misread.
+ */
+typedef struct ImageHeader {
+    char magic[8];
+    size_t byte_order; /* IMAGE_BYTE_ORDER as written */
+    size_t stride;
+    size_t len;
+} ImageHeader;
+
+#define IMAGE_MAGIC "AVLIMG\0\1"
+#define IMAGE_BYTE_ORDER ((size_t) 0x01020304UL)
+#define IMAGE_HEADER_SIZE ((size_t) 64)
+
+static void freeze(const AvlTree *self, AvlFrozenTree *frozen, size_t stride, int is_copy);
+
+static void init_image_view(AvlFrozenTree *self, const void *image, size_t stride, size_t len);
+
+static void fill_eytzinger(const AvlFrozenTree *self, char *slots, size_t index,
+                           AvlCursor *cursor);
+
+static const AvlNode* slot_node(const AvlFrozenTree *self, size_t index);
+
+static size_t lower_bound_index(const AvlFrozenTree *self, const void *key,
+                                AvlHetComparator compare, void *arg);
+
+/**
+ *  Takes a read-only snapshot of the nodes of an AvlTree.
+ *
+ *  Runs in O(n) time and allocates one pointer per node. Lookups on
+ *  frozen return the nodes of self, which must outlive it.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param frozen Must not be NULL. Must not be initialized.
+ */
+void AvlTree_freeze(const AvlTree *self, AvlFrozenTree *frozen) {
+    freeze(self, frozen, sizeof(const AvlNode*), 0);
+}
+
+/**
+ *  Takes a read-only snapshot of copies of the nodes of an AvlTree.
+ *
+ *  Runs in O(n) time and allocates node_size bytes per node. Lookups
+ *  on frozen return pointers to the copies, which the comparators
+ *  and the caller may read as if they were the original nodes.
+ *
+ *  @param self Must not be NULL. Must be initialized. Must not have
+ *              been initialized by AvlTree_new_with_offset with a
+ *              nonzero node_offset, since its nodes are not at the
+ *              start of their containers; freeze it with
+ *              AvlTree_freeze instead.
+ *  @param frozen Must not be NULL. Must not be initialized.
+ *  @param node_size The size of the type that contains each node, such
+ *                   as sizeof(Node). Every node must be at the start
+ *                   of an object of that size that can be copied with
+ *                   memcpy.
+ */
+void AvlTree_freeze_copies(const AvlTree *self, AvlFrozenTree *frozen, size_t node_size) {
+    assert(self);
+    assert(self->node_offset == 0);
+    assert(node_size >= sizeof(AvlNode));
+
+    freeze(self, frozen, node_size, 1);
+}
+
+/**
+ *  Rebuilds a snapshot after its AvlTree was modified.
+ *
+ *  Reuses the memory of self if it is large enough. Snapshots of
+ *  copies stay snapshots of copies.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param tree Must not be NULL. Must be initialized. Need not be the
+ *              tree self was frozen from. If self holds copies, must
+ *              be a tree AvlTree_freeze_copies accepts.
+ */
+void AvlFrozenTree_refreeze(AvlFrozenTree *self, const AvlTree *tree) {
+    AvlCursor cursor;
+
+    assert(self);
+    assert(tree);
+    assert(!self->is_copy || tree->node_offset == 0);
+
+    if (self->is_image) { /* the image is not ours to overwrite */
+        self->slots = NULL;
+        self->is_image = 0;
+    }
+
+    if (tree->len + 1 > self->capacity) {
+        allocator_free(self->allocator, self->buffer, self->capacity * self->stride);
+        self->capacity = tree->len + 1;
+        self->buffer = (char*) allocator_malloc(self->allocator, self->capacity * self->stride);
+    }
+
+    self->slots = self->buffer;
+    self->len = tree->len;
+
+    AvlCursor_first(&cursor, tree);
+    fill_eytzinger(self, self->buffer, 1, &cursor);
+    assert(!AvlCursor_get(&cursor));
+}
+
+/**
+ *  Drops a snapshot. The nodes it points to are not affected.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ */
+void AvlFrozenTree_drop(AvlFrozenTree *self) {
+    assert(self);
+
+    allocator_free(self->allocator, self->buffer, self->capacity * self->stride);
+
+    self->slots = NULL;
+    self->buffer = NULL;
+    self->len = 0;
+    self->capacity = 0;
+}
+
+/**
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @returns A pointer to the node that compares equal to key, if
+ *           there is one.
+ */
+const AvlNode* AvlFrozenTree_get(const AvlFrozenTree *self, const void *key,
+                                 AvlHetComparator compare, void *arg) {
+    const AvlNode *node;
+    size_t index;
+
+    assert(self);
+    assert(compare);
+
+    index = lower_bound_index(self, key, compare, arg);
+
+    if (index == 0) {
+        return NULL;
+    }
+
+    node = slot_node(self, index);
+
+    return (compare(key, node, arg) == 0) ? node : NULL;
+}
+
+/**
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @returns A pointer to the least node such that
+ *           compare(key, node, arg) <= 0, if there is one.
+ */
+const AvlNode* AvlFrozenTree_lower_bound(const AvlFrozenTree *self, const void *key,
+                                         AvlHetComparator compare, void *arg) {
+    size_t index;
+
+    assert(self);
+    assert(compare);
+
+    index = lower_bound_index(self, key, compare, arg);
+
+    return (index == 0) ? NULL : slot_node(self, index);
+}
+
+/**
+ *  Looks up a batch of keys, interleaving their searches.
+ *
+ *  Equivalent to calling AvlFrozenTree_get on each key, but runs up to
+ *  AVL_GET_MANY_LANES searches in lockstep like AvlTree_get_many.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param keys Must not be NULL if num_keys > 0. Each element is
+ *              passed to compare as the key to look up.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @param found Must not be NULL if num_keys > 0. Element i will be
+ *               set to the node that compares equal to keys[i], or
+ *               NULL if there is none.
+ */
+void AvlFrozenTree_get_many(const AvlFrozenTree *self, const void *const *keys,
+                            size_t num_keys, AvlHetComparator compare, void *arg,
+                            const AvlNode **found) {
+    size_t first;
+
+    assert(self);
+    assert(num_keys == 0 || keys);
+    assert(compare);
+    assert(num_keys == 0 || found);
+
+    for (first = 0; first < num_keys; first += AVL_GET_MANY_LANES) {
+        size_t index[AVL_GET_MANY_LANES];
+        const size_t num_lanes = (num_keys - first < AVL_GET_MANY_LANES)
+                                 ? num_keys - first : AVL_GET_MANY_LANES;
+        size_t num_active = (self->len > 0) ? num_lanes : 0;
+        size_t lane;
+
+        for (lane = 0; lane < num_lanes; ++lane) {
+            index[lane] = 1;
+        }
+
+        /* searches differ in depth by at most one level */
+        while (num_active > 0) {
+            num_active = 0;
+
+            for (lane = 0; lane < num_lanes; ++lane) {
+                size_t ahead;
+                int ordering;
+
+                if (index[lane] > self->len) {
+                    continue;
+                }
+
+                ahead = PREFETCH_AHEAD * index[lane];
+                ordering = compare(keys[first + lane], slot_node(self, index[lane]), arg);
+
+                PREFETCH(self->slots + ((ahead < self->len) ? ahead : self->len) * self->stride);
+                index[lane] = 2 * index[lane] + (size_t) (ordering > 0);
+                num_active += index[lane] <= self->len;
+            }
+        }
+
+        for (lane = 0; lane < num_lanes; ++lane) {
+            const AvlNode *node;
+
+            while (index[lane] & 1) {
+                index[lane] >>= 1;
+            }
+
+            index[lane] >>= 1;
+
+            if (index[lane] == 0) {
+                found[first + lane] = NULL;
+
+                continue;
+            }
+
+            node = slot_node(self, index[lane]);
+            found[first + lane] = (compare(keys[first + lane], node, arg) == 0) ? node : NULL;
+        }
+    }
+}
+
+/**
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param node_size As for AvlTree_freeze_copies.
+ *  @returns The number of bytes AvlTree_write_image writes for self.
+ */
+size_t AvlTree_image_size(const AvlTree *self, size_t node_size) {
+    assert(self);
+    assert(node_size >= sizeof(AvlNode));
+
+    return IMAGE_HEADER_SIZE + (self->len + 1) * node_size;
+}
+
+/**
+ *  Writes a relocatable image of copies of the nodes of an AvlTree.
+ *
+ *  The image holds the same Eytzinger-ordered slots as a snapshot by
+ *  AvlTree_freeze_copies, which link to each other by position rather
+ *  than by pointer, so it can be saved to a file and later mapped at
+ *  any address and queried through AvlFrozenTree_from_image without
+ *  being parsed. Nodes are copied during one in-order pass of a
+ *  cursor, straight into their slots, so nothing is allocated. The
+ *  AvlNode member of each copy is zeroed; the rest must not hold
+ *  pointers if the image is to outlive the process.
+ *
+ *  @param self Must not be NULL. Must be initialized. As for
+ *              AvlTree_freeze_copies, its nodes must be at the start
+ *              of their containers.
+ *  @param node_size As for AvlTree_freeze_copies.
+ *  @param image Must not be NULL. Must point to
+ *               AvlTree_image_size(self, node_size) writable bytes,
+ *               aligned for the type that contains each node.
+ */
+void AvlTree_write_image(const AvlTree *self, size_t node_size, void *image) {
+    ImageHeader header;
+    AvlFrozenTree layout;
+    char *const slots = (char*) image + IMAGE_HEADER_SIZE;
+    AvlCursor cursor;
+    size_t index;
+
+    assert(self);
+    assert(self->node_offset == 0);
+    assert(node_size >= sizeof(AvlNode));
+    assert(image);
+    assert(sizeof(ImageHeader) <= IMAGE_HEADER_SIZE);
+
+    memset(image, 0, IMAGE_HEADER_SIZE + node_size);
+    memcpy(header.magic, IMAGE_MAGIC, sizeof(header.magic));
+    header.byte_order = IMAGE_BYTE_ORDER;
+    header.stride = node_size;
+    header.len = self->len;
+    memcpy(image, &header, sizeof(header));
+
+    init_image_view(&layout, image, node_size, self->len);
+    AvlCursor_first(&cursor, self);
+    fill_eytzinger(&layout, slots, 1, &cursor);
+    assert(!AvlCursor_get(&cursor));
+
+    for (index = 1; index <= self->len; ++index) {
+        memset(slots + index * node_size, 0, sizeof(AvlNode));
+    }
+}
+
+/**
+ *  Views an image written by AvlTree_write_image as a snapshot.
+ *
+ *  Runs in O(1) time and neither copies nor allocates: lookups read
+ *  the image in place and return pointers into it, so a mapped file
+ *  is only paged in as lookups touch it, and processes that map the
+ *  same file share its pages.
+ *
+ *  @param self Must not be NULL. Must not be initialized. Will be
+ *              initialized as a snapshot of copies that must be
+ *              dropped before the image is unmapped or freed, and
+ *              that AvlFrozenTree_refreeze moves into new memory.
+ *  @param image Must not be NULL. Is only read, so it may be a
+ *               read-only mapping. Must be aligned for the type that
+ *               contains each node.
+ *  @param size The number of bytes readable at image.
+ *  @returns Nonzero if image holds a valid image written on a machine
+ *           with the same byte order and word size, in which case self
+ *           is initialized; otherwise self is left uninitialized.
+ */
+int AvlFrozenTree_from_image(AvlFrozenTree *self, const void *image, size_t size) {
+    ImageHeader header;
+
+    assert(self);
+    assert(image);
+
+    if (size < IMAGE_HEADER_SIZE) {
+        return 0;
+    }
+
+    memcpy(&header, image, sizeof(header));
+
+    if (memcmp(header.magic, IMAGE_MAGIC, sizeof(header.magic)) != 0
+        || header.byte_order != IMAGE_BYTE_ORDER || header.stride < sizeof(AvlNode)
+        || header.len >= (size - IMAGE_HEADER_SIZE) / header.stride) {
+        return 0;
+    }
+
+    init_image_view(self, image, header.stride, header.len);
+
+    return 1;
+}
+
+static void freeze(const AvlTree *self, AvlFrozenTree *frozen, size_t stride, int is_copy) {
+    assert(self);
+    assert(frozen);
+
+    frozen->slots = NULL;
+    frozen->buffer = NULL;
+    frozen->stride = stride;
+    frozen->len = 0;
+    frozen->capacity = 0;
+    frozen->is_copy = is_copy;
+    frozen->is_image = 0;
+    frozen->allocator = self->allocator ? self->allocator : AvlAllocator_get_default();
+
+    AvlFrozenTree_refreeze(frozen, self);
+}
+
+static void init_image_view(AvlFrozenTree *self, const void *image, size_t stride, size_t len) {
+    assert(self);
+    assert(image);
+
+    self->slots = (const char*) image + IMAGE_HEADER_SIZE;
+    self->buffer = NULL;
+    self->stride = stride;
+    self->len = len;
+    self->capacity = 0;
+    self->is_copy = 1;
+    self->is_image = 1;
+    self->allocator = AvlAllocator_get_default();
+}
+
+/* assigns the cursor's nodes to the subtree at index of the writable
+ * slots laid out like self, in order */
+static void fill_eytzinger(const AvlFrozenTree *self, char *slots, size_t index,
+                           AvlCursor *cursor) {
+    const AvlNode *node;
+
+    if (index > self->len) {
+        return;
+    }
+
+    fill_eytzinger(self, slots, 2 * index, cursor);
+
+    node = AvlCursor_get(cursor);
+    assert(node);
+
+    if (self->is_copy) {
+        memcpy(slots + index * self->stride, node, self->stride);
+    } else {
+        ((const AvlNode**) (void*) slots)[index] = node;
+    }
+
+    AvlCursor_next(cursor);
+
+    fill_eytzinger(self, slots, 2 * index + 1, cursor);
+}
+
+static const AvlNode* slot_node(const AvlFrozenTree *self, size_t index) {
+    assert(index >= 1 && index <= self->len);
+
+    if (self->is_copy) {
+        return (const AvlNode*) (self->slots + index * self->stride);
+    }
+
+    return ((const AvlNode *const*) self->slots)[index];
+}
+
+/**
+ *  Descends the whole implicit tree without branching on the result
+ *  of compare, then backs out of the right turns taken since the last
+ *  left turn, which was at the lower bound.
+ *
+ *  @returns The index of the lower bound of key, or 0 if every node
+ *           compares less than key.
+ */
+static size_t lower_bound_index(const AvlFrozenTree *self, const void *key,
+                                AvlHetComparator compare, void *arg) {
+    size_t index = 1;
+
+    while (index <= self->len) {
+        const size_t ahead = PREFETCH_AHEAD * index;
+
+        PREFETCH(self->slots + ((ahead < self->len) ? ahead : self->len) * self->stride);
+        index = 2 * index + (size_t) (compare(key, slot_node(self, index), arg) > 0);
+    }
+
+    while (index & 1) {
+        index >>= 1;
+    }
+
+    return index >> 1;
+}
@@ -0,0 +1,484 @@
+/*  MIT License
+ *
+ *  Copyright (c) 2019 Gregory Meyer
+ *
+ *  Permission is hereby granted, free of charge, to any person
+ *  obtaining a copy of this software and associated documentation
+ *  files (the "Software"), to deal in the Software without
+ *  restriction, including without limitation the rights to use, copy,
+ *  modify, merge, publish, distribute, sublicense, and/or sell copies
+ *  of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including
+ *  the next paragraph) shall be included in all copies or substantial
+ *  portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ *  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ *  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ *  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ *  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ */
+
+#include <bloodhound.h>
+
+#include <assert.h>
+#include <stddef.h>
+
+/* bits 30 and 31 of AvlIndexNode.left hold the balance factor plus one */
+#define BALANCE_SHIFT 30
+#define INDEX_MASK AVL_INDEX_NIL
+
+static AvlIndexNode* node_at(const AvlIndexTree *self, AvlIndex index);
+
+static void set_left(AvlIndexNode *node, AvlIndex child);
+
+static void set_right(AvlIndexNode *node, AvlIndex child);
+
+static void set_balance_factor(AvlIndexNode *node, int balance_factor);
+
+static void set_child(AvlIndexTree *self, const AvlIndex *path,
+                      const unsigned char *is_right, size_t depth, AvlIndex child);
+
+static AvlIndex rebalance(AvlIndexTree *self, AvlIndex root, int balance_factor);
+
+/**
+ *  Initializes an empty AvlIndexTree over an array of nodes.
+ *
+ *  @param self Must not be NULL. Must not be initialized.
+ *  @param nodes Must not be NULL. Must point to an array of elements
+ *               that each begin with an AvlIndexNode. Must outlive
+ *               self. Since links are indices, the array may be moved
+ *               as long as self->nodes is updated to its new address.
+ *  @param stride The size in bytes of each element of nodes. Must be
+ *                at least sizeof(AvlIndexNode).
+ *  @param compare Must not be NULL. Will be invoked to compare nodes
+ *                 by compare(lhs, rhs, compare_arg). Return values
+ *                 should have the same meaning as strcmp and should
+ *                 form a total ordering over the set of nodes.
+ */
+void AvlIndexTree_new(AvlIndexTree *self, void *nodes, size_t stride,
+                      AvlIndexComparator compare, void *compare_arg) {
+    assert(self);
+    assert(nodes);
+    assert(stride >= sizeof(AvlIndexNode));
+    assert(compare);
+
+    self->nodes = (char*) nodes;
+    self->stride = stride;
+    self->root = AVL_INDEX_NIL;
+    self->len = 0;
+    self->compare = compare;
+    self->compare_arg = compare_arg;
+}
+
+/**
+ *  Finds the node of an AvlIndexTree that compares equal to a key.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlIndexTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @returns The index of the matching node, or AVL_INDEX_NIL if there
+ *           is none.
+ */
+AvlIndex AvlIndexTree_get(const AvlIndexTree *self, const void *key,
+                          AvlIndexHetComparator compare, void *arg) {
+    AvlIndex current;
+
+    assert(self);
+    assert(compare);
+
+    current = self->root;
+
+    while (current != AVL_INDEX_NIL) {
+        const AvlIndexNode *const current_node = node_at(self, current);
+        const int ordering = compare(key, current_node, arg);
+
+        if (ordering == 0) {
+            break;
+        } else if (ordering < 0) {
+            current = AvlIndexNode_left(current_node);
+        } else {
+            current = AvlIndexNode_right(current_node);
+        }
+    }
+
+    return current;
+}
+
+/**
+ *  Inserts a node into an AvlIndexTree or replaces the node that
+ *  compares equal to it.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param index Must be less than AVL_INDEX_NIL. The node at index in
+ *               the array passed to AvlIndexTree_new must not already
+ *               be in the tree. Its links will be overwritten.
+ *  @returns The index of the replaced node, or AVL_INDEX_NIL if no
+ *           node compared equal to the inserted one.
+ */
+AvlIndex AvlIndexTree_insert(AvlIndexTree *self, AvlIndex index) {
+    AvlIndex path[AVL_MAX_HEIGHT];
+    unsigned char is_right[AVL_MAX_HEIGHT];
+    size_t depth = 0;
+    AvlIndexNode *node;
+    AvlIndex current;
+
+    assert(self);
+    assert(index < AVL_INDEX_NIL);
+
+    node = node_at(self, index);
+    current = self->root;
+
+    while (current != AVL_INDEX_NIL) {
+        const AvlIndexNode *const current_node = node_at(self, current);
+        const int ordering = self->compare(node, current_node, self->compare_arg);
+
+        if (ordering == 0) { /* node takes over the links and balance of current */
+            node->left = current_node->left;
+            node->right = current_node->right;
+            set_child(self, path, is_right, depth, index);
+
+            return current;
+        }
+
+        assert(depth < AVL_MAX_HEIGHT);
+        path[depth] = current;
+        is_right[depth] = (unsigned char) (ordering > 0);
+        ++depth;
+
+        if (ordering < 0) {
+            current = AvlIndexNode_left(current_node);
+        } else {
+            current = AvlIndexNode_right(current_node);
+        }
+    }
+
+    node->left = AVL_INDEX_NIL;
+    node->right = AVL_INDEX_NIL;
+    set_balance_factor(node, 0);
+    set_child(self, path, is_right, depth, index);
+    ++self->len;
+
+    /* walk back up until a subtree's height stops changing */
+    while (depth > 0) {
+        AvlIndexNode *parent;
+        int balance_factor;
+
+        --depth;
+        parent = node_at(self, path[depth]);
+        balance_factor = AvlIndexNode_balance_factor(parent) + (is_right[depth] ? 1 : -1);
+
+        if (balance_factor == 2 || balance_factor == -2) {
+            set_child(self, path, is_right, depth, rebalance(self, path[depth], balance_factor));
+
+            break;
+        }
+
+        set_balance_factor(parent, balance_factor);
+
+        if (balance_factor == 0) {
+            break;
+        }
+    }
+
+    return AVL_INDEX_NIL;
+}
+
+/**
+ *  Removes the node of an AvlIndexTree that compares equal to a key.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlIndexTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @returns The index of the removed node, or AVL_INDEX_NIL if no node
+ *           compared equal to key.
+ */
+AvlIndex AvlIndexTree_remove(AvlIndexTree *self, const void *key,
+                             AvlIndexHetComparator compare, void *arg) {
+    AvlIndex path[AVL_MAX_HEIGHT];
+    unsigned char is_right[AVL_MAX_HEIGHT];
+    size_t depth = 0;
+    AvlIndexNode *target_node;
+    AvlIndex target;
+
+    assert(self);
+    assert(compare);
+
+    target = self->root;
+
+    while (target != AVL_INDEX_NIL) {
+        const AvlIndexNode *const node = node_at(self, target);
+        const int ordering = compare(key, node, arg);
+
+        if (ordering == 0) {
+            break;
+        }
+
+        assert(depth < AVL_MAX_HEIGHT);
+        path[depth] = target;
+        is_right[depth] = (unsigned char) (ordering > 0);
+        ++depth;
+
+        if (ordering < 0) {
+            target = AvlIndexNode_left(node);
+        } else {
+            target = AvlIndexNode_right(node);
+        }
+    }
+
+    if (target == AVL_INDEX_NIL) {
+        return AVL_INDEX_NIL;
+    }
+
+    target_node = node_at(self, target);
+
+    if (AvlIndexNode_left(target_node) == AVL_INDEX_NIL) {
+        set_child(self, path, is_right, depth, AvlIndexNode_right(target_node));
+    } else if (AvlIndexNode_right(target_node) == AVL_INDEX_NIL) {
+        set_child(self, path, is_right, depth, AvlIndexNode_left(target_node));
+    } else { /* the in-order successor moves into target's position */
+        const size_t target_depth = depth;
+        AvlIndexNode *successor_node;
+        AvlIndex successor;
+
+        path[depth] = target;
+        is_right[depth] = 1;
+        ++depth;
+        successor = AvlIndexNode_right(target_node);
+
+        while (AvlIndexNode_left(node_at(self, successor)) != AVL_INDEX_NIL) {
+            assert(depth < AVL_MAX_HEIGHT);
+            path[depth] = successor;
+            is_right[depth] = 0;
+            ++depth;
+            successor = AvlIndexNode_left(node_at(self, successor));
+        }
+
+        successor_node = node_at(self, successor);
+        set_child(self, path, is_right, depth, AvlIndexNode_right(successor_node));
+
+        successor_node->left = target_node->left;
+        successor_node->right = target_node->right;
+        set_child(self, path, is_right, target_depth, successor);
+        path[target_depth] = successor;
+    }
+
+    --self->len;
+
+    /* walk back up until a subtree's height stops changing */
+    while (depth > 0) {
+        AvlIndexNode *parent;
+        int balance_factor;
+
+        --depth;
+        parent = node_at(self, path[depth]);
+        balance_factor = AvlIndexNode_balance_factor(parent) + (is_right[depth] ? -1 : 1);
+
+        if (balance_factor == 2 || balance_factor == -2) {
+            const AvlIndex new_root = rebalance(self, path[depth], balance_factor);
+
+            set_child(self, path, is_right, depth, new_root);
+
+            if (AvlIndexNode_balance_factor(node_at(self, new_root)) != 0) {
+                break;
+            }
+        } else {
+            set_balance_factor(parent, balance_factor);
+
+            if (balance_factor != 0) {
+                break;
+            }
+        }
+    }
+
+    return target;
+}
+
+/**
+ *  Removes every node from an AvlIndexTree in O(1) time.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ */
+void AvlIndexTree_clear(AvlIndexTree *self) {
+    assert(self);
+
+    self->root = AVL_INDEX_NIL;
+    self->len = 0;
+}
+
+/**
+ *  @param self Must not be NULL. Must be in an AvlIndexTree.
+ *  @returns The index of the left child of self, or AVL_INDEX_NIL.
+ */
+AvlIndex AvlIndexNode_left(const AvlIndexNode *self) {
+    assert(self);
+
+    return self->left & INDEX_MASK;
+}
+
+/**
+ *  @param self Must not be NULL. Must be in an AvlIndexTree.
+ *  @returns The index of the right child of self, or AVL_INDEX_NIL.
+ */
+AvlIndex AvlIndexNode_right(const AvlIndexNode *self) {
+    assert(self);
+
+    return self->right & INDEX_MASK;
+}
+
+/**
+ *  @param self Must not be NULL. Must be in an AvlIndexTree.
+ *  @returns The height of the right subtree of self minus the height
+ *           of its left subtree, which is one of {-1, 0, 1}.
+ */
+int AvlIndexNode_balance_factor(const AvlIndexNode *self) {
+    assert(self);
+
+    return (int) ((self->left >> BALANCE_SHIFT) & 3) - 1;
+}
+
+static AvlIndexNode* node_at(const AvlIndexTree *self, AvlIndex index) {
+    assert(self);
+    assert(index < AVL_INDEX_NIL);
+
+    return (AvlIndexNode*) (self->nodes + (size_t) index * self->stride);
+}
+
+static void set_left(AvlIndexNode *node, AvlIndex child) {
+    assert(node);
+    assert(child <= AVL_INDEX_NIL);
+
+    node->left = (node->left & ~INDEX_MASK) | child;
+}
+
+static void set_right(AvlIndexNode *node, AvlIndex child) {
+    assert(node);
+    assert(child <= AVL_INDEX_NIL);
+
+    node->right = child;
+}
+
+static void set_balance_factor(AvlIndexNode *node, int balance_factor) {
+    assert(node);
+    assert(balance_factor >= -1 && balance_factor <= 1);
+
+    node->left = (node->left & INDEX_MASK)
+                 | ((AvlIndex) (balance_factor + 1) << BALANCE_SHIFT);
+}
+
+/* points the link to path[depth] at child; depth 0 is the root */
+static void set_child(AvlIndexTree *self, const AvlIndex *path,
+                      const unsigned char *is_right, size_t depth, AvlIndex child) {
+    AvlIndexNode *parent;
+
+    assert(self);
+
+    if (depth == 0) {
+        self->root = child;
+
+        return;
+    }
+
+    parent = node_at(self, path[depth - 1]);
+
+    if (is_right[depth - 1]) {
+        set_right(parent, child);
+    } else {
+        set_left(parent, child);
+    }
+}
+
+/**
+ *  Restores the AVL condition at a node whose subtrees differ in
+ *  height by two.
+ *
+ *  Uses the same single and double rotations as the pointer-based
+ *  tree. The balance factor of root is passed in because +/-2 can't be
+ *  stored in two bits.
+ *
+ *  @returns The new root of the subtree.
+ */
+static AvlIndex rebalance(AvlIndexTree *self, AvlIndex root, int balance_factor) {
+    AvlIndexNode *const root_node = node_at(self, root);
+
+    assert(balance_factor == 2 || balance_factor == -2);
+
+    if (balance_factor == 2) {
+        const AvlIndex child = AvlIndexNode_right(root_node);
+        AvlIndexNode *const child_node = node_at(self, child);
+        const int child_balance_factor = AvlIndexNode_balance_factor(child_node);
+
+        if (child_balance_factor >= 0) { /* rotate left */
+            set_right(root_node, AvlIndexNode_left(child_node));
+            set_left(child_node, root);
+
+            if (child_balance_factor == 0) { /* only after a removal */
+                set_balance_factor(root_node, 1);
+                set_balance_factor(child_node, -1);
+            } else {
+                set_balance_factor(root_node, 0);
+                set_balance_factor(child_node, 0);
+            }
+
+            return child;
+        } else { /* rotate right at child, then left at root */
+            const AvlIndex grandchild = AvlIndexNode_left(child_node);
+            AvlIndexNode *const grandchild_node = node_at(self, grandchild);
+            const int grandchild_balance_factor = AvlIndexNode_balance_factor(grandchild_node);
+
+            set_right(root_node, AvlIndexNode_left(grandchild_node));
+            set_left(child_node, AvlIndexNode_right(grandchild_node));
+            set_left(grandchild_node, root);
+            set_right(grandchild_node, child);
+
+            set_balance_factor(root_node, (grandchild_balance_factor > 0) ? -1 : 0);
+            set_balance_factor(child_node, (grandchild_balance_factor < 0) ? 1 : 0);
+            set_balance_factor(grandchild_node, 0);
+
+            return grandchild;
+        }
+    } else {
+        const AvlIndex child = AvlIndexNode_left(root_node);
+        AvlIndexNode *const child_node = node_at(self, child);
+        const int child_balance_factor = AvlIndexNode_balance_factor(child_node);
+
+        if (child_balance_factor <= 0) { /* rotate right */
+            set_left(root_node, AvlIndexNode_right(child_node));
+            set_right(child_node, root);
+
+            if (child_balance_factor == 0) { /* only after a removal */
+                set_balance_factor(root_node, -1);
+                set_balance_factor(child_node, 1);
+            } else {
+                set_balance_factor(root_node, 0);
+                set_balance_factor(child_node, 0);
+            }
+
+            return child;
+        } else { /* rotate left at child, then right at root */
+            const AvlIndex grandchild = AvlIndexNode_right(child_node);
+            AvlIndexNode *const grandchild_node = node_at(self, grandchild);
+            const int grandchild_balance_factor = AvlIndexNode_balance_factor(grandchild_node);
+
+            set_left(root_node, AvlIndexNode_right(grandchild_node));
+            set_right(child_node, AvlIndexNode_left(grandchild_node));
+            set_right(grandchild_node, root);
+            set_left(grandchild_node, child);
+
+            set_balance_factor(root_node, (grandchild_balance_factor < 0) ? 1 : 0);
+            set_balance_factor(child_node, (grandchild_balance_factor > 0) ? -1 : 0);
+            set_balance_factor(grandchild_node, 0);
+
+            return grandchild;
+        }
+    }
+}
@@ -0,0 +1,942 @@
+/*  MIT License
+ *
+ *  Copyright (c) 2019 Gregory Meyer
+ *
+ *  Permission is hereby granted, free of charge, to any person
+ *  obtaining a copy of this software and associated documentation
+ *  files (the "Software"), to deal in the Software without
+ *  restriction, including without limitation the rights to use, copy,
+ *  modify, merge, publish, distribute, sublicense, and/or sell copies
+ *  of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including
+ *  the next paragraph) shall be included in all copies or substantial
+ *  portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ *  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ *  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ *  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ *  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ */
+
+#include "join.h"
+
+#include "node.h"
+#include "relaxed.h"
+
+#include <assert.h>
+#include <stddef.h>
+
+#define MAX(X, Y) (((X) < (Y)) ? (Y) : (X))
+#define MIN(X, Y) (((X) < (Y)) ? (X) : (Y))
+
+/* heights of the children of a node, given its own height */
+#define LEFT_HEIGHT(N, H) ((H) - 1 - MAX((N)->balance_factor, 0))
+#define RIGHT_HEIGHT(N, H) ((H) - 1 + MIN((N)->balance_factor, 0))
+
+static void count_split(AvlTree *left, AvlTree *right, size_t total);
+
+static void init_set_op(SetOp *op, const AvlTree *self, const AvlTree *other);
+
+/* forwards to another deleter, counting the nodes passed to it */
+typedef struct CountingDeleter {
+    AvlDeleter deleter;
+    void *deleter_arg;
+    size_t num_deleted;
+} CountingDeleter;
+
+static void count_and_delete(AvlNode *node, void *arg);
+
+/**
+ *  Splits an AvlTree around a key in O(log n) time if it is ranked, or
+ *  O(log n + min(l, r)) time otherwise, where l and r are the number
+ *  of nodes on either side of key.
+ *
+ *  An unranked tree counts the nodes of the smaller half to keep len
+ *  accurate; a ranked one reads the counts from the subtree sizes.
+ *
+ *  @param self Must not be NULL. Must be initialized. Will retain the
+ *              nodes that compare less than key.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @param right Must not be NULL. Must not be initialized. Will be
+ *               initialized with the same comparator and deleter as
+ *               self and will receive the nodes that compare greater
+ *               than key.
+ *  @returns The node that compared equal to key, if there was one. It
+ *           is in neither tree and is not passed to the deleter.
+ */
+AvlNode* AvlTree_split(AvlTree *self, const void *key, AvlHetComparator compare, void *arg,
+                       AvlTree *right) {
+    int left_height;
+    int right_height;
+    AvlNode *found;
+    size_t total;
+
+    assert(self);
+    assert(!IS_STALE(self->root));
+    assert(compare);
+    assert(right);
+    assert(self != right);
+
+    /* an offset tree's comparator and deleter point back to self */
+    if (self->container_compare) {
+        AvlTree_new_with_offset(right, self->node_offset, self->container_compare,
+                                self->container_compare_arg, self->container_deleter,
+                                self->container_deleter_arg);
+    } else {
+        AvlTree_new(right, self->compare, self->compare_arg, self->deleter, self->deleter_arg);
+    }
+
+    right->is_ranked = self->is_ranked;
+    right->allocator = self->allocator;
+    right->lookup_stats = self->lookup_stats;
+
+    found = split_subtree(self->root, subtree_height(self->root), key, compare, arg,
+                          &self->root, &left_height, &right->root, &right_height,
+                          self->is_ranked);
+
+    total = self->len - (found ? 1 : 0);
+
+    if (self->is_ranked) {
+        self->len = rank_size(self->root);
+        right->len = rank_size(right->root);
+        assert(self->len + right->len == total);
+    } else {
+        count_split(self, right, total);
+    }
+
+    return found;
+}
+
+/**
+ *  Appends a pivot and every node of another AvlTree to an AvlTree.
+ *
+ *  Runs in O(log n) time.
+ *
+ *  @param self Must not be NULL. Must be initialized. Every node in
+ *              self must compare less than pivot and every node in
+ *              right.
+ *  @param pivot If not NULL, must compare less than every node in
+ *               right and must not be in self or right.
+ *  @param right Must not be NULL. Must be initialized. Must form the
+ *               same ordering as self. Will be left empty.
+ */
+void AvlTree_join(AvlTree *self, AvlNode *pivot, AvlTree *right) {
+    int left_height;
+    int right_height;
+    int height;
+
+    assert(self);
+    assert(!IS_STALE(self->root));
+    assert(right);
+    assert(!IS_STALE(right->root));
+    assert(self != right);
+    assert(self->is_ranked == right->is_ranked);
+
+    left_height = subtree_height(self->root);
+    right_height = subtree_height(right->root);
+
+    if (pivot) {
+        self->root = join_subtrees(self->root, left_height, pivot, right->root, right_height,
+                                   &height, self->is_ranked);
+        ++self->len;
+    } else {
+        self->root = join2_subtrees(self->root, left_height, right->root, right_height,
+                                    &height, self->is_ranked);
+    }
+
+    self->len += right->len;
+    right->root = NULL;
+    right->len = 0;
+}
+
+/**
+ *  Removes and deletes every node in a range of an AvlTree.
+ *
+ *  Cuts the range out with two splits and a join instead of removing
+ *  its nodes one by one, so restructuring the tree takes O(log n) time
+ *  and O(log n) comparisons however long the range is. Deleting the
+ *  nodes adds O(k) time for a range of k nodes.
+ *
+ *  @param self Must not be NULL. Must be initialized. Nodes in the
+ *              range are passed to its deleter.
+ *  @param first Must not be NULL. Must point to a node of self or past
+ *               the end. The first node to remove.
+ *  @param last Must not be NULL. Must point to a node of self that
+ *              does not compare less than the one first points to, or
+ *              past the end. The first node after the range, which is
+ *              kept. Both cursors are invalidated.
+ *  @returns The number of nodes removed.
+ */
+size_t AvlTree_erase_range(AvlTree *self, const AvlCursor *first, const AvlCursor *last) {
+    AvlNode *begin;
+    AvlNode *end;
+    AvlNode *found;
+    AvlNode *before;
+    AvlNode *rest; /* begin and everything after it */
+    AvlNode *range;
+    AvlNode *after;
+    int before_height;
+    int rest_height;
+    int range_height;
+    int after_height;
+    int height;
+    CountingDeleter deleter;
+
+    assert(self);
+    assert(!IS_STALE(self->root));
+    assert(first);
+    assert(last);
+
+    if (first->len == 0) {
+        return 0;
+    }
+
+    begin = first->path[first->len - 1];
+    end = (last->len > 0) ? last->path[last->len - 1] : NULL;
+
+    if (begin == end) {
+        return 0;
+    }
+
+    found = split_subtree(self->root, subtree_height(self->root), begin,
+                          (AvlHetComparator) self->compare, self->compare_arg, &before,
+                          &before_height, &rest, &rest_height, self->is_ranked);
+    assert(found == begin);
+
+    if (end) {
+        found = split_subtree(rest, rest_height, end, (AvlHetComparator) self->compare,
+                              self->compare_arg, &range, &range_height, &after, &after_height,
+                              self->is_ranked);
+        assert(found == end);
+
+        self->root = join_subtrees(before, before_height, end, after, after_height, &height,
+                                   self->is_ranked);
+    } else {
+        range = rest;
+        self->root = before;
+    }
+
+    (void) found;
+
+    deleter.deleter = self->deleter;
+    deleter.deleter_arg = self->deleter_arg;
+    deleter.num_deleted = 0;
+
+    count_and_delete(begin, &deleter);
+    delete_subtree(range, count_and_delete, &deleter);
+
+    assert(deleter.num_deleted <= self->len);
+    self->len -= deleter.num_deleted;
+
+    return deleter.num_deleted;
+}
+
+/**
+ *  Moves every node of another AvlTree into an AvlTree.
+ *
+ *  Runs in O(m log(n / m + 1)) time, where m is the number of nodes in
+ *  the smaller tree and n is the number of nodes in the larger tree.
+ *
+ *  @param self Must not be NULL. Must be initialized. If a node in self
+ *              compares equal to a node in other, the node in self is
+ *              kept.
+ *  @param other Must not be NULL. Must be initialized. Must form the
+ *               same ordering as self. Will be left empty. Nodes that
+ *               compare equal to a node in self are passed to the
+ *               deleter of other.
+ */
+void AvlTree_union(AvlTree *self, AvlTree *other) {
+    SetOp op;
+    int height;
+
+    assert(self);
+    assert(!IS_STALE(self->root));
+    assert(other);
+    assert(!IS_STALE(other->root));
+    assert(self != other);
+
+    init_set_op(&op, self, other);
+
+    self->root = union_subtrees(&op, self->root, subtree_height(self->root), other->root,
+                                subtree_height(other->root), &height);
+    self->len = self->len + other->len - op.num_matched;
+
+    other->root = NULL;
+    other->len = 0;
+}
+
+/**
+ *  Removes every node of an AvlTree that does not compare equal to a
+ *  node in another AvlTree.
+ *
+ *  Runs in O(m log(n / m + 1)) time, plus the cost of deleting nodes,
+ *  where m is the number of nodes in the smaller tree and n is the
+ *  number of nodes in the larger tree.
+ *
+ *  @param self Must not be NULL. Must be initialized. Nodes that do
+ *              not compare equal to a node in other are passed to the
+ *              deleter of self.
+ *  @param other Must not be NULL. Must be initialized. Must form the
+ *               same ordering as self. Will be left empty; all of its
+ *               nodes are passed to its deleter.
+ */
+void AvlTree_intersection(AvlTree *self, AvlTree *other) {
+    SetOp op;
+    int height;
+
+    assert(self);
+    assert(!IS_STALE(self->root));
+    assert(other);
+    assert(!IS_STALE(other->root));
+    assert(self != other);
+
+    init_set_op(&op, self, other);
+
+    self->root = intersect_subtrees(&op, self->root, subtree_height(self->root), other->root,
+                                    subtree_height(other->root), &height);
+    self->len = op.num_matched;
+
+    other->root = NULL;
+    other->len = 0;
+}
+
+/**
+ *  Removes every node of an AvlTree that compares equal to a node in
+ *  another AvlTree.
+ *
+ *  Runs in O(m log(n / m + 1)) time, plus the cost of deleting nodes,
+ *  where m is the number of nodes in the smaller tree and n is the
+ *  number of nodes in the larger tree.
+ *
+ *  @param self Must not be NULL. Must be initialized. Nodes that
+ *              compare equal to a node in other are passed to the
+ *              deleter of self.
+ *  @param other Must not be NULL. Must be initialized. Must form the
+ *               same ordering as self. Will be left empty; all of its
+ *               nodes are passed to its deleter.
+ */
+void AvlTree_difference(AvlTree *self, AvlTree *other) {
+    SetOp op;
+    int height;
+
+    assert(self);
+    assert(!IS_STALE(self->root));
+    assert(other);
+    assert(!IS_STALE(other->root));
+    assert(self != other);
+
+    init_set_op(&op, self, other);
+
+    self->root = subtract_subtrees(&op, self->root, subtree_height(self->root), other->root,
+                                   subtree_height(other->root), &height);
+    self->len -= op.num_matched;
+
+    other->root = NULL;
+    other->len = 0;
+}
+
+/**
+ *  Computes the height of a tree by following its balance factors.
+ *
+ *  @param root The root of the tree. May be NULL.
+ *  @returns The number of nodes on the longest path from root to a
+ *           leaf, which is 0 for an empty tree.
+ */
+int subtree_height(const AvlNode *root) {
+    int height = 0;
+
+    while (root) {
+        ++height;
+
+        if (root->balance_factor < 0) {
+            root = root->left;
+        } else {
+            root = root->right;
+        }
+    }
+
+    return height;
+}
+
+static AvlNode* join_right(AvlNode *left, int left_height, AvlNode *pivot, AvlNode *right,
+                           int right_height, int *height, int is_ranked);
+
+static AvlNode* join_left(AvlNode *left, int left_height, AvlNode *pivot, AvlNode *right,
+                          int right_height, int *height, int is_ranked);
+
+/**
+ *  Joins two trees around a pivot node.
+ *
+ *  Runs in O(|left_height - right_height| + 1) time.
+ *
+ *  @param left May be NULL. Every node in left must compare less than
+ *              pivot.
+ *  @param left_height Must be the height of left.
+ *  @param pivot Must not be NULL. Must not be in left or right.
+ *  @param right May be NULL. Every node in right must compare greater
+ *               than pivot.
+ *  @param right_height Must be the height of right.
+ *  @param height Must not be NULL. Will be set to the height of the
+ *                joined tree.
+ *  @param is_ranked If nonzero, every node must be an AvlRankNode and
+ *                   the sizes of the result are kept up to date.
+ *  @returns The root of the joined tree.
+ */
+AvlNode* join_subtrees(AvlNode *left, int left_height, AvlNode *pivot, AvlNode *right,
+                       int right_height, int *height, int is_ranked) {
+    assert(pivot);
+    assert(height);
+
+    if (left_height > right_height + 1) {
+        return join_right(left, left_height, pivot, right, right_height, height, is_ranked);
+    } else if (right_height > left_height + 1) {
+        return join_left(left, left_height, pivot, right, right_height, height, is_ranked);
+    }
+
+    pivot->left = left;
+    pivot->right = right;
+    pivot->balance_factor = (signed char) (right_height - left_height);
+    *height = MAX(left_height, right_height) + 1;
+
+    if (is_ranked) {
+        update_rank_size(pivot);
+    }
+
+    return pivot;
+}
+
+/* hang pivot and right off the right spine of left, then retrace */
+static AvlNode* join_right(AvlNode *left, int left_height, AvlNode *pivot, AvlNode *right,
+                           int right_height, int *height, int is_ranked) {
+    AvlNode *spine[AVL_MAX_HEIGHT];
+    size_t spine_len = 0;
+    AvlNode *current = left;
+    int current_height = left_height;
+    int has_grown = 1;
+
+    while (current_height > right_height + 1) {
+        assert(current);
+        assert(spine_len < AVL_MAX_HEIGHT);
+
+        spine[spine_len] = current;
+        ++spine_len;
+
+        current_height = RIGHT_HEIGHT(current, current_height);
+        current = current->right;
+    }
+
+    pivot->left = current;
+    pivot->right = right;
+    pivot->balance_factor = (signed char) (right_height - current_height);
+    current = pivot;
+
+    if (is_ranked) {
+        update_rank_size(pivot);
+    }
+
+    while (spine_len > 0) {
+        AvlNode *parent = spine[--spine_len];
+        int is_rotated = 0;
+
+        parent->right = current;
+
+        if (has_grown) {
+            ++parent->balance_factor;
+
+            if (parent->balance_factor == 0) {
+                has_grown = 0;
+            } else if (parent->balance_factor == 2) {
+                AvlNode *const child = parent->right;
+
+                has_grown = child->balance_factor == 0;
+
+                if (child->balance_factor < 0) {
+                    parent->right = rotate_right_any(child);
+                }
+
+                parent = rotate_left_any(parent);
+                is_rotated = 1;
+            }
+        }
+
+        if (is_ranked && is_rotated) {
+            update_rotated_rank_sizes(parent);
+        } else if (is_ranked) {
+            update_rank_size(parent);
+        }
+
+        current = parent;
+    }
+
+    *height = left_height + has_grown;
+
+    return current;
+}
+
+/* hang left and pivot off the left spine of right, then retrace */
+static AvlNode* join_left(AvlNode *left, int left_height, AvlNode *pivot, AvlNode *right,
+                          int right_height, int *height, int is_ranked) {
+    AvlNode *spine[AVL_MAX_HEIGHT];
+    size_t spine_len = 0;
+    AvlNode *current = right;
+    int current_height = right_height;
+    int has_grown = 1;
+
+    while (current_height > left_height + 1) {
+        assert(current);
+        assert(spine_len < AVL_MAX_HEIGHT);
+
+        spine[spine_len] = current;
+        ++spine_len;
+
+        current_height = LEFT_HEIGHT(current, current_height);
+        current = current->left;
+    }
+
+    pivot->left = left;
+    pivot->right = current;
+    pivot->balance_factor = (signed char) (current_height - left_height);
+    current = pivot;
+
+    if (is_ranked) {
+        update_rank_size(pivot);
+    }
+
+    while (spine_len > 0) {
+        AvlNode *parent = spine[--spine_len];
+        int is_rotated = 0;
+
+        parent->left = current;
+
+        if (has_grown) {
+            --parent->balance_factor;
+
+            if (parent->balance_factor == 0) {
+                has_grown = 0;
+            } else if (parent->balance_factor == -2) {
+                AvlNode *const child = parent->left;
+
+                has_grown = child->balance_factor == 0;
+
+                if (child->balance_factor > 0) {
+                    parent->left = rotate_left_any(child);
+                }
+
+                parent = rotate_right_any(parent);
+                is_rotated = 1;
+            }
+        }
+
+        if (is_ranked && is_rotated) {
+            update_rotated_rank_sizes(parent);
+        } else if (is_ranked) {
+            update_rank_size(parent);
+        }
+
+        current = parent;
+    }
+
+    *height = right_height + has_grown;
+
+    return current;
+}
+
+static AvlNode* split_last(AvlNode *root, int height, AvlNode **rest, int *rest_height,
+                           int is_ranked);
+
+/**
+ *  Joins two trees without a pivot node.
+ *
+ *  Runs in O(log n) time.
+ *
+ *  @param left May be NULL. Every node in left must compare less than
+ *              every node in right.
+ *  @param left_height Must be the height of left.
+ *  @param right May be NULL.
+ *  @param right_height Must be the height of right.
+ *  @param height Must not be NULL. Will be set to the height of the
+ *                joined tree.
+ *  @param is_ranked If nonzero, every node must be an AvlRankNode and
+ *                   the sizes of the result are kept up to date.
+ *  @returns The root of the joined tree.
+ */
+AvlNode* join2_subtrees(AvlNode *left, int left_height, AvlNode *right, int right_height,
+                        int *height, int is_ranked) {
+    AvlNode *rest;
+    int rest_height;
+    AvlNode *last;
+
+    assert(height);
+
+    if (!left) {
+        *height = right_height;
+
+        return right;
+    } else if (!right) {
+        *height = left_height;
+
+        return left;
+    }
+
+    last = split_last(left, left_height, &rest, &rest_height, is_ranked);
+
+    return join_subtrees(rest, rest_height, last, right, right_height, height, is_ranked);
+}
+
+/* detaches the greatest node of a tree */
+static AvlNode* split_last(AvlNode *root, int height, AvlNode **rest, int *rest_height,
+                           int is_ranked) {
+    AvlNode *right_rest;
+    int right_rest_height;
+    AvlNode *last;
+
+    assert(root);
+    assert(rest);
+    assert(rest_height);
+
+    if (!root->right) {
+        *rest = root->left;
+        *rest_height = LEFT_HEIGHT(root, height);
+
+        root->left = NULL;
+        root->balance_factor = 0;
+
+        return root;
+    }
+
+    last = split_last(root->right, RIGHT_HEIGHT(root, height), &right_rest, &right_rest_height,
+                      is_ranked);
+    *rest = join_subtrees(root->left, LEFT_HEIGHT(root, height), root, right_rest,
+                          right_rest_height, rest_height, is_ranked);
+
+    return last;
+}
+
+/**
+ *  Splits a tree into the nodes that compare less than and greater
+ *  than a key.
+ *
+ *  Runs in O(log n) time.
+ *
+ *  @param root May be NULL.
+ *  @param height Must be the height of root.
+ *  @param compare Must not be NULL. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @param left Must not be NULL. Will be set to the root of the tree
+ *              of nodes that compare less than key.
+ *  @param left_height Must not be NULL. Will be set to the height of
+ *                     *left.
+ *  @param right Must not be NULL. Will be set to the root of the tree
+ *               of nodes that compare greater than key.
+ *  @param right_height Must not be NULL. Will be set to the height of
+ *                      *right.
+ *  @param is_ranked If nonzero, every node must be an AvlRankNode and
+ *                   the sizes of the result are kept up to date.
+ *  @returns The node that compared equal to key, if there was one. It
+ *           is detached from both trees.
+ */
+AvlNode* split_subtree(AvlNode *root, int height, const void *key, AvlHetComparator compare,
+                       void *arg, AvlNode **left, int *left_height, AvlNode **right,
+                       int *right_height, int is_ranked) {
+    AvlNode *root_left;
+    AvlNode *root_right;
+    int root_left_height;
+    int root_right_height;
+    int ordering;
+
+    assert(compare);
+    assert(left);
+    assert(left_height);
+    assert(right);
+    assert(right_height);
+
+    if (!root) {
+        *left = NULL;
+        *left_height = 0;
+        *right = NULL;
+        *right_height = 0;
+
+        return NULL;
+    }
+
+    root_left = root->left;
+    root_right = root->right;
+    root_left_height = LEFT_HEIGHT(root, height);
+    root_right_height = RIGHT_HEIGHT(root, height);
+    ordering = compare(key, root, arg);
+
+    if (ordering == 0) {
+        *left = root_left;
+        *left_height = root_left_height;
+        *right = root_right;
+        *right_height = root_right_height;
+
+        root->left = NULL;
+        root->right = NULL;
+        root->balance_factor = 0;
+
+        return root;
+    } else if (ordering < 0) {
+        AvlNode *middle;
+        int middle_height;
+        AvlNode *const found = split_subtree(root_left, root_left_height, key, compare, arg,
+                                             left, left_height, &middle, &middle_height, is_ranked);
+
+        *right = join_subtrees(middle, middle_height, root, root_right, root_right_height,
+                               right_height, is_ranked);
+
+        return found;
+    } else {
+        AvlNode *middle;
+        int middle_height;
+        AvlNode *const found = split_subtree(root_right, root_right_height, key, compare, arg,
+                                             &middle, &middle_height, right, right_height,
+                                             is_ranked);
+
+        *left = join_subtrees(root_left, root_left_height, root, middle, middle_height,
+                              left_height, is_ranked);
+
+        return found;
+    }
+}
+
+/* walk both halves in lockstep so only the smaller one is counted fully */
+static void count_split(AvlTree *left, AvlTree *right, size_t total) {
+    AvlCursor left_cursor;
+    AvlCursor right_cursor;
+    size_t count = 0;
+
+    assert(left);
+    assert(right);
+
+    AvlCursor_first(&left_cursor, left);
+    AvlCursor_first(&right_cursor, right);
+
+    while (1) {
+        if (!AvlCursor_get(&left_cursor)) {
+            left->len = count;
+            right->len = total - count;
+
+            return;
+        } else if (!AvlCursor_get(&right_cursor)) {
+            right->len = count;
+            left->len = total - count;
+
+            return;
+        }
+
+        AvlCursor_next(&left_cursor);
+        AvlCursor_next(&right_cursor);
+        ++count;
+    }
+}
+
+/**
+ *  Moves every node of other into self.
+ *
+ *  @param op Must not be NULL. Nodes of other that compare equal to a
+ *            node of self are passed to op->other_deleter and counted
+ *            in op->num_matched.
+ *  @param height Must not be NULL. Will be set to the height of the
+ *                result.
+ *  @returns The root of the union.
+ */
+AvlNode* union_subtrees(SetOp *op, AvlNode *self, int self_height, AvlNode *other,
+                        int other_height, int *height) {
+    AvlNode *other_left;
+    AvlNode *other_right;
+    AvlNode *self_left;
+    AvlNode *self_right;
+    int self_left_height;
+    int self_right_height;
+    AvlNode *found;
+    AvlNode *pivot;
+    AvlNode *left;
+    AvlNode *right;
+    int left_height;
+    int right_height;
+
+    assert(op);
+    assert(height);
+
+    if (!self) {
+        *height = other_height;
+
+        return other;
+    } else if (!other) {
+        *height = self_height;
+
+        return self;
+    }
+
+    other_left = other->left;
+    other_right = other->right;
+
+    found = split_subtree(self, self_height, other, op->compare, op->compare_arg, &self_left,
+                          &self_left_height, &self_right, &self_right_height, op->is_ranked);
+
+    left = union_subtrees(op, self_left, self_left_height, other_left,
+                          LEFT_HEIGHT(other, other_height), &left_height);
+    right = union_subtrees(op, self_right, self_right_height, other_right,
+                           RIGHT_HEIGHT(other, other_height), &right_height);
+
+    if (found) {
+        ++op->num_matched;
+        pivot = found;
+
+        op->other_deleter(other, op->other_deleter_arg);
+    } else {
+        pivot = other;
+    }
+
+    return join_subtrees(left, left_height, pivot, right, right_height, height, op->is_ranked);
+}
+
+/**
+ *  Keeps the nodes of self that compare equal to a node of other.
+ *
+ *  @param op Must not be NULL. Discarded nodes of self are passed to
+ *            op->self_deleter, every node of other is passed to
+ *            op->other_deleter and kept nodes are counted in
+ *            op->num_matched.
+ *  @param height Must not be NULL. Will be set to the height of the
+ *                result.
+ *  @returns The root of the intersection.
+ */
+AvlNode* intersect_subtrees(SetOp *op, AvlNode *self, int self_height, AvlNode *other,
+                            int other_height, int *height) {
+    AvlNode *other_left;
+    AvlNode *other_right;
+    AvlNode *self_left;
+    AvlNode *self_right;
+    int self_left_height;
+    int self_right_height;
+    AvlNode *found;
+    AvlNode *left;
+    AvlNode *right;
+    int left_height;
+    int right_height;
+
+    assert(op);
+    assert(height);
+
+    if (!self || !other) {
+        delete_subtree(self, op->self_deleter, op->self_deleter_arg);
+        delete_subtree(other, op->other_deleter, op->other_deleter_arg);
+        *height = 0;
+
+        return NULL;
+    }
+
+    other_left = other->left;
+    other_right = other->right;
+
+    found = split_subtree(self, self_height, other, op->compare, op->compare_arg, &self_left,
+                          &self_left_height, &self_right, &self_right_height, op->is_ranked);
+
+    left = intersect_subtrees(op, self_left, self_left_height, other_left,
+                              LEFT_HEIGHT(other, other_height), &left_height);
+    right = intersect_subtrees(op, self_right, self_right_height, other_right,
+                               RIGHT_HEIGHT(other, other_height), &right_height);
+
+    op->other_deleter(other, op->other_deleter_arg);
+
+    if (found) {
+        ++op->num_matched;
+
+        return join_subtrees(left, left_height, found, right, right_height, height, op->is_ranked);
+    } else {
+        return join2_subtrees(left, left_height, right, right_height, height, op->is_ranked);
+    }
+}
+
+/**
+ *  Keeps the nodes of self that do not compare equal to a node of
+ *  other.
+ *
+ *  @param op Must not be NULL. Discarded nodes of self are passed to
+ *            op->self_deleter and counted in op->num_matched, every
+ *            node of other is passed to op->other_deleter.
+ *  @param height Must not be NULL. Will be set to the height of the
+ *                result.
+ *  @returns The root of the difference.
+ */
+AvlNode* subtract_subtrees(SetOp *op, AvlNode *self, int self_height, AvlNode *other,
+                           int other_height, int *height) {
+    AvlNode *other_left;
+    AvlNode *other_right;
+    AvlNode *self_left;
+    AvlNode *self_right;
+    int self_left_height;
+    int self_right_height;
+    AvlNode *found;
+    AvlNode *left;
+    AvlNode *right;
+    int left_height;
+    int right_height;
+
+    assert(op);
+    assert(height);
+
+    if (!self || !other) {
+        delete_subtree(other, op->other_deleter, op->other_deleter_arg);
+        *height = self_height;
+
+        return self;
+    }
+
+    other_left = other->left;
+    other_right = other->right;
+
+    found = split_subtree(self, self_height, other, op->compare, op->compare_arg, &self_left,
+                          &self_left_height, &self_right, &self_right_height, op->is_ranked);
+
+    left = subtract_subtrees(op, self_left, self_left_height, other_left,
+                             LEFT_HEIGHT(other, other_height), &left_height);
+    right = subtract_subtrees(op, self_right, self_right_height, other_right,
+                              RIGHT_HEIGHT(other, other_height), &right_height);
+
+    op->other_deleter(other, op->other_deleter_arg);
+
+    if (found) {
+        ++op->num_matched;
+        op->self_deleter(found, op->self_deleter_arg);
+    }
+
+    return join2_subtrees(left, left_height, right, right_height, height, op->is_ranked);
+}
+
+static void count_and_delete(AvlNode *node, void *arg) {
+    CountingDeleter *const deleter = (CountingDeleter*) arg;
+
+    assert(deleter);
+
+    ++deleter->num_deleted;
+    deleter->deleter(node, deleter->deleter_arg);
+}
+
+static void init_set_op(SetOp *op, const AvlTree *self, const AvlTree *other) {
+    assert(op);
+    assert(self);
+    assert(other);
+
+    op->compare = (AvlHetComparator) self->compare;
+    op->compare_arg = self->compare_arg;
+    op->self_deleter = self->deleter;
+    op->self_deleter_arg = self->deleter_arg;
+    op->other_deleter = other->deleter;
+    op->other_deleter_arg = other->deleter_arg;
+    op->num_matched = 0;
+    op->is_ranked = self->is_ranked;
+
+    assert(self->is_ranked == other->is_ranked);
+}
@@ -0,0 +1,169 @@
+/*  MIT License
+ *
+ *  Copyright (c) 2019 Gregory Meyer
+ *
+ *  Permission is hereby granted, free of charge, to any person
+ *  obtaining a copy of this software and associated documentation
+ *  files (the "Software"), to deal in the Software without
+ *  restriction, including without limitation the rights to use, copy,
+ *  modify, merge, publish, distribute, sublicense, and/or sell copies
+ *  of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including
+ *  the next paragraph) shall be included in all copies or substantial
+ *  portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ *  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ *  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ *  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ *  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ */
+
+#ifndef BLOODHOUND_IMPL_JOIN_H
+#define BLOODHOUND_IMPL_JOIN_H
+
+#include <bloodhound.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ *  Computes the height of a tree by following its balance factors.
+ *
+ *  @param root The root of the tree. May be NULL.
+ *  @returns The number of nodes on the longest path from root to a
+ *           leaf, which is 0 for an empty tree.
+ */
+int subtree_height(const AvlNode *root);
+
+/**
+ *  Joins two trees around a pivot node.
+ *
+ *  Runs in O(|left_height - right_height| + 1) time.
+ *
+ *  @param left May be NULL. Every node in left must compare less than
+ *              pivot.
+ *  @param left_height Must be the height of left.
+ *  @param pivot Must not be NULL. Must not be in left or right.
+ *  @param right May be NULL. Every node in right must compare greater
+ *               than pivot.
+ *  @param right_height Must be the height of right.
+ *  @param height Must not be NULL. Will be set to the height of the
+ *                joined tree.
+ *  @param is_ranked If nonzero, every node must be an AvlRankNode and
+ *                   the sizes of the result are kept up to date.
+ *  @returns The root of the joined tree.
+ */
+AvlNode* join_subtrees(AvlNode *left, int left_height, AvlNode *pivot, AvlNode *right,
+                       int right_height, int *height, int is_ranked);
+
+/**
+ *  Joins two trees without a pivot node.
+ *
+ *  Runs in O(log n) time.
+ *
+ *  @param left May be NULL. Every node in left must compare less than
+ *              every node in right.
+ *  @param left_height Must be the height of left.
+ *  @param right May be NULL.
+ *  @param right_height Must be the height of right.
+ *  @param height Must not be NULL. Will be set to the height of the
+ *                joined tree.
+ *  @param is_ranked If nonzero, every node must be an AvlRankNode and
+ *                   the sizes of the result are kept up to date.
+ *  @returns The root of the joined tree.
+ */
+AvlNode* join2_subtrees(AvlNode *left, int left_height, AvlNode *right, int right_height,
+                        int *height, int is_ranked);
+
+/**
+ *  Splits a tree into the nodes that compare less than and greater
+ *  than a key.
+ *
+ *  Runs in O(log n) time.
+ *
+ *  @param root May be NULL.
+ *  @param height Must be the height of root.
+ *  @param compare Must not be NULL. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @param left Must not be NULL. Will be set to the root of the tree
+ *              of nodes that compare less than key.
+ *  @param left_height Must not be NULL. Will be set to the height of
+ *                     *left.
+ *  @param right Must not be NULL. Will be set to the root of the tree
+ *               of nodes that compare greater than key.
+ *  @param right_height Must not be NULL. Will be set to the height of
+ *                      *right.
+ *  @param is_ranked If nonzero, every node must be an AvlRankNode and
+ *                   the sizes of the result are kept up to date.
+ *  @returns The node that compared equal to key, if there was one. It
+ *           is detached from both trees.
+ */
+AvlNode* split_subtree(AvlNode *root, int height, const void *key, AvlHetComparator compare,
+                       void *arg, AvlNode **left, int *left_height, AvlNode **right,
+                       int *right_height, int is_ranked);
+
+/** Shared state for the recursive set operations. */
+typedef struct SetOp {
+    AvlHetComparator compare;
+    void *compare_arg;
+    AvlDeleter self_deleter;
+    void *self_deleter_arg;
+    AvlDeleter other_deleter;
+    void *other_deleter_arg;
+    size_t num_matched;
+    int is_ranked;
+} SetOp;
+
+/**
+ *  Moves every node of other into self.
+ *
+ *  @param op Must not be NULL. Nodes of other that compare equal to a
+ *            node of self are passed to op->other_deleter and counted
+ *            in op->num_matched.
+ *  @param height Must not be NULL. Will be set to the height of the
+ *                result.
+ *  @returns The root of the union.
+ */
+AvlNode* union_subtrees(SetOp *op, AvlNode *self, int self_height, AvlNode *other,
+                        int other_height, int *height);
+
+/**
+ *  Keeps the nodes of self that compare equal to a node of other.
+ *
+ *  @param op Must not be NULL. Discarded nodes of self are passed to
+ *            op->self_deleter, every node of other is passed to
+ *            op->other_deleter and kept nodes are counted in
+ *            op->num_matched.
+ *  @param height Must not be NULL. Will be set to the height of the
+ *                result.
+ *  @returns The root of the intersection.
+ */
+AvlNode* intersect_subtrees(SetOp *op, AvlNode *self, int self_height, AvlNode *other,
+                            int other_height, int *height);
+
+/**
+ *  Keeps the nodes of self that do not compare equal to a node of
+ *  other.
+ *
+ *  @param op Must not be NULL. Discarded nodes of self are passed to
+ *            op->self_deleter and counted in op->num_matched, every
+ *            node of other is passed to op->other_deleter.
+ *  @param height Must not be NULL. Will be set to the height of the
+ *                result.
+ *  @returns The root of the difference.
+ */
+AvlNode* subtract_subtrees(SetOp *op, AvlNode *self, int self_height, AvlNode *other,
+                           int other_height, int *height);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
@@ -30,14 +30,20 @@
 #include "mem.h"
 #include "node.h"
 #include "node_stack.h"
+#include "relaxed.h"
+#include "stats.h"
 
 #include <assert.h>
 #include <limits.h>
-#include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define MAX(X, Y) (((X) < (Y)) ? (Y) : (X))
 
+static int compare_containers(const AvlNode *lhs, const AvlNode *rhs, void *self_v);
+
+static void delete_container(AvlNode *node, void *self_v);
+
 /**
  *  Initializes an empty AvlTree.
  *
@@ -62,6 +68,209 @@ void AvlTree_new(AvlTree *self, AvlComparator compare, void *compare_arg,
     self->compare_arg = compare_arg;
     self->deleter = deleter;
     self->deleter_arg = deleter_arg;
+    self->is_ranked = 0;
+    self->is_relaxed = 0;
+    self->node_offset = 0;
+    self->container_compare = NULL;
+    self->container_compare_arg = NULL;
+    self->container_deleter = NULL;
+    self->container_deleter_arg = NULL;
+    self->allocator = NULL;
+
+    memset(&self->stats, 0, sizeof(self->stats));
+    self->lookup_stats = NULL;
+}
+
+/**
+ *  Initializes an empty AvlTree of AvlRankNodes.
+ *
+ *  @param self Must not be NULL. Must not be initialized.
+ *  @param compare Must not be NULL. Will be invoked to compare nodes
+ *                 by compare(lhs, rhs, compare_arg). Return values
+ *                 should have the same meaning as strcmp and should
+ *                 form a total ordering over the set of nodes.
+ *  @param deleter Must not be NULL. Will be used to free nodes when
+ *                 they are no longer usable by the tree as if by
+ *                 deleter(node, deleter_arg).
+ */
+void AvlTree_new_ranked(AvlTree *self, AvlComparator compare, void *compare_arg,
+                        AvlDeleter deleter, void *deleter_arg) {
+    AvlTree_new(self, compare, compare_arg, deleter, deleter_arg);
+    self->is_ranked = 1;
+}
+
+/**
+ *  Initializes an empty AvlTree of nodes that are members of a larger
+ *  struct at a known offset.
+ *
+ *  compare and deleter are passed the containing structs rather than
+ *  the nodes, so a struct with several AvlNode members can be in one
+ *  tree per member, each with its own order, without a wrapper
+ *  allocation per tree or per-comparator pointer arithmetic. Other
+ *  functions still take and return AvlNode pointers, which
+ *  AVL_CONTAINER_OF and AVL_CONST_CONTAINER_OF turn back into
+ *  containers.
+ *
+ *  self passes itself to compare and deleter, so it must not be copied
+ *  or moved while it is initialized.
+ *
+ *  @param self Must not be NULL. Must not be initialized.
+ *  @param node_offset The offset of the AvlNode member of each
+ *                     container, as given by offsetof.
+ *  @param compare Must not be NULL. Will be invoked to compare
+ *                 containers by compare(lhs, rhs, compare_arg). Return
+ *                 values should have the same meaning as strcmp and
+ *                 should form a total ordering over the set of nodes.
+ *  @param deleter Must not be NULL. Will be used to free containers
+ *                 when their nodes are no longer usable by the tree as
+ *                 if by deleter(container, deleter_arg).
+ */
+void AvlTree_new_with_offset(AvlTree *self, size_t node_offset,
+                             AvlContainerComparator compare, void *compare_arg,
+                             AvlContainerDeleter deleter, void *deleter_arg) {
+    assert(self);
+    assert(compare);
+    assert(deleter);
+
+    AvlTree_new(self, compare_containers, self, delete_container, self);
+    self->node_offset = node_offset;
+    self->container_compare = compare;
+    self->container_compare_arg = compare_arg;
+    self->container_deleter = deleter;
+    self->container_deleter_arg = deleter_arg;
+}
+
+static int compare_containers(const AvlNode *lhs, const AvlNode *rhs, void *self_v) {
+    const AvlTree *const self = (const AvlTree*) self_v;
+
+    assert(self);
+
+    return self->container_compare((const char*) lhs - self->node_offset,
+                                   (const char*) rhs - self->node_offset,
+                                   self->container_compare_arg);
+}
+
+static void delete_container(AvlNode *node, void *self_v) {
+    const AvlTree *const self = (const AvlTree*) self_v;
+
+    assert(self);
+
+    self->container_deleter((char*) node - self->node_offset, self->container_deleter_arg);
+}
+
+#ifdef NDEBUG
+#define assert_correct_balance_factors(N) ((void) 0)
+#else
+#define assert_correct_balance_factors(N) do_assert_balance_factors((N))
+static int do_assert_balance_factors(const AvlNode *node);
+#endif
+
+#ifdef BLOODHOUND_STATS
+#define count_rotation(T, N) do_count_rotation((T), (N))
+static void do_count_rotation(AvlTree *self, const AvlNode *root);
+#else
+#define count_rotation(T, N) ((void) 0)
+#endif
+
+static void fill_from_sorted(AvlTree *self, AvlNode **nodes, size_t num_nodes);
+
+static AvlNode* build_balanced(AvlNode **nodes, size_t num_nodes, int is_ranked, int *height);
+
+/**
+ *  Initializes an AvlTree from an array of nodes in ascending order.
+ *
+ *  Builds a perfectly balanced tree in O(n) time without invoking
+ *  compare.
+ *
+ *  @param self Must not be NULL. Must not be initialized.
+ *  @param nodes Must not be NULL if num_nodes > 0. Must be sorted in
+ *               strictly ascending order according to compare. The
+ *               array itself is not retained.
+ *  @param compare Must not be NULL. Will be invoked to compare nodes
+ *                 by compare(lhs, rhs, compare_arg). Return values
+ *                 should have the same meaning as strcmp and should
+ *                 form a total ordering over the set of nodes.
+ *  @param deleter Must not be NULL. Will be used to free nodes when
+ *                 they are no longer usable by the tree as if by
+ *                 deleter(node, deleter_arg).
+ */
+void AvlTree_from_sorted(AvlTree *self, AvlNode **nodes, size_t num_nodes,
+                         AvlComparator compare, void *compare_arg,
+                         AvlDeleter deleter, void *deleter_arg) {
+    AvlTree_new(self, compare, compare_arg, deleter, deleter_arg);
+    fill_from_sorted(self, nodes, num_nodes);
+}
+
+/**
+ *  Initializes an AvlTree of AvlRankNodes from an array of nodes in
+ *  ascending order.
+ *
+ *  @param self Must not be NULL. Must not be initialized.
+ *  @param nodes Must not be NULL if num_nodes > 0. Must be sorted in
+ *               strictly ascending order according to compare. Each
+ *               element must be the node member of an AvlRankNode.
+ *  @param compare Must not be NULL.
+ *  @param deleter Must not be NULL.
+ */
+void AvlTree_from_sorted_ranked(AvlTree *self, AvlNode **nodes, size_t num_nodes,
+                                AvlComparator compare, void *compare_arg,
+                                AvlDeleter deleter, void *deleter_arg) {
+    AvlTree_new_ranked(self, compare, compare_arg, deleter, deleter_arg);
+    fill_from_sorted(self, nodes, num_nodes);
+}
+
+static void fill_from_sorted(AvlTree *self, AvlNode **nodes, size_t num_nodes) {
+    int height;
+
+    assert(self);
+    assert(!self->root);
+    assert(nodes || num_nodes == 0);
+
+#ifndef NDEBUG
+    {
+        size_t i;
+
+        for (i = 1; i < num_nodes; ++i) {
+            assert(self->compare(nodes[i - 1], nodes[i], self->compare_arg) < 0);
+        }
+    }
+#endif
+
+    self->root = build_balanced(nodes, num_nodes, self->is_ranked, &height);
+    self->len = num_nodes;
+    assert_correct_balance_factors(self->root);
+}
+
+/* the left half gets the extra node, so balance factors are 0 or -1 */
+static AvlNode* build_balanced(AvlNode **nodes, size_t num_nodes, int is_ranked, int *height) {
+    AvlNode *root;
+    size_t middle;
+    int left_height;
+    int right_height;
+
+    assert(height);
+
+    if (num_nodes == 0) {
+        *height = 0;
+
+        return NULL;
+    }
+
+    middle = num_nodes / 2;
+    root = nodes[middle];
+
+    root->left = build_balanced(nodes, middle, is_ranked, &left_height);
+    root->right = build_balanced(nodes + middle + 1, num_nodes - middle - 1, is_ranked,
+                                 &right_height);
+    root->balance_factor = (signed char) (right_height - left_height);
+
+    if (is_ranked) {
+        ((AvlRankNode*) root)->size = num_nodes;
+    }
+
+    *height = MAX(left_height, right_height) + 1;
+
+    return root;
 }
 
 /**
@@ -77,7 +286,8 @@ void AvlTree_drop(AvlTree *self) {
     AvlTree_clear(self);
 }
 
-static AvlNode* find(AvlNode *root, const void *key, AvlHetComparator comparator, void *arg);
+static AvlNode* find(const AvlTree *self, const void *key, AvlHetComparator comparator,
+                     void *arg);
 
 /**
  *  @param self Must not be NULL. Must be initialized.
@@ -93,7 +303,7 @@ const AvlNode* AvlTree_get(const AvlTree *self, const void *key,
     assert(self);
     assert(compare);
 
-    return find(self->root, key, compare, arg);
+    return find(self, key, compare, arg);
 }
 
 /**
@@ -109,32 +319,126 @@ AvlNode* AvlTree_get_mut(AvlTree *self, const void *key, AvlHetComparator compar
     assert(self);
     assert(compare);
 
-    return find(self->root, key, compare, arg);
+    return find(self, key, compare, arg);
 }
 
-static AvlNode* find(AvlNode *root, const void *key, AvlHetComparator comparator, void *arg) {
-    assert(comparator);
+/**
+ *  Looks up a batch of keys, interleaving their searches.
+ *
+ *  Runs up to AVL_GET_MANY_LANES searches in lockstep, prefetching
+ *  the next node of each while the others are compared, so the cache
+ *  misses of one search overlap with work on the rest. Equivalent to
+ *  calling AvlTree_get on each key.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param keys Must not be NULL if num_keys > 0. Each element is
+ *              passed to compare as the key to look up.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @param found Must not be NULL if num_keys > 0. Element i will be
+ *               set to the node that compares equal to keys[i], or
+ *               NULL if there is none.
+ */
+void AvlTree_get_many(const AvlTree *self, const void *const *keys, size_t num_keys,
+                      AvlHetComparator compare, void *arg, const AvlNode **found) {
+    size_t first;
 
-    if (!root) {
-        return NULL;
+    assert(self);
+    assert(num_keys == 0 || keys);
+    assert(compare);
+    assert(num_keys == 0 || found);
+
+    for (first = 0; first < num_keys; first += AVL_GET_MANY_LANES) {
+        const AvlNode *current[AVL_GET_MANY_LANES];
+        const size_t num_lanes = (num_keys - first < AVL_GET_MANY_LANES)
+                                 ? num_keys - first : AVL_GET_MANY_LANES;
+        size_t num_active = num_lanes;
+        size_t num_compared = 0;
+        size_t num_passes = 0; /* the depth of the deepest search */
+        size_t lane;
+
+        for (lane = 0; lane < num_lanes; ++lane) {
+            current[lane] = self->root;
+            found[first + lane] = NULL;
+        }
+
+        if (!self->root) {
+            SHARED_STATS_SEARCHES(LOOKUP_STATS(self), num_lanes, 0, 0);
+
+            continue;
+        }
+
+        /* one step of every unfinished search per pass */
+        while (num_active > 0) {
+            num_active = 0;
+            ++num_passes;
+
+            for (lane = 0; lane < num_lanes; ++lane) {
+                const AvlNode *const node = current[lane];
+                int ordering;
+
+                if (!node) {
+                    continue;
+                }
+
+                ordering = compare(keys[first + lane], node, arg);
+                ++num_compared;
+
+                if (ordering == 0) {
+                    found[first + lane] = node;
+                    current[lane] = NULL;
+
+                    continue;
+                }
+
+                current[lane] = (ordering < 0) ? node->left : node->right;
+
+                if (current[lane]) {
+                    PREFETCH(current[lane]);
+                    ++num_active;
+                }
+            }
+        }
+
+        SHARED_STATS_ADD(LOOKUP_STATS(self), num_comparisons, num_compared);
+        SHARED_STATS_SEARCHES(LOOKUP_STATS(self), num_lanes, num_compared, num_passes);
     }
+}
+
+static AvlNode* find(const AvlTree *self, const void *key, AvlHetComparator comparator,
+                     void *arg) {
+    AvlNode *current = self->root;
+    size_t depth = 0;
+
+    assert(comparator);
+
+    while (current) {
+        const int ordering = comparator(key, current, arg);
 
-    while (root) {
-        const int ordering = comparator(key, root, arg);
+        ++depth;
 
         if (ordering == 0) {
-            return root;
+            break;
         } else if (ordering < 0) {
-            root = root->left;
+            current = current->left;
         } else { /* ordering > 0 */
-            root = root->right;
+            current = current->right;
         }
     }
 
-    return NULL;
+    SHARED_STATS_SEARCH(LOOKUP_STATS(self), depth);
+
+    return current;
 }
 
-static void rebalance(const BitStack *is_left_flags, AvlNode **root_ptr, AvlNode *inserted);
+static void rebalance(AvlTree *self, const BitStack *is_left_flags, AvlNode **root_ptr,
+                      AvlNode *inserted);
+
+static void grow_path_sizes(const NodeStack *path, size_t len);
+
+static void replace_node(AvlNode *previous, AvlNode *node, int is_ranked);
 
 typedef struct NodeOrParentRet {
     AvlNode **node_or_parent;
@@ -142,16 +446,9 @@ typedef struct NodeOrParentRet {
     int is_node;
 } NodeOrParentRet;
 
-static NodeOrParentRet find_node_or_parent(AvlNode **root_ptr, const void *key,
+static NodeOrParentRet find_node_or_parent(AvlTree *self, const void *key,
                                            AvlHetComparator compare, void *arg,
-                                           BitStack *is_left_flags);
-
-#ifdef NDEBUG
-#define assert_correct_balance_factors(N) ((void) 0)
-#else
-#define assert_correct_balance_factors(N) do_assert_balance_factors((N))
-static int do_assert_balance_factors(const AvlNode *node);
-#endif
+                                           BitStack *is_left_flags, NodeStack *path);
 
 /* at least 96 bits - enough to traverse a tree with 2^63 - 1 nodes */
 #define IS_LEFT_FLAGS_BUF_SZ 3
@@ -167,27 +464,29 @@ static int do_assert_balance_factors(const AvlNode *node);
 AvlNode* AvlTree_insert(AvlTree *self, AvlNode *node) {
     unsigned long is_left_flags_buf[IS_LEFT_FLAGS_BUF_SZ];
     BitStack is_left_flags;
+    AvlNode *path_buf[AVL_MAX_HEIGHT];
+    NodeStack path; /* only recorded for ranked trees */
     NodeOrParentRet ret;
     AvlNode *previous;
 
     assert(self);
     assert(node);
 
-    BitStack_from_adopted_slice(&is_left_flags, is_left_flags_buf, IS_LEFT_FLAGS_BUF_SZ);
-    ret = find_node_or_parent(&self->root, node, (AvlHetComparator) self->compare,
-                                         self->compare_arg, &is_left_flags);
+    if (self->is_relaxed && relaxed_insert(self, node, &previous)) {
+        return previous;
+    }
+
+    BitStack_from_adopted_slice(&is_left_flags, self->allocator, is_left_flags_buf,
+                                IS_LEFT_FLAGS_BUF_SZ);
+    NodeStack_from_adopted_slice(&path, self->allocator, path_buf, AVL_MAX_HEIGHT);
+    ret = find_node_or_parent(self, node, (AvlHetComparator) self->compare,
+                              self->compare_arg, &is_left_flags,
+                              self->is_ranked ? &path : NULL);
 
     if (ret.is_node) {
         previous = *ret.node_or_parent;
         *ret.node_or_parent = node;
-
-        node->left = previous->left;
-        node->right = previous->right;
-        node->balance_factor = previous->balance_factor;
-
-        previous->left = NULL;
-        previous->right = NULL;
-        previous->balance_factor = 0;
+        replace_node(previous, node, self->is_ranked);
     } else {
         ++self->len;
 
@@ -197,12 +496,20 @@ AvlNode* AvlTree_insert(AvlTree *self, AvlNode *node) {
         node->right = NULL;
         node->balance_factor = 0;
 
+        if (self->is_ranked) {
+            ((AvlRankNode*) node)->size = 1;
+            grow_path_sizes(&path, NodeStack_len(&path));
+        }
+
         if (ret.last_with_nonzero_balance_factor) {
-            rebalance(&is_left_flags, ret.last_with_nonzero_balance_factor, node);
+            rebalance(self, &is_left_flags, ret.last_with_nonzero_balance_factor, node);
             assert_correct_balance_factors(self->root);
         }
     }
 
+    assert(!path.is_owned);
+    STATS_ADD(WRITE_STATS(self), num_allocations, path.is_owned + is_left_flags.is_owned);
+    NodeStack_drop(&path);
     BitStack_drop(&is_left_flags);
 
     return previous;
@@ -231,15 +538,21 @@ AvlNode* AvlTree_get_or_insert(AvlTree *self, const void *key, AvlHetComparator
                                void *insert_arg, int *inserted) {
     unsigned long is_left_flags_buf[IS_LEFT_FLAGS_BUF_SZ];
     BitStack is_left_flags;
+    AvlNode *path_buf[AVL_MAX_HEIGHT];
+    NodeStack path; /* only recorded for ranked trees */
     NodeOrParentRet ret;
     AvlNode *equal_or_inserted;
 
     assert(self);
     assert(compare);
     assert(insert);
+    assert(!IS_STALE(self->root));
 
-    BitStack_from_adopted_slice(&is_left_flags, is_left_flags_buf, IS_LEFT_FLAGS_BUF_SZ);
-    ret = find_node_or_parent(&self->root, key, compare, compare_arg, &is_left_flags);
+    BitStack_from_adopted_slice(&is_left_flags, self->allocator, is_left_flags_buf,
+                                IS_LEFT_FLAGS_BUF_SZ);
+    NodeStack_from_adopted_slice(&path, self->allocator, path_buf, AVL_MAX_HEIGHT);
+    ret = find_node_or_parent(self, key, compare, compare_arg, &is_left_flags,
+                              self->is_ranked ? &path : NULL);
 
     if (ret.is_node) {
         equal_or_inserted = *ret.node_or_parent;
@@ -258,159 +571,929 @@ AvlNode* AvlTree_get_or_insert(AvlTree *self, const void *key, AvlHetComparator
 
         *ret.node_or_parent = equal_or_inserted;
 
-        if (inserted) {
-            *inserted = 1;
-        }
+        if (inserted) {
+            *inserted = 1;
+        }
+
+        if (self->is_ranked) {
+            ((AvlRankNode*) equal_or_inserted)->size = 1;
+            grow_path_sizes(&path, NodeStack_len(&path));
+        }
+
+        if (ret.last_with_nonzero_balance_factor) {
+            rebalance(self, &is_left_flags, ret.last_with_nonzero_balance_factor,
+                      equal_or_inserted);
+            assert_correct_balance_factors(self->root);
+        }
+    }
+
+    assert(!path.is_owned);
+    STATS_ADD(WRITE_STATS(self), num_allocations, path.is_owned + is_left_flags.is_owned);
+    NodeStack_drop(&path);
+    BitStack_drop(&is_left_flags);
+
+    return equal_or_inserted;
+}
+
+static size_t climb_to_subtree(const NodeStack *path, const void *key,
+                               AvlHetComparator compare, void *arg, size_t *num_compared,
+                               int *is_equal);
+
+static int descend_from(const AvlTree *self, NodeStack *path, const void *key,
+                        AvlHetComparator compare, void *arg, size_t *num_compared);
+
+static AvlNode** child_ptr(AvlTree *self, NodeStack *path, size_t depth);
+
+static void insert_below_path(AvlTree *self, NodeStack *path, int ordering, AvlNode *node);
+
+/**
+ *  Inserts an array of elements into an AvlTree.
+ *
+ *  Equivalent to calling AvlTree_insert on each node in order, but
+ *  each search starts from the path to the previously inserted node
+ *  and only climbs as far as needed to find a subtree that contains
+ *  the next node. Batches of nearby or sorted keys skip most of the
+ *  comparisons and cache misses near the root; unsorted batches are
+ *  still correct, but gain little.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param nodes Must not be NULL if num_nodes > 0. Each element must
+ *               not be NULL and will be replaced with the previous
+ *               element that compared equal to it, if there was one,
+ *               or NULL otherwise.
+ */
+void AvlTree_insert_batch(AvlTree *self, AvlNode **nodes, size_t num_nodes) {
+    AvlNode *path_buf[AVL_MAX_HEIGHT];
+    NodeStack path; /* root to the last touched node */
+    size_t i;
+
+    assert(self);
+    assert(nodes || num_nodes == 0);
+    assert(!IS_STALE(self->root));
+
+    NodeStack_from_adopted_slice(&path, self->allocator, path_buf, AVL_MAX_HEIGHT);
+
+    for (i = 0; i < num_nodes; ++i) {
+        AvlNode *const node = nodes[i];
+        size_t num_compared;
+        int ordering;
+
+        assert(node);
+
+        ordering = descend_from(self, &path, node, (AvlHetComparator) self->compare,
+                                self->compare_arg, &num_compared);
+        STATS_ADD(WRITE_STATS(self), num_comparisons, num_compared);
+        STATS_SEARCHES(WRITE_STATS(self), 1, NodeStack_len(&path), NodeStack_len(&path));
+
+        if (NodeStack_len(&path) > 0 && ordering == 0) {
+            const size_t depth = NodeStack_len(&path) - 1;
+            AvlNode **const previous_ptr = child_ptr(self, &path, depth);
+            AvlNode *const previous = *previous_ptr;
+
+            replace_node(previous, node, self->is_ranked);
+
+            *previous_ptr = node;
+            *NodeStack_get_mut(&path, (ptrdiff_t) depth) = node;
+            nodes[i] = previous;
+
+            continue;
+        }
+
+        nodes[i] = NULL;
+        insert_below_path(self, &path, ordering, node);
+    }
+
+    assert(!path.is_owned);
+    NodeStack_drop(&path);
+}
+
+/*
+ *  Links a new node below the top of a path from the root, then
+ *  rebalances.
+ *
+ *  If path is empty, the tree must be empty and node becomes its root.
+ *  Otherwise node becomes the left child of the top of path if
+ *  ordering < 0 and the right child if ordering > 0; that slot must be
+ *  empty. On return, path is still a path from the root, but may end
+ *  above node if a rotation moved it.
+ */
+static void insert_below_path(AvlTree *self, NodeStack *path, int ordering, AvlNode *node) {
+    unsigned long is_left_flags_buf[IS_LEFT_FLAGS_BUF_SZ];
+    BitStack is_left_flags;
+    AvlNode **rotate_root_ptr;
+    AvlNode *rotate_root;
+    size_t depth;
+    size_t rotate_depth;
+
+    assert(self);
+    assert(path);
+    assert(node);
+
+    ++self->len;
+
+    node->left = NULL;
+    node->right = NULL;
+    node->balance_factor = 0;
+
+    if (self->is_ranked) {
+        ((AvlRankNode*) node)->size = 1;
+    }
+
+    if (NodeStack_len(path) == 0) {
+        assert(!self->root);
+
+        self->root = node;
+        NodeStack_push(path, node);
+
+        return;
+    }
+
+    assert(ordering != 0);
+    depth = NodeStack_len(path) - 1;
+
+    if (ordering < 0) {
+        assert(!NodeStack_get(path, -1)->left);
+        NodeStack_get(path, -1)->left = node;
+    } else {
+        assert(!NodeStack_get(path, -1)->right);
+        NodeStack_get(path, -1)->right = node;
+    }
+
+    if (self->is_ranked) {
+        grow_path_sizes(path, depth + 1);
+    }
+
+    /* same as find_node_or_parent: rebalance below the deepest unbalanced node */
+    for (rotate_depth = depth; rotate_depth > 0; --rotate_depth) {
+        if (NodeStack_get(path, (ptrdiff_t) rotate_depth)->balance_factor != 0) {
+            break;
+        }
+    }
+
+    NodeStack_push(path, node);
+
+    BitStack_from_adopted_slice(&is_left_flags, self->allocator, is_left_flags_buf,
+                                IS_LEFT_FLAGS_BUF_SZ);
+
+    for (depth = rotate_depth; depth + 1 < NodeStack_len(path); ++depth) {
+        AvlNode *const current = NodeStack_get(path, (ptrdiff_t) depth);
+
+        if (current->left == NodeStack_get(path, (ptrdiff_t) depth + 1)) {
+            BitStack_push_set(&is_left_flags);
+        } else {
+            BitStack_push_clear(&is_left_flags);
+        }
+    }
+
+    rotate_root_ptr = child_ptr(self, path, rotate_depth);
+    rotate_root = *rotate_root_ptr;
+    rebalance(self, &is_left_flags, rotate_root_ptr, node);
+    assert_correct_balance_factors(self->root);
+
+    BitStack_drop(&is_left_flags);
+
+    /* a rotation invalidates everything below the old subtree root */
+    if (*rotate_root_ptr != rotate_root) {
+        path->len = rotate_depth;
+        NodeStack_push(path, *rotate_root_ptr);
+    }
+}
+
+/*
+ *  Finds the deepest node on path whose subtree must contain key.
+ *
+ *  The subtree under path[i] holds everything between its closest
+ *  ancestors that path turns left and right at, so walking up from the
+ *  top only needs to check each bound once. If an ancestor compares
+ *  equal to key, *is_equal is set and its depth is returned. Each
+ *  comparison is added to *num_compared.
+ */
+static size_t climb_to_subtree(const NodeStack *path, const void *key,
+                               AvlHetComparator compare, void *arg, size_t *num_compared,
+                               int *is_equal) {
+    size_t candidate;
+    size_t depth;
+    int has_lower = 0;
+    int has_upper = 0;
+
+    assert(path);
+    assert(NodeStack_len(path) > 0);
+    assert(compare);
+    assert(num_compared);
+    assert(is_equal);
+
+    candidate = NodeStack_len(path) - 1;
+
+    for (depth = candidate; depth > 0 && !(has_lower && has_upper); --depth) {
+        AvlNode *const ancestor = NodeStack_get(path, (ptrdiff_t) depth - 1);
+        const int is_left = ancestor->left == NodeStack_get(path, (ptrdiff_t) depth);
+        int ordering;
+
+        if ((is_left && has_upper) || (!is_left && has_lower)) {
+            continue; /* a closer ancestor already bounds this side */
+        }
+
+        ordering = compare(key, ancestor, arg);
+        ++*num_compared;
+
+        if (ordering == 0) {
+            *is_equal = 1;
+
+            return depth - 1;
+        } else if ((ordering < 0) == is_left) { /* node is inside this bound */
+            if (is_left) {
+                has_upper = 1;
+            } else {
+                has_lower = 1;
+            }
+        } else { /* node is outside; the ancestor's subtree is the new candidate */
+            candidate = depth - 1;
+            has_lower = 0;
+            has_upper = 0;
+        }
+    }
+
+    return candidate;
+}
+
+/*
+ *  Moves a path from the root to the node that compares equal to key
+ *  or, if there isn't one, to the node that would become its parent.
+ *
+ *  Climbs from the top of path only as far as needed, which is all the
+ *  way to the root in the worst case but amortized O(1) levels per
+ *  step of a monotone sweep. path may be empty, in
+ *  which case the search starts at the root. Returns the ordering of
+ *  key against the top of path, which is 0 if it compared equal or if
+ *  self is empty, and sets *num_compared to the number of comparisons;
+ *  callers count the search for the tree they are reading or writing.
+ */
+static int descend_from(const AvlTree *self, NodeStack *path, const void *key,
+                        AvlHetComparator compare, void *arg, size_t *num_compared) {
+    int ordering = 0;
+    int is_equal = 0;
+
+    assert(self);
+    assert(path);
+    assert(compare);
+    assert(num_compared);
+
+    *num_compared = 0;
+
+    if (!self->root) {
+        path->len = 0;
+
+        return 0;
+    }
+
+    if (NodeStack_len(path) == 0) {
+        NodeStack_push(path, self->root);
+    }
+
+    path->len = climb_to_subtree(path, key, compare, arg, num_compared, &is_equal) + 1;
+
+    while (!is_equal) {
+        AvlNode *const current = NodeStack_get(path, -1);
+        AvlNode *next;
+
+        ordering = compare(key, current, arg);
+        ++*num_compared;
+
+        if (ordering == 0) {
+            break;
+        }
+
+        next = (ordering < 0) ? current->left : current->right;
+
+        if (!next) {
+            break;
+        }
+
+        NodeStack_push(path, next);
+    }
+
+    return ordering;
+}
+
+static AvlNode** child_ptr(AvlTree *self, NodeStack *path, size_t depth) {
+    AvlNode *parent;
+
+    assert(self);
+    assert(path);
+    assert(depth < NodeStack_len(path));
+
+    if (depth == 0) {
+        return &self->root;
+    }
+
+    parent = NodeStack_get(path, (ptrdiff_t) depth - 1);
+
+    if (parent->left == NodeStack_get(path, (ptrdiff_t) depth)) {
+        return &parent->left;
+    } else {
+        return &parent->right;
+    }
+}
+
+/* if path is not NULL, every node visited is pushed onto it */
+static NodeOrParentRet find_node_or_parent(AvlTree *self, const void *key,
+                                           AvlHetComparator compare, void *arg,
+                                           BitStack *is_left_flags, NodeStack *path) {
+    AvlNode **const root_ptr = &self->root;
+    NodeOrParentRet to_return;
+    size_t depth = 0;
+
+    assert(compare);
+    assert(is_left_flags);
+
+    to_return.last_with_nonzero_balance_factor = NULL;
+
+    if (!*root_ptr) {
+        STATS_SEARCH(WRITE_STATS(self), 0);
+        to_return.is_node = 0;
+        to_return.node_or_parent = root_ptr;
+
+        return to_return;
+    } else {
+        AvlNode **current_ptr = root_ptr;
+        AvlNode **rotate_root_ptr = root_ptr;
+
+        while (1) {
+            AvlNode *const current = *current_ptr;
+            const int ordering = compare(key, current, arg);
+
+            ++depth;
+
+            if (ordering == 0) { /* key == current */
+                STATS_SEARCH(WRITE_STATS(self), depth);
+                to_return.is_node = 1;
+                to_return.node_or_parent = current_ptr;
+
+                return to_return;
+            }
+
+            if (current->balance_factor != 0) {
+                rotate_root_ptr = current_ptr;
+                BitStack_clear(is_left_flags);
+            }
+
+            if (path) {
+                NodeStack_push(path, current);
+            }
+
+            if (ordering < 0) { /* key < current */
+                BitStack_push_set(is_left_flags);
+                current_ptr = &current->left;
+            } else { /* key > current, ordering > 0 */
+                BitStack_push_clear(is_left_flags);
+                current_ptr = &current->right;
+            }
+
+            if (!*current_ptr) {
+                STATS_SEARCH(WRITE_STATS(self), depth);
+                to_return.is_node = 0;
+                to_return.node_or_parent = current_ptr;
+                to_return.last_with_nonzero_balance_factor = rotate_root_ptr;
+
+                return to_return;
+            }
+        }
+    }
+}
+
+static void rebalance(AvlTree *self, const BitStack *is_left_flags, AvlNode **root_ptr,
+                      AvlNode *inserted) {
+    AvlNode *current;
+    size_t depth_from_root;
+    size_t length = 0;
+
+    assert(self);
+    assert(is_left_flags);
+    assert(root_ptr);
+    assert(*root_ptr);
+
+    for (depth_from_root = BitStack_len(is_left_flags) - 1, current = *root_ptr;
+         current != inserted; --depth_from_root) {
+        const int is_left = BitStack_get(is_left_flags, depth_from_root);
+        assert(is_left != -1);
+
+        ++length;
+
+        if (is_left) {
+            --current->balance_factor;
+            current = current->left;
+        } else {
+            ++current->balance_factor;
+            current = current->right;
+        }
+    }
+
+    STATS_ADD(WRITE_STATS(self), num_rebalances, 1);
+    STATS_ADD(WRITE_STATS(self), total_rebalance_length, length);
+    count_rotation(self, *root_ptr);
+
+    *root_ptr = rotate(*root_ptr);
+
+    if (self->is_ranked) {
+        update_rotated_rank_sizes(*root_ptr);
+    }
+}
+
+/* counts a node just inserted below path[len - 1] */
+static void grow_path_sizes(const NodeStack *path, size_t len) {
+    size_t i;
+
+    assert(path);
+    assert(len <= NodeStack_len(path));
+
+    for (i = 0; i < len; ++i) {
+        ++((AvlRankNode*) NodeStack_get(path, (ptrdiff_t) i))->size;
+    }
+}
+
+/* moves the links of previous to node, which takes its place */
+static void replace_node(AvlNode *previous, AvlNode *node, int is_ranked) {
+    assert(previous);
+    assert(node);
+
+    node->left = previous->left;
+    node->right = previous->right;
+    node->balance_factor = previous->balance_factor;
+
+    if (is_ranked) {
+        ((AvlRankNode*) node)->size = ((AvlRankNode*) previous)->size;
+    }
+
+    previous->left = NULL;
+    previous->right = NULL;
+    previous->balance_factor = 0;
+}
+
+static void remove_node(AvlTree *self, AvlNode **node_ptr, NodeStack *nodes,
+                        BitStack *is_left_flags);
+
+/**
+ *  Removes the node that compares equal to a key.
+ *
+ *  @param self Must not be NULL.
+ *  @param compare Must not be NULL. Must form the same total
+ *                 ordering over the set of nodes as the one
+ *                 passed to AvlTree_new. Will be invoked to compare
+ *                 the key to nodes by compare(key, node, arg).
+ *  @returns The node that compared equal to key, if there was one.
+ */
+AvlNode* AvlTree_remove(AvlTree *self, const void *key, AvlHetComparator compare, void *arg) {
+    AvlNode *nodes_buf[AVL_MAX_HEIGHT];
+    NodeStack nodes;
+    unsigned long is_left_flags_buf[IS_LEFT_FLAGS_BUF_SZ];
+    BitStack is_left_flags;
+    size_t current_depth = 0;
+    AvlNode **current_ptr;
+    AvlNode *to_remove;
+
+    assert(self);
+    assert(compare);
+
+    if (self->is_relaxed) {
+        return relaxed_remove(self, key, compare, arg);
+    }
+
+    NodeStack_from_adopted_slice(&nodes, self->allocator, nodes_buf, AVL_MAX_HEIGHT);
+    BitStack_from_adopted_slice(&is_left_flags, self->allocator, is_left_flags_buf,
+                                IS_LEFT_FLAGS_BUF_SZ);
+    for (current_ptr = &self->root; *current_ptr; ++current_depth) {
+        AvlNode *const current = *current_ptr;
+        const int ordering = compare(key, current, arg);
+
+        NodeStack_push(&nodes, current);
+
+        if (ordering == 0) {
+            break; /* we got em */
+        } else if (ordering < 0 && current->left) {
+            current_ptr = &current->left;
+            BitStack_push_set(&is_left_flags);
+        } else if (ordering > 0 && current->right) {
+            current_ptr = &current->right;
+            BitStack_push_clear(&is_left_flags);
+        } else {
+            STATS_SEARCH(WRITE_STATS(self), NodeStack_len(&nodes));
+            BitStack_drop(&is_left_flags);
+            NodeStack_drop(&nodes);
+
+            return 0; /* no such node... */
+        }
+    }
+
+    STATS_SEARCH(WRITE_STATS(self), NodeStack_len(&nodes));
+
+    if (!*current_ptr) {
+        BitStack_drop(&is_left_flags);
+        NodeStack_drop(&nodes);
+
+        return 0; /* ...not even a root */
+    }
+
+    to_remove = *current_ptr;
+    remove_node(self, current_ptr, &nodes, &is_left_flags);
+    --self->len;
+
+    /* neither stack should ever outgrow its buffer */
+    assert(!nodes.is_owned);
+    assert(!is_left_flags.is_owned);
+    STATS_ADD(WRITE_STATS(self), num_allocations, nodes.is_owned + is_left_flags.is_owned);
+
+    BitStack_drop(&is_left_flags);
+    NodeStack_drop(&nodes);
+
+    return to_remove;
+}
+
+/**
+ *  Inserts a node below the end of a path found by the caller.
+ *
+ *  Lets callers that search the tree themselves, such as the C++
+ *  templates in avl_tree.h, reuse the rebalancing of AvlTree_insert.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param parent Must not be NULL. Must hold the path from the root of
+ *                self to the node that will become the parent of node,
+ *                or be empty if self is empty. Will be invalidated.
+ *  @param ordering If negative, node becomes the left child of the
+ *                  node parent points to; if positive, its right
+ *                  child. That child must be NULL. Ignored if self is
+ *                  empty.
+ *  @param node Must not be NULL. Must compare between the neighbors of
+ *              the slot it is inserted into.
+ */
+void AvlTree_insert_at(AvlTree *self, AvlCursor *parent, int ordering, AvlNode *node) {
+    NodeStack path;
+
+    assert(self);
+    assert(parent);
+    assert(node);
+    assert(parent->len == 0 ? !self->root : parent->path[0] == self->root);
+    assert(parent->len == 0 || ordering != 0);
+    assert(!IS_STALE(self->root));
+
+    NodeStack_from_adopted_slice(&path, self->allocator, parent->path, AVL_MAX_HEIGHT);
+    path.len = parent->len;
+
+    insert_below_path(self, &path, ordering, node);
+
+    assert(!path.is_owned);
+    STATS_ADD(WRITE_STATS(self), num_allocations, path.is_owned);
+    parent->len = NodeStack_len(&path);
+    NodeStack_drop(&path);
+}
+
+/**
+ *  Replaces the node a cursor points to with an equal node.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param cursor Must not be NULL. Must point to a node of self.
+ *  @param node Must not be NULL. Must compare equal to the node cursor
+ *              points to, which it takes the place of in self and in
+ *              cursor.
+ *  @returns The node that was replaced.
+ */
+AvlNode* AvlTree_replace_at(AvlTree *self, AvlCursor *cursor, AvlNode *node) {
+    AvlNode **slot;
+    AvlNode *previous;
+
+    assert(self);
+    assert(!IS_STALE(self->root));
+    assert(cursor);
+    assert(cursor->len > 0);
+    assert(cursor->path[0] == self->root);
+    assert(node);
+
+    previous = cursor->path[cursor->len - 1];
+
+    if (cursor->len == 1) {
+        slot = &self->root;
+    } else if (cursor->path[cursor->len - 2]->left == previous) {
+        slot = &cursor->path[cursor->len - 2]->left;
+    } else {
+        slot = &cursor->path[cursor->len - 2]->right;
+    }
+
+    replace_node(previous, node, self->is_ranked);
+    *slot = node;
+    cursor->path[cursor->len - 1] = node;
+
+    return previous;
+}
+
+/**
+ *  Removes the node a cursor points to.
+ *
+ *  Lets callers that search the tree themselves reuse the rebalancing
+ *  of AvlTree_remove.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param cursor Must not be NULL. Must point to a node of self. Will
+ *                be left pointing past the end.
+ *  @returns The node that was removed.
+ */
+AvlNode* AvlTree_remove_at(AvlTree *self, AvlCursor *cursor) {
+    NodeStack nodes;
+    unsigned long is_left_flags_buf[IS_LEFT_FLAGS_BUF_SZ];
+    BitStack is_left_flags;
+    AvlNode **node_ptr;
+    AvlNode *to_remove;
+    size_t depth;
+
+    assert(self);
+    assert(cursor);
+    assert(cursor->len > 0);
+    assert(cursor->path[0] == self->root);
+    assert(!IS_STALE(self->root));
+
+    NodeStack_from_adopted_slice(&nodes, self->allocator, cursor->path, AVL_MAX_HEIGHT);
+    nodes.len = cursor->len;
+    BitStack_from_adopted_slice(&is_left_flags, self->allocator, is_left_flags_buf,
+                                IS_LEFT_FLAGS_BUF_SZ);
+
+    for (depth = 0; depth + 1 < cursor->len; ++depth) {
+        if (cursor->path[depth]->left == cursor->path[depth + 1]) {
+            BitStack_push_set(&is_left_flags);
+        } else {
+            BitStack_push_clear(&is_left_flags);
+        }
+    }
+
+    node_ptr = child_ptr(self, &nodes, cursor->len - 1);
+    to_remove = *node_ptr;
+    remove_node(self, node_ptr, &nodes, &is_left_flags);
+    --self->len;
+
+    assert(!nodes.is_owned);
+    assert(!is_left_flags.is_owned);
+    STATS_ADD(WRITE_STATS(self), num_allocations, nodes.is_owned + is_left_flags.is_owned);
+
+    BitStack_drop(&is_left_flags);
+    NodeStack_drop(&nodes);
+    cursor->len = 0;
+
+    return to_remove;
+}
+
+/**
+ *  Removes the node a cursor points to and passes it to the deleter.
+ *
+ *  Runs in O(log n) time without invoking any comparator.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param cursor Must not be NULL. Must point to a node of self. Will
+ *                be left pointing past the end.
+ */
+void AvlTree_erase_at(AvlTree *self, AvlCursor *cursor) {
+    assert(self);
+    assert(!IS_STALE(self->root));
+    assert(cursor);
+
+    self->deleter(AvlTree_remove_at(self, cursor), self->deleter_arg);
+}
+
+static size_t linked_len(const AvlTree *self, AvlNode *const *path, size_t len);
+
+/**
+ *  Finds the node that compares equal to a key, starting from where a
+ *  previous search left off.
+ *
+ *  Only climbs from the end of finger as far as needed to find a
+ *  subtree that contains key, then descends from there. finger is a
+ *  path from the root with no links between neighbors, so a key next
+ *  to the last one but across a high ancestor still takes O(log n)
+ *  comparisons in the worst case. Over a monotone sweep through
+ *  consecutive keys, each step takes amortized O(1) comparisons.
+ *  Equivalent to AvlTree_get otherwise.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param finger Must not be NULL. Must be past the end or point to a
+ *                node of self, and self must not have been modified
+ *                since except through functions that were passed
+ *                finger. Will be left pointing at the node that
+ *                compares equal to key or, if there isn't one, the
+ *                node that would become its parent.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @returns The node that compares equal to key, if there is one.
+ */
+const AvlNode* AvlTree_get_from(const AvlTree *self, AvlCursor *finger, const void *key,
+                                AvlHetComparator compare, void *arg) {
+    NodeStack path;
+    size_t num_compared;
+    int ordering;
+
+    assert(self);
+    assert(finger);
+    assert(finger->len == 0 || finger->path[0] == self->root);
+    assert(compare);
+
+    NodeStack_from_adopted_slice(&path, self->allocator, finger->path, AVL_MAX_HEIGHT);
+    path.len = finger->len;
+    ordering = descend_from(self, &path, key, compare, arg, &num_compared);
+    SHARED_STATS_ADD(LOOKUP_STATS(self), num_comparisons, num_compared);
+    SHARED_STATS_SEARCHES(LOOKUP_STATS(self), 1, NodeStack_len(&path), NodeStack_len(&path));
+
+    assert(!path.is_owned);
+    finger->len = NodeStack_len(&path);
+    NodeStack_drop(&path);
+
+    if (finger->len == 0 || ordering != 0) {
+        return NULL;
+    }
+
+    return finger->path[finger->len - 1];
+}
+
+/**
+ *  Inserts an element into an AvlTree, starting the search from where
+ *  a previous one left off.
+ *
+ *  Equivalent to AvlTree_insert, but only climbs from the end of
+ *  finger as far as needed, like AvlTree_get_from: O(log n) time in
+ *  the worst case, amortized O(1) per step of a monotone sweep.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param finger Must not be NULL. Must be past the end or point to a
+ *                node of self, and self must not have been modified
+ *                since except through functions that were passed
+ *                finger. Will be left pointing at node or one of its
+ *                ancestors.
+ *  @param node Must not be NULL.
+ *  @returns The previous element that compares equal to node, if there
+ *           was one.
+ */
+AvlNode* AvlTree_insert_from(AvlTree *self, AvlCursor *finger, AvlNode *node) {
+    NodeStack path;
+    size_t num_compared;
+    int ordering;
+
+    assert(self);
+    assert(!IS_STALE(self->root));
+    assert(finger);
+    assert(finger->len == 0 || finger->path[0] == self->root);
+    assert(node);
+
+    NodeStack_from_adopted_slice(&path, self->allocator, finger->path, AVL_MAX_HEIGHT);
+    path.len = finger->len;
+    ordering = descend_from(self, &path, node, (AvlHetComparator) self->compare,
+                            self->compare_arg, &num_compared);
+    STATS_ADD(WRITE_STATS(self), num_comparisons, num_compared);
+    STATS_SEARCHES(WRITE_STATS(self), 1, NodeStack_len(&path), NodeStack_len(&path));
+
+    assert(!path.is_owned);
+    finger->len = NodeStack_len(&path);
+    NodeStack_drop(&path);
 
-        if (ret.last_with_nonzero_balance_factor) {
-            rebalance(&is_left_flags, ret.last_with_nonzero_balance_factor, equal_or_inserted);
-            assert_correct_balance_factors(self->root);
-        }
+    if (finger->len > 0 && ordering == 0) {
+        return AvlTree_replace_at(self, finger, node);
     }
 
-    BitStack_drop(&is_left_flags);
+    AvlTree_insert_at(self, finger, ordering, node);
 
-    return equal_or_inserted;
+    return NULL;
 }
 
-static NodeOrParentRet find_node_or_parent(AvlNode **root_ptr, const void *key,
-                                           AvlHetComparator compare, void *arg,
-                                           BitStack *is_left_flags) {
-    NodeOrParentRet to_return;
+/**
+ *  Removes the node that compares equal to a key, starting the search
+ *  from where a previous one left off.
+ *
+ *  Equivalent to AvlTree_remove, but only climbs from the end of
+ *  finger as far as needed, like AvlTree_get_from: O(log n) time in
+ *  the worst case, amortized O(1) per step of a monotone sweep.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param finger Must not be NULL. Must be past the end or point to a
+ *                node of self, and self must not have been modified
+ *                since except through functions that were passed
+ *                finger. Will be left pointing at a node near the one
+ *                that was removed, or past the end.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @returns The node that compared equal to key, if there was one.
+ */
+AvlNode* AvlTree_remove_from(AvlTree *self, AvlCursor *finger, const void *key,
+                             AvlHetComparator compare, void *arg) {
+    AvlNode *removed;
+    size_t len;
 
-    assert(root_ptr);
+    assert(self);
+    assert(!IS_STALE(self->root));
+    assert(finger);
     assert(compare);
-    assert(is_left_flags);
-
-    to_return.last_with_nonzero_balance_factor = NULL;
-
-    if (!*root_ptr) {
-        to_return.is_node = 0;
-        to_return.node_or_parent = root_ptr;
-
-        return to_return;
-    } else {
-        AvlNode **current_ptr = root_ptr;
-        AvlNode **rotate_root_ptr = root_ptr;
-
-        while (1) {
-            AvlNode *const current = *current_ptr;
-            const int ordering = compare(key, current, arg);
-
-            if (ordering == 0) { /* key == current */
-                to_return.is_node = 1;
-                to_return.node_or_parent = current_ptr;
-
-                return to_return;
-            }
 
-            if (current->balance_factor != 0) {
-                rotate_root_ptr = current_ptr;
-                BitStack_clear(is_left_flags);
-            }
+    if (!AvlTree_get_from(self, finger, key, compare, arg)) {
+        return NULL;
+    }
 
-            if (ordering < 0) { /* key < current */
-                BitStack_push_set(is_left_flags);
-                current_ptr = &current->left;
-            } else { /* key > current, ordering > 0 */
-                BitStack_push_clear(is_left_flags);
-                current_ptr = &current->right;
-            }
+    len = finger->len;
+    removed = AvlTree_remove_at(self, finger);
 
-            if (!*current_ptr) {
-                to_return.is_node = 0;
-                to_return.node_or_parent = current_ptr;
-                to_return.last_with_nonzero_balance_factor = rotate_root_ptr;
+    /*
+     *  removal only pops the path, so its buffer still holds the
+     *  ancestors of the removed node, followed by its successor if that
+     *  took its place; keep as much of it as rebalancing left linked
+     */
+    finger->len = linked_len(self, finger->path, len);
 
-                return to_return;
-            }
-        }
-    }
+    return removed;
 }
 
-static void rebalance(const BitStack *is_left_flags, AvlNode **root_ptr, AvlNode *inserted) {
-    AvlNode *current;
-    size_t depth_from_root;
+/**
+ *  Searches an AvlTree once, for a later insertion or replacement.
+ *
+ *  Lets a caller decide what to do about a key after a single search:
+ *  if a node compares equal to key, it can be updated in place or
+ *  passed with entry->cursor to AvlTree_replace_at or
+ *  AvlTree_remove_at; otherwise a node can be built only then and
+ *  linked by AvlTree_insert_entry without searching again. Either way,
+ *  nothing has to be allocated up front and thrown away.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param entry Must not be NULL. Will be filled with the path from the
+ *               root to the node that compares equal to key or, if
+ *               there isn't one, to the node that would become its
+ *               parent. Invalidated by any modification of self except
+ *               through functions that are passed entry.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @returns The node that compares equal to key, if there is one.
+ */
+AvlNode* AvlTree_entry(AvlTree *self, AvlEntry *entry, const void *key,
+                       AvlHetComparator compare, void *arg) {
+    NodeStack path;
+    size_t num_compared;
 
-    assert(is_left_flags);
-    assert(root_ptr);
-    assert(*root_ptr);
+    assert(self);
+    assert(entry);
+    assert(compare);
 
-    for (depth_from_root = BitStack_len(is_left_flags) - 1, current = *root_ptr;
-         current != inserted; --depth_from_root) {
-        const int is_left = BitStack_get(is_left_flags, depth_from_root);
-        assert(is_left != -1);
+    NodeStack_from_adopted_slice(&path, self->allocator, entry->cursor.path, AVL_MAX_HEIGHT);
+    entry->ordering = descend_from(self, &path, key, compare, arg, &num_compared);
+    STATS_ADD(WRITE_STATS(self), num_comparisons, num_compared);
+    STATS_SEARCHES(WRITE_STATS(self), 1, NodeStack_len(&path), NodeStack_len(&path));
 
-        if (is_left) {
-            --current->balance_factor;
-            current = current->left;
-        } else {
-            ++current->balance_factor;
-            current = current->right;
-        }
+    assert(!path.is_owned);
+    entry->cursor.len = NodeStack_len(&path);
+    NodeStack_drop(&path);
+
+    if (entry->cursor.len == 0 || entry->ordering != 0) {
+        return NULL;
     }
 
-    *root_ptr = rotate(*root_ptr);
+    return entry->cursor.path[entry->cursor.len - 1];
 }
 
-static void remove_node(AvlTree *self, AvlNode **node_ptr, NodeStack *nodes,
-                        BitStack *is_left_flags);
-
-static size_t max_height(size_t num_nodes);
-
 /**
- *  Removes the node that compares equal to a key.
+ *  Inserts a node into the slot a search by AvlTree_entry found empty.
  *
- *  @param self Must not be NULL.
- *  @param compare Must not be NULL. Must form the same total
- *                 ordering over the set of nodes as the one
- *                 passed to AvlTree_new. Will be invoked to compare
- *                 the key to nodes by compare(key, node, arg).
- *  @returns The node that compared equal to key, if there was one.
+ *  Runs in O(log n) time without invoking any comparator.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param entry Must not be NULL. Must have been filled by
+ *               AvlTree_entry, which must have returned NULL, and self
+ *               must not have been modified since. Will be
+ *               invalidated.
+ *  @param node Must not be NULL. Must compare equal to the key that was
+ *              passed to AvlTree_entry.
  */
-AvlNode* AvlTree_remove(AvlTree *self, const void *key, AvlHetComparator compare, void *arg) {
-    NodeStack nodes;
-    unsigned long is_left_flags_buf[IS_LEFT_FLAGS_BUF_SZ];
-    BitStack is_left_flags;
-    size_t current_depth = 0;
-    AvlNode **current_ptr;
-    AvlNode *to_remove;
-
+void AvlTree_insert_entry(AvlTree *self, AvlEntry *entry, AvlNode *node) {
     assert(self);
-    assert(compare);
+    assert(!IS_STALE(self->root));
+    assert(entry);
+    assert(entry->cursor.len == 0 || entry->ordering != 0);
+    assert(node);
 
-    NodeStack_with_capacity(&nodes, max_height(self->len) + 1);
-    BitStack_from_adopted_slice(&is_left_flags, is_left_flags_buf, IS_LEFT_FLAGS_BUF_SZ);
-    for (current_ptr = &self->root; *current_ptr; ++current_depth) {
-        AvlNode *const current = *current_ptr;
-        const int ordering = compare(key, current, arg);
+    AvlTree_insert_at(self, &entry->cursor, entry->ordering, node);
+}
 
-        NodeStack_push(&nodes, current);
+/* the length of the longest prefix of path that is a path from the root */
+static size_t linked_len(const AvlTree *self, AvlNode *const *path, size_t len) {
+    size_t i;
 
-        if (ordering == 0) {
-            break; /* we got em */
-        } else if (ordering < 0 && current->left) {
-            current_ptr = &current->left;
-            BitStack_push_set(&is_left_flags);
-        } else if (ordering > 0 && current->right) {
-            current_ptr = &current->right;
-            BitStack_push_clear(&is_left_flags);
-        } else {
-            BitStack_drop(&is_left_flags);
-            NodeStack_drop(&nodes);
+    assert(self);
+    assert(path);
 
-            return 0; /* no such node... */
-        }
+    if (len == 0 || path[0] != self->root) {
+        return 0;
     }
 
-    to_remove = *current_ptr;
-    remove_node(self, current_ptr, &nodes, &is_left_flags);
-    --self->len;
-
-    BitStack_drop(&is_left_flags);
-    NodeStack_drop(&nodes);
+    for (i = 1; i < len; ++i) {
+        if (path[i - 1]->left != path[i] && path[i - 1]->right != path[i]) {
+            break;
+        }
+    }
 
-    return to_remove;
+    return i;
 }
 
 static AvlNode* swap_for_delete(NodeStack *nodes, BitStack *is_left_flags, AvlNode *node);
@@ -448,6 +1531,15 @@ static void remove_node(AvlTree *self, AvlNode **node_ptr, NodeStack *nodes,
 
     NodeStack_pop(nodes);
 
+    /* every node left on the path lost one descendant */
+    if (self->is_ranked) {
+        size_t i;
+
+        for (i = NodeStack_len(nodes); i > 0; --i) {
+            update_rank_size(NodeStack_get(nodes, (ptrdiff_t) i - 1));
+        }
+    }
+
     update_balance_factors_and_rebalance(self, nodes, is_left_flags);
     assert_correct_balance_factors(self->root);
 }
@@ -497,6 +1589,8 @@ static AvlNode* swap_for_delete(NodeStack *nodes, BitStack *is_left_flags, AvlNo
 
 static void update_balance_factors_and_rebalance(AvlTree *self, NodeStack *nodes,
                                                  BitStack *is_left_flags) {
+    size_t length = 0;
+
     assert(nodes);
     assert(is_left_flags);
 
@@ -524,12 +1618,13 @@ static void update_balance_factors_and_rebalance(AvlTree *self, NodeStack *nodes
         }
 
         assert(node == *parent_ptr);
+        ++length;
 
         if (is_left) {
             ++node->balance_factor;
 
             if (node->balance_factor == 1) {
-                return;
+                break;
             } else if (node->balance_factor == 2) {
                 AvlNode *const middle_or_bottom = node->right;
                 assert(middle_or_bottom);
@@ -542,6 +1637,11 @@ static void update_balance_factors_and_rebalance(AvlTree *self, NodeStack *nodes
 
                     node->right = rotate_right_unchecked(middle, bottom);
                     *parent_ptr = rotate_left_unchecked(node, bottom);
+                    STATS_ADD(WRITE_STATS(self), num_double_rotations, 1);
+
+                    if (self->is_ranked) {
+                        update_rotated_rank_sizes(bottom);
+                    }
 
                     if (bottom->balance_factor == 1) {
                         node->balance_factor = -1;
@@ -561,6 +1661,11 @@ static void update_balance_factors_and_rebalance(AvlTree *self, NodeStack *nodes
                     AvlNode *const bottom = middle_or_bottom;
 
                     *parent_ptr = rotate_left_unchecked(node, bottom);
+                    STATS_ADD(WRITE_STATS(self), num_single_rotations, 1);
+
+                    if (self->is_ranked) {
+                        update_rotated_rank_sizes(bottom);
+                    }
 
                     if (bottom->balance_factor == 0) {
                         bottom->balance_factor = -1;
@@ -579,7 +1684,7 @@ static void update_balance_factors_and_rebalance(AvlTree *self, NodeStack *nodes
             --node->balance_factor;
 
             if (node->balance_factor == -1) {
-                return;
+                break;
             } else if (node->balance_factor == -2) {
                 AvlNode *const middle_or_bottom = node->left;
                 assert(middle_or_bottom);
@@ -592,6 +1697,11 @@ static void update_balance_factors_and_rebalance(AvlTree *self, NodeStack *nodes
 
                     node->left = rotate_left_unchecked(middle, bottom);
                     *parent_ptr = rotate_right_unchecked(node, bottom);
+                    STATS_ADD(WRITE_STATS(self), num_double_rotations, 1);
+
+                    if (self->is_ranked) {
+                        update_rotated_rank_sizes(bottom);
+                    }
 
                     if (bottom->balance_factor == -1) {
                         node->balance_factor = 1;
@@ -611,6 +1721,11 @@ static void update_balance_factors_and_rebalance(AvlTree *self, NodeStack *nodes
                     AvlNode *const bottom = middle_or_bottom;
 
                     *parent_ptr = rotate_right_unchecked(node, bottom);
+                    STATS_ADD(WRITE_STATS(self), num_single_rotations, 1);
+
+                    if (self->is_ranked) {
+                        update_rotated_rank_sizes(bottom);
+                    }
 
                     if (bottom->balance_factor == 0) {
                         bottom->balance_factor = 1;
@@ -627,48 +1742,216 @@ static void update_balance_factors_and_rebalance(AvlTree *self, NodeStack *nodes
             }
         }
     }
+
+    STATS_ADD(WRITE_STATS(self), num_rebalances, 1);
+    STATS_ADD(WRITE_STATS(self), total_rebalance_length, length);
 }
 
-static double log2(double x);
+/**
+ *  Clears the tree, removing all members.
+ *
+ *  Equivalent to AvlTree_clear_with(self, self->deleter,
+ *  self->deleter_arg).
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ */
+void AvlTree_clear(AvlTree *self) {
+    assert(self);
 
-static size_t max_height(size_t num_nodes) {
-    return (size_t) ceil(1.44 * log2((double) num_nodes + 1.065) - 0.328);
+    AvlTree_clear_with(self, self->deleter, self->deleter_arg);
 }
 
-static double log2(double x) {
-    return log(x) / log(2.0);
+/**
+ *  Clears the tree, removing all members, with a different deleter.
+ *
+ *  Nodes are visited in pre-order by chasing child pointers and are
+ *  never written to, so the deleter may free them immediately.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param deleter If NULL, the tree is reset in O(1) time and its
+ *                 nodes are not visited; use this when they are owned
+ *                 elsewhere, such as by an arena. Otherwise, will be
+ *                 invoked on each node as if by deleter(node,
+ *                 deleter_arg).
+ */
+void AvlTree_clear_with(AvlTree *self, AvlDeleter deleter, void *deleter_arg) {
+    assert(self);
+
+    if (deleter) {
+        delete_subtree(self->root, deleter, deleter_arg);
+    }
+
+    self->len = 0;
+    self->root = NULL;
 }
 
 /**
- *  Clears the tree, removing all members.
+ *  Invokes a callback on each node of an AvlTree in order.
  *
  *  @param self Must not be NULL. Must be initialized.
+ *  @param traverse Must not be NULL. Will be invoked on each node as
+ *                  if by traverse(arg, node). Must not modify self.
  */
-void AvlTree_clear(AvlTree *self) {
-    AvlNode *current;
+void AvlTree_traverse(const AvlTree *self, AvlTraverseCb traverse, void *arg) {
+    AvlCursor cursor;
 
     assert(self);
+    assert(traverse);
 
-    if (!self->root) {
+    for (AvlCursor_first(&cursor, self); AvlCursor_get(&cursor); AvlCursor_next(&cursor)) {
+        traverse(arg, AvlCursor_get(&cursor));
+    }
+}
+
+/**
+ *  Invokes a callback on each node of an AvlTree in order.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param traverse Must not be NULL. Will be invoked on each node as
+ *                  if by traverse(arg, node). May modify the contents
+ *                  of each node, but must not change its ordering
+ *                  relative to the other nodes or modify self.
+ */
+void AvlTree_traverse_mut(AvlTree *self, AvlTraverseMutCb traverse, void *arg) {
+    AvlCursor cursor;
+
+    assert(self);
+    assert(traverse);
+
+    for (AvlCursor_first(&cursor, self); AvlCursor_get(&cursor); AvlCursor_next(&cursor)) {
+        traverse(arg, AvlCursor_get_mut(&cursor));
+    }
+}
+
+/**
+ *  Reads the counters of the operations that modified an AvlTree.
+ *
+ *  Lookups are not included; see AvlTree_set_lookup_stats.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param stats Must not be NULL. Will be set to the counters of self,
+ *               or to all zeroes if BLOODHOUND_STATS is not defined.
+ */
+void AvlTree_stats(const AvlTree *self, AvlTreeStats *stats) {
+    assert(self);
+    assert(stats);
+
+    *stats = self->stats;
+}
+
+/**
+ *  Makes the lookups on an AvlTree count into caller-owned counters.
+ *
+ *  Counted lookups are the functions that search a tree without
+ *  modifying it, such as AvlTree_get, AvlTree_get_many, AvlTree_get_from
+ *  and AvlTree_lower_bound. Counts are only kept if libbloodhound is
+ *  built with BLOODHOUND_STATS defined. With GCC and Clang they are
+ *  added atomically, so lookups on different threads may share one
+ *  sink; read it with __atomic_load_n while they run. Otherwise
+ *  lookups that share a sink must not run concurrently.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param lookup_stats If NULL, lookups are not counted. Otherwise
+ *                      must be initialized, such as to all zeroes, and
+ *                      must outlive its use by self and by the trees
+ *                      AvlTree_split splits from it.
+ */
+void AvlTree_set_lookup_stats(AvlTree *self, AvlTreeStats *lookup_stats) {
+    assert(self);
+
+    self->lookup_stats = lookup_stats;
+}
+
+/**
+ *  Makes snapshots of an AvlTree, and the scratch stacks of its
+ *  operations, allocate through an allocator.
+ *
+ *  @param self Must not be NULL. Must be initialized. Must not be in
+ *              the middle of an operation.
+ *  @param allocator If NULL, the allocator that is the default when
+ *                   memory is allocated is used. Otherwise must be
+ *                   initialized and must outlive every snapshot of
+ *                   self.
+ */
+void AvlTree_set_allocator(AvlTree *self, AvlAllocator *allocator) {
+    assert(self);
+
+    self->allocator = allocator;
+}
+
+#ifdef BLOODHOUND_STATS
+/**
+ *  Adds to a counter, atomically if built with GCC or Clang.
+ *
+ *  @param counter Must not be NULL.
+ */
+void stats_add(size_t *counter, size_t n) {
+    assert(counter);
+
+#ifdef __GNUC__
+    (void) __atomic_fetch_add(counter, n, __ATOMIC_RELAXED);
+#else
+    *counter += n;
+#endif
+}
+
+/**
+ *  Counts searches from the root, atomically if built with GCC or
+ *  Clang.
+ *
+ *  @param stats If NULL, nothing is counted.
+ *  @param num The number of searches.
+ *  @param total_depth The number of nodes on all of their paths.
+ *  @param max_depth The number of nodes on the longest of them.
+ */
+void stats_searches(AvlTreeStats *stats, size_t num, size_t total_depth, size_t max_depth) {
+#ifdef __GNUC__
+    size_t previous_max;
+#endif
+
+    if (!stats) {
         return;
     }
 
-    current = self->root;
-    while (current) {
-        AvlNode *next;
+    stats_add(&stats->num_searches, num);
 
-        while (current->left) {
-            current = rotate_right_unchecked(current, current->left);
-        }
+    if (total_depth != 0) {
+        stats_add(&stats->total_search_depth, total_depth);
+    }
 
-        next = current->right;
-        self->deleter(current, self->deleter_arg);
-        current = next;
+#ifdef __GNUC__
+    previous_max = __atomic_load_n(&stats->max_search_depth, __ATOMIC_RELAXED);
+
+    while (max_depth > previous_max
+           && !__atomic_compare_exchange_n(&stats->max_search_depth, &previous_max, max_depth, 1,
+                                           __ATOMIC_RELAXED, __ATOMIC_RELAXED)) { }
+#else
+    if (max_depth > stats->max_search_depth) {
+        stats->max_search_depth = max_depth;
     }
+#endif
+}
 
-    self->len = 0;
-    self->root = NULL;
+/* counts the rotation that rotate(root) is about to make, if any */
+static void do_count_rotation(AvlTree *self, const AvlNode *root) {
+    assert(self);
+    assert(root);
+
+    if (root->balance_factor == -2) {
+        if (root->left->balance_factor == 1) {
+            ++self->stats.num_double_rotations;
+        } else {
+            ++self->stats.num_single_rotations;
+        }
+    } else if (root->balance_factor == 2) {
+        if (root->right->balance_factor == -1) {
+            ++self->stats.num_double_rotations;
+        } else {
+            ++self->stats.num_single_rotations;
+        }
+    }
 }
+#endif
 
 #ifndef NDEBUG
 static int do_assert_balance_factors(const AvlNode *node) {
@@ -26,78 +26,221 @@
 
 #include "mem.h"
 
+#include <assert.h>
 #include <stdlib.h>
 #include <stdio.h>
 
+static void* malloc_alloc(size_t size, void *ctx);
+
+static void* malloc_realloc(void *ptr, size_t old_size, size_t new_size, void *ctx);
+
+static void malloc_free(void *ptr, size_t size, void *ctx);
+
+static void count_bytes(AvlAllocator *allocator, size_t freed, size_t allocated);
+
+static AvlAllocator malloc_allocator = {
+    malloc_alloc, malloc_realloc, malloc_free, NULL, 0, 0
+};
+
+static AvlAllocator *default_allocator = &malloc_allocator;
+
 /**
- *  Allocates uninitialized memory.
+ *  Allocates uninitialized memory through an AvlAllocator.
  *
- *  Uses malloc() internally. If malloc() returns NULL, a message is
- *  printed to stderr and abort() is called.
+ *  If the allocator returns NULL, a message is printed to stderr and
+ *  abort() is called.
  *
- *  @param size The minimum number of bytes that the allocated memory
- *              should be able to hold.
+ *  @param allocator If NULL, the default allocator is used.
+ *  @param size Must be > 0.
  *  @returns A pointer to uninitialized memory at least size bytes
  *           long.
  */
-void* checked_malloc(size_t size) {
-    void *const ptr = malloc(size);
+void* allocator_malloc(AvlAllocator *allocator, size_t size) {
+    void *ptr;
+
+    assert(size > 0);
+
+    if (!allocator) {
+        allocator = default_allocator;
+    }
+
+    ptr = allocator->alloc(size, allocator->ctx);
 
     if (!ptr) {
-        fprintf(stderr, "libavlbst: checked_malloc(): malloc() returned NULL\n");
+        fprintf(stderr, "libavlbst: allocator_malloc(): alloc() returned NULL\n");
         abort();
     }
 
+    count_bytes(allocator, 0, size);
+
     return ptr;
 }
 
 /**
- *  Allocates zero initialized memory.
+ *  Reallocates memory through the AvlAllocator that allocated it.
  *
- *  Uses calloc() internally. If calloc() returns NULL, a message is
- *  printed to stderr and abort() is called.
+ *  If the allocator returns NULL, a message is printed to stderr and
+ *  abort() is called.
  *
- *  @param num_objects The number of objects that the allocated memory
- *                     should be able to hold.
- *  @param object_size The length of each object in bytes.
- *  @returns A pointer to zero initialized memory.
+ *  @param allocator If NULL, the default allocator is used.
+ *  @param ptr If NULL, this call is equivalent to
+ *             allocator_malloc(allocator, new_size).
+ *  @param old_size The size ptr was allocated with.
+ *  @param new_size Must be > 0.
+ *  @returns A pointer to memory at least new_size bytes long, which
+ *           begins with the first min(old_size, new_size) bytes of ptr.
  */
-void* checked_calloc(size_t num_objects, size_t object_size) {
-    void *const ptr = calloc(num_objects, object_size);
+void* allocator_realloc(AvlAllocator *allocator, void *ptr, size_t old_size, size_t new_size) {
+    assert(new_size > 0);
 
     if (!ptr) {
-        fprintf(stderr, "libavlbst: checked_calloc(): calloc() returned NULL\n");
+        return allocator_malloc(allocator, new_size);
+    }
+
+    if (!allocator) {
+        allocator = default_allocator;
+    }
+
+    ptr = allocator->realloc(ptr, old_size, new_size, allocator->ctx);
+
+    if (!ptr) {
+        fprintf(stderr, "libavlbst: allocator_realloc(): realloc() returned NULL\n");
         abort();
     }
 
+    count_bytes(allocator, old_size, new_size);
+
     return ptr;
 }
 
 /**
- *  Reallocates memory.
+ *  Frees memory through the AvlAllocator that allocated it.
  *
- *  Uses realloc() internally. If realloc() returns NULL, a message is
- *  printed to stderr and abort() is called.
+ *  @param allocator If NULL, the default allocator is used.
+ *  @param ptr If NULL, nothing is done.
+ *  @param size The size ptr was allocated with.
+ */
+void allocator_free(AvlAllocator *allocator, void *ptr, size_t size) {
+    if (!ptr) {
+        return;
+    }
+
+    if (!allocator) {
+        allocator = default_allocator;
+    }
+
+    allocator->free(ptr, size, allocator->ctx);
+    count_bytes(allocator, size, 0);
+}
+
+/**
+ *  Initializes an AvlAllocator with zeroed counters.
  *
- *  @param ptr A pointer to memory allocated by malloc(), calloc(), or
- *             realloc(). If NULL, this call is functionally equivalent
- *             to checked_malloc(new_size).
- *  @param new_size The minimum number of bytes that the allocated
- *                  memory should be able to hold.
- *  @returns A pointer to memory at least new_size bytes long. If
- *           new_size is greater the size ptr was allocated with, the
- *           first size bytes will be copied from ptr into the new
- *           memory and the remaining bytes are uninitialized.
- *           Otherwise, the first new_size bytes are copied and all
- *           memory is initialized.
+ *  @param self Must not be NULL. Must not be initialized.
+ *  @param alloc_fn Must not be NULL. Will be invoked by
+ *                  alloc_fn(size, ctx) to allocate memory aligned for
+ *                  any object.
+ *  @param realloc_fn Must not be NULL. Will be invoked by
+ *                    realloc_fn(ptr, old_size, new_size, ctx) to resize
+ *                    memory it or alloc_fn returned, preserving its
+ *                    contents as realloc() does.
+ *  @param free_fn Must not be NULL. Will be invoked by free_fn(ptr,
+ *                 size, ctx) to release memory alloc_fn or realloc_fn
+ *                 returned, where size is the size it was last
+ *                 requested with.
  */
-void* checked_realloc(void *ptr, size_t new_size) {
-    ptr = realloc(ptr, new_size);
+void AvlAllocator_new(AvlAllocator *self, AvlAllocFn alloc_fn, AvlReallocFn realloc_fn,
+                      AvlFreeFn free_fn, void *ctx) {
+    assert(self);
+    assert(alloc_fn);
+    assert(realloc_fn);
+    assert(free_fn);
 
-    if (!ptr) {
-        fprintf(stderr, "libavlbst: checked_realloc(): realloc() returned NULL\n");
-        abort();
+    self->alloc = alloc_fn;
+    self->realloc = realloc_fn;
+    self->free = free_fn;
+    self->ctx = ctx;
+    self->bytes_held = 0;
+    self->peak_bytes_held = 0;
+}
+
+/**
+ *  Installs the allocator for memory not tied to a particular AvlTree.
+ *
+ *  Must not be called while any tree is in use, and memory must be
+ *  freed by the allocator that allocated it, so no snapshot frozen
+ *  from a tree without an allocator of its own may still be live.
+ *
+ *  @param allocator If NULL, the malloc-based default is restored.
+ *                   Otherwise must be initialized and must outlive its
+ *                   use as the default.
+ */
+void AvlAllocator_set_default(AvlAllocator *allocator) {
+    default_allocator = allocator ? allocator : &malloc_allocator;
+}
+
+/**
+ *  @returns The allocator for memory not tied to a particular AvlTree,
+ *           including the malloc-based one that is installed unless
+ *           AvlAllocator_set_default says otherwise.
+ */
+AvlAllocator* AvlAllocator_get_default(void) {
+    return default_allocator;
+}
+
+static void* malloc_alloc(size_t size, void *ctx) {
+    (void) ctx;
+
+    return malloc(size);
+}
+
+static void* malloc_realloc(void *ptr, size_t old_size, size_t new_size, void *ctx) {
+    (void) old_size;
+    (void) ctx;
+
+    return realloc(ptr, new_size);
+}
+
+static void malloc_free(void *ptr, size_t size, void *ctx) {
+    (void) size;
+    (void) ctx;
+
+    free(ptr);
+}
+
+/*
+ *  Atomically if built with GCC or Clang, since the default is shared
+ *  by every tree that did not ask for an allocator, including trees on
+ *  different threads.
+ */
+static void count_bytes(AvlAllocator *allocator, size_t freed, size_t allocated) {
+    size_t held;
+#ifdef __GNUC__
+    size_t previous_peak;
+#endif
+
+    assert(allocator);
+
+#ifdef __GNUC__
+    if (allocated >= freed) {
+        held = __atomic_add_fetch(&allocator->bytes_held, allocated - freed, __ATOMIC_RELAXED);
+    } else {
+        held = __atomic_sub_fetch(&allocator->bytes_held, freed - allocated, __ATOMIC_RELAXED);
     }
 
-    return ptr;
+    previous_peak = __atomic_load_n(&allocator->peak_bytes_held, __ATOMIC_RELAXED);
+
+    while (held > previous_peak
+           && !__atomic_compare_exchange_n(&allocator->peak_bytes_held, &previous_peak, held, 1,
+                                           __ATOMIC_RELAXED, __ATOMIC_RELAXED)) { }
+#else
+    assert(allocator->bytes_held >= freed);
+
+    held = allocator->bytes_held - freed + allocated;
+    allocator->bytes_held = held;
+
+    if (held > allocator->peak_bytes_held) {
+        allocator->peak_bytes_held = held;
+    }
+#endif
 }
@@ -27,6 +27,8 @@
 #ifndef BLOODHOUND_IMPL_MEM_H
 #define BLOODHOUND_IMPL_MEM_H
 
+#include <bloodhound.h>
+
 #include <stddef.h>
 
 #ifdef __cplusplus
@@ -34,50 +36,42 @@ extern "C" {
 #endif
 
 /**
- *  Allocates uninitialized memory.
+ *  Allocates uninitialized memory through an AvlAllocator.
  *
- *  Uses malloc() internally. If malloc() returns NULL, a message is
- *  printed to stderr and abort() is called.
+ *  If the allocator returns NULL, a message is printed to stderr and
+ *  abort() is called.
  *
- *  @param size The minimum number of bytes that the allocated memory
- *              should be able to hold.
+ *  @param allocator If NULL, the default allocator is used.
+ *  @param size Must be > 0.
  *  @returns A pointer to uninitialized memory at least size bytes
  *           long.
  */
-void* checked_malloc(size_t size);
+void* allocator_malloc(AvlAllocator *allocator, size_t size);
 
 /**
- *  Allocates zero initialized memory.
+ *  Reallocates memory through the AvlAllocator that allocated it.
  *
- *  Uses calloc() internally. If calloc() returns NULL, a message is
- *  printed to stderr and abort() is called.
+ *  If the allocator returns NULL, a message is printed to stderr and
+ *  abort() is called.
  *
- *  @param num_objects The number of objects that the allocated memory
- *                     should be able to hold.
- *  @param object_size The length of each object in bytes.
- *  @returns A pointer to zero initialized memory.
+ *  @param allocator If NULL, the default allocator is used.
+ *  @param ptr If NULL, this call is equivalent to
+ *             allocator_malloc(allocator, new_size).
+ *  @param old_size The size ptr was allocated with.
+ *  @param new_size Must be > 0.
+ *  @returns A pointer to memory at least new_size bytes long, which
+ *           begins with the first min(old_size, new_size) bytes of ptr.
  */
-void* checked_calloc(size_t num_objects, size_t object_size);
+void* allocator_realloc(AvlAllocator *allocator, void *ptr, size_t old_size, size_t new_size);
 
 /**
- *  Reallocates memory.
- *
- *  Uses realloc() internally. If realloc() returns NULL, a message is
- *  printed to stderr and abort() is called.
+ *  Frees memory through the AvlAllocator that allocated it.
  *
- *  @param ptr A pointer to memory allocated by malloc(), calloc(), or
- *             realloc(). If NULL, this call is functionally equivalent
- *             to checked_malloc(new_size).
- *  @param new_size The minimum number of bytes that the allocated
- *                  memory should be able to hold.
- *  @returns A pointer to memory at least new_size bytes long. If
- *           new_size is greater the size ptr was allocated with, the
- *           first size bytes will be copied from ptr into the new
- *           memory and the remaining bytes are uninitialized.
- *           Otherwise, the first new_size bytes are copied and all
- *           memory is initialized.
+ *  @param allocator If NULL, the default allocator is used.
+ *  @param ptr If NULL, nothing is done.
+ *  @param size The size ptr was allocated with.
  */
-void* checked_realloc(void *ptr, size_t new_size);
+void allocator_free(AvlAllocator *allocator, void *ptr, size_t size);
 
 #ifdef __cplusplus
 } // extern "C"
@@ -28,6 +28,9 @@
 
 #include <assert.h>
 
+#define MAX(X, Y) (((X) < (Y)) ? (Y) : (X))
+#define MIN(X, Y) (((X) < (Y)) ? (X) : (Y))
+
 /**
  *  Automatically selects a rotation to execute on a tree.
  *
@@ -235,3 +238,160 @@ AvlNode* rotate_right_unchecked(AvlNode *top, AvlNode *bottom) {
 
     return bottom;
 }
+
+/**
+ *  Executes a left rotation around top, updating balance factors.
+ *
+ *  Unlike rotate_left, top and its right child may have any balance
+ *  factors, as long as they accurately describe the heights of their
+ *  subtrees.
+ *
+ *  @param top Must not be NULL. Must have a right child.
+ *  @returns The right child of top, the new root of the tree.
+ */
+AvlNode* rotate_left_any(AvlNode *top) {
+    AvlNode *bottom;
+    int top_balance;
+    int bottom_balance;
+
+    assert(top);
+    assert(top->right);
+
+    bottom = top->right;
+    top_balance = top->balance_factor;
+    bottom_balance = bottom->balance_factor;
+
+    rotate_left_unchecked(top, bottom);
+
+    top_balance = top_balance - 1 - MAX(bottom_balance, 0);
+    bottom_balance = bottom_balance - 1 + MIN(top_balance, 0);
+
+    top->balance_factor = (signed char) top_balance;
+    bottom->balance_factor = (signed char) bottom_balance;
+
+    return bottom;
+}
+
+/**
+ *  Executes a right rotation around top, updating balance factors.
+ *
+ *  Unlike rotate_right, top and its left child may have any balance
+ *  factors, as long as they accurately describe the heights of their
+ *  subtrees.
+ *
+ *  @param top Must not be NULL. Must have a left child.
+ *  @returns The left child of top, the new root of the tree.
+ */
+AvlNode* rotate_right_any(AvlNode *top) {
+    AvlNode *bottom;
+    int top_balance;
+    int bottom_balance;
+
+    assert(top);
+    assert(top->left);
+
+    bottom = top->left;
+    top_balance = top->balance_factor;
+    bottom_balance = bottom->balance_factor;
+
+    rotate_right_unchecked(top, bottom);
+
+    top_balance = top_balance + 1 - MIN(bottom_balance, 0);
+    bottom_balance = bottom_balance + 1 + MAX(top_balance, 0);
+
+    top->balance_factor = (signed char) top_balance;
+    bottom->balance_factor = (signed char) bottom_balance;
+
+    return bottom;
+}
+
+/**
+ *  Returns the number of nodes in a subtree of a ranked tree.
+ *
+ *  @param node May be NULL. If not NULL, must be the node member of an
+ *              AvlRankNode.
+ *  @returns 0 if node is NULL, otherwise the size stored in node.
+ */
+size_t rank_size(const AvlNode *node) {
+    if (!node) {
+        return 0;
+    }
+
+    return ((const AvlRankNode*) node)->size;
+}
+
+/**
+ *  Recomputes the size of a node in a ranked tree from its children.
+ *
+ *  @param node Must not be NULL. Must be the node member of an
+ *              AvlRankNode whose children have correct sizes.
+ */
+void update_rank_size(AvlNode *node) {
+    assert(node);
+
+    ((AvlRankNode*) node)->size = rank_size(node->left) + rank_size(node->right) + 1;
+}
+
+/**
+ *  Recomputes the sizes of the nodes moved by a rotation.
+ *
+ *  @param root Must not be NULL. Must be the node member of an
+ *              AvlRankNode whose grandchildren have correct sizes.
+ */
+void update_rotated_rank_sizes(AvlNode *root) {
+    assert(root);
+
+    if (root->left) {
+        update_rank_size(root->left);
+    }
+
+    if (root->right) {
+        update_rank_size(root->right);
+    }
+
+    update_rank_size(root);
+}
+
+/**
+ *  Frees every node of a tree without restructuring it.
+ *
+ *  @param root May be NULL.
+ *  @param deleter Must not be NULL. Will be invoked on each node as if
+ *                 by deleter(node, deleter_arg).
+ */
+void delete_subtree(AvlNode *root, AvlDeleter deleter, void *deleter_arg) {
+    /* only right children of the current path wait here, so the height bounds it */
+    AvlNode *pending[AVL_MAX_HEIGHT];
+    size_t num_pending = 0;
+    AvlNode *current = root;
+
+    assert(deleter);
+
+    while (current) {
+        AvlNode *const left = current->left;
+        AvlNode *const right = current->right;
+
+        PREFETCH(left);
+        PREFETCH(right);
+
+        deleter(current, deleter_arg);
+
+        if (left) {
+            if (right) {
+                assert(num_pending < AVL_MAX_HEIGHT);
+
+                pending[num_pending] = right;
+                ++num_pending;
+            }
+
+            current = left;
+        } else if (right) {
+            current = right;
+        } else if (num_pending > 0) {
+            --num_pending;
+            current = pending[num_pending];
+        } else {
+            current = NULL;
+        }
+    }
+}
@@ -29,6 +29,12 @@
 
 #include <bloodhound.h>
 
+#ifdef __GNUC__
+#define PREFETCH(P) __builtin_prefetch((P))
+#else
+#define PREFETCH(P) ((void) (P))
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -115,6 +121,70 @@ AvlNode* rotate_left_unchecked(AvlNode *top, AvlNode *bottom);
  */
 AvlNode* rotate_right_unchecked(AvlNode *top, AvlNode *bottom);
 
+/**
+ *  Executes a left rotation around top, updating balance factors.
+ *
+ *  Unlike rotate_left, top and its right child may have any balance
+ *  factors, as long as they accurately describe the heights of their
+ *  subtrees.
+ *
+ *  @param top Must not be NULL. Must have a right child.
+ *  @returns The right child of top, the new root of the tree.
+ */
+AvlNode* rotate_left_any(AvlNode *top);
+
+/**
+ *  Executes a right rotation around top, updating balance factors.
+ *
+ *  Unlike rotate_right, top and its left child may have any balance
+ *  factors, as long as they accurately describe the heights of their
+ *  subtrees.
+ *
+ *  @param top Must not be NULL. Must have a left child.
+ *  @returns The left child of top, the new root of the tree.
+ */
+AvlNode* rotate_right_any(AvlNode *top);
+
+/**
+ *  Returns the number of nodes in a subtree of a ranked tree.
+ *
+ *  @param node May be NULL. If not NULL, must be the node member of an
+ *              AvlRankNode.
+ *  @returns 0 if node is NULL, otherwise the size stored in node.
+ */
+size_t rank_size(const AvlNode *node);
+
+/**
+ *  Recomputes the size of a node in a ranked tree from its children.
+ *
+ *  @param node Must not be NULL. Must be the node member of an
+ *              AvlRankNode whose children have correct sizes.
+ */
+void update_rank_size(AvlNode *node);
+
+/**
+ *  Recomputes the sizes of the nodes moved by a rotation.
+ *
+ *  Every rotation, single or double, only moves the new root of the
+ *  subtree and its children, so those three are all that change.
+ *
+ *  @param root Must not be NULL. Must be the node member of an
+ *              AvlRankNode whose grandchildren have correct sizes.
+ */
+void update_rotated_rank_sizes(AvlNode *root);
+
+/**
+ *  Frees every node of a tree without restructuring it.
+ *
+ *  Visits nodes in pre-order, reading and prefetching both children
+ *  before a node is passed to the deleter, and never writes to a node.
+ *
+ *  @param root May be NULL.
+ *  @param deleter Must not be NULL. Will be invoked on each node as if
+ *                 by deleter(node, deleter_arg).
+ */
+void delete_subtree(AvlNode *root, AvlDeleter deleter, void *deleter_arg);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -30,18 +30,23 @@
 
 #include <assert.h>
 #include <stdlib.h>
+#include <string.h>
 
 /**
  *  Initializes an empty NodeStack.
  *
  *  @param self Must not be NULL. Must not be initialized.
+ *  @param allocator Will be used for every allocation the stack makes.
+ *                   If NULL, the default allocator is used.
  */
-void NodeStack_new(NodeStack *self) {
+void NodeStack_new(NodeStack *self, AvlAllocator *allocator) {
     assert(self);
 
     self->data = NULL;
     self->len = 0;
     self->capacity = 0;
+    self->is_owned = 1;
+    self->allocator = allocator;
 }
 
 /**
@@ -49,19 +54,47 @@ void NodeStack_new(NodeStack *self) {
  *  elements.
  *
  *  @param self Must not be NULL. Must not be initialized.
+ *  @param allocator Will be used for every allocation the stack makes.
+ *                   If NULL, the default allocator is used.
  */
-void NodeStack_with_capacity(NodeStack *self, size_t size) {
+void NodeStack_with_capacity(NodeStack *self, AvlAllocator *allocator, size_t size) {
     assert(self);
 
     if (size == 0) {
-        NodeStack_new(self);
+        NodeStack_new(self, allocator);
 
         return;
     }
 
-    self->data = checked_malloc(sizeof(AvlNode*) * size);
+    self->data = allocator_malloc(allocator, sizeof(AvlNode*) * size);
     self->len = 0;
     self->capacity = size;
+    self->is_owned = 1;
+    self->allocator = allocator;
+}
+
+/**
+ *  Initializes an empty NodeStack that will initially use the adopted
+ *  slice of memory until it fills up.
+ *
+ *  @param self Must not be NULL. Must not be initialized.
+ *  @param allocator Will be used for every allocation the stack makes.
+ *                   If NULL, the default allocator is used.
+ *  @param data Must point to a buffer at least len * sizeof(AvlNode*)
+ *              bytes long.
+ *  @param len Must be > 0.
+ */
+void NodeStack_from_adopted_slice(NodeStack *self, AvlAllocator *allocator, AvlNode **data,
+                                  size_t len) {
+    assert(self);
+    assert(data);
+    assert(len > 0);
+
+    self->data = data;
+    self->len = 0;
+    self->capacity = len;
+    self->is_owned = 0;
+    self->allocator = allocator;
 }
 
 /**
@@ -70,16 +103,19 @@ void NodeStack_with_capacity(NodeStack *self, size_t size) {
  *  @param self Must not be NULL. Must not be initialized.
  */
 void NodeStack_drop(NodeStack *self) {
-    free(self->data);
+    if (self->is_owned) {
+        allocator_free(self->allocator, self->data, sizeof(AvlNode*) * self->capacity);
+    }
 }
 
 /**
  *  Pushes an AvlNode to the top of this NodeStack.
  *
- *  If not enough space is available for this NodeStack, realloc() is
- *  called to increase the capacity of the NodeStack by 1.5 - if there
- *  is no capacity, malloc() is called to initialize the NodeStack with
- *  space for 8 node pointers.
+ *  If not enough space is available for this NodeStack, its
+ *  AvlAllocator is used to increase the capacity of the NodeStack by
+ *  1.5 - if there is no capacity, to initialize the NodeStack with
+ *  space for 8 node pointers. If this NodeStack is using an adopted
+ *  slice, its contents are copied into newly allocated memory.
  *
  *  @param self Must not be NULL. Must be initialized.
  *  @param node Will be yielded as the next result of pop().
@@ -93,16 +129,29 @@ size_t NodeStack_push(NodeStack *self, AvlNode *node) {
             assert(self->len == 0);
             assert(self->capacity == 0);
 
-            self->data = checked_malloc(sizeof(AvlNode*) * 8);
+            self->data = allocator_malloc(self->allocator, sizeof(AvlNode*) * 8);
             self->capacity = 8;
         } else {
+            const size_t old_capacity = self->capacity;
+
             assert(self->capacity != 0);
 
             ++self->capacity; /* if capacity = 1, below is a noop */
             self->capacity *= 3;
             self->capacity /= 2;
 
-            self->data = checked_realloc(self->data, sizeof(AvlNode*) * self->capacity);
+            if (self->is_owned) {
+                self->data = allocator_realloc(self->allocator, self->data,
+                                               sizeof(AvlNode*) * old_capacity,
+                                               sizeof(AvlNode*) * self->capacity);
+            } else {
+                AvlNode **const data =
+                    allocator_malloc(self->allocator, sizeof(AvlNode*) * self->capacity);
+                memcpy(data, self->data, sizeof(AvlNode*) * self->len);
+
+                self->data = data;
+                self->is_owned = 1;
+            }
         }
     }
 
@@ -46,16 +46,34 @@ typedef struct NodeStack NodeStack;
  *  Initializes an empty NodeStack.
  *
  *  @param self Must not be NULL. Must not be initialized.
+ *  @param allocator Will be used for every allocation the stack makes.
+ *                   If NULL, the default allocator is used.
  */
-void NodeStack_new(NodeStack *self);
+void NodeStack_new(NodeStack *self, AvlAllocator *allocator);
 
 /**
  *  Initializes an empty NodeStack with space for at least size
  *  elements.
  *
  *  @param self Must not be NULL. Must not be initialized.
+ *  @param allocator Will be used for every allocation the stack makes.
+ *                   If NULL, the default allocator is used.
  */
-void NodeStack_with_capacity(NodeStack *self, size_t size);
+void NodeStack_with_capacity(NodeStack *self, AvlAllocator *allocator, size_t size);
+
+/**
+ *  Initializes an empty NodeStack that will initially use the adopted
+ *  slice of memory until it fills up.
+ *
+ *  @param self Must not be NULL. Must not be initialized.
+ *  @param allocator Will be used for every allocation the stack makes.
+ *                   If NULL, the default allocator is used.
+ *  @param data Must point to a buffer at least len * sizeof(AvlNode*)
+ *              bytes long.
+ *  @param len Must be > 0.
+ */
+void NodeStack_from_adopted_slice(NodeStack *self, AvlAllocator *allocator, AvlNode **data,
+                                  size_t len);
 
 /**
  *  Drops a NodeStack, deallocating all owned resources.
@@ -67,10 +85,11 @@ void NodeStack_drop(NodeStack *self);
 /**
  *  Pushes an AvlNode to the top of this NodeStack.
  *
- *  If not enough space is available for this NodeStack, realloc() is
- *  called to increase the capacity of the NodeStack by 1.5 - if there
- *  is no capacity, malloc() is called to initialize the NodeStack with
- *  space for 8 node pointers.
+ *  If not enough space is available for this NodeStack, its
+ *  AvlAllocator is used to increase the capacity of the NodeStack by
+ *  1.5 - if there is no capacity, to initialize the NodeStack with
+ *  space for 8 node pointers. If this NodeStack is using an adopted
+ *  slice, its contents are copied into newly allocated memory.
  *
  *  @param self Must not be NULL. Must be initialized.
  *  @param node Will be yielded as the next result of pop().
@@ -125,6 +144,8 @@ struct NodeStack {
     AvlNode **data;
     size_t len;
     size_t capacity;
+    int is_owned;
+    AvlAllocator *allocator; /* or NULL for the default */
 };
 
 #ifdef __cplusplus
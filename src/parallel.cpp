@@ -0,0 +1,615 @@
+//  MIT License
+//
+//  Copyright (c) 2019 Gregory Meyer
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//  files (the "Software"), to deal in the Software without
+//  restriction, including without limitation the rights to use, copy,
+//  modify, merge, publish, distribute, sublicense, and/or sell copies
+//  of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice (including
+//  the next paragraph) shall be included in all copies or substantial
+//  portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+//  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+//  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+//  IN THE SOFTWARE.
+
+#include <bloodhound_parallel.h>
+
+#include "join.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace {
+
+class Task {
+public:
+    Task() noexcept : done_(false) { }
+
+    Task(const Task &other) = delete;
+
+    virtual ~Task() = default;
+
+    void execute() noexcept {
+        run();
+        done_.store(true, std::memory_order_release);
+    }
+
+    bool is_done() const noexcept {
+        return done_.load(std::memory_order_acquire);
+    }
+
+private:
+    virtual void run() noexcept = 0;
+
+    std::atomic<bool> done_;
+};
+
+template <typename F>
+class FunctionTask : public Task {
+public:
+    explicit FunctionTask(F &f) noexcept : f_(f) { }
+
+private:
+    void run() noexcept override {
+        f_();
+    }
+
+    F &f_;
+};
+
+} // namespace
+
+struct AvlThreadPool {
+public:
+    explicit AvlThreadPool(std::size_t num_threads);
+
+    AvlThreadPool(const AvlThreadPool &other) = delete;
+
+    ~AvlThreadPool();
+
+    std::size_t num_threads() const noexcept {
+        return threads_.size();
+    }
+
+    // runs f and g, possibly in parallel, and returns when both are done
+    template <typename F, typename G>
+    void fork_join(F &&f, G &&g);
+
+private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task*> tasks;
+    };
+
+    std::size_t home() const noexcept;
+
+    void spawn(Task &task);
+
+    void wait(const Task &task);
+
+    bool run_one(std::size_t home);
+
+    void stop() noexcept;
+
+    void work(std::size_t index);
+
+    static thread_local const AvlThreadPool *current_pool_;
+    static thread_local std::size_t current_index_;
+
+    // queues_[num_threads()] is shared by threads outside the pool
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> threads_;
+    std::atomic<std::size_t> num_queued_;
+    std::mutex sleep_mutex_;
+    std::condition_variable wakeup_;
+    bool is_stopping_;
+};
+
+thread_local const AvlThreadPool *AvlThreadPool::current_pool_ = nullptr;
+thread_local std::size_t AvlThreadPool::current_index_ = 0;
+
+AvlThreadPool::AvlThreadPool(std::size_t num_threads) : num_queued_(0), is_stopping_(false) {
+    assert(num_threads > 0);
+
+    for (std::size_t i = 0; i <= num_threads; ++i) {
+        queues_.emplace_back(new Queue());
+    }
+
+    try {
+        for (std::size_t i = 0; i < num_threads; ++i) {
+            threads_.emplace_back(&AvlThreadPool::work, this, i);
+        }
+    } catch (...) {
+        stop();
+
+        throw;
+    }
+}
+
+AvlThreadPool::~AvlThreadPool() {
+    stop();
+}
+
+void AvlThreadPool::stop() noexcept {
+    {
+        const std::lock_guard<std::mutex> guard(sleep_mutex_);
+        is_stopping_ = true;
+    }
+
+    wakeup_.notify_all();
+
+    for (std::thread &thread : threads_) {
+        thread.join();
+    }
+
+    threads_.clear();
+}
+
+template <typename F, typename G>
+void AvlThreadPool::fork_join(F &&f, G &&g) {
+    FunctionTask<typename std::remove_reference<F>::type> task(f);
+
+    spawn(task);
+    g();
+    wait(task);
+}
+
+std::size_t AvlThreadPool::home() const noexcept {
+    if (current_pool_ == this) {
+        return current_index_;
+    }
+
+    return num_threads();
+}
+
+void AvlThreadPool::spawn(Task &task) {
+    Queue &queue = *queues_[home()];
+
+    // counted before it is visible so that a thief can't take the count
+    // below zero
+    num_queued_.fetch_add(1, std::memory_order_relaxed);
+
+    {
+        const std::lock_guard<std::mutex> guard(queue.mutex);
+        queue.tasks.push_back(&task);
+    }
+
+    // taking the lock orders this with a worker checking num_queued_
+    {
+        const std::lock_guard<std::mutex> guard(sleep_mutex_);
+    }
+
+    wakeup_.notify_one();
+}
+
+// helps with other tasks instead of blocking, so nested forks cannot
+// deadlock the pool
+void AvlThreadPool::wait(const Task &task) {
+    const std::size_t index = home();
+
+    while (!task.is_done()) {
+        if (!run_one(index)) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+// pops the newest task of home, otherwise steals the oldest task of
+// another queue
+bool AvlThreadPool::run_one(std::size_t home) {
+    Task *task = nullptr;
+
+    {
+        Queue &queue = *queues_[home];
+        const std::lock_guard<std::mutex> guard(queue.mutex);
+
+        if (!queue.tasks.empty()) {
+            task = queue.tasks.back();
+            queue.tasks.pop_back();
+        }
+    }
+
+    for (std::size_t i = 1; !task && i < queues_.size(); ++i) {
+        Queue &queue = *queues_[(home + i) % queues_.size()];
+        const std::lock_guard<std::mutex> guard(queue.mutex);
+
+        if (!queue.tasks.empty()) {
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+        }
+    }
+
+    if (!task) {
+        return false;
+    }
+
+    num_queued_.fetch_sub(1, std::memory_order_relaxed);
+    task->execute();
+
+    return true;
+}
+
+void AvlThreadPool::work(std::size_t index) {
+    current_pool_ = this;
+    current_index_ = index;
+
+    while (true) {
+        if (run_one(index)) {
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        wakeup_.wait(lock, [this] {
+            return is_stopping_ || num_queued_.load(std::memory_order_relaxed) > 0;
+        });
+
+        if (is_stopping_) {
+            return;
+        }
+    }
+}
+
+namespace {
+
+int left_height(const AvlNode *node, int height) noexcept {
+    return height - 1 - std::max(static_cast<int>(node->balance_factor), 0);
+}
+
+int right_height(const AvlNode *node, int height) noexcept {
+    return height - 1 + std::min(static_cast<int>(node->balance_factor), 0);
+}
+
+// the height of a subtree with 2^h - 1 nodes that still counts as small
+int grain_height(std::size_t grain_size) noexcept {
+    int height = 0;
+
+    while (grain_size > 1) {
+        grain_size /= 2;
+        ++height;
+    }
+
+    return height + 1;
+}
+
+// the height of the tree that AvlTree_from_sorted builds from n nodes
+int balanced_height(std::size_t num_nodes) noexcept {
+    int height = 0;
+
+    while (num_nodes > 0) {
+        num_nodes /= 2;
+        ++height;
+    }
+
+    return height;
+}
+
+SetOp make_set_op(const AvlTree &self, const AvlTree &other) noexcept {
+    SetOp op;
+
+    op.compare = reinterpret_cast<AvlHetComparator>(self.compare);
+    op.compare_arg = self.compare_arg;
+    op.self_deleter = self.deleter;
+    op.self_deleter_arg = self.deleter_arg;
+    op.other_deleter = other.deleter;
+    op.other_deleter_arg = other.deleter_arg;
+    op.num_matched = 0;
+    op.is_ranked = self.is_ranked;
+
+    assert(self.is_ranked == other.is_ranked);
+
+    return op;
+}
+
+enum class SetOpKind {
+    Union,
+    Intersection,
+    Difference,
+};
+
+// mirrors union_subtrees, intersect_subtrees and subtract_subtrees, but
+// runs the two recursive calls as a fork. each branch counts matches in
+// its own SetOp so that no counter is shared between threads.
+class ParallelSetOp {
+public:
+    ParallelSetOp(AvlThreadPool &pool, SetOpKind kind, int grain_height) noexcept
+    : pool_(pool), kind_(kind), grain_height_(grain_height) { }
+
+    AvlNode* operator()(SetOp &op, AvlNode *self, int self_height, AvlNode *other,
+                        int other_height, int *height) const {
+        if (!self || !other || other_height <= grain_height_) {
+            return sequential(op, self, self_height, other, other_height, height);
+        }
+
+        AvlNode *const other_left = other->left;
+        AvlNode *const other_right = other->right;
+        AvlNode *self_left;
+        AvlNode *self_right;
+        int self_left_height;
+        int self_right_height;
+
+        AvlNode *const found = split_subtree(self, self_height, other, op.compare,
+                                             op.compare_arg, &self_left, &self_left_height,
+                                             &self_right, &self_right_height, op.is_ranked);
+
+        SetOp right_op = op;
+        right_op.num_matched = 0;
+
+        AvlNode *left;
+        AvlNode *right;
+        int left_subtree_height;
+        int right_subtree_height;
+
+        auto do_right = [&] {
+            right = (*this)(right_op, self_right, self_right_height, other_right,
+                            right_height(other, other_height), &right_subtree_height);
+        };
+
+        auto do_left = [&] {
+            left = (*this)(op, self_left, self_left_height, other_left,
+                           left_height(other, other_height), &left_subtree_height);
+        };
+
+        pool_.fork_join(do_right, do_left);
+        op.num_matched += right_op.num_matched;
+
+        if (found) {
+            ++op.num_matched;
+        }
+
+        switch (kind_) {
+        case SetOpKind::Union:
+            if (found) {
+                op.other_deleter(other, op.other_deleter_arg);
+            }
+
+            return join_subtrees(left, left_subtree_height, found ? found : other, right,
+                                 right_subtree_height, height, op.is_ranked);
+        case SetOpKind::Intersection:
+            op.other_deleter(other, op.other_deleter_arg);
+
+            if (found) {
+                return join_subtrees(left, left_subtree_height, found, right,
+                                     right_subtree_height, height, op.is_ranked);
+            }
+
+            return join2_subtrees(left, left_subtree_height, right, right_subtree_height,
+                                  height, op.is_ranked);
+        case SetOpKind::Difference:
+            op.other_deleter(other, op.other_deleter_arg);
+
+            if (found) {
+                op.self_deleter(found, op.self_deleter_arg);
+            }
+
+            return join2_subtrees(left, left_subtree_height, right, right_subtree_height,
+                                  height, op.is_ranked);
+        }
+
+        std::abort();
+    }
+
+private:
+    AvlNode* sequential(SetOp &op, AvlNode *self, int self_height, AvlNode *other,
+                        int other_height, int *height) const {
+        switch (kind_) {
+        case SetOpKind::Union:
+            return union_subtrees(&op, self, self_height, other, other_height, height);
+        case SetOpKind::Intersection:
+            return intersect_subtrees(&op, self, self_height, other, other_height, height);
+        case SetOpKind::Difference:
+            return subtract_subtrees(&op, self, self_height, other, other_height, height);
+        }
+
+        std::abort();
+    }
+
+    AvlThreadPool &pool_;
+    SetOpKind kind_;
+    int grain_height_;
+};
+
+std::size_t par_set_op(AvlTree *self, AvlTree *other, AvlThreadPool *pool,
+                       std::size_t grain_size, SetOpKind kind) {
+    assert(self);
+    assert(other);
+    assert(self != other);
+    assert(pool);
+
+    SetOp op = make_set_op(*self, *other);
+    const ParallelSetOp par_op(*pool, kind, grain_height(grain_size));
+    int height;
+
+    self->root = par_op(op, self->root, subtree_height(self->root), other->root,
+                        subtree_height(other->root), &height);
+
+    other->root = nullptr;
+    other->len = 0;
+
+    return op.num_matched;
+}
+
+// same shape as build_balanced: the middle node is nodes[n / 2]
+AvlNode* par_build(AvlThreadPool &pool, AvlNode **nodes, std::size_t num_nodes,
+                   const AvlTree &proto, std::size_t grain_size) {
+    if (num_nodes <= grain_size) {
+        AvlTree chunk;
+        AvlTree_from_sorted(&chunk, nodes, num_nodes, proto.compare, proto.compare_arg,
+                            proto.deleter, proto.deleter_arg);
+
+        return chunk.root;
+    }
+
+    const std::size_t middle = num_nodes / 2;
+    AvlNode *const root = nodes[middle];
+
+    auto do_right = [&] {
+        root->right = par_build(pool, nodes + middle + 1, num_nodes - middle - 1, proto,
+                                grain_size);
+    };
+
+    auto do_left = [&] {
+        root->left = par_build(pool, nodes, middle, proto, grain_size);
+    };
+
+    pool.fork_join(do_right, do_left);
+    root->balance_factor = static_cast<signed char>(balanced_height(num_nodes - middle - 1)
+                                                    - balanced_height(middle));
+
+    return root;
+}
+
+} // namespace
+
+/**
+ *  Creates a thread pool.
+ *
+ *  Aborts if the pool or its threads could not be created.
+ *
+ *  @param num_threads The number of worker threads to start. If 0, one
+ *                     worker is started per hardware thread.
+ *  @returns A pool to be dropped with AvlThreadPool_drop.
+ */
+AvlThreadPool* AvlThreadPool_new(std::size_t num_threads) {
+    if (num_threads == 0) {
+        num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    try {
+        return new AvlThreadPool(num_threads);
+    } catch (const std::exception &e) {
+        std::fprintf(stderr, "AvlThreadPool_new: couldn't start %zu threads: %s\n",
+                     num_threads, e.what());
+        std::abort();
+    }
+}
+
+/**
+ *  Stops and frees a thread pool.
+ *
+ *  @param self May be NULL. No call using self may be in progress.
+ */
+void AvlThreadPool_drop(AvlThreadPool *self) {
+    delete self;
+}
+
+/**
+ *  Returns the number of worker threads in a thread pool.
+ *
+ *  @param self Must not be NULL.
+ */
+std::size_t AvlThreadPool_num_threads(const AvlThreadPool *self) {
+    assert(self);
+
+    return self->num_threads();
+}
+
+/**
+ *  Moves every node of an AvlTree into another AvlTree in parallel.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param other Must not be NULL. Must be initialized. Must form the
+ *               same ordering as self. Will be left empty.
+ *  @param pool Must not be NULL.
+ *  @param grain_size Subproblems covering about grain_size nodes or
+ *                    fewer of other run sequentially.
+ */
+void AvlTree_par_union(AvlTree *self, AvlTree *other, AvlThreadPool *pool,
+                       std::size_t grain_size) {
+    assert(self);
+    assert(other);
+
+    const std::size_t total = self->len + other->len;
+
+    self->len = total - par_set_op(self, other, pool, grain_size, SetOpKind::Union);
+}
+
+/**
+ *  Removes every node of an AvlTree that does not compare equal to a
+ *  node in another AvlTree in parallel.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param other Must not be NULL. Must be initialized. Must form the
+ *               same ordering as self. Will be left empty.
+ *  @param pool Must not be NULL.
+ *  @param grain_size Subproblems covering about grain_size nodes or
+ *                    fewer of other run sequentially.
+ */
+void AvlTree_par_intersection(AvlTree *self, AvlTree *other, AvlThreadPool *pool,
+                              std::size_t grain_size) {
+    self->len = par_set_op(self, other, pool, grain_size, SetOpKind::Intersection);
+}
+
+/**
+ *  Removes every node of an AvlTree that compares equal to a node in
+ *  another AvlTree in parallel.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param other Must not be NULL. Must be initialized. Must form the
+ *               same ordering as self. Will be left empty.
+ *  @param pool Must not be NULL.
+ *  @param grain_size Subproblems covering about grain_size nodes or
+ *                    fewer of other run sequentially.
+ */
+void AvlTree_par_difference(AvlTree *self, AvlTree *other, AvlThreadPool *pool,
+                            std::size_t grain_size) {
+    assert(self);
+
+    self->len -= par_set_op(self, other, pool, grain_size, SetOpKind::Difference);
+}
+
+/**
+ *  Initializes an AvlTree from an array of nodes in ascending order in
+ *  parallel.
+ *
+ *  @param self Must not be NULL. Must not be initialized.
+ *  @param nodes Must not be NULL if num_nodes > 0. Must be sorted in
+ *               strictly ascending order according to compare.
+ *  @param compare Must not be NULL.
+ *  @param deleter Must not be NULL.
+ *  @param pool Must not be NULL.
+ *  @param grain_size Ranges of grain_size nodes or fewer are built
+ *                    sequentially.
+ */
+void AvlTree_par_from_sorted(AvlTree *self, AvlNode **nodes, std::size_t num_nodes,
+                             AvlComparator compare, void *compare_arg,
+                             AvlDeleter deleter, void *deleter_arg,
+                             AvlThreadPool *pool, std::size_t grain_size) {
+    assert(self);
+    assert(nodes || num_nodes == 0);
+    assert(pool);
+
+#ifndef NDEBUG
+    for (std::size_t i = 1; i < num_nodes; ++i) {
+        assert(compare(nodes[i - 1], nodes[i], compare_arg) < 0);
+    }
+#endif
+
+    AvlTree_new(self, compare, compare_arg, deleter, deleter_arg);
+
+    grain_size = std::max(grain_size, static_cast<std::size_t>(1));
+    self->root = par_build(*pool, nodes, num_nodes, *self, grain_size);
+    self->len = num_nodes;
+}
@@ -0,0 +1,504 @@
+/*  MIT License
+ *
+ *  Copyright (c) 2019 Gregory Meyer
+ *
+ *  Permission is hereby granted, free of charge, to any person
+ *  obtaining a copy of this software and associated documentation
+ *  files (the "Software"), to deal in the Software without
+ *  restriction, including without limitation the rights to use, copy,
+ *  modify, merge, publish, distribute, sublicense, and/or sell copies
+ *  of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including
+ *  the next paragraph) shall be included in all copies or substantial
+ *  portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ *  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ *  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ *  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ *  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ */
+
+
+#include <bloodhound.h>
+
+#include "node.h"
+
+#include <assert.h>
+#include <stddef.h>
+
+static AvlNode* parent_of(const AvlNode *node);
+
+static void set_parent(AvlNode *node, AvlNode *parent);
+
+static void replace_child(AvlParentTree *self, AvlNode *parent, AvlNode *child,
+                          AvlNode *replacement);
+
+static AvlNode* rebalance(AvlParentTree *self, AvlNode *root);
+
+static void retrace_insert(AvlParentTree *self, AvlNode *node);
+
+static void retrace_remove(AvlParentTree *self, AvlNode *parent, int is_left);
+
+static AvlNode* leftmost(AvlNode *node);
+
+static AvlNode* rightmost(AvlNode *node);
+
+/**
+ *  Initializes an empty AvlParentTree.
+ *
+ *  @param self Must not be NULL. Must not be initialized.
+ *  @param compare Must not be NULL. Will be invoked to compare nodes
+ *                 by compare(lhs, rhs, compare_arg). Return values
+ *                 should have the same meaning as strcmp and should
+ *                 form a total ordering over the set of nodes.
+ *  @param deleter Must not be NULL. Will be used to free nodes when
+ *                 they are no longer usable by the tree as if by
+ *                 deleter(node, deleter_arg).
+ */
+void AvlParentTree_new(AvlParentTree *self, AvlComparator compare, void *compare_arg,
+                       AvlDeleter deleter, void *deleter_arg) {
+    assert(self);
+    assert(compare);
+    assert(deleter);
+
+    self->root = NULL;
+    self->len = 0;
+    self->compare = compare;
+    self->compare_arg = compare_arg;
+    self->deleter = deleter;
+    self->deleter_arg = deleter_arg;
+}
+
+/**
+ *  Drops an AvlParentTree, passing each of its nodes to the deleter.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ */
+void AvlParentTree_drop(AvlParentTree *self) {
+    assert(self);
+
+    delete_subtree(self->root, self->deleter, self->deleter_arg);
+    self->root = NULL;
+    self->len = 0;
+}
+
+/**
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlParentTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @returns The node member of the AvlParentNode that compares equal
+ *           to key, if there is one.
+ */
+const AvlNode* AvlParentTree_get(const AvlParentTree *self, const void *key,
+                                 AvlHetComparator compare, void *arg) {
+    const AvlNode *current;
+
+    assert(self);
+    assert(compare);
+
+    current = self->root;
+
+    while (current) {
+        const int ordering = compare(key, current, arg);
+
+        if (ordering == 0) {
+            break;
+        } else if (ordering < 0) {
+            current = current->left;
+        } else { /* ordering > 0 */
+            current = current->right;
+        }
+    }
+
+    return current;
+}
+
+/**
+ *  Inserts an element into an AvlParentTree.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param node Must not be NULL. Must be the node member of an
+ *              AvlParentNode.
+ *  @returns The previous element that compares equal to node, if there
+ *           was one. It is no longer in self.
+ */
+AvlNode* AvlParentTree_insert(AvlParentTree *self, AvlNode *node) {
+    AvlNode *parent = NULL;
+    AvlNode **slot;
+
+    assert(self);
+    assert(node);
+
+    for (slot = &self->root; *slot;) {
+        AvlNode *const current = *slot;
+        const int ordering = self->compare(node, current, self->compare_arg);
+
+        if (ordering == 0) {
+            node->left = current->left;
+            node->right = current->right;
+            node->balance_factor = current->balance_factor;
+            set_parent(node, parent);
+            set_parent(node->left, node);
+            set_parent(node->right, node);
+            *slot = node;
+
+            current->left = NULL;
+            current->right = NULL;
+            current->balance_factor = 0;
+            set_parent(current, NULL);
+
+            return current;
+        }
+
+        parent = current;
+        slot = (ordering < 0) ? &current->left : &current->right;
+    }
+
+    node->left = NULL;
+    node->right = NULL;
+    node->balance_factor = 0;
+    set_parent(node, parent);
+    *slot = node;
+    ++self->len;
+
+    retrace_insert(self, node);
+
+    return NULL;
+}
+
+/**
+ *  Removes the node that compares equal to a key.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlParentTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @returns The node that compared equal to key, if there was one.
+ */
+AvlNode* AvlParentTree_remove(AvlParentTree *self, const void *key, AvlHetComparator compare,
+                              void *arg) {
+    AvlNode *current;
+
+    assert(self);
+    assert(compare);
+
+    current = self->root;
+
+    while (current) {
+        const int ordering = compare(key, current, arg);
+
+        if (ordering == 0) {
+            AvlParentTree_remove_node(self, current);
+
+            return current;
+        }
+
+        current = (ordering < 0) ? current->left : current->right;
+    }
+
+    return NULL;
+}
+
+/**
+ *  Removes a node without searching for it.
+ *
+ *  Makes no comparisons. A node with two children is first swapped
+ *  with its successor, found by walking down its right subtree. The
+ *  tree is then retraced upward through parent links for as long as
+ *  balance factors change. Runs in O(log n) time in the worst case;
+ *  the rebalancing alone is amortized O(1) over a sequence of
+ *  removals.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param node Must not be NULL. Must be the node member of an
+ *              AvlParentNode in self.
+ */
+void AvlParentTree_remove_node(AvlParentTree *self, AvlNode *node) {
+    AvlNode *parent;
+
+    assert(self);
+    assert(node);
+    assert(self->len > 0);
+
+    parent = parent_of(node);
+
+    if (node->left && node->right) { /* the successor takes its place */
+        AvlNode *const successor = leftmost(node->right);
+        AvlNode *retrace_from;
+        int is_left;
+
+        if (successor == node->right) {
+            retrace_from = successor;
+            is_left = 0;
+        } else {
+            retrace_from = parent_of(successor);
+            is_left = 1;
+
+            retrace_from->left = successor->right;
+            set_parent(successor->right, retrace_from);
+            successor->right = node->right;
+            set_parent(successor->right, successor);
+        }
+
+        successor->left = node->left;
+        set_parent(successor->left, successor);
+        successor->balance_factor = node->balance_factor;
+        set_parent(successor, parent);
+        replace_child(self, parent, node, successor);
+
+        retrace_remove(self, retrace_from, is_left);
+    } else {
+        AvlNode *const child = node->left ? node->left : node->right;
+        const int is_left = parent && parent->left == node;
+
+        set_parent(child, parent);
+        replace_child(self, parent, node, child);
+
+        retrace_remove(self, parent, is_left);
+    }
+
+    --self->len;
+
+    node->left = NULL;
+    node->right = NULL;
+    node->balance_factor = 0;
+    set_parent(node, NULL);
+}
+
+/**
+ *  @param self Must not be NULL. Must be initialized.
+ *  @returns The least node of self, if it is not empty.
+ */
+const AvlNode* AvlParentTree_first(const AvlParentTree *self) {
+    assert(self);
+
+    return leftmost(self->root);
+}
+
+/**
+ *  @param self Must not be NULL. Must be initialized.
+ *  @returns The greatest node of self, if it is not empty.
+ */
+const AvlNode* AvlParentTree_last(const AvlParentTree *self) {
+    assert(self);
+
+    return rightmost(self->root);
+}
+
+/**
+ *  Finds the next node in order without a stack.
+ *
+ *  Runs in O(1) amortized time over a traversal of the whole tree.
+ *
+ *  @param self Must not be NULL. Must be the node member of an
+ *              AvlParentNode in an AvlParentTree.
+ *  @returns The least node that compares greater than self, if there
+ *           is one.
+ */
+const AvlNode* AvlParentNode_next(const AvlNode *self) {
+    const AvlNode *parent;
+
+    assert(self);
+
+    if (self->right) {
+        return leftmost(self->right);
+    }
+
+    for (parent = parent_of(self); parent && parent->right == self;
+         parent = parent_of(parent)) {
+        self = parent;
+    }
+
+    return parent;
+}
+
+/**
+ *  Finds the previous node in order without a stack.
+ *
+ *  Runs in O(1) amortized time over a traversal of the whole tree.
+ *
+ *  @param self Must not be NULL. Must be the node member of an
+ *              AvlParentNode in an AvlParentTree.
+ *  @returns The greatest node that compares less than self, if there
+ *           is one.
+ */
+const AvlNode* AvlParentNode_prev(const AvlNode *self) {
+    const AvlNode *parent;
+
+    assert(self);
+
+    if (self->left) {
+        return rightmost(self->left);
+    }
+
+    for (parent = parent_of(self); parent && parent->left == self;
+         parent = parent_of(parent)) {
+        self = parent;
+    }
+
+    return parent;
+}
+
+static AvlNode* parent_of(const AvlNode *node) {
+    assert(node);
+
+    return ((const AvlParentNode*) node)->parent;
+}
+
+static void set_parent(AvlNode *node, AvlNode *parent) {
+    if (node) {
+        ((AvlParentNode*) node)->parent = parent;
+    }
+}
+
+/* points the link that reached child, or the root if it has no parent, at replacement */
+static void replace_child(AvlParentTree *self, AvlNode *parent, AvlNode *child,
+                          AvlNode *replacement) {
+    assert(self);
+
+    if (!parent) {
+        self->root = replacement;
+    } else if (parent->left == child) {
+        parent->left = replacement;
+    } else {
+        assert(parent->right == child);
+
+        parent->right = replacement;
+    }
+}
+
+/*
+ *  Rotates a subtree whose root has a balance factor of 2 or -2 and
+ *  links the result to root's parent. A rotation only moves nodes in
+ *  the top three levels of the subtree, so those are all that need
+ *  their parent links fixed.
+ */
+static AvlNode* rebalance(AvlParentTree *self, AvlNode *root) {
+    AvlNode *const parent = parent_of(root);
+    AvlNode *new_root;
+
+    assert(self);
+
+    if (root->balance_factor == 2) {
+        if (root->right->balance_factor < 0) {
+            root->right = rotate_right_any(root->right);
+        }
+
+        new_root = rotate_left_any(root);
+    } else {
+        assert(root->balance_factor == -2);
+
+        if (root->left->balance_factor > 0) {
+            root->left = rotate_left_any(root->left);
+        }
+
+        new_root = rotate_right_any(root);
+    }
+
+    set_parent(new_root, parent);
+    replace_child(self, parent, root, new_root);
+
+    set_parent(new_root->left, new_root);
+    set_parent(new_root->right, new_root);
+
+    if (new_root->left) {
+        set_parent(new_root->left->left, new_root->left);
+        set_parent(new_root->left->right, new_root->left);
+    }
+
+    if (new_root->right) {
+        set_parent(new_root->right->left, new_root->right);
+        set_parent(new_root->right->right, new_root->right);
+    }
+
+    return new_root;
+}
+
+/* walks up from a new leaf until a subtree's height stops growing */
+static void retrace_insert(AvlParentTree *self, AvlNode *node) {
+    AvlNode *parent;
+
+    assert(self);
+    assert(node);
+
+    for (parent = parent_of(node); parent; node = parent, parent = parent_of(parent)) {
+        if (parent->left == node) {
+            --parent->balance_factor;
+        } else {
+            ++parent->balance_factor;
+        }
+
+        if (parent->balance_factor == 0) {
+            return;
+        } else if (parent->balance_factor == 2 || parent->balance_factor == -2) {
+            rebalance(self, parent); /* restores the height from before the insertion */
+
+            return;
+        }
+    }
+}
+
+/*
+ *  Walks up from the parent of a removed node until a subtree's height
+ *  stops shrinking. is_left is nonzero if the removal was from the
+ *  left subtree of parent.
+ */
+static void retrace_remove(AvlParentTree *self, AvlNode *parent, int is_left) {
+    assert(self);
+
+    while (parent) {
+        AvlNode *const grandparent = parent_of(parent);
+        const int parent_is_left = grandparent && grandparent->left == parent;
+
+        if (is_left) {
+            ++parent->balance_factor;
+        } else {
+            --parent->balance_factor;
+        }
+
+        if (parent->balance_factor == 1 || parent->balance_factor == -1) {
+            return; /* this subtree is as tall as before */
+        } else if (parent->balance_factor != 0) {
+            /* a rotation around a child with a balance factor of 0 keeps the height */
+            if (rebalance(self, parent)->balance_factor != 0) {
+                return;
+            }
+        }
+
+        parent = grandparent;
+        is_left = parent_is_left;
+    }
+}
+
+static AvlNode* leftmost(AvlNode *node) {
+    if (!node) {
+        return NULL;
+    }
+
+    while (node->left) {
+        node = node->left;
+    }
+
+    return node;
+}
+
+static AvlNode* rightmost(AvlNode *node) {
+    if (!node) {
+        return NULL;
+    }
+
+    while (node->right) {
+        node = node->right;
+    }
+
+    return node;
+}
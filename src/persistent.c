@@ -0,0 +1,514 @@
+/*  MIT License
+ *
+ *  Copyright (c) 2019 Gregory Meyer
+ *
+ *  Permission is hereby granted, free of charge, to any person
+ *  obtaining a copy of this software and associated documentation
+ *  files (the "Software"), to deal in the Software without
+ *  restriction, including without limitation the rights to use, copy,
+ *  modify, merge, publish, distribute, sublicense, and/or sell copies
+ *  of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including
+ *  the next paragraph) shall be included in all copies or substantial
+ *  portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ *  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ *  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ *  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ *  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ */
+
+#include <bloodhound.h>
+
+#include "node.h"
+
+#include <assert.h>
+#include <stddef.h>
+
+/* reference counts may be shared between threads that own different
+ * versions, so use atomics where the compiler provides them */
+#ifdef __GNUC__
+#define LOAD_REFCOUNT(P) __atomic_load_n((P), __ATOMIC_ACQUIRE)
+#define INCREMENT_REFCOUNT(P) ((void) __atomic_add_fetch((P), 1, __ATOMIC_RELAXED))
+#define DECREMENT_REFCOUNT(P) __atomic_sub_fetch((P), 1, __ATOMIC_ACQ_REL)
+#else
+#define LOAD_REFCOUNT(P) (*(P))
+#define INCREMENT_REFCOUNT(P) ((void) ++*(P))
+#define DECREMENT_REFCOUNT(P) (--*(P))
+#endif
+
+static size_t* refcount_of(AvlNode *node);
+
+static void retain(AvlNode *node);
+
+static void release(AvlPersistentTree *self, AvlNode *node);
+
+static AvlNode* unshare(AvlPersistentTree *self, AvlNode *node);
+
+static void unshare_path(AvlPersistentTree *self, AvlNode **path, const unsigned char *is_right,
+                         size_t depth);
+
+static void set_child(AvlPersistentTree *self, AvlNode *const *path,
+                      const unsigned char *is_right, size_t depth, AvlNode *child);
+
+static AvlNode* rebalance(AvlPersistentTree *self, AvlNode *root);
+
+/**
+ *  Initializes an empty AvlPersistentTree.
+ *
+ *  @param self Must not be NULL. Must not be initialized.
+ *  @param compare Must not be NULL. Will be invoked to compare nodes
+ *                 by compare(lhs, rhs, compare_arg). Return values
+ *                 should have the same meaning as strcmp and should
+ *                 form a total ordering over the set of nodes.
+ *  @param clone Must not be NULL. Will be invoked to copy a node that
+ *               is shared with another version before changing its
+ *               links as if by clone(node, clone_arg). Must return the
+ *               node member of a new AvlPersistentNode whose element
+ *               compares equal to node. Its links are overwritten.
+ *  @param deleter Must not be NULL. Will be used to free nodes when
+ *                 no version reaches them any more as if by
+ *                 deleter(node, deleter_arg).
+ */
+void AvlPersistentTree_new(AvlPersistentTree *self, AvlComparator compare, void *compare_arg,
+                           AvlCloner clone, void *clone_arg, AvlDeleter deleter,
+                           void *deleter_arg) {
+    assert(self);
+    assert(compare);
+    assert(clone);
+    assert(deleter);
+
+    self->root = NULL;
+    self->len = 0;
+    self->compare = compare;
+    self->compare_arg = compare_arg;
+    self->clone = clone;
+    self->clone_arg = clone_arg;
+    self->deleter = deleter;
+    self->deleter_arg = deleter_arg;
+}
+
+/**
+ *  Makes a new version of an AvlPersistentTree that shares every node
+ *  with it.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param snapshot Must not be NULL. Must not be initialized.
+ */
+void AvlPersistentTree_snapshot(const AvlPersistentTree *self, AvlPersistentTree *snapshot) {
+    assert(self);
+    assert(snapshot);
+    assert(self != snapshot);
+
+    *snapshot = *self;
+    retain(self->root);
+}
+
+/**
+ *  Drops a version of an AvlPersistentTree, passing each node that no
+ *  other version reaches to the deleter.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ */
+void AvlPersistentTree_drop(AvlPersistentTree *self) {
+    assert(self);
+
+    release(self, self->root);
+    self->root = NULL;
+    self->len = 0;
+}
+
+/**
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlPersistentTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @returns A pointer to the node that compares equal to key, if
+ *           there is one.
+ */
+const AvlNode* AvlPersistentTree_get(const AvlPersistentTree *self, const void *key,
+                                     AvlHetComparator compare, void *arg) {
+    const AvlNode *current;
+
+    assert(self);
+    assert(compare);
+
+    current = self->root;
+
+    while (current) {
+        const int ordering = compare(key, current, arg);
+
+        if (ordering < 0) {
+            current = current->left;
+        } else if (ordering > 0) {
+            current = current->right;
+        } else {
+            break;
+        }
+    }
+
+    return current;
+}
+
+/**
+ *  Inserts a node into a version of an AvlPersistentTree or replaces
+ *  the node that compares equal to it.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param node Must not be NULL. Must be the node member of an
+ *              AvlPersistentNode that is in no tree.
+ *  @returns Nonzero if a node was replaced.
+ */
+int AvlPersistentTree_insert(AvlPersistentTree *self, AvlNode *node) {
+    AvlNode *path[AVL_MAX_HEIGHT];
+    unsigned char is_right[AVL_MAX_HEIGHT];
+    size_t depth = 0;
+    AvlNode *current;
+
+    assert(self);
+    assert(node);
+
+    *refcount_of(node) = 1;
+    current = self->root;
+
+    while (current) {
+        const int ordering = self->compare(node, current, self->compare_arg);
+
+        if (ordering == 0) {
+            break;
+        }
+
+        assert(depth < AVL_MAX_HEIGHT);
+        path[depth] = current;
+        is_right[depth] = (unsigned char) (ordering > 0);
+        ++depth;
+
+        if (ordering < 0) {
+            current = current->left;
+        } else {
+            current = current->right;
+        }
+    }
+
+    unshare_path(self, path, is_right, depth);
+
+    if (current) { /* node shares the children of current, which may live on elsewhere */
+        node->left = current->left;
+        node->right = current->right;
+        node->balance_factor = current->balance_factor;
+        retain(node->left);
+        retain(node->right);
+        set_child(self, path, is_right, depth, node);
+        release(self, current);
+
+        return 1;
+    }
+
+    node->left = NULL;
+    node->right = NULL;
+    node->balance_factor = 0;
+    set_child(self, path, is_right, depth, node);
+    ++self->len;
+
+    /* walk back up until a subtree's height stops changing */
+    while (depth > 0) {
+        AvlNode *parent;
+
+        --depth;
+        parent = path[depth];
+        parent->balance_factor =
+            (signed char) (parent->balance_factor + (is_right[depth] ? 1 : -1));
+
+        if (parent->balance_factor == 2 || parent->balance_factor == -2) {
+            set_child(self, path, is_right, depth, rebalance(self, parent));
+
+            break;
+        }
+
+        if (parent->balance_factor == 0) {
+            break;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ *  Removes the node of a version of an AvlPersistentTree that compares
+ *  equal to a key.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlPersistentTree_new. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @returns Nonzero if a node was removed.
+ */
+int AvlPersistentTree_remove(AvlPersistentTree *self, const void *key,
+                             AvlHetComparator compare, void *arg) {
+    AvlNode *path[AVL_MAX_HEIGHT];
+    unsigned char is_right[AVL_MAX_HEIGHT];
+    size_t depth = 0;
+    AvlNode *target;
+
+    assert(self);
+    assert(compare);
+
+    target = self->root;
+
+    while (target) {
+        const int ordering = compare(key, target, arg);
+
+        if (ordering == 0) {
+            break;
+        }
+
+        assert(depth < AVL_MAX_HEIGHT);
+        path[depth] = target;
+        is_right[depth] = (unsigned char) (ordering > 0);
+        ++depth;
+
+        if (ordering < 0) {
+            target = target->left;
+        } else {
+            target = target->right;
+        }
+    }
+
+    if (!target) { /* nothing was copied */
+        return 0;
+    }
+
+    if (!target->left || !target->right) {
+        AvlNode *const child = target->left ? target->left : target->right;
+
+        /* target itself isn't changed, so it need not be copied */
+        unshare_path(self, path, is_right, depth);
+        retain(child);
+        set_child(self, path, is_right, depth, child);
+        release(self, target);
+    } else { /* the in-order successor moves into target's position */
+        const size_t target_depth = depth;
+        AvlNode *successor;
+
+        path[depth] = target;
+        is_right[depth] = 1;
+        ++depth;
+        successor = target->right;
+
+        while (successor) {
+            assert(depth < AVL_MAX_HEIGHT);
+            path[depth] = successor;
+            is_right[depth] = 0;
+            ++depth;
+            successor = successor->left;
+        }
+
+        /* target's right link changes, so it is copied if shared */
+        unshare_path(self, path, is_right, depth);
+        target = path[target_depth];
+        successor = path[--depth];
+        set_child(self, path, is_right, depth, successor->right);
+
+        successor->left = target->left;
+        successor->right = target->right;
+        successor->balance_factor = target->balance_factor;
+        set_child(self, path, is_right, target_depth, successor);
+        path[target_depth] = successor;
+
+        /* the links of target were moved to successor */
+        target->left = NULL;
+        target->right = NULL;
+        release(self, target);
+    }
+
+    --self->len;
+
+    /* walk back up until a subtree's height stops changing */
+    while (depth > 0) {
+        AvlNode *parent;
+
+        --depth;
+        parent = path[depth];
+        parent->balance_factor =
+            (signed char) (parent->balance_factor + (is_right[depth] ? -1 : 1));
+
+        if (parent->balance_factor == 2 || parent->balance_factor == -2) {
+            AvlNode *const new_root = rebalance(self, parent);
+
+            set_child(self, path, is_right, depth, new_root);
+
+            if (new_root->balance_factor != 0) {
+                break;
+            }
+        } else if (parent->balance_factor != 0) {
+            break;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ *  Traverses a version of an AvlPersistentTree in-order.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param traverse Must not be NULL.
+ */
+void AvlPersistentTree_traverse(const AvlPersistentTree *self, AvlTraverseCb traverse,
+                                void *arg) {
+    const AvlNode *stack[AVL_MAX_HEIGHT];
+    size_t stack_len = 0;
+    const AvlNode *current;
+
+    assert(self);
+    assert(traverse);
+
+    current = self->root;
+
+    while (current || stack_len > 0) {
+        while (current) {
+            assert(stack_len < AVL_MAX_HEIGHT);
+            stack[stack_len++] = current;
+            current = current->left;
+        }
+
+        current = stack[--stack_len];
+        traverse(arg, current);
+        current = current->right;
+    }
+}
+
+static size_t* refcount_of(AvlNode *node) {
+    assert(node);
+
+    return &((AvlPersistentNode*) node)->refcount;
+}
+
+/* adds a reference from a new link or version */
+static void retain(AvlNode *node) {
+    if (node) {
+        INCREMENT_REFCOUNT(refcount_of(node));
+    }
+}
+
+/* drops a reference, freeing node and releasing its children if it was
+ * the last one */
+static void release(AvlPersistentTree *self, AvlNode *node) {
+    while (node && DECREMENT_REFCOUNT(refcount_of(node)) == 0) {
+        AvlNode *const left = node->left;
+        AvlNode *const right = node->right;
+
+        self->deleter(node, self->deleter_arg);
+        release(self, left);
+        node = right;
+    }
+}
+
+/**
+ *  Returns a node that only the link it was reached through refers to.
+ *
+ *  The caller must store the returned node in that link, whose owner
+ *  must already be unshared.
+ */
+static AvlNode* unshare(AvlPersistentTree *self, AvlNode *node) {
+    AvlNode *copy;
+
+    assert(self);
+    assert(node);
+
+    if (LOAD_REFCOUNT(refcount_of(node)) == 1) {
+        return node;
+    }
+
+    copy = self->clone(node, self->clone_arg);
+    assert(copy);
+
+    copy->left = node->left;
+    copy->right = node->right;
+    copy->balance_factor = node->balance_factor;
+    *refcount_of(copy) = 1;
+    retain(copy->left);
+    retain(copy->right);
+    release(self, node);
+
+    return copy;
+}
+
+/* unshares path[0] through path[depth - 1], relinking each copy */
+static void unshare_path(AvlPersistentTree *self, AvlNode **path, const unsigned char *is_right,
+                         size_t depth) {
+    size_t i;
+
+    assert(self);
+
+    for (i = 0; i < depth; ++i) {
+        AvlNode *const node = unshare(self, path[i]);
+
+        if (node != path[i]) {
+            path[i] = node;
+            set_child(self, path, is_right, i, node);
+        }
+    }
+}
+
+/* points the link to path[depth] at child; depth 0 is the root */
+static void set_child(AvlPersistentTree *self, AvlNode *const *path,
+                      const unsigned char *is_right, size_t depth, AvlNode *child) {
+    assert(self);
+
+    if (depth == 0) {
+        self->root = child;
+    } else if (is_right[depth - 1]) {
+        path[depth - 1]->right = child;
+    } else {
+        path[depth - 1]->left = child;
+    }
+}
+
+/**
+ *  Restores the AVL condition at an unshared node whose subtrees
+ *  differ in height by two.
+ *
+ *  The children that are rotated are unshared first; on insertion they
+ *  are on the path and already are, but on removal the taller side is
+ *  the sibling of the path.
+ *
+ *  @returns The new root of the subtree.
+ */
+static AvlNode* rebalance(AvlPersistentTree *self, AvlNode *root) {
+    assert(self);
+    assert(root);
+
+    if (root->balance_factor == 2) {
+        AvlNode *const right = unshare(self, root->right);
+
+        root->right = right;
+
+        if (right->balance_factor < 0) {
+            right->left = unshare(self, right->left);
+            root->right = rotate_right_any(right);
+        }
+
+        return rotate_left_any(root);
+    } else {
+        AvlNode *const left = unshare(self, root->left);
+
+        assert(root->balance_factor == -2);
+        root->left = left;
+
+        if (left->balance_factor > 0) {
+            left->right = unshare(self, left->right);
+            root->left = rotate_left_any(left);
+        }
+
+        return rotate_right_any(root);
+    }
+}
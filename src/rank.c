@@ -0,0 +1,131 @@
+/*  MIT License
+ *
+ *  Copyright (c) 2019 Gregory Meyer
+ *
+ *  Permission is hereby granted, free of charge, to any person
+ *  obtaining a copy of this software and associated documentation
+ *  files (the "Software"), to deal in the Software without
+ *  restriction, including without limitation the rights to use, copy,
+ *  modify, merge, publish, distribute, sublicense, and/or sell copies
+ *  of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including
+ *  the next paragraph) shall be included in all copies or substantial
+ *  portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ *  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ *  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ *  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ *  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ */
+
+#include <bloodhound.h>
+
+#include "node.h"
+
+#include <assert.h>
+#include <stddef.h>
+
+static AvlNode* select_node(AvlNode *root, size_t index);
+
+/**
+ *  Finds the node with a given position in the in-order sequence of a
+ *  ranked AvlTree.
+ *
+ *  @param self Must not be NULL. Must be initialized by
+ *              AvlTree_new_ranked or AvlTree_from_sorted_ranked.
+ *  @param index The number of nodes that compare less than the node to
+ *               find.
+ *  @returns A pointer to the node, or NULL if index >= self->len.
+ */
+const AvlNode* AvlTree_select(const AvlTree *self, size_t index) {
+    assert(self);
+    assert(self->is_ranked);
+
+    return select_node(self->root, index);
+}
+
+/**
+ *  Finds the node with a given position in the in-order sequence of a
+ *  ranked AvlTree.
+ *
+ *  @param self Must not be NULL. Must be initialized by
+ *              AvlTree_new_ranked or AvlTree_from_sorted_ranked.
+ *  @param index The number of nodes that compare less than the node to
+ *               find.
+ *  @returns A mutable pointer to the node, or NULL if
+ *           index >= self->len.
+ */
+AvlNode* AvlTree_select_mut(AvlTree *self, size_t index) {
+    assert(self);
+    assert(self->is_ranked);
+
+    return select_node(self->root, index);
+}
+
+/**
+ *  Counts the nodes of a ranked AvlTree that compare less than a key.
+ *
+ *  @param self Must not be NULL. Must be initialized by
+ *              AvlTree_new_ranked or AvlTree_from_sorted_ranked.
+ *  @param compare Must not be NULL. Must form the same total ordering
+ *                 over the contained elements as the one formed by one
+ *                 passed to AvlTree_new_ranked. Will be invoked by
+ *                 compare(key, node, arg).
+ *  @returns The number of nodes that compare less than key.
+ */
+size_t AvlTree_rank(const AvlTree *self, const void *key, AvlHetComparator compare, void *arg) {
+    const AvlNode *current;
+    size_t rank = 0;
+
+    assert(self);
+    assert(self->is_ranked);
+    assert(compare);
+
+    current = self->root;
+
+    while (current) {
+        const int ordering = compare(key, current, arg);
+
+        if (ordering == 0) {
+            return rank + rank_size(current->left);
+        } else if (ordering < 0) {
+            current = current->left;
+        } else { /* current and its left subtree are all less than key */
+            rank += rank_size(current->left) + 1;
+            current = current->right;
+        }
+    }
+
+    return rank;
+}
+
+static AvlNode* select_node(AvlNode *root, size_t index) {
+    AvlNode *current = root;
+
+    if (index >= rank_size(root)) {
+        return NULL;
+    }
+
+    while (current) {
+        const size_t left_size = rank_size(current->left);
+
+        if (index < left_size) {
+            current = current->left;
+        } else if (index == left_size) {
+            return current;
+        } else {
+            index -= left_size + 1;
+            current = current->right;
+        }
+    }
+
+    assert(0 && "subtree sizes are inconsistent");
+
+    return NULL;
+}
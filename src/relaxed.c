@@ -0,0 +1,258 @@
+/*  MIT License
+ *
+ *  Copyright (c) 2019 Gregory Meyer
+ *
+ *  Permission is hereby granted, free of charge, to any person
+ *  obtaining a copy of this software and associated documentation
+ *  files (the "Software"), to deal in the Software without
+ *  restriction, including without limitation the rights to use, copy,
+ *  modify, merge, publish, distribute, sublicense, and/or sell copies
+ *  of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including
+ *  the next paragraph) shall be included in all copies or substantial
+ *  portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ *  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ *  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ *  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ *  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ */
+
+
+#include <bloodhound.h>
+
+#include "join.h"
+#include "relaxed.h"
+#include "stats.h"
+
+#include <assert.h>
+#include <stddef.h>
+
+static AvlNode* repair_subtree(AvlNode *root, int *height, size_t *budget, int is_ranked);
+
+/**
+ *  Makes AvlTree_insert and AvlTree_remove defer rebalancing.
+ *
+ *  A relaxed write only links or unlinks its node and marks the nodes
+ *  above it as stale, so it does a search and a few stores but never
+ *  rotates or retraces. Lookups and cursors stay correct and only get
+ *  slower as the tree drifts out of balance, but no other function may
+ *  modify self, and AvlTree_select and AvlTree_rank may be wrong, until
+ *  it is repaired by AvlTree_rebalance_step or AvlTree_rebalance. A
+ *  write that would make self too tall for an AvlCursor repairs it
+ *  first.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ */
+void AvlTree_relax(AvlTree *self) {
+    assert(self);
+
+    self->is_relaxed = 1;
+}
+
+/**
+ *  Repairs some of the nodes made stale by relaxed writes.
+ *
+ *  Stale nodes are repaired from the bottom up by joining their
+ *  already balanced subtrees, so each takes O(log n) time and a call
+ *  takes O(budget log n) time. self stays relaxed.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param budget The most stale nodes to repair.
+ *  @returns Nonzero if self is balanced.
+ */
+int AvlTree_rebalance_step(AvlTree *self, size_t budget) {
+    int height;
+
+    assert(self);
+
+    self->root = repair_subtree(self->root, &height, &budget, self->is_ranked);
+
+    return !IS_STALE(self->root);
+}
+
+/**
+ *  Repairs every node made stale by relaxed writes and makes later
+ *  writes rebalance as usual.
+ *
+ *  Takes O(k log n) time, where k is the number of nodes on the paths
+ *  written to since self was last balanced.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ */
+void AvlTree_rebalance(AvlTree *self) {
+    assert(self);
+
+    AvlTree_rebalance_step(self, (size_t) -1);
+    self->is_relaxed = 0;
+}
+
+int relaxed_insert(AvlTree *self, AvlNode *node, AvlNode **previous) {
+    AvlNode **slot = &self->root;
+    size_t depth = 0;
+
+    assert(self);
+    assert(self->is_relaxed);
+    assert(node);
+    assert(previous);
+
+    while (*slot) {
+        AvlNode *const current = *slot;
+        int ordering;
+
+        /* node would end up deeper than an AvlCursor can reach */
+        if (depth + 1 == AVL_MAX_HEIGHT) {
+            STATS_SEARCH(WRITE_STATS(self), depth);
+            AvlTree_rebalance_step(self, (size_t) -1);
+
+            return 0;
+        }
+
+        ordering = self->compare(node, current, self->compare_arg);
+        ++depth;
+
+        if (ordering == 0) {
+            STATS_SEARCH(WRITE_STATS(self), depth);
+
+            node->left = current->left;
+            node->right = current->right;
+            node->balance_factor = current->balance_factor;
+
+            if (self->is_ranked) {
+                ((AvlRankNode*) node)->size = ((AvlRankNode*) current)->size;
+            }
+
+            current->left = NULL;
+            current->right = NULL;
+            current->balance_factor = 0;
+
+            *slot = node;
+            *previous = current;
+
+            return 1;
+        }
+
+        current->balance_factor = STALE_BALANCE_FACTOR;
+        slot = (ordering < 0) ? &current->left : &current->right;
+    }
+
+    STATS_SEARCH(WRITE_STATS(self), depth);
+
+    node->left = NULL;
+    node->right = NULL;
+    node->balance_factor = 0;
+
+    if (self->is_ranked) {
+        ((AvlRankNode*) node)->size = 1;
+    }
+
+    *slot = node;
+    *previous = NULL;
+    ++self->len;
+
+    return 1;
+}
+
+AvlNode* relaxed_remove(AvlTree *self, const void *key, AvlHetComparator compare, void *arg) {
+    AvlNode **slot = &self->root;
+    AvlNode *removed;
+    size_t depth = 0;
+
+    assert(self);
+    assert(self->is_relaxed);
+    assert(compare);
+
+    while (*slot) {
+        AvlNode *const current = *slot;
+        const int ordering = compare(key, current, arg);
+
+        ++depth;
+
+        if (ordering == 0) {
+            break;
+        }
+
+        current->balance_factor = STALE_BALANCE_FACTOR;
+        slot = (ordering < 0) ? &current->left : &current->right;
+    }
+
+    STATS_SEARCH(WRITE_STATS(self), depth);
+    removed = *slot;
+
+    if (!removed) {
+        return NULL;
+    }
+
+    if (!removed->left) {
+        *slot = removed->right;
+    } else if (!removed->right) {
+        *slot = removed->left;
+    } else {
+        AvlNode **successor_slot = &removed->right;
+        AvlNode *successor;
+
+        while ((*successor_slot)->left) {
+            (*successor_slot)->balance_factor = STALE_BALANCE_FACTOR;
+            successor_slot = &(*successor_slot)->left;
+        }
+
+        successor = *successor_slot;
+        *successor_slot = successor->right;
+
+        successor->left = removed->left;
+        successor->right = removed->right;
+        successor->balance_factor = STALE_BALANCE_FACTOR;
+        *slot = successor;
+    }
+
+    removed->left = NULL;
+    removed->right = NULL;
+    removed->balance_factor = 0;
+    --self->len;
+
+    return removed;
+}
+
+/*
+ *  Every stale node is on a path from the root, so the stale nodes
+ *  form a subtree at the top of the tree and everything below it is
+ *  still balanced. Sets *height to -1 if the budget ran out before root
+ *  could be repaired.
+ */
+static AvlNode* repair_subtree(AvlNode *root, int *height, size_t *budget, int is_ranked) {
+    int left_height;
+    int right_height;
+
+    assert(height);
+    assert(budget);
+
+    if (!IS_STALE(root)) {
+        *height = subtree_height(root);
+
+        return root;
+    } else if (*budget == 0) {
+        *height = -1;
+
+        return root;
+    }
+
+    root->left = repair_subtree(root->left, &left_height, budget, is_ranked);
+    root->right = repair_subtree(root->right, &right_height, budget, is_ranked);
+
+    if (left_height < 0 || right_height < 0 || *budget == 0) {
+        *height = -1;
+
+        return root;
+    }
+
+    --*budget;
+
+    return join_subtrees(root->left, left_height, root, root->right, right_height, height,
+                         is_ranked);
+}
@@ -0,0 +1,71 @@
+/*  MIT License
+ *
+ *  Copyright (c) 2019 Gregory Meyer
+ *
+ *  Permission is hereby granted, free of charge, to any person
+ *  obtaining a copy of this software and associated documentation
+ *  files (the "Software"), to deal in the Software without
+ *  restriction, including without limitation the rights to use, copy,
+ *  modify, merge, publish, distribute, sublicense, and/or sell copies
+ *  of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including
+ *  the next paragraph) shall be included in all copies or substantial
+ *  portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ *  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ *  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ *  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ *  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ */
+
+
+#ifndef BLOODHOUND_IMPL_RELAXED_H
+#define BLOODHOUND_IMPL_RELAXED_H
+
+#include <bloodhound.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* the balance factor of a node whose subtree was changed by a relaxed write */
+#define STALE_BALANCE_FACTOR 2
+
+/* nonzero if ROOT, and so the tree it is the root of, needs repair */
+#define IS_STALE(ROOT) ((ROOT) && (ROOT)->balance_factor == STALE_BALANCE_FACTOR)
+
+/**
+ *  Inserts or replaces a node without rebalancing, marking every node
+ *  on the path to it as stale.
+ *
+ *  @param self Must not be NULL. Must be relaxed.
+ *  @param node Must not be NULL.
+ *  @param previous Must not be NULL. Will be set to the node that was
+ *                  replaced, if there was one.
+ *  @returns Zero if node would have been too deep for an AvlCursor, in
+ *           which case self was fully repaired and node must be
+ *           inserted as usual.
+ */
+int relaxed_insert(AvlTree *self, AvlNode *node, AvlNode **previous);
+
+/**
+ *  Removes the node that compares equal to a key without rebalancing,
+ *  marking every node on the path to it as stale.
+ *
+ *  @param self Must not be NULL. Must be relaxed.
+ *  @param compare Must not be NULL.
+ *  @returns The node that compared equal to key, if there was one.
+ */
+AvlNode* relaxed_remove(AvlTree *self, const void *key, AvlHetComparator compare, void *arg);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif
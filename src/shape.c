@@ -0,0 +1,157 @@
+/*  MIT License
+ *
+ *  Copyright (c) 2019 Gregory Meyer
+ *
+ *  Permission is hereby granted, free of charge, to any person
+ *  obtaining a copy of this software and associated documentation
+ *  files (the "Software"), to deal in the Software without
+ *  restriction, including without limitation the rights to use, copy,
+ *  modify, merge, publish, distribute, sublicense, and/or sell copies
+ *  of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including
+ *  the next paragraph) shall be included in all copies or substantial
+ *  portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ *  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ *  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ *  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ *  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ */
+
+
+#include <bloodhound.h>
+
+#include "mem.h"
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ *  Sizes the layout counts of AvlShapeReport assume; the common case
+ *  on x86-64 and AArch64. Nodes are classified by the address of their
+ *  AvlNode, since that is the part every search step reads.
+ */
+#define SHAPE_CACHE_LINE_SIZE ((size_t) 64)
+#define SHAPE_PAGE_SIZE ((size_t) 4096)
+
+static double min_mean_depth(size_t len);
+
+static int compare_sizes(const void *lhs_v, const void *rhs_v);
+
+/**
+ *  Measures the shape and memory layout of an AvlTree.
+ *
+ *  Visits every node once, so it runs in O(n log n) time (to count the
+ *  cache lines nodes occupy) and should not be used on hot paths. Only
+ *  node addresses are read; node contents are never dereferenced past
+ *  their AvlNode member. Relaxed trees are measured as they are.
+ *  Scratch space comes from the allocator of self.
+ *
+ *  @param self Must not be NULL. Must be initialized.
+ *  @param report Must not be NULL. Will be set to the shape of self.
+ */
+void AvlTree_shape_report(const AvlTree *self, AvlShapeReport *report) {
+    AvlCursor cursor;
+    size_t *lines = NULL;
+    size_t num_nodes = 0;
+
+    assert(self);
+    assert(report);
+
+    memset(report, 0, sizeof(*report));
+    report->cache_line_size = SHAPE_CACHE_LINE_SIZE;
+    report->page_size = SHAPE_PAGE_SIZE;
+
+    if (self->len > 0) {
+        lines = (size_t*) allocator_malloc(self->allocator, self->len * sizeof(size_t));
+    }
+
+    /* cursor paths run from the root, so their length is the depth */
+    for (AvlCursor_first(&cursor, self); AvlCursor_get(&cursor); AvlCursor_next(&cursor)) {
+        const size_t depth = cursor.len;
+        const size_t address = (size_t) cursor.path[depth - 1];
+        const size_t line = address / SHAPE_CACHE_LINE_SIZE;
+
+        assert(num_nodes < self->len);
+        lines[num_nodes++] = line;
+        ++report->depth_histogram[depth - 1];
+        report->total_depth += depth;
+
+        if ((int) depth > report->height) {
+            report->height = (int) depth;
+        }
+
+        if ((address + sizeof(AvlNode) - 1) / SHAPE_CACHE_LINE_SIZE != line) {
+            ++report->num_straddling_nodes;
+        }
+
+        if (depth > 1) {
+            const size_t parent = (size_t) cursor.path[depth - 2];
+
+            ++report->num_links;
+
+            if (parent / SHAPE_CACHE_LINE_SIZE == line) {
+                ++report->num_same_line_links;
+            }
+
+            if (parent / SHAPE_PAGE_SIZE == address / SHAPE_PAGE_SIZE) {
+                ++report->num_same_page_links;
+            }
+        }
+    }
+
+    assert(num_nodes == self->len);
+    report->len = num_nodes;
+
+    if (num_nodes > 0) {
+        size_t i;
+
+        report->mean_depth = (double) report->total_depth / (double) num_nodes;
+        report->min_mean_depth = min_mean_depth(num_nodes);
+
+        qsort(lines, num_nodes, sizeof(size_t), compare_sizes);
+        report->num_cache_lines = 1;
+
+        for (i = 1; i < num_nodes; ++i) {
+            report->num_cache_lines += lines[i] != lines[i - 1];
+        }
+
+        allocator_free(self->allocator, lines, num_nodes * sizeof(size_t));
+    }
+}
+
+/* mean depth of a tree of len > 0 nodes with every level but the last full */
+static double min_mean_depth(size_t len) {
+    size_t remaining = len;
+    size_t level_len = 1;
+    size_t depth = 1;
+    double total_depth = 0.0;
+
+    assert(len > 0);
+
+    while (remaining > level_len) {
+        total_depth += (double) level_len * (double) depth;
+        remaining -= level_len;
+        level_len *= 2;
+        ++depth;
+    }
+
+    total_depth += (double) remaining * (double) depth;
+
+    return total_depth / (double) len;
+}
+
+static int compare_sizes(const void *lhs_v, const void *rhs_v) {
+    const size_t lhs = *(const size_t*) lhs_v;
+    const size_t rhs = *(const size_t*) rhs_v;
+
+    return (lhs > rhs) - (lhs < rhs);
+}
@@ -0,0 +1,697 @@
+//  MIT License
+//
+//  Copyright (c) 2019 Gregory Meyer
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//  files (the "Software"), to deal in the Software without
+//  restriction, including without limitation the rights to use, copy,
+//  modify, merge, publish, distribute, sublicense, and/or sell copies
+//  of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice (including
+//  the next paragraph) shall be included in all copies or substantial
+//  portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+//  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+//  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+//  IN THE SOFTWARE.
+
+#include <bloodhound_sharded.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <utility>
+
+namespace {
+
+// keeps data written by different threads on different cache lines
+constexpr std::size_t CACHE_LINE_SIZE = 64;
+
+// a shard splits or evens out with a neighbor once it holds this many
+// more nodes than twice the average
+constexpr std::size_t REBALANCE_SLACK = 64;
+
+// threads announce that they are routing on one of these counters
+constexpr std::size_t NUM_ROUTER_STRIPES = 16;
+
+struct RouterStripe {
+    // the number of threads routing in each phase
+    std::atomic<std::size_t> counts[2];
+    char padding[CACHE_LINE_SIZE];
+};
+
+std::size_t router_stripe() noexcept {
+    static std::atomic<std::size_t> next_stripe(0);
+    static thread_local const std::size_t stripe =
+        next_stripe.fetch_add(1, std::memory_order_relaxed) % NUM_ROUTER_STRIPES;
+
+    return stripe;
+}
+
+} // namespace
+
+struct AvlShardedTree {
+public:
+    AvlShardedTree(std::size_t num_shards, AvlComparator compare, void *compare_arg,
+                   AvlDeleter deleter, void *deleter_arg);
+
+    AvlShardedTree(const AvlShardedTree &other) = delete;
+
+    ~AvlShardedTree();
+
+    const AvlNode* get(const void *key, AvlHetComparator compare, void *arg);
+
+    void traverse_from(const void *key, AvlHetComparator compare, void *arg,
+                       AvlShardedVisitor visit, void *visit_arg);
+
+    bool insert(AvlNode *node);
+
+    bool remove(const void *key, AvlHetComparator compare, void *arg);
+
+    std::size_t len() const noexcept;
+
+    std::size_t num_shards() const noexcept {
+        return num_shards_;
+    }
+
+    std::size_t shard_len(std::size_t index) const noexcept {
+        return shards_[index].len.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Shard {
+        char padding[CACHE_LINE_SIZE];
+        std::mutex mutex;
+        AvlTree tree;
+        std::atomic<std::size_t> len;
+
+        // len may grow this far before the average is recomputed
+        std::atomic<std::size_t> rebalance_limit;
+
+        // the lower boundary of this shard was removed from tree but
+        // is kept alive until the boundary moves
+        bool is_boundary_detached;
+    };
+
+    static int compare_node(const void *key, const AvlNode *node, void *self_v);
+
+    // locks the shard whose range contains key
+    std::unique_lock<std::mutex> lock_shard_for(const void *key, AvlHetComparator compare,
+                                                void *arg, std::size_t &index);
+
+    std::size_t find_shard(const void *key, AvlHetComparator compare, void *arg) const noexcept;
+
+    // the lock of shards_[index] must be held
+    bool is_in_shard(std::size_t index, const void *key, AvlHetComparator compare,
+                     void *arg) const;
+
+    // the lock of shards_[index] must be held
+    void discard(std::size_t index, AvlNode *node);
+
+    void maybe_rebalance(std::size_t index);
+
+    // splits shards_[index] in half, shifting the shards between it and
+    // the empty shards_[empty] up by one to make room
+    void split_into(std::size_t index, std::size_t empty);
+
+    // moves about target of the greatest nodes of shards_[index] to
+    // shards_[index + 1], both of whose locks must be held; sets
+    // old_boundary to a detached boundary that may now be deleted
+    bool move_up(std::size_t index, std::size_t target, AvlNode *&old_boundary);
+
+    // moves about target of the least nodes of shards_[index] to
+    // shards_[index - 1], both of whose locks must be held
+    bool move_down(std::size_t index, std::size_t target, AvlNode *&old_boundary);
+
+    // makes boundary the lower boundary of shards_[index], whose lock and
+    // that of the shard below it must be held; returns the old boundary
+    // if it was detached
+    AvlNode* replace_boundary(std::size_t index, AvlNode *boundary);
+
+    // waits until no thread can still be comparing against a boundary
+    // that was replaced before the call
+    void synchronize();
+
+    std::size_t num_shards_;
+    AvlComparator compare_;
+    void *compare_arg_;
+    AvlDeleter deleter_;
+    void *deleter_arg_;
+    std::unique_ptr<Shard[]> shards_;
+
+    // boundaries_[i] is the least key of shards_[i], or NULL if it has
+    // no range yet; boundaries_[0] is always NULL
+    std::unique_ptr<std::atomic<AvlNode*>[]> boundaries_;
+
+    std::atomic<unsigned> phase_;
+    std::unique_ptr<RouterStripe[]> routers_;
+    std::mutex synchronize_mutex_;
+};
+
+AvlShardedTree::AvlShardedTree(std::size_t num_shards, AvlComparator compare, void *compare_arg,
+                               AvlDeleter deleter, void *deleter_arg)
+: num_shards_(num_shards), compare_(compare), compare_arg_(compare_arg), deleter_(deleter),
+  deleter_arg_(deleter_arg), shards_(new Shard[num_shards]),
+  boundaries_(new std::atomic<AvlNode*>[num_shards]), phase_(0),
+  routers_(new RouterStripe[NUM_ROUTER_STRIPES]) {
+    for (std::size_t i = 0; i < num_shards; ++i) {
+        AvlTree_new_ranked(&shards_[i].tree, compare, compare_arg, deleter, deleter_arg);
+        shards_[i].len.store(0, std::memory_order_relaxed);
+        shards_[i].rebalance_limit.store(REBALANCE_SLACK, std::memory_order_relaxed);
+        shards_[i].is_boundary_detached = false;
+        boundaries_[i].store(nullptr, std::memory_order_relaxed);
+    }
+
+    for (std::size_t i = 0; i < NUM_ROUTER_STRIPES; ++i) {
+        routers_[i].counts[0].store(0, std::memory_order_relaxed);
+        routers_[i].counts[1].store(0, std::memory_order_relaxed);
+    }
+}
+
+AvlShardedTree::~AvlShardedTree() {
+    for (std::size_t i = 0; i < num_shards_; ++i) {
+        if (shards_[i].is_boundary_detached) {
+            deleter_(boundaries_[i].load(std::memory_order_relaxed), deleter_arg_);
+        }
+
+        AvlTree_drop(&shards_[i].tree);
+    }
+}
+
+const AvlNode* AvlShardedTree::get(const void *key, AvlHetComparator compare, void *arg) {
+    std::size_t index;
+    const std::unique_lock<std::mutex> lock = lock_shard_for(key, compare, arg, index);
+
+    return AvlTree_get(&shards_[index].tree, key, compare, arg);
+}
+
+void AvlShardedTree::traverse_from(const void *key, AvlHetComparator compare, void *arg,
+                                   AvlShardedVisitor visit, void *visit_arg) {
+    std::size_t index = 0;
+    std::unique_lock<std::mutex> lock;
+
+    if (key) {
+        lock = lock_shard_for(key, compare, arg, index);
+    } else {
+        lock = std::unique_lock<std::mutex>(shards_[0].mutex);
+    }
+
+    for (;;) {
+        AvlCursor cursor;
+
+        if (key) {
+            AvlTree_lower_bound(&shards_[index].tree, key, compare, arg, &cursor);
+        } else {
+            AvlCursor_first(&cursor, &shards_[index].tree);
+        }
+
+        for (const AvlNode *node; (node = AvlCursor_get(&cursor)); AvlCursor_next(&cursor)) {
+            if (visit(visit_arg, node)) {
+                return;
+            }
+        }
+
+        if (++index == num_shards_) {
+            return;
+        }
+
+        // nodes can't cross into a shard that has been visited until
+        // the next one is locked too
+        std::unique_lock<std::mutex> next_lock(shards_[index].mutex);
+
+        lock = std::move(next_lock);
+        key = nullptr;
+    }
+}
+
+bool AvlShardedTree::insert(AvlNode *node) {
+    std::size_t index;
+    AvlNode *previous;
+
+    {
+        const std::unique_lock<std::mutex> lock = lock_shard_for(node, compare_node, this,
+                                                                 index);
+        Shard &shard = shards_[index];
+
+        previous = AvlTree_insert(&shard.tree, node);
+        shard.len.store(shard.tree.len, std::memory_order_relaxed);
+
+        if (previous) {
+            discard(index, previous);
+        }
+    }
+
+    maybe_rebalance(index);
+
+    return previous != nullptr;
+}
+
+bool AvlShardedTree::remove(const void *key, AvlHetComparator compare, void *arg) {
+    std::size_t index;
+    AvlNode *removed;
+
+    {
+        const std::unique_lock<std::mutex> lock = lock_shard_for(key, compare, arg, index);
+        Shard &shard = shards_[index];
+
+        removed = AvlTree_remove(&shard.tree, key, compare, arg);
+        shard.len.store(shard.tree.len, std::memory_order_relaxed);
+
+        if (removed) {
+            discard(index, removed);
+        }
+    }
+
+    maybe_rebalance(index);
+
+    return removed != nullptr;
+}
+
+std::size_t AvlShardedTree::len() const noexcept {
+    std::size_t total = 0;
+
+    for (std::size_t i = 0; i < num_shards_; ++i) {
+        total += shard_len(i);
+    }
+
+    return total;
+}
+
+int AvlShardedTree::compare_node(const void *key, const AvlNode *node, void *self_v) {
+    const AvlShardedTree &self = *static_cast<const AvlShardedTree*>(self_v);
+
+    return self.compare_(static_cast<const AvlNode*>(key), node, self.compare_arg_);
+}
+
+std::unique_lock<std::mutex> AvlShardedTree::lock_shard_for(const void *key,
+                                                            AvlHetComparator compare,
+                                                            void *arg, std::size_t &index) {
+    for (;;) {
+        index = find_shard(key, compare, arg);
+
+        // the boundaries of a shard only move while its lock is held,
+        // so they can be rechecked safely
+        std::unique_lock<std::mutex> lock(shards_[index].mutex);
+
+        if (is_in_shard(index, key, compare, arg)) {
+            return lock;
+        }
+    }
+}
+
+std::size_t AvlShardedTree::find_shard(const void *key, AvlHetComparator compare,
+                                       void *arg) const noexcept {
+    std::atomic<std::size_t> *const counts = routers_[router_stripe()].counts;
+    unsigned phase;
+
+    // announce ourselves so synchronize() waits before deleting any
+    // boundary we might load
+    for (;;) {
+        phase = phase_.load();
+        counts[phase].fetch_add(1);
+
+        if (phase_.load() == phase) {
+            break;
+        }
+
+        counts[phase].fetch_sub(1);
+    }
+
+    // the least index is 0, which has no lower boundary
+    std::size_t low = 0;
+    std::size_t high = num_shards_;
+
+    while (high - low > 1) {
+        const std::size_t middle = low + (high - low) / 2;
+        const AvlNode *const boundary = boundaries_[middle].load();
+
+        if (boundary && compare(key, boundary, arg) >= 0) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+
+    counts[phase].fetch_sub(1, std::memory_order_release);
+
+    return low;
+}
+
+bool AvlShardedTree::is_in_shard(std::size_t index, const void *key, AvlHetComparator compare,
+                                 void *arg) const {
+    if (index > 0) {
+        const AvlNode *const lower = boundaries_[index].load(std::memory_order_relaxed);
+
+        if (!lower || compare(key, lower, arg) < 0) {
+            return false;
+        }
+    }
+
+    if (index + 1 < num_shards_) {
+        const AvlNode *const upper = boundaries_[index + 1].load(std::memory_order_relaxed);
+
+        if (upper && compare(key, upper, arg) >= 0) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void AvlShardedTree::discard(std::size_t index, AvlNode *node) {
+    if (index > 0 && node == boundaries_[index].load(std::memory_order_relaxed)) {
+        shards_[index].is_boundary_detached = true;
+    } else {
+        deleter_(node, deleter_arg_);
+    }
+}
+
+void AvlShardedTree::maybe_rebalance(std::size_t index) {
+    Shard &shard = shards_[index];
+
+    if (shard_len(index) <= shard.rebalance_limit.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    const std::size_t limit = 2 * len() / num_shards_ + REBALANCE_SLACK;
+
+    shard.rebalance_limit.store(limit, std::memory_order_relaxed);
+
+    if (shard_len(index) <= limit) {
+        return;
+    }
+
+    for (std::size_t empty = index + 1; empty < num_shards_; ++empty) {
+        if (shard_len(empty) == 0) {
+            split_into(index, empty);
+
+            return;
+        }
+    }
+
+    const bool is_up = index + 1 < num_shards_
+                       && (index == 0 || shard_len(index + 1) <= shard_len(index - 1));
+
+    if (!is_up && index == 0) {
+        return;
+    }
+
+    const std::size_t neighbor = is_up ? index + 1 : index - 1;
+    AvlNode *old_boundary = nullptr;
+
+    {
+        const std::size_t lower = std::min(index, neighbor);
+        const std::lock_guard<std::mutex> lower_guard(shards_[lower].mutex);
+        const std::lock_guard<std::mutex> upper_guard(shards_[lower + 1].mutex);
+        const std::size_t from_len = shard_len(index);
+        const std::size_t to_len = shard_len(neighbor);
+
+        // evening out with a neighbor of similar size would only push
+        // it over its own limit
+        if (2 * to_len + REBALANCE_SLACK >= from_len) {
+            return;
+        }
+
+        const std::size_t target = (from_len - to_len) / 2;
+
+        if (is_up) {
+            move_up(index, target, old_boundary);
+        } else {
+            move_down(index, target, old_boundary);
+        }
+    }
+
+    if (old_boundary) {
+        deleter_(old_boundary, deleter_arg_);
+    }
+}
+
+void AvlShardedTree::split_into(std::size_t index, std::size_t empty) {
+    AvlNode *old_boundaries[2] = {nullptr, nullptr};
+
+    for (std::size_t i = index; i <= empty; ++i) {
+        shards_[i].mutex.lock();
+    }
+
+    if (shard_len(empty) == 0) {
+        Shard &last = shards_[empty];
+
+        if (last.is_boundary_detached) {
+            old_boundaries[0] = boundaries_[empty].load(std::memory_order_relaxed);
+        }
+
+        // moving a whole tree only takes copying its root, so shift the
+        // shards in between up to make room next to index
+        for (std::size_t i = empty; i > index + 1; --i) {
+            Shard &to = shards_[i];
+            Shard &from = shards_[i - 1];
+
+            to.tree.root = from.tree.root;
+            to.tree.len = from.tree.len;
+            to.len.store(from.tree.len, std::memory_order_relaxed);
+            to.is_boundary_detached = from.is_boundary_detached;
+            boundaries_[i].store(boundaries_[i - 1].load(std::memory_order_relaxed));
+            from.tree.root = nullptr;
+            from.tree.len = 0;
+            from.len.store(0, std::memory_order_relaxed);
+        }
+
+        // the old boundary of index + 1 now belongs to index + 2
+        shards_[index + 1].is_boundary_detached = false;
+        if (!move_up(index, shard_len(index) / 2, old_boundaries[1])) {
+            synchronize();
+        }
+    }
+
+    for (std::size_t i = empty + 1; i > index; --i) {
+        shards_[i - 1].mutex.unlock();
+    }
+
+    for (AvlNode *old_boundary : old_boundaries) {
+        if (old_boundary) {
+            deleter_(old_boundary, deleter_arg_);
+        }
+    }
+}
+
+bool AvlShardedTree::move_up(std::size_t index, std::size_t target, AvlNode *&old_boundary) {
+    Shard &lower = shards_[index];
+    Shard &upper = shards_[index + 1];
+    AvlNode *pivot = lower.tree.root;
+
+    // without a left subtree, the root could be the lower boundary
+    if (!pivot || !pivot->left) {
+        return false;
+    }
+
+    // each step right roughly halves the number of nodes moved
+    for (std::size_t estimate = lower.tree.len / 2; estimate / 2 >= target && pivot->right;
+         estimate /= 2) {
+        pivot = pivot->right;
+    }
+
+    AvlTree moved;
+
+    AvlTree_split(&lower.tree, pivot, compare_node, this, &moved);
+    AvlTree_join(&moved, nullptr, &upper.tree);
+    AvlTree_join(&upper.tree, pivot, &moved);
+
+    lower.len.store(lower.tree.len, std::memory_order_relaxed);
+    upper.len.store(upper.tree.len, std::memory_order_relaxed);
+    old_boundary = replace_boundary(index + 1, pivot);
+
+    return true;
+}
+
+bool AvlShardedTree::move_down(std::size_t index, std::size_t target, AvlNode *&old_boundary) {
+    Shard &lower = shards_[index - 1];
+    Shard &upper = shards_[index];
+    AvlNode *pivot = upper.tree.root;
+
+    if (!pivot || !pivot->left) {
+        return false;
+    }
+
+    for (std::size_t estimate = upper.tree.len / 2;
+         estimate / 2 >= target && pivot->left->left; estimate /= 2) {
+        pivot = pivot->left;
+    }
+
+    AvlTree kept;
+
+    AvlTree_split(&upper.tree, pivot, compare_node, this, &kept);
+    AvlTree_join(&lower.tree, nullptr, &upper.tree);
+    AvlTree_join(&upper.tree, pivot, &kept);
+
+    lower.len.store(lower.tree.len, std::memory_order_relaxed);
+    upper.len.store(upper.tree.len, std::memory_order_relaxed);
+    old_boundary = replace_boundary(index, pivot);
+
+    return true;
+}
+
+AvlNode* AvlShardedTree::replace_boundary(std::size_t index, AvlNode *boundary) {
+    AvlNode *const old_boundary = boundaries_[index].exchange(boundary);
+    const bool was_detached = shards_[index].is_boundary_detached;
+
+    shards_[index].is_boundary_detached = false;
+    synchronize();
+
+    return was_detached ? old_boundary : nullptr;
+}
+
+void AvlShardedTree::synchronize() {
+    const std::lock_guard<std::mutex> guard(synchronize_mutex_);
+    const unsigned phase = phase_.load();
+
+    phase_.store(phase ^ 1);
+
+    for (std::size_t i = 0; i < NUM_ROUTER_STRIPES; ++i) {
+        while (routers_[i].counts[phase].load() != 0) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+/**
+ *  Creates an empty AvlShardedTree.
+ *
+ *  @param num_shards Must be positive.
+ *  @param compare Must not be NULL.
+ *  @param deleter Must not be NULL.
+ *  @returns A tree to be dropped with AvlShardedTree_drop.
+ */
+AvlShardedTree* AvlShardedTree_new(std::size_t num_shards, AvlComparator compare,
+                                   void *compare_arg, AvlDeleter deleter, void *deleter_arg) {
+    assert(num_shards > 0);
+    assert(compare);
+    assert(deleter);
+
+    try {
+        return new AvlShardedTree(num_shards, compare, compare_arg, deleter, deleter_arg);
+    } catch (const std::bad_alloc &e) {
+        std::fprintf(stderr, "AvlShardedTree_new: %s\n", e.what());
+        std::abort();
+    }
+}
+
+/**
+ *  Drops an AvlShardedTree, passing every node it still holds to the
+ *  deleter.
+ *
+ *  @param self May be NULL. No other call using self may be in
+ *              progress.
+ */
+void AvlShardedTree_drop(AvlShardedTree *self) {
+    delete self;
+}
+
+/**
+ *  Finds the node that compares equal to a key.
+ *
+ *  @param self Must not be NULL.
+ *  @param compare Must not be NULL.
+ *  @returns A pointer to the node that compared equal to key, if there
+ *           was one.
+ */
+const AvlNode* AvlShardedTree_get(AvlShardedTree *self, const void *key,
+                                  AvlHetComparator compare, void *arg) {
+    assert(self);
+    assert(compare);
+
+    return self->get(key, compare, arg);
+}
+
+/**
+ *  Visits nodes in order, starting from the least node that does not
+ *  compare less than a key.
+ *
+ *  @param self Must not be NULL.
+ *  @param compare Must not be NULL if key is not NULL.
+ *  @param visit Must not be NULL.
+ */
+void AvlShardedTree_traverse_from(AvlShardedTree *self, const void *key,
+                                  AvlHetComparator compare, void *arg,
+                                  AvlShardedVisitor visit, void *visit_arg) {
+    assert(self);
+    assert(!key || compare);
+    assert(visit);
+
+    self->traverse_from(key, compare, arg, visit, visit_arg);
+}
+
+/**
+ *  Inserts a node, replacing the node that compares equal to it.
+ *
+ *  @param self Must not be NULL.
+ *  @param node Must not be NULL. Must not be in any tree.
+ *  @returns Nonzero if a node was replaced.
+ */
+int AvlShardedTree_insert(AvlShardedTree *self, AvlNode *node) {
+    assert(self);
+    assert(node);
+
+    return self->insert(node);
+}
+
+/**
+ *  Removes the node that compares equal to a key.
+ *
+ *  @param self Must not be NULL.
+ *  @param compare Must not be NULL.
+ *  @returns Nonzero if a node was removed.
+ */
+int AvlShardedTree_remove(AvlShardedTree *self, const void *key, AvlHetComparator compare,
+                          void *arg) {
+    assert(self);
+    assert(compare);
+
+    return self->remove(key, compare, arg);
+}
+
+/**
+ *  @param self Must not be NULL.
+ *  @returns The number of nodes in self.
+ */
+std::size_t AvlShardedTree_len(const AvlShardedTree *self) {
+    assert(self);
+
+    return self->len();
+}
+
+/**
+ *  @param self Must not be NULL.
+ *  @returns The number of shards self was created with.
+ */
+std::size_t AvlShardedTree_num_shards(const AvlShardedTree *self) {
+    assert(self);
+
+    return self->num_shards();
+}
+
+/**
+ *  @param self Must not be NULL.
+ *  @param index Must be less than the number of shards of self.
+ *  @returns The number of nodes in a shard.
+ */
+std::size_t AvlShardedTree_shard_len(const AvlShardedTree *self, std::size_t index) {
+    assert(self);
+    assert(index < self->num_shards());
+
+    return self->shard_len(index);
+}
@@ -0,0 +1,134 @@
+/*  MIT License
+ *
+ *  Copyright (c) 2019 Gregory Meyer
+ *
+ *  Permission is hereby granted, free of charge, to any person
+ *  obtaining a copy of this software and associated documentation
+ *  files (the "Software"), to deal in the Software without
+ *  restriction, including without limitation the rights to use, copy,
+ *  modify, merge, publish, distribute, sublicense, and/or sell copies
+ *  of the Software, and to permit persons to whom the Software is
+ *  furnished to do so, subject to the following conditions:
+ *
+ *  The above copyright notice and this permission notice (including
+ *  the next paragraph) shall be included in all copies or substantial
+ *  portions of the Software.
+ *
+ *  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ *  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ *  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ *  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+ *  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+ *  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ *  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ *  IN THE SOFTWARE.
+ */
+
+
+#ifndef BLOODHOUND_IMPL_STATS_H
+#define BLOODHOUND_IMPL_STATS_H
+
+#include <bloodhound.h>
+
+/*
+ *  Hooks for the counters in AvlTreeStats. Each takes the counters to
+ *  add to, which may be NULL: WRITE_STATS for operations that modify a
+ *  tree, LOOKUP_STATS for ones that only read it. Without
+ *  BLOODHOUND_STATS they only evaluate their arguments, which are
+ *  plain locals, so the compiler drops them along with the code that
+ *  computed them.
+ *
+ *  Callers keep counts in locals and record them once per operation,
+ *  so a search costs one increment per level whichever way this is
+ *  built. Only the one thread modifying a tree writes its own
+ *  counters, so STATS_ADD and STATS_SEARCHES use plain adds and skip
+ *  zero deltas. The lookup sink may be shared by concurrent lookups,
+ *  so LOOKUP_STATS must only be passed to the SHARED_ variants, which
+ *  add atomically where the compiler allows it.
+ */
+#define WRITE_STATS(TREE) (&(TREE)->stats)
+
+#define LOOKUP_STATS(TREE) ((TREE)->lookup_stats)
+
+#ifdef BLOODHOUND_STATS
+
+#define STATS_ADD(STATS, FIELD, N) \
+    do { \
+        AvlTreeStats *const stats_ = (STATS); \
+        const size_t n_ = (size_t) (N); \
+        if (stats_ && n_ != 0) { \
+            stats_->FIELD += n_; \
+        } \
+    } while (0)
+
+#define STATS_SEARCHES(STATS, NUM, TOTAL_DEPTH, MAX_DEPTH) \
+    do { \
+        AvlTreeStats *const stats_ = (STATS); \
+        const size_t max_depth_ = (size_t) (MAX_DEPTH); \
+        if (stats_) { \
+            stats_->num_searches += (size_t) (NUM); \
+            stats_->total_search_depth += (size_t) (TOTAL_DEPTH); \
+            if (max_depth_ > stats_->max_search_depth) { \
+                stats_->max_search_depth = max_depth_; \
+            } \
+        } \
+    } while (0)
+
+#define SHARED_STATS_ADD(STATS, FIELD, N) \
+    do { \
+        AvlTreeStats *const stats_ = (STATS); \
+        const size_t n_ = (size_t) (N); \
+        if (stats_ && n_ != 0) { \
+            stats_add(&stats_->FIELD, n_); \
+        } \
+    } while (0)
+
+#define SHARED_STATS_SEARCHES(STATS, NUM, TOTAL_DEPTH, MAX_DEPTH) \
+    stats_searches((STATS), (size_t) (NUM), (size_t) (TOTAL_DEPTH), (size_t) (MAX_DEPTH))
+
+/**
+ *  Adds to a counter, atomically if built with GCC or Clang.
+ *
+ *  @param counter Must not be NULL.
+ */
+void stats_add(size_t *counter, size_t n);
+
+/**
+ *  Counts searches from the root, atomically if built with GCC or
+ *  Clang.
+ *
+ *  @param stats If NULL, nothing is counted.
+ *  @param num The number of searches.
+ *  @param total_depth The number of nodes on all of their paths.
+ *  @param max_depth The number of nodes on the longest of them.
+ */
+void stats_searches(AvlTreeStats *stats, size_t num, size_t total_depth, size_t max_depth);
+
+#else
+
+#define STATS_ADD(STATS, FIELD, N) ((void) (STATS), (void) (N))
+
+#define STATS_SEARCHES(STATS, NUM, TOTAL_DEPTH, MAX_DEPTH) \
+    ((void) (STATS), (void) (NUM), (void) (TOTAL_DEPTH), (void) (MAX_DEPTH))
+
+#define SHARED_STATS_ADD(STATS, FIELD, N) STATS_ADD(STATS, FIELD, N)
+
+#define SHARED_STATS_SEARCHES(STATS, NUM, TOTAL_DEPTH, MAX_DEPTH) \
+    STATS_SEARCHES(STATS, NUM, TOTAL_DEPTH, MAX_DEPTH)
+
+#endif
+
+/* one search from the root that compared against DEPTH nodes */
+#define STATS_SEARCH(STATS, DEPTH) \
+    do { \
+        STATS_ADD((STATS), num_comparisons, (DEPTH)); \
+        STATS_SEARCHES((STATS), 1, (DEPTH), (DEPTH)); \
+    } while (0)
+
+#define SHARED_STATS_SEARCH(STATS, DEPTH) \
+    do { \
+        SHARED_STATS_ADD((STATS), num_comparisons, (DEPTH)); \
+        SHARED_STATS_SEARCHES((STATS), 1, (DEPTH), (DEPTH)); \
+    } while (0)
+
+#endif
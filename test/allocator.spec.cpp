@@ -0,0 +1,170 @@
+//  MIT License
+//
+//  Copyright (c) 2019 Gregory Meyer
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//  files (the "Software"), to deal in the Software without
+//  restriction, including without limitation the rights to use, copy,
+//  modify, merge, publish, distribute, sublicense, and/or sell copies
+//  of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice (including
+//  the next paragraph) shall be included in all copies or substantial
+//  portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+//  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+//  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+//  IN THE SOFTWARE.
+
+#include "int_node.h"
+
+#include <cstdlib>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+namespace {
+
+struct Counts {
+    std::size_t num_allocs = 0;
+    std::size_t num_frees = 0;
+    std::size_t bytes = 0;
+};
+
+void* counting_alloc(std::size_t size, void *counts_v) {
+    Counts &counts = *static_cast<Counts*>(counts_v);
+
+    ++counts.num_allocs;
+    counts.bytes += size;
+
+    return std::malloc(size);
+}
+
+void* counting_realloc(void *ptr, std::size_t old_size, std::size_t new_size, void *counts_v) {
+    Counts &counts = *static_cast<Counts*>(counts_v);
+
+    counts.bytes = counts.bytes - old_size + new_size;
+
+    return std::realloc(ptr, new_size);
+}
+
+void counting_free(void *ptr, std::size_t size, void *counts_v) {
+    Counts &counts = *static_cast<Counts*>(counts_v);
+
+    ++counts.num_frees;
+    counts.bytes -= size;
+    std::free(ptr);
+}
+
+// AvlTree over nodes owned by a std::vector, keyed 0 to n - 1
+struct Tree {
+    explicit Tree(std::size_t n) : nodes(n) {
+        AvlTree_new(&tree, IntNode_compare, nullptr, IntNode_delete, nullptr);
+
+        for (std::size_t i = 0; i < n; ++i) {
+            nodes[i].key = static_cast<int>(i);
+            AvlTree_insert(&tree, &nodes[i].node);
+        }
+    }
+
+    ~Tree() {
+        AvlTree_drop(&tree);
+    }
+
+    std::vector<IntNode> nodes;
+    AvlTree tree;
+};
+
+} // namespace
+
+TEST_CASE("snapshots allocate through the allocator of their tree") {
+    Counts counts;
+    AvlAllocator allocator;
+    Tree tree(100);
+    AvlFrozenTree frozen;
+
+    AvlAllocator_new(&allocator, counting_alloc, counting_realloc, counting_free, &counts);
+    AvlTree_set_allocator(&tree.tree, &allocator);
+
+    AvlTree_freeze(&tree.tree, &frozen);
+    REQUIRE(counts.num_allocs == 1);
+    REQUIRE(counts.bytes == 101 * sizeof(const AvlNode*));
+    REQUIRE(allocator.bytes_held == counts.bytes);
+
+    Tree larger(200);
+
+    AvlFrozenTree_refreeze(&frozen, &larger.tree);
+    REQUIRE(counts.num_allocs == 2);
+    REQUIRE(counts.num_frees == 1);
+    REQUIRE(allocator.bytes_held == 201 * sizeof(const AvlNode*));
+
+    const int key = 150;
+    REQUIRE(AvlFrozenTree_get(&frozen, &key, IntNode_het_compare, nullptr)
+            == &larger.nodes[150].node);
+
+    AvlFrozenTree_drop(&frozen);
+    REQUIRE(counts.num_frees == 2);
+    REQUIRE(counts.bytes == 0);
+    REQUIRE(allocator.bytes_held == 0);
+    REQUIRE(allocator.peak_bytes_held == 201 * sizeof(const AvlNode*));
+}
+
+TEST_CASE("shape reports allocate through the allocator of their tree") {
+    Counts counts;
+    AvlAllocator allocator;
+    Tree tree(100);
+    AvlShapeReport shape;
+
+    AvlAllocator_new(&allocator, counting_alloc, counting_realloc, counting_free, &counts);
+    AvlTree_set_allocator(&tree.tree, &allocator);
+
+    AvlTree_shape_report(&tree.tree, &shape);
+    REQUIRE(shape.len == 100);
+    REQUIRE(counts.num_allocs == 1);
+    REQUIRE(counts.num_frees == 1);
+    REQUIRE(counts.bytes == 0);
+    REQUIRE(allocator.peak_bytes_held == 100 * sizeof(std::size_t));
+}
+
+TEST_CASE("trees without an allocator use the default") {
+    Counts counts;
+    AvlAllocator allocator;
+    Tree tree(64);
+    AvlFrozenTree frozen;
+
+    REQUIRE(AvlAllocator_get_default());
+    AvlAllocator *const builtin = AvlAllocator_get_default();
+
+    AvlAllocator_new(&allocator, counting_alloc, counting_realloc, counting_free, &counts);
+    AvlAllocator_set_default(&allocator);
+    REQUIRE(AvlAllocator_get_default() == &allocator);
+
+    AvlTree_freeze_copies(&tree.tree, &frozen, sizeof(IntNode));
+    REQUIRE(counts.num_allocs == 1);
+    REQUIRE(allocator.bytes_held == 65 * sizeof(IntNode));
+    REQUIRE(builtin->bytes_held == 0);
+
+    AvlFrozenTree_drop(&frozen);
+    REQUIRE(counts.bytes == 0);
+    REQUIRE(allocator.peak_bytes_held == 65 * sizeof(IntNode));
+
+    AvlAllocator_set_default(nullptr);
+    REQUIRE(AvlAllocator_get_default() == builtin);
+
+    // shared with other tests, so only the change in its counts is known
+    const std::size_t held_before = builtin->bytes_held;
+
+    AvlTree_freeze(&tree.tree, &frozen);
+    REQUIRE(builtin->bytes_held == held_before + 65 * sizeof(const AvlNode*));
+    REQUIRE(builtin->peak_bytes_held >= builtin->bytes_held);
+    AvlFrozenTree_drop(&frozen);
+    REQUIRE(builtin->bytes_held == held_before);
+    REQUIRE(counts.num_allocs == 1);
+}
@@ -0,0 +1,167 @@
+//  MIT License
+//
+//  Copyright (c) 2019 Gregory Meyer
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//  files (the "Software"), to deal in the Software without
+//  restriction, including without limitation the rights to use, copy,
+//  modify, merge, publish, distribute, sublicense, and/or sell copies
+//  of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice (including
+//  the next paragraph) shall be included in all copies or substantial
+//  portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+//  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+//  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+//  IN THE SOFTWARE.
+
+#include "avl_arena.h"
+#include "avl_map.h"
+#include "util.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+constexpr int NUM_INSERTIONS = 2048;
+
+namespace {
+
+// counts live instances so that tests can see destructors run
+class Tracked {
+public:
+    explicit Tracked(int *num_live) noexcept : num_live_(num_live) {
+        ++*num_live_;
+    }
+
+    Tracked(const Tracked &other) = delete;
+
+    ~Tracked() {
+        --*num_live_;
+    }
+
+private:
+    int *num_live_;
+};
+
+} // namespace
+
+TEST_CASE("arena-backed map insertion and removal") {
+    using Allocator = avl::ArenaAllocator<std::pair<const int, int>>;
+
+    const Allocator alloc(1024);
+    avl::Map<int, int, Allocator> map(alloc);
+    const auto urbg_ptr = make_urbg();
+    const std::vector<int> keys = rand_iota(NUM_INSERTIONS, *urbg_ptr);
+
+    for (int key : keys) {
+        REQUIRE_FALSE(map.insert(key, key * 2).second);
+    }
+
+    REQUIRE(map.size() == static_cast<std::size_t>(NUM_INSERTIONS));
+
+    for (int key : keys) {
+        REQUIRE(map.get(key));
+        REQUIRE(*map.get(key) == key * 2);
+    }
+
+    const std::size_t num_blocks = alloc.arena().num_blocks();
+    REQUIRE(num_blocks > 1);
+
+    // removed nodes are recycled instead of growing the arena
+    for (int key : keys) {
+        REQUIRE(map.remove(key));
+        REQUIRE(map.insert_or_assign(key, key).second);
+    }
+
+    REQUIRE(alloc.arena().num_blocks() == num_blocks);
+    REQUIRE(map.get_allocator() == alloc);
+}
+
+TEST_CASE("arena-backed map clears by releasing its blocks") {
+    avl::Map<int, int, avl::ArenaAllocator<std::pair<const int, int>>> map;
+
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < NUM_INSERTIONS; ++i) {
+            map.insert(i, i);
+        }
+
+        REQUIRE(map.get_allocator().arena().num_blocks() > 0);
+
+        map.clear();
+
+        REQUIRE(map.size() == 0);
+        REQUIRE_FALSE(map.get(0));
+        REQUIRE(map.get_allocator().arena().num_blocks() == 0);
+    }
+}
+
+TEST_CASE("arena-backed map runs destructors on clear") {
+    using Allocator = avl::ArenaAllocator<std::pair<const int, Tracked>>;
+
+    int num_live = 0;
+    const Allocator alloc;
+
+    {
+        avl::Map<int, Tracked, Allocator> map(alloc);
+
+        for (int i = 0; i < NUM_INSERTIONS; ++i) {
+            map.insert(i, &num_live);
+        }
+
+        REQUIRE(num_live == NUM_INSERTIONS);
+        REQUIRE(map.get(7));
+
+        map.clear();
+        REQUIRE(num_live == 0);
+
+        // the arena is shared with alloc, so it must not be released
+        REQUIRE(alloc.arena().num_blocks() > 0);
+
+        map.insert(1, &num_live);
+    }
+
+    REQUIRE(num_live == 0);
+}
+
+TEST_CASE("arena chunks are reused per size") {
+    avl::Arena arena(256);
+    std::vector<void*> small;
+    std::vector<void*> large;
+
+    for (int i = 0; i < 64; ++i) {
+        small.push_back(arena.allocate(8));
+        large.push_back(arena.allocate(100));
+    }
+
+    const std::size_t num_blocks = arena.num_blocks();
+
+    for (std::size_t i = 0; i < small.size(); ++i) {
+        arena.deallocate(small[i], 8);
+        arena.deallocate(large[i], 100);
+    }
+
+    for (std::size_t i = 0; i < small.size(); ++i) {
+        arena.allocate(8);
+        arena.allocate(100);
+    }
+
+    REQUIRE(arena.num_blocks() == num_blocks);
+
+    void *const huge = arena.allocate(4096);
+    REQUIRE(huge);
+    REQUIRE(arena.num_blocks() == num_blocks + 1);
+
+    arena.release();
+    REQUIRE(arena.num_blocks() == 0);
+}
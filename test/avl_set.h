@@ -29,6 +29,8 @@
 #include "bloodhound.h"
 
 #include <functional>
+#include <type_traits>
+#include <utility>
 
 namespace avl {
 
@@ -71,8 +73,8 @@ public:
     }
 
     const K* get(const K &key) const noexcept {
-        Node *const node = reinterpret_cast<Node*>(
-            AvlTree_get_mut(&impl_, &key, Set::het_comparator<K>, &comparator_)
+        const Node *const node = reinterpret_cast<const Node*>(
+            AvlTree_get(&impl_, &key, Set::het_comparator<K>, const_cast<C*>(&comparator_))
         );
 
         if (!node) {
@@ -0,0 +1,114 @@
+//  MIT License
+//
+//  Copyright (c) 2019 Gregory Meyer
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//  files (the "Software"), to deal in the Software without
+//  restriction, including without limitation the rights to use, copy,
+//  modify, merge, publish, distribute, sublicense, and/or sell copies
+//  of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice (including
+//  the next paragraph) shall be included in all copies or substantial
+//  portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+//  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+//  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+//  IN THE SOFTWARE.
+
+#include "int_node.h"
+#include "util.h"
+
+#include <utility>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+constexpr std::size_t NUM_INSERTIONS = 2048;
+
+static std::vector<int> evens() {
+    return mapped(iota(NUM_INSERTIONS), [](int i) { return i * 2; });
+}
+
+static int window_compare(const void *window_v, const AvlNode *node, void*) {
+    const std::pair<int, int> &window = *static_cast<const std::pair<int, int>*>(window_v);
+    const int key = IntNode_key(node);
+
+    if (window.second < key) {
+        return -1;
+    } else if (key < window.first) {
+        return 1;
+    } else {
+        return 0;
+    }
+}
+
+TEST_CASE("random insert, lower bound") {
+    const auto urbg_ptr = make_urbg();
+    IntTree tree(shuffled(evens(), *urbg_ptr));
+    AvlCursor cursor;
+
+    for (int i = -1; i < static_cast<int>(NUM_INSERTIONS * 2) - 1; ++i) {
+        const int expected = (i % 2 == 0) ? i : i + 1;
+
+        AvlTree_lower_bound(&tree.tree, &i, IntNode_het_compare, nullptr, &cursor);
+        REQUIRE(AvlCursor_get(&cursor));
+        REQUIRE(IntNode_key(AvlCursor_get(&cursor)) == expected);
+    }
+
+    const int past_end = static_cast<int>(NUM_INSERTIONS * 2) - 1;
+    AvlTree_lower_bound(&tree.tree, &past_end, IntNode_het_compare, nullptr, &cursor);
+    REQUIRE_FALSE(AvlCursor_get(&cursor));
+}
+
+TEST_CASE("random insert, upper bound") {
+    const auto urbg_ptr = make_urbg();
+    IntTree tree(shuffled(evens(), *urbg_ptr));
+    AvlCursor cursor;
+
+    for (int i = -1; i < static_cast<int>(NUM_INSERTIONS * 2) - 2; ++i) {
+        const int expected = (i % 2 == 0) ? i + 2 : i + 1;
+
+        AvlTree_upper_bound(&tree.tree, &i, IntNode_het_compare, nullptr, &cursor);
+        REQUIRE(AvlCursor_get(&cursor));
+        REQUIRE(IntNode_key(AvlCursor_get(&cursor)) == expected);
+    }
+
+    const int last = static_cast<int>(NUM_INSERTIONS * 2) - 2;
+    AvlTree_upper_bound(&tree.tree, &last, IntNode_het_compare, nullptr, &cursor);
+    REQUIRE_FALSE(AvlCursor_get(&cursor));
+}
+
+TEST_CASE("random insert, windowed equal range") {
+    const auto urbg_ptr = make_urbg();
+    IntTree tree(shuffled(evens(), *urbg_ptr));
+    AvlCursor first;
+    AvlCursor last;
+
+    for (int lower = -3; lower < static_cast<int>(NUM_INSERTIONS * 2); lower += 61) {
+        const std::pair<int, int> window(lower, lower + 100);
+        std::vector<int> expected;
+        std::vector<int> actual;
+
+        for (int i = window.first; i <= window.second; ++i) {
+            if (i >= 0 && i % 2 == 0 && i < static_cast<int>(NUM_INSERTIONS * 2)) {
+                expected.push_back(i);
+            }
+        }
+
+        AvlTree_equal_range(&tree.tree, &window, window_compare, nullptr, &first, &last);
+
+        for (; AvlCursor_get(&first) != AvlCursor_get(&last); AvlCursor_next(&first)) {
+            actual.push_back(IntNode_key(AvlCursor_get(&first)));
+        }
+
+        REQUIRE(actual == expected);
+    }
+}
@@ -0,0 +1,121 @@
+//  MIT License
+//
+//  Copyright (c) 2019 Gregory Meyer
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//  files (the "Software"), to deal in the Software without
+//  restriction, including without limitation the rights to use, copy,
+//  modify, merge, publish, distribute, sublicense, and/or sell copies
+//  of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice (including
+//  the next paragraph) shall be included in all copies or substantial
+//  portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+//  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+//  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+//  IN THE SOFTWARE.
+
+#include "int_node.h"
+#include "util.h"
+
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+TEST_CASE("builder, push and finish") {
+    for (std::size_t n = 0; n <= 256; ++n) {
+        std::vector<IntNode> nodes(n);
+        AvlBuilder builder;
+        AvlTree tree;
+
+        AvlBuilder_new(&builder, IntNode_compare, nullptr, IntNode_delete, nullptr);
+
+        for (std::size_t i = 0; i < n; ++i) {
+            nodes[i].key = static_cast<int>(i);
+            AvlBuilder_push(&builder, &nodes[i].node);
+            REQUIRE(checked_height(builder.tree.root) >= 0);
+        }
+
+        AvlBuilder_finish(&builder, &tree);
+        REQUIRE(tree.len == n);
+        REQUIRE(keys_of(tree) == iota(n));
+        REQUIRE(builder.tree.len == 0);
+        REQUIRE_FALSE(builder.tree.root);
+
+        AvlBuilder_drop(&builder);
+        AvlTree_drop(&tree);
+    }
+}
+
+TEST_CASE("builder, reuse after finish") {
+    const auto urbg_ptr = make_urbg();
+    const std::vector<int> keys = sorted(rand_iota(1024, *urbg_ptr));
+    std::vector<IntNode> nodes(keys.size());
+    AvlBuilder builder;
+    AvlTree first;
+    AvlTree second;
+
+    AvlBuilder_new(&builder, IntNode_compare, nullptr, IntNode_delete, nullptr);
+
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        nodes[i].key = keys[i];
+    }
+
+    for (std::size_t i = 0; i < keys.size() / 2; ++i) {
+        AvlBuilder_push(&builder, &nodes[i].node);
+    }
+
+    AvlBuilder_finish(&builder, &first);
+
+    for (std::size_t i = keys.size() / 2; i < keys.size(); ++i) {
+        AvlBuilder_push(&builder, &nodes[i].node);
+    }
+
+    AvlBuilder_finish(&builder, &second);
+    AvlBuilder_drop(&builder);
+
+    REQUIRE(checked_height(first.root) >= 0);
+    REQUIRE(checked_height(second.root) >= 0);
+    REQUIRE(keys_of(first) == std::vector<int>(keys.begin(), keys.begin() + 512));
+    REQUIRE(keys_of(second) == std::vector<int>(keys.begin() + 512, keys.end()));
+
+    for (int key : keys) {
+        AvlTree &tree = (key < keys[512]) ? first : second;
+
+        REQUIRE(AvlTree_get(&tree, &key, IntNode_het_compare, nullptr));
+    }
+
+    AvlTree_drop(&first);
+    AvlTree_drop(&second);
+}
+
+TEST_CASE("builder, ranked") {
+    std::vector<RankNode> nodes(1000);
+    AvlBuilder builder;
+    AvlTree tree;
+
+    AvlBuilder_new_ranked(&builder, RankNode_compare, nullptr, IntNode_delete, nullptr);
+
+    for (std::size_t i = 0; i < nodes.size(); ++i) {
+        nodes[i].key = static_cast<int>(i);
+        AvlBuilder_push(&builder, &nodes[i].node.node);
+    }
+
+    AvlBuilder_finish(&builder, &tree);
+    AvlBuilder_drop(&builder);
+    REQUIRE(tree.len == nodes.size());
+
+    for (std::size_t i = 0; i < nodes.size(); ++i) {
+        REQUIRE(AvlTree_select(&tree, i) == &nodes[i].node.node);
+    }
+
+    AvlTree_drop(&tree);
+}
@@ -0,0 +1,104 @@
+//  MIT License
+//
+//  Copyright (c) 2019 Gregory Meyer
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//  files (the "Software"), to deal in the Software without
+//  restriction, including without limitation the rights to use, copy,
+//  modify, merge, publish, distribute, sublicense, and/or sell copies
+//  of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice (including
+//  the next paragraph) shall be included in all copies or substantial
+//  portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+//  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+//  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+//  IN THE SOFTWARE.
+
+#include "int_node.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+constexpr std::size_t NUM_INSERTIONS = 4096;
+
+static void record_delete(AvlNode *node, void *deleted_v) {
+    auto &deleted = *static_cast<std::vector<int>*>(deleted_v);
+    IntNode &int_node = *reinterpret_cast<IntNode*>(node);
+
+    deleted.push_back(int_node.key);
+    int_node.key = -1; // the tree must not read a node after deleting it
+}
+
+TEST_CASE("AvlTree_clear_with passes each node to the deleter once") {
+    const auto urbg_ptr = make_urbg();
+    std::vector<int> deleted;
+    std::vector<IntNode> nodes(NUM_INSERTIONS);
+    std::vector<AvlNode*> ptrs(NUM_INSERTIONS);
+
+    for (std::size_t i = 0; i < NUM_INSERTIONS; ++i) {
+        nodes[i].key = static_cast<int>(i);
+        ptrs[i] = &nodes[i].node;
+    }
+
+    SECTION("random insertion") {
+        IntTree tree(rand_iota(NUM_INSERTIONS, *urbg_ptr));
+
+        AvlTree_clear_with(&tree.tree, record_delete, &deleted);
+
+        REQUIRE_FALSE(tree.tree.root);
+        REQUIRE(tree.tree.len == 0);
+    }
+
+    SECTION("bulk construction") {
+        AvlTree tree;
+
+        AvlTree_from_sorted(&tree, ptrs.data(), ptrs.size(), IntNode_compare, nullptr,
+                            record_delete, &deleted);
+        AvlTree_clear(&tree);
+
+        REQUIRE_FALSE(tree.root);
+        REQUIRE(tree.len == 0);
+    }
+
+    REQUIRE(sorted(std::move(deleted)) == iota(NUM_INSERTIONS));
+}
+
+TEST_CASE("AvlTree_clear_with a NULL deleter leaves the nodes alone") {
+    std::vector<int> deleted;
+    std::vector<IntNode> nodes(NUM_INSERTIONS);
+    AvlTree tree;
+
+    AvlTree_new(&tree, IntNode_compare, nullptr, record_delete, &deleted);
+
+    for (std::size_t i = 0; i < NUM_INSERTIONS; ++i) {
+        nodes[i].key = static_cast<int>(i);
+        AvlTree_insert(&tree, &nodes[i].node);
+    }
+
+    AvlTree_clear_with(&tree, nullptr, nullptr);
+
+    REQUIRE_FALSE(tree.root);
+    REQUIRE(tree.len == 0);
+    REQUIRE(deleted.empty());
+    REQUIRE(std::all_of(nodes.begin(), nodes.end(), [](const IntNode &n) { return n.key >= 0; }));
+
+    // the tree is still usable afterwards
+    REQUIRE_FALSE(AvlTree_insert(&tree, &nodes[0].node));
+    REQUIRE(tree.len == 1);
+
+    AvlTree_drop(&tree);
+    REQUIRE(deleted == std::vector<int>{0});
+}
@@ -0,0 +1,181 @@
+//  MIT License
+//
+//  Copyright (c) 2019 Gregory Meyer
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//  files (the "Software"), to deal in the Software without
+//  restriction, including without limitation the rights to use, copy,
+//  modify, merge, publish, distribute, sublicense, and/or sell copies
+//  of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice (including
+//  the next paragraph) shall be included in all copies or substantial
+//  portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+//  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+//  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+//  IN THE SOFTWARE.
+
+#include "bloodhound.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+constexpr std::size_t NUM_INSERTIONS = 512;
+
+namespace {
+
+struct CompactNode {
+    AvlCompactNode node;
+    int key;
+};
+
+int CompactNode_key(const AvlCompactNode *node) {
+    return reinterpret_cast<const CompactNode*>(node)->key;
+}
+
+int CompactNode_compare(const AvlCompactNode *lhs, const AvlCompactNode *rhs, void*) {
+    return (CompactNode_key(lhs) > CompactNode_key(rhs))
+           - (CompactNode_key(lhs) < CompactNode_key(rhs));
+}
+
+int CompactNode_het_compare(const void *lhs_v, const AvlCompactNode *rhs, void*) {
+    const int lhs = *static_cast<const int*>(lhs_v);
+
+    return (lhs > CompactNode_key(rhs)) - (lhs < CompactNode_key(rhs));
+}
+
+void CompactNode_count(AvlCompactNode*, void *count_v) {
+    ++*static_cast<std::size_t*>(count_v);
+}
+
+// height of a subtree, or -1 if its balance factors are wrong
+int checked_height(const AvlCompactNode *root) {
+    if (!root) {
+        return 0;
+    }
+
+    const int left = checked_height(AvlCompactNode_left(root));
+    const int right = checked_height(AvlCompactNode_right(root));
+
+    if (left < 0 || right < 0 || right - left != AvlCompactNode_balance_factor(root)) {
+        return -1;
+    }
+
+    return ((left < right) ? right : left) + 1;
+}
+
+void push_keys(const AvlCompactNode *root, std::vector<int> &keys) {
+    if (!root) {
+        return;
+    }
+
+    push_keys(AvlCompactNode_left(root), keys);
+    keys.push_back(CompactNode_key(root));
+    push_keys(AvlCompactNode_right(root), keys);
+}
+
+std::vector<int> keys_of(const AvlCompactTree &tree) {
+    std::vector<int> keys;
+    push_keys(tree.root, keys);
+
+    return keys;
+}
+
+} // namespace
+
+TEST_CASE("AvlCompactNode is two pointers") {
+    REQUIRE(sizeof(AvlCompactNode) == 2 * sizeof(void*));
+    REQUIRE(sizeof(AvlCompactNode) < sizeof(AvlNode));
+}
+
+TEST_CASE("AvlCompactTree insertion and lookup") {
+    const auto urbg_ptr = make_urbg();
+    const std::vector<int> keys = rand_iota(NUM_INSERTIONS, *urbg_ptr);
+    std::vector<CompactNode> nodes(keys.size() + 1);
+    std::size_t num_deleted = 0;
+    AvlCompactTree tree;
+
+    AvlCompactTree_new(&tree, CompactNode_compare, nullptr, CompactNode_count, &num_deleted);
+
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        nodes[i].key = keys[i];
+
+        REQUIRE_FALSE(AvlCompactTree_insert(&tree, &nodes[i].node));
+        REQUIRE(tree.len == i + 1);
+        REQUIRE(checked_height(tree.root) >= 0);
+    }
+
+    REQUIRE(keys_of(tree) == sorted(std::vector<int>(keys)));
+
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        REQUIRE(AvlCompactTree_get(&tree, &keys[i], CompactNode_het_compare, nullptr)
+                == &nodes[i].node);
+        REQUIRE(AvlCompactTree_get_mut(&tree, &keys[i], CompactNode_het_compare, nullptr)
+                == &nodes[i].node);
+    }
+
+    const int missing = -1;
+    REQUIRE_FALSE(AvlCompactTree_get(&tree, &missing, CompactNode_het_compare, nullptr));
+
+    // the spare node replaces the node with the same key in place
+    CompactNode &spare = nodes.back();
+    spare.key = keys[0];
+
+    REQUIRE(AvlCompactTree_insert(&tree, &spare.node) == &nodes[0].node);
+    REQUIRE(tree.len == keys.size());
+    REQUIRE(checked_height(tree.root) >= 0);
+    REQUIRE(AvlCompactTree_get(&tree, &keys[0], CompactNode_het_compare, nullptr) == &spare.node);
+    REQUIRE(keys_of(tree) == sorted(std::vector<int>(keys)));
+
+    AvlCompactTree_drop(&tree);
+    REQUIRE(num_deleted == keys.size());
+}
+
+TEST_CASE("AvlCompactTree removal") {
+    const auto urbg_ptr = make_urbg();
+    const std::vector<int> keys = rand_iota(NUM_INSERTIONS, *urbg_ptr);
+    std::vector<CompactNode> nodes(keys.size());
+    std::size_t num_deleted = 0;
+    AvlCompactTree tree;
+
+    AvlCompactTree_new(&tree, CompactNode_compare, nullptr, CompactNode_count, &num_deleted);
+
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        nodes[i].key = keys[i];
+        AvlCompactTree_insert(&tree, &nodes[i].node);
+    }
+
+    const int missing = static_cast<int>(NUM_INSERTIONS);
+    REQUIRE_FALSE(AvlCompactTree_remove(&tree, &missing, CompactNode_het_compare, nullptr));
+
+    std::vector<int> remaining = sorted(std::vector<int>(keys));
+
+    for (int key : shuffled(std::vector<int>(keys), *urbg_ptr)) {
+        const AvlCompactNode *const removed =
+            AvlCompactTree_remove(&tree, &key, CompactNode_het_compare, nullptr);
+
+        REQUIRE(removed);
+        REQUIRE(CompactNode_key(removed) == key);
+        REQUIRE(checked_height(tree.root) >= 0);
+
+        remaining.erase(std::find(remaining.begin(), remaining.end(), key));
+        REQUIRE(tree.len == remaining.size());
+        REQUIRE(keys_of(tree) == remaining);
+    }
+
+    REQUIRE_FALSE(tree.root);
+    AvlCompactTree_drop(&tree);
+    REQUIRE(num_deleted == 0);
+}
@@ -0,0 +1,202 @@
+//  MIT License
+//
+//  Copyright (c) 2019 Gregory Meyer
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//  files (the "Software"), to deal in the Software without
+//  restriction, including without limitation the rights to use, copy,
+//  modify, merge, publish, distribute, sublicense, and/or sell copies
+//  of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice (including
+//  the next paragraph) shall be included in all copies or substantial
+//  portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+//  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+//  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+//  IN THE SOFTWARE.
+
+#include "bloodhound_concurrent.h"
+#include "int_node.h"
+#include "util.h"
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+constexpr int NUM_STABLE_KEYS = 512;
+constexpr std::size_t NUM_READERS = 4;
+constexpr std::size_t NUM_WRITES = 20000;
+
+using TreePtr = std::unique_ptr<AvlConcurrentTree, decltype(&AvlConcurrentTree_drop)>;
+using ReaderPtr = std::unique_ptr<AvlReader, decltype(&AvlReader_drop)>;
+
+static AvlNode* make_node(int key) {
+    PersistentIntNode *const node = new PersistentIntNode;
+
+    node->key = key;
+
+    return &node->node.node;
+}
+
+static AvlNode* clone_node(const AvlNode *node, void*) {
+    return make_node(PersistentIntNode_key(node));
+}
+
+static void delete_node(AvlNode *node, void*) {
+    delete reinterpret_cast<PersistentIntNode*>(node);
+}
+
+static TreePtr make_tree() {
+    return TreePtr(AvlConcurrentTree_new(PersistentIntNode_compare, nullptr, clone_node, nullptr,
+                                         delete_node, nullptr),
+                   AvlConcurrentTree_drop);
+}
+
+static ReaderPtr make_reader(AvlConcurrentTree &tree) {
+    return ReaderPtr(AvlReader_new(&tree), AvlReader_drop);
+}
+
+static bool insert_key(AvlConcurrentTree &tree, int key) {
+    return AvlConcurrentTree_insert(&tree, make_node(key)) != 0;
+}
+
+static bool contains(const AvlConcurrentTree &tree, const AvlReader &reader, int key) {
+    const AvlNode *const node =
+        AvlConcurrentTree_get(&tree, &reader, &key, PersistentIntNode_het_compare, nullptr);
+
+    return node && PersistentIntNode_key(node) == key;
+}
+
+TEST_CASE("AvlConcurrentTree behaves like an AvlTree from a single thread") {
+    const auto urbg_ptr = make_urbg();
+    const auto tree_ptr = make_tree();
+    const auto reader_ptr = make_reader(*tree_ptr);
+    const std::vector<int> keys = rand_iota(NUM_STABLE_KEYS, *urbg_ptr);
+
+    for (int key : keys) {
+        REQUIRE_FALSE(insert_key(*tree_ptr, key));
+    }
+
+    REQUIRE(insert_key(*tree_ptr, keys.front()));
+    REQUIRE(AvlConcurrentTree_len(tree_ptr.get()) == keys.size());
+
+    AvlReader_enter(reader_ptr.get());
+
+    for (int key : keys) {
+        REQUIRE(contains(*tree_ptr, *reader_ptr, key));
+    }
+
+    const int missing = NUM_STABLE_KEYS;
+    REQUIRE_FALSE(contains(*tree_ptr, *reader_ptr, missing));
+
+    std::vector<const AvlNode*> nodes(keys.size() + 1);
+    const int lower = NUM_STABLE_KEYS / 2;
+
+    REQUIRE(AvlConcurrentTree_scan(tree_ptr.get(), reader_ptr.get(), nullptr, nullptr, nullptr,
+                                   nodes.data(), nodes.size()) == keys.size());
+
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        REQUIRE(PersistentIntNode_key(nodes[i]) == static_cast<int>(i));
+    }
+
+    REQUIRE(AvlConcurrentTree_scan(tree_ptr.get(), reader_ptr.get(), &lower,
+                                   PersistentIntNode_het_compare, nullptr, nodes.data(), 10) == 10);
+
+    for (std::size_t i = 0; i < 10; ++i) {
+        REQUIRE(PersistentIntNode_key(nodes[i]) == lower + static_cast<int>(i));
+    }
+
+    AvlReader_exit(reader_ptr.get());
+
+    for (int key : keys) {
+        REQUIRE(AvlConcurrentTree_remove(tree_ptr.get(), &key, PersistentIntNode_het_compare,
+                                         nullptr));
+        REQUIRE_FALSE(AvlConcurrentTree_remove(tree_ptr.get(), &key, PersistentIntNode_het_compare,
+                                               nullptr));
+    }
+
+    REQUIRE(AvlConcurrentTree_len(tree_ptr.get()) == 0);
+}
+
+TEST_CASE("AvlConcurrentTree readers never miss stable keys while a writer churns") {
+    const auto urbg_ptr = make_urbg();
+    const auto tree_ptr = make_tree();
+    AvlConcurrentTree &tree = *tree_ptr;
+
+    // even keys are never touched again, odd keys come and go
+    for (int key : shuffled(iota(NUM_STABLE_KEYS), *urbg_ptr)) {
+        insert_key(tree, key * 2);
+    }
+
+    std::atomic<bool> is_done(false);
+    std::atomic<std::size_t> num_failures(0);
+    std::vector<std::thread> readers;
+
+    for (std::size_t i = 0; i < NUM_READERS; ++i) {
+        readers.emplace_back([&tree, &is_done, &num_failures] {
+            const auto reader_ptr = make_reader(tree);
+            std::vector<const AvlNode*> nodes(NUM_STABLE_KEYS * 2);
+
+            while (!is_done.load()) {
+                AvlReader_enter(reader_ptr.get());
+
+                for (int key = 0; key < NUM_STABLE_KEYS * 2; key += 2) {
+                    if (!contains(tree, *reader_ptr, key)) {
+                        ++num_failures;
+                    }
+                }
+
+                const std::size_t num_nodes =
+                    AvlConcurrentTree_scan(&tree, reader_ptr.get(), nullptr, nullptr, nullptr,
+                                           nodes.data(), nodes.size());
+                std::size_t num_even = 0;
+
+                for (std::size_t j = 0; j < num_nodes; ++j) {
+                    const int key = PersistentIntNode_key(nodes[j]);
+
+                    num_even += (key % 2 == 0);
+
+                    if (j > 0 && PersistentIntNode_key(nodes[j - 1]) >= key) {
+                        ++num_failures;
+                    }
+                }
+
+                if (num_even != NUM_STABLE_KEYS) {
+                    ++num_failures;
+                }
+
+                AvlReader_exit(reader_ptr.get());
+            }
+        });
+    }
+
+    for (std::size_t i = 0; i < NUM_WRITES; ++i) {
+        const int key = static_cast<int>((*urbg_ptr)() % NUM_STABLE_KEYS) * 2 + 1;
+
+        if (i % 2 == 0) {
+            insert_key(tree, key);
+        } else {
+            AvlConcurrentTree_remove(&tree, &key, PersistentIntNode_het_compare, nullptr);
+        }
+    }
+
+    is_done.store(true);
+
+    for (std::thread &reader : readers) {
+        reader.join();
+    }
+
+    REQUIRE(num_failures.load() == 0);
+}
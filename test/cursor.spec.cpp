@@ -0,0 +1,124 @@
+//  MIT License
+//
+//  Copyright (c) 2019 Gregory Meyer
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//  files (the "Software"), to deal in the Software without
+//  restriction, including without limitation the rights to use, copy,
+//  modify, merge, publish, distribute, sublicense, and/or sell copies
+//  of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice (including
+//  the next paragraph) shall be included in all copies or substantial
+//  portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+//  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+//  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+//  IN THE SOFTWARE.
+
+#include "int_node.h"
+#include "util.h"
+
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+constexpr std::size_t NUM_INSERTIONS = 2048;
+
+static void push_key(void *keys_v, const AvlNode *node) {
+    static_cast<std::vector<int>*>(keys_v)->push_back(IntNode_key(node));
+}
+
+static void increment_key(void *count_v, AvlNode *node) {
+    ++reinterpret_cast<IntNode*>(node)->key;
+    ++*static_cast<std::size_t*>(count_v);
+}
+
+TEST_CASE("empty cursor") {
+    IntTree tree({});
+    AvlCursor cursor;
+
+    AvlCursor_first(&cursor, &tree.tree);
+    REQUIRE_FALSE(AvlCursor_get(&cursor));
+
+    AvlCursor_last(&cursor, &tree.tree);
+    REQUIRE_FALSE(AvlCursor_get(&cursor));
+
+    AvlCursor_next(&cursor);
+    REQUIRE_FALSE(AvlCursor_get(&cursor));
+}
+
+TEST_CASE("random insert, forward cursor") {
+    const auto urbg_ptr = make_urbg();
+    IntTree tree(rand_iota(NUM_INSERTIONS, *urbg_ptr));
+    AvlCursor cursor;
+    int expected = 0;
+
+    for (AvlCursor_first(&cursor, &tree.tree); AvlCursor_get(&cursor);
+         AvlCursor_next(&cursor)) {
+        REQUIRE(IntNode_key(AvlCursor_get(&cursor)) == expected);
+        ++expected;
+    }
+
+    REQUIRE(expected == static_cast<int>(NUM_INSERTIONS));
+}
+
+TEST_CASE("random insert, backward cursor") {
+    const auto urbg_ptr = make_urbg();
+    IntTree tree(rand_iota(NUM_INSERTIONS, *urbg_ptr));
+    AvlCursor cursor;
+    int expected = static_cast<int>(NUM_INSERTIONS) - 1;
+
+    for (AvlCursor_last(&cursor, &tree.tree); AvlCursor_get(&cursor);
+         AvlCursor_prev(&cursor)) {
+        REQUIRE(IntNode_key(AvlCursor_get(&cursor)) == expected);
+        --expected;
+    }
+
+    REQUIRE(expected == -1);
+}
+
+TEST_CASE("random insert, alternating cursor") {
+    const auto urbg_ptr = make_urbg();
+    IntTree tree(rand_iota(NUM_INSERTIONS, *urbg_ptr));
+    AvlCursor cursor;
+
+    AvlCursor_first(&cursor, &tree.tree);
+
+    for (int i = 0; i + 1 < static_cast<int>(NUM_INSERTIONS); ++i) {
+        AvlCursor_next(&cursor);
+        REQUIRE(IntNode_key(AvlCursor_get(&cursor)) == i + 1);
+
+        AvlCursor_prev(&cursor);
+        REQUIRE(IntNode_key(AvlCursor_get(&cursor)) == i);
+
+        AvlCursor_next(&cursor);
+    }
+
+    AvlCursor_next(&cursor);
+    REQUIRE_FALSE(AvlCursor_get(&cursor));
+}
+
+TEST_CASE("random insert, traverse") {
+    const auto urbg_ptr = make_urbg();
+    IntTree tree(rand_iota(NUM_INSERTIONS, *urbg_ptr));
+    std::vector<int> keys;
+
+    AvlTree_traverse(&tree.tree, push_key, &keys);
+    REQUIRE(keys == iota(NUM_INSERTIONS));
+
+    std::size_t count = 0;
+    AvlTree_traverse_mut(&tree.tree, increment_key, &count);
+    REQUIRE(count == NUM_INSERTIONS);
+
+    keys.clear();
+    AvlTree_traverse(&tree.tree, push_key, &keys);
+    REQUIRE(keys == iota(NUM_INSERTIONS, 1));
+}
@@ -0,0 +1,141 @@
+//  MIT License
+//
+//  Copyright (c) 2019 Gregory Meyer
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//  files (the "Software"), to deal in the Software without
+//  restriction, including without limitation the rights to use, copy,
+//  modify, merge, publish, distribute, sublicense, and/or sell copies
+//  of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice (including
+//  the next paragraph) shall be included in all copies or substantial
+//  portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+//  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+//  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+//  IN THE SOFTWARE.
+
+#include "avl_map.h"
+#include "int_node.h"
+#include "util.h"
+
+#include <string>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+constexpr std::size_t NUM_INSERTIONS = 2048;
+
+TEST_CASE("entry, insert into vacant entries") {
+    const auto urbg_ptr = make_urbg();
+    const std::vector<int> keys = rand_iota(NUM_INSERTIONS, *urbg_ptr);
+    std::vector<IntNode> nodes(keys.size());
+    AvlTree tree;
+
+    AvlTree_new(&tree, IntNode_compare, nullptr, IntNode_delete, nullptr);
+
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        AvlEntry entry;
+
+        REQUIRE_FALSE(AvlTree_entry(&tree, &entry, &keys[i], IntNode_het_compare, nullptr));
+
+        nodes[i].key = keys[i];
+        AvlTree_insert_entry(&tree, &entry, &nodes[i].node);
+        REQUIRE(tree.len == i + 1);
+    }
+
+    REQUIRE(checked_height(tree.root) >= 0);
+    REQUIRE(keys_of(tree) == iota(NUM_INSERTIONS));
+
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        AvlEntry entry;
+
+        REQUIRE(AvlTree_entry(&tree, &entry, &keys[i], IntNode_het_compare, nullptr)
+                == &nodes[i].node);
+        REQUIRE(AvlCursor_get(&entry.cursor) == &nodes[i].node);
+    }
+
+    AvlTree_drop(&tree);
+}
+
+TEST_CASE("entry, replace and remove occupied entries") {
+    std::vector<IntNode> nodes(64);
+    std::vector<IntNode> replacements(nodes.size());
+    AvlTree tree;
+
+    AvlTree_new(&tree, IntNode_compare, nullptr, IntNode_delete, nullptr);
+
+    for (std::size_t i = 0; i < nodes.size(); ++i) {
+        nodes[i].key = static_cast<int>(i);
+        replacements[i].key = static_cast<int>(i);
+        AvlTree_insert(&tree, &nodes[i].node);
+    }
+
+    for (int key = 0; key < 64; key += 2) {
+        AvlEntry entry;
+        const auto index = static_cast<std::size_t>(key);
+
+        REQUIRE(AvlTree_entry(&tree, &entry, &key, IntNode_het_compare, nullptr));
+        REQUIRE(AvlTree_replace_at(&tree, &entry.cursor, &replacements[index].node)
+                == &nodes[index].node);
+
+        const int next = key + 1;
+        REQUIRE(AvlTree_entry(&tree, &entry, &next, IntNode_het_compare, nullptr));
+        REQUIRE(AvlTree_remove_at(&tree, &entry.cursor) == &nodes[index + 1].node);
+    }
+
+    REQUIRE(tree.len == 32);
+    REQUIRE(checked_height(tree.root) >= 0);
+    REQUIRE(keys_of(tree) == mapped(iota(32), [](int i) { return i * 2; }));
+
+    for (int key = 0; key < 64; key += 2) {
+        REQUIRE(AvlTree_get(&tree, &key, IntNode_het_compare, nullptr)
+                == &replacements[static_cast<std::size_t>(key)].node);
+    }
+
+    AvlTree_drop(&tree);
+}
+
+TEST_CASE("map entry") {
+    avl::Map<std::string, int> map;
+
+    auto entry = map.entry(std::string("foo"));
+    REQUIRE_FALSE(entry.get());
+
+    std::pair<std::string, int> &inserted = entry.insert("foo", 5);
+    REQUIRE(entry.get() == &inserted);
+    REQUIRE(map.size() == 1);
+    REQUIRE(map.get("foo"));
+    REQUIRE(*map.get("foo") == 5);
+
+    auto again = map.entry(std::string("foo"));
+    REQUIRE(again.get() == &inserted);
+    ++again.get()->second;
+    REQUIRE(*map.get("foo") == 6);
+}
+
+TEST_CASE("map insert and insert or assign update in place") {
+    avl::Map<std::string, int> map;
+
+    std::pair<std::string, int> &first = map.insert("foo", 5).first;
+    const auto replaced = map.insert("foo", 6);
+
+    REQUIRE(replaced.second);
+    REQUIRE(&replaced.first == &first);
+    REQUIRE(first.second == 6);
+
+    const auto assigned = map.insert_or_assign("foo", 7);
+
+    REQUIRE_FALSE(assigned.second);
+    REQUIRE(&assigned.first == &first);
+    REQUIRE(first.second == 7);
+    REQUIRE(map.size() == 1);
+}
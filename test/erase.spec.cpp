@@ -0,0 +1,116 @@
+//  MIT License
+//
+//  Copyright (c) 2019 Gregory Meyer
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//  files (the "Software"), to deal in the Software without
+//  restriction, including without limitation the rights to use, copy,
+//  modify, merge, publish, distribute, sublicense, and/or sell copies
+//  of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice (including
+//  the next paragraph) shall be included in all copies or substantial
+//  portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+//  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+//  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+//  IN THE SOFTWARE.
+
+#include "int_node.h"
+#include "util.h"
+
+#include <cstddef>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+namespace {
+
+void count_delete(AvlNode*, void *arg) {
+    ++*static_cast<std::size_t*>(arg);
+}
+
+AvlCursor bound(const AvlTree &tree, int key) {
+    AvlCursor cursor;
+
+    AvlTree_lower_bound(&tree, &key, IntNode_het_compare, nullptr, &cursor);
+
+    return cursor;
+}
+
+} // namespace
+
+TEST_CASE("AvlTree_erase_range") {
+    const auto urbg_ptr = make_urbg();
+    const int n = 100;
+
+    for (int begin = 0; begin <= n; begin += 7) {
+        for (int end = begin; end <= n; end += 5) {
+            const std::vector<int> keys = rand_iota(static_cast<std::size_t>(n), *urbg_ptr);
+            std::vector<IntNode> nodes(keys.size());
+            std::size_t num_deleted = 0;
+            AvlTree tree;
+
+            AvlTree_new(&tree, IntNode_compare, nullptr, count_delete, &num_deleted);
+
+            for (std::size_t i = 0; i < keys.size(); ++i) {
+                nodes[i].key = keys[i];
+                AvlTree_insert(&tree, &nodes[i].node);
+            }
+
+            const AvlCursor first = bound(tree, begin);
+            const AvlCursor last = bound(tree, end);
+            std::vector<int> expected = iota(static_cast<std::size_t>(begin));
+
+            for (int key = end; key < n; ++key) {
+                expected.push_back(key);
+            }
+
+            REQUIRE(AvlTree_erase_range(&tree, &first, &last)
+                    == static_cast<std::size_t>(end - begin));
+            REQUIRE(num_deleted == static_cast<std::size_t>(end - begin));
+            REQUIRE(tree.len == expected.size());
+            REQUIRE(checked_height(tree.root) >= 0);
+            REQUIRE(keys_of(tree) == expected);
+
+            AvlTree_drop(&tree);
+        }
+    }
+}
+
+TEST_CASE("AvlTree_erase_at") {
+    const auto urbg_ptr = make_urbg();
+    const std::vector<int> keys = rand_iota(256, *urbg_ptr);
+    std::vector<IntNode> nodes(keys.size());
+    std::size_t num_deleted = 0;
+    AvlTree tree;
+
+    AvlTree_new(&tree, IntNode_compare, nullptr, count_delete, &num_deleted);
+
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        nodes[i].key = keys[i];
+        AvlTree_insert(&tree, &nodes[i].node);
+    }
+
+    // erase every other node, always from the front
+    for (std::size_t i = 0; i < keys.size() / 2; ++i) {
+        AvlCursor cursor = bound(tree, 2 * static_cast<int>(i));
+
+        AvlTree_erase_at(&tree, &cursor);
+        REQUIRE(cursor.len == 0);
+        REQUIRE(num_deleted == i + 1);
+    }
+
+    REQUIRE(tree.len == keys.size() / 2);
+    REQUIRE(checked_height(tree.root) >= 0);
+    REQUIRE(keys_of(tree) == mapped(iota(keys.size() / 2), [](int i) { return 2 * i + 1; }));
+
+    AvlTree_drop(&tree);
+}
@@ -0,0 +1,176 @@
+//  MIT License
+//
+//  Copyright (c) 2019 Gregory Meyer
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//  files (the "Software"), to deal in the Software without
+//  restriction, including without limitation the rights to use, copy,
+//  modify, merge, publish, distribute, sublicense, and/or sell copies
+//  of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice (including
+//  the next paragraph) shall be included in all copies or substantial
+//  portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+//  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+//  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+//  IN THE SOFTWARE.
+
+#include "int_node.h"
+#include "util.h"
+
+#include <cstddef>
+#include <random>
+#include <set>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+constexpr std::size_t NUM_KEYS = 2048;
+
+namespace {
+
+// keys that wander around a moving point, like a replay of nearby ticks
+std::vector<int> walk(std::size_t n, std::mt19937 &urbg) {
+    std::uniform_int_distribution<int> step(-8, 16);
+    std::vector<int> keys;
+    int key = 0;
+
+    for (std::size_t i = 0; i < n; ++i) {
+        key += step(urbg);
+        keys.push_back(key);
+    }
+
+    return keys;
+}
+
+bool is_path_from_root(const AvlTree &tree, const AvlCursor &finger) {
+    if (finger.len == 0) {
+        return true;
+    }
+
+    if (finger.path[0] != tree.root) {
+        return false;
+    }
+
+    for (std::size_t i = 1; i < finger.len; ++i) {
+        const AvlNode *const parent = finger.path[i - 1];
+
+        if (parent->left != finger.path[i] && parent->right != finger.path[i]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+} // namespace
+
+TEST_CASE("AvlTree_get_from") {
+    const auto urbg_ptr = make_urbg();
+    const IntTree tree(shuffled(mapped(iota(NUM_KEYS), [](int i) { return 2 * i; }), *urbg_ptr));
+    AvlCursor finger;
+
+    finger.len = 0;
+
+    SECTION("sorted probes") {
+        for (int key = -3; key < 2 * static_cast<int>(NUM_KEYS) + 3; ++key) {
+            REQUIRE(AvlTree_get_from(&tree.tree, &finger, &key, IntNode_het_compare, nullptr)
+                    == AvlTree_get(&tree.tree, &key, IntNode_het_compare, nullptr));
+            REQUIRE(is_path_from_root(tree.tree, finger));
+        }
+    }
+
+    SECTION("random probes") {
+        for (int key : rand_iota(2 * NUM_KEYS, *urbg_ptr)) {
+            REQUIRE(AvlTree_get_from(&tree.tree, &finger, &key, IntNode_het_compare, nullptr)
+                    == AvlTree_get(&tree.tree, &key, IntNode_het_compare, nullptr));
+            REQUIRE(is_path_from_root(tree.tree, finger));
+        }
+    }
+
+    SECTION("from a cursor") {
+        const int key = 1000;
+
+        AvlCursor_last(&finger, &tree.tree);
+        REQUIRE(IntNode_key(AvlTree_get_from(&tree.tree, &finger, &key, IntNode_het_compare,
+                                             nullptr)) == key);
+        REQUIRE(IntNode_key(AvlCursor_get(&finger)) == key);
+    }
+
+    SECTION("empty tree") {
+        const IntTree empty({});
+        const int key = 0;
+
+        REQUIRE_FALSE(AvlTree_get_from(&empty.tree, &finger, &key, IntNode_het_compare, nullptr));
+        REQUIRE(finger.len == 0);
+    }
+}
+
+TEST_CASE("AvlTree_insert_from and AvlTree_remove_from") {
+    const auto urbg_ptr = make_urbg();
+    const std::vector<int> keys = walk(4 * NUM_KEYS, *urbg_ptr);
+    std::vector<IntNode> nodes(keys.size());
+    std::set<int> expected;
+    AvlTree tree;
+    AvlCursor finger;
+
+    AvlTree_new(&tree, IntNode_compare, nullptr, IntNode_delete, nullptr);
+    finger.len = 0;
+
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        nodes[i].key = keys[i];
+
+        AvlNode *const previous = AvlTree_insert_from(&tree, &finger, &nodes[i].node);
+
+        REQUIRE((previous != nullptr) == !expected.insert(keys[i]).second);
+        REQUIRE(is_path_from_root(tree, finger));
+    }
+
+    REQUIRE(tree.len == expected.size());
+    REQUIRE(checked_height(tree.root) >= 0);
+    REQUIRE(keys_of(tree) == std::vector<int>(expected.begin(), expected.end()));
+
+    // walk back over the same keys, removing every other one
+    for (std::size_t i = keys.size(); i-- > 0;) {
+        const int key = keys[i] + static_cast<int>(i % 2);
+        const AvlNode *const removed = AvlTree_remove_from(&tree, &finger, &key,
+                                                           IntNode_het_compare, nullptr);
+
+        REQUIRE((removed != nullptr) == (expected.erase(key) == 1));
+        REQUIRE((!removed || IntNode_key(removed) == key));
+        REQUIRE(is_path_from_root(tree, finger));
+    }
+
+    REQUIRE(tree.len == expected.size());
+    REQUIRE(checked_height(tree.root) >= 0);
+    REQUIRE(keys_of(tree) == std::vector<int>(expected.begin(), expected.end()));
+
+    AvlTree_drop(&tree);
+}
+
+#ifdef BLOODHOUND_STATS
+TEST_CASE("AvlTree_get_from climbs only as far as needed") {
+    IntTree tree(iota(1 << 16));
+    AvlCursor finger;
+    AvlTreeStats lookups = AvlTreeStats();
+
+    finger.len = 0;
+    AvlTree_set_lookup_stats(&tree.tree, &lookups);
+
+    for (int key = 0; key < (1 << 16); ++key) {
+        REQUIRE(AvlTree_get_from(&tree.tree, &finger, &key, IntNode_het_compare, nullptr));
+    }
+
+    // a search from the root would make about 16 comparisons per key
+    REQUIRE(lookups.num_searches == 1 << 16);
+    REQUIRE(lookups.num_comparisons < 4 * (1 << 16));
+}
+#endif
@@ -0,0 +1,101 @@
+//  MIT License
+//
+//  Copyright (c) 2019 Gregory Meyer
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//  files (the "Software"), to deal in the Software without
+//  restriction, including without limitation the rights to use, copy,
+//  modify, merge, publish, distribute, sublicense, and/or sell copies
+//  of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice (including
+//  the next paragraph) shall be included in all copies or substantial
+//  portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+//  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+//  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+//  IN THE SOFTWARE.
+
+#include "int_node.h"
+#include "util.h"
+
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+constexpr std::size_t NUM_INSERTIONS = 2048;
+
+static void push_key(void *keys_v, const AvlNode *node) {
+    static_cast<std::vector<int>*>(keys_v)->push_back(IntNode_key(node));
+}
+
+static std::vector<AvlNode*> pointers_to(std::vector<IntNode> &nodes) {
+    std::vector<AvlNode*> pointers;
+
+    for (IntNode &node : nodes) {
+        pointers.push_back(&node.node);
+    }
+
+    return pointers;
+}
+
+TEST_CASE("from sorted, traverse") {
+    for (std::size_t n = 0; n <= 64; ++n) {
+        std::vector<IntNode> nodes(n);
+
+        for (std::size_t i = 0; i < n; ++i) {
+            nodes[i].key = static_cast<int>(i);
+        }
+
+        std::vector<AvlNode*> pointers = pointers_to(nodes);
+        AvlTree tree;
+        std::vector<int> keys;
+
+        AvlTree_from_sorted(&tree, pointers.data(), n, IntNode_compare, nullptr,
+                            IntNode_delete, nullptr);
+        REQUIRE(tree.len == n);
+
+        AvlTree_traverse(&tree, push_key, &keys);
+        REQUIRE(keys == iota(n));
+
+        AvlTree_drop(&tree);
+    }
+}
+
+TEST_CASE("from sorted, random get and remove") {
+    const auto urbg_ptr = make_urbg();
+    std::vector<IntNode> nodes(NUM_INSERTIONS);
+
+    for (std::size_t i = 0; i < NUM_INSERTIONS; ++i) {
+        nodes[i].key = static_cast<int>(i);
+    }
+
+    std::vector<AvlNode*> pointers = pointers_to(nodes);
+    AvlTree tree;
+
+    AvlTree_from_sorted(&tree, pointers.data(), NUM_INSERTIONS, IntNode_compare, nullptr,
+                        IntNode_delete, nullptr);
+
+    const std::vector<int> keys = rand_iota(NUM_INSERTIONS, *urbg_ptr);
+
+    for (int i : keys) {
+        const AvlNode *const node = AvlTree_get(&tree, &i, IntNode_het_compare, nullptr);
+
+        REQUIRE(node);
+        REQUIRE(IntNode_key(node) == i);
+    }
+
+    for (int i : keys) {
+        REQUIRE(AvlTree_remove(&tree, &i, IntNode_het_compare, nullptr));
+    }
+
+    REQUIRE(tree.len == 0);
+    REQUIRE_FALSE(tree.root);
+}
@@ -0,0 +1,243 @@
+//  MIT License
+//
+//  Copyright (c) 2019 Gregory Meyer
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//  files (the "Software"), to deal in the Software without
+//  restriction, including without limitation the rights to use, copy,
+//  modify, merge, publish, distribute, sublicense, and/or sell copies
+//  of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice (including
+//  the next paragraph) shall be included in all copies or substantial
+//  portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+//  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+//  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+//  IN THE SOFTWARE.
+
+#include "int_node.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+constexpr std::size_t NUM_KEYS = 1000;
+
+namespace {
+
+// the frozen tree must agree with std::lower_bound over sorted keys
+void require_matches(const AvlFrozenTree &frozen, const std::vector<int> &keys) {
+    const std::vector<int> expected = sorted(std::vector<int>(keys));
+
+    REQUIRE(frozen.len == keys.size());
+
+    for (int key = -1; key <= 2 * static_cast<int>(NUM_KEYS) + 1; ++key) {
+        const auto it = std::lower_bound(expected.begin(), expected.end(), key);
+        const AvlNode *const lower =
+            AvlFrozenTree_lower_bound(&frozen, &key, IntNode_het_compare, nullptr);
+        const AvlNode *const found = AvlFrozenTree_get(&frozen, &key, IntNode_het_compare, nullptr);
+
+        if (it == expected.end()) {
+            REQUIRE_FALSE(lower);
+        } else {
+            REQUIRE(lower);
+            REQUIRE(IntNode_key(lower) == *it);
+        }
+
+        if (it != expected.end() && *it == key) {
+            REQUIRE(found == lower);
+        } else {
+            REQUIRE_FALSE(found);
+        }
+    }
+}
+
+} // namespace
+
+TEST_CASE("AvlTree_freeze") {
+    const auto urbg_ptr = make_urbg();
+
+    SECTION("empty tree") {
+        IntTree tree({});
+        AvlFrozenTree frozen;
+
+        AvlTree_freeze(&tree.tree, &frozen);
+        require_matches(frozen, {});
+        AvlFrozenTree_drop(&frozen);
+    }
+
+    SECTION("every size up to 64") {
+        for (int n = 1; n <= 64; ++n) {
+            const std::vector<int> keys =
+                shuffled(mapped(iota(static_cast<std::size_t>(n)), [](int i) { return 2 * i; }),
+                         *urbg_ptr);
+            IntTree tree(keys);
+            AvlFrozenTree frozen;
+
+            AvlTree_freeze(&tree.tree, &frozen);
+            require_matches(frozen, keys);
+            AvlFrozenTree_drop(&frozen);
+        }
+    }
+
+    SECTION("even keys") {
+        const std::vector<int> keys =
+            shuffled(mapped(iota(NUM_KEYS), [](int i) { return 2 * i; }), *urbg_ptr);
+        IntTree tree(keys);
+        AvlFrozenTree frozen;
+
+        AvlTree_freeze(&tree.tree, &frozen);
+        require_matches(frozen, keys);
+
+        for (int key : keys) {
+            REQUIRE(AvlFrozenTree_get(&frozen, &key, IntNode_het_compare, nullptr)
+                    == AvlTree_get(&tree.tree, &key, IntNode_het_compare, nullptr));
+        }
+
+        AvlFrozenTree_drop(&frozen);
+    }
+
+    SECTION("copies") {
+        const std::vector<int> keys =
+            shuffled(mapped(iota(NUM_KEYS), [](int i) { return 2 * i; }), *urbg_ptr);
+        IntTree tree(keys);
+        AvlFrozenTree frozen;
+
+        AvlTree_freeze_copies(&tree.tree, &frozen, sizeof(IntNode));
+        require_matches(frozen, keys);
+
+        for (int key : keys) {
+            const AvlNode *const copy = AvlFrozenTree_get(&frozen, &key, IntNode_het_compare,
+                                                          nullptr);
+
+            REQUIRE(copy);
+            REQUIRE(copy != AvlTree_get(&tree.tree, &key, IntNode_het_compare, nullptr));
+        }
+
+        // a snapshot of copies outlives changes to its nodes
+        AvlTree_clear(&tree.tree);
+        require_matches(frozen, keys);
+
+        AvlFrozenTree_refreeze(&frozen, &tree.tree);
+        require_matches(frozen, {});
+
+        AvlFrozenTree_drop(&frozen);
+    }
+}
+
+TEST_CASE("AvlFrozenTree_refreeze") {
+    const auto urbg_ptr = make_urbg();
+    const std::vector<int> keys = rand_iota(NUM_KEYS, *urbg_ptr);
+    std::vector<IntNode> nodes(keys.size());
+    AvlTree tree;
+    AvlFrozenTree frozen;
+
+    AvlTree_new(&tree, IntNode_compare, nullptr, IntNode_delete, nullptr);
+    AvlTree_freeze(&tree, &frozen);
+
+    std::vector<int> inserted;
+
+    // grow the tree in steps, rebuilding the snapshot after each one
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        nodes[i].key = keys[i];
+        AvlTree_insert(&tree, &nodes[i].node);
+        inserted.push_back(keys[i]);
+
+        if (i % 100 == 99) {
+            AvlFrozenTree_refreeze(&frozen, &tree);
+            require_matches(frozen, inserted);
+        }
+    }
+
+    // then shrink it, which reuses the snapshot's memory
+    for (std::size_t i = 0; i < keys.size() / 2; ++i) {
+        AvlTree_remove(&tree, &keys[i], IntNode_het_compare, nullptr);
+    }
+
+    AvlFrozenTree_refreeze(&frozen, &tree);
+    require_matches(frozen, std::vector<int>(keys.begin() + keys.size() / 2, keys.end()));
+
+    AvlFrozenTree_drop(&frozen);
+    AvlTree_drop(&tree);
+}
+
+TEST_CASE("AvlTree_write_image") {
+    const auto urbg_ptr = make_urbg();
+    const std::vector<int> keys =
+        shuffled(mapped(iota(NUM_KEYS), [](int i) { return 2 * i; }), *urbg_ptr);
+    IntTree tree(keys);
+    const std::size_t size = AvlTree_image_size(&tree.tree, sizeof(IntNode));
+
+    // IntNode-aligned storage for the image and for a copy of it
+    std::vector<IntNode> written(size / sizeof(IntNode) + 1);
+    std::vector<IntNode> moved(written.size());
+    AvlFrozenTree frozen;
+
+    AvlTree_write_image(&tree.tree, sizeof(IntNode), written.data());
+
+    SECTION("relocated") {
+        // an image refers to nothing outside itself, so it can be moved
+        // anywhere once the tree it was written from is gone
+        std::memcpy(moved.data(), written.data(), size);
+        AvlTree_clear(&tree.tree);
+        std::memset(static_cast<void*>(written.data()), 0, size);
+
+        REQUIRE(AvlFrozenTree_from_image(&frozen, moved.data(), size));
+        require_matches(frozen, keys);
+
+        // refreezing copies into new memory and leaves the image alone
+        AvlFrozenTree_refreeze(&frozen, &tree.tree);
+        require_matches(frozen, {});
+        AvlFrozenTree_drop(&frozen);
+
+        REQUIRE(AvlFrozenTree_from_image(&frozen, moved.data(), size));
+        require_matches(frozen, keys);
+        AvlFrozenTree_drop(&frozen);
+    }
+
+    SECTION("read-only") {
+        // as from a PROT_READ mapping
+        const std::vector<IntNode> &image = written;
+
+        REQUIRE(AvlFrozenTree_from_image(&frozen, image.data(), size));
+        require_matches(frozen, keys);
+        AvlFrozenTree_drop(&frozen);
+    }
+
+    SECTION("deterministic") {
+        IntTree rebuilt(sorted(std::vector<int>(keys)));
+
+        AvlTree_write_image(&rebuilt.tree, sizeof(IntNode), moved.data());
+        REQUIRE(std::memcmp(written.data(), moved.data(), size) == 0);
+    }
+
+    SECTION("rejects bad images") {
+        REQUIRE_FALSE(AvlFrozenTree_from_image(&frozen, written.data(), size - 1));
+        REQUIRE_FALSE(AvlFrozenTree_from_image(&frozen, written.data(), 16));
+
+        reinterpret_cast<char*>(written.data())[0] ^= 1;
+        REQUIRE_FALSE(AvlFrozenTree_from_image(&frozen, written.data(), size));
+    }
+
+    SECTION("empty tree") {
+        IntTree empty({});
+        const std::size_t empty_size = AvlTree_image_size(&empty.tree, sizeof(IntNode));
+
+        AvlTree_write_image(&empty.tree, sizeof(IntNode), moved.data());
+        REQUIRE(AvlFrozenTree_from_image(&frozen, moved.data(), empty_size));
+        require_matches(frozen, {});
+        AvlFrozenTree_drop(&frozen);
+    }
+}
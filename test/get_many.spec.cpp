@@ -0,0 +1,120 @@
+//  MIT License
+//
+//  Copyright (c) 2019 Gregory Meyer
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//  files (the "Software"), to deal in the Software without
+//  restriction, including without limitation the rights to use, copy,
+//  modify, merge, publish, distribute, sublicense, and/or sell copies
+//  of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice (including
+//  the next paragraph) shall be included in all copies or substantial
+//  portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+//  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+//  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+//  IN THE SOFTWARE.
+
+#include "int_node.h"
+#include "util.h"
+
+#include <cstddef>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+constexpr std::size_t NUM_KEYS = 1000;
+
+namespace {
+
+// 2006 keys, so the last batch has fewer than AVL_GET_MANY_LANES of them
+std::vector<int> probe_keys() {
+    std::vector<int> probes;
+
+    for (int key = -3; key < 2 * static_cast<int>(NUM_KEYS) + 3; ++key) {
+        probes.push_back(key);
+    }
+
+    return probes;
+}
+
+std::vector<const void*> pointers_to(const std::vector<int> &keys) {
+    std::vector<const void*> pointers;
+
+    for (const int &key : keys) {
+        pointers.push_back(&key);
+    }
+
+    return pointers;
+}
+
+} // namespace
+
+TEST_CASE("AvlTree_get_many") {
+    const auto urbg_ptr = make_urbg();
+    const std::vector<int> probes = shuffled(probe_keys(), *urbg_ptr);
+    const std::vector<const void*> probe_ptrs = pointers_to(probes);
+
+    SECTION("empty tree") {
+        IntTree tree({});
+        IntNode sentinel;
+        std::vector<const AvlNode*> found(probes.size(), &sentinel.node);
+
+        AvlTree_get_many(&tree.tree, probe_ptrs.data(), probes.size(), IntNode_het_compare,
+                         nullptr, found.data());
+
+        for (const AvlNode *node : found) {
+            REQUIRE_FALSE(node);
+        }
+    }
+
+    SECTION("even keys") {
+        IntTree tree(shuffled(mapped(iota(NUM_KEYS), [](int i) { return 2 * i; }), *urbg_ptr));
+        std::vector<const AvlNode*> found(probes.size());
+
+        AvlTree_get_many(&tree.tree, probe_ptrs.data(), probes.size(), IntNode_het_compare,
+                         nullptr, found.data());
+
+        for (std::size_t i = 0; i < probes.size(); ++i) {
+            REQUIRE(found[i] == AvlTree_get(&tree.tree, &probes[i], IntNode_het_compare, nullptr));
+        }
+    }
+
+    SECTION("no keys") {
+        IntTree tree({0});
+
+        AvlTree_get_many(&tree.tree, nullptr, 0, IntNode_het_compare, nullptr, nullptr);
+    }
+}
+
+TEST_CASE("AvlFrozenTree_get_many") {
+    const auto urbg_ptr = make_urbg();
+    const std::vector<int> probes = shuffled(probe_keys(), *urbg_ptr);
+    const std::vector<const void*> probe_ptrs = pointers_to(probes);
+
+    // every size up to 40 covers lanes finishing at different depths
+    for (std::size_t n = 0; n <= 40; ++n) {
+        IntTree tree(shuffled(mapped(iota(n), [](int i) { return 2 * i; }), *urbg_ptr));
+        AvlFrozenTree frozen;
+        std::vector<const AvlNode*> found(probes.size());
+
+        AvlTree_freeze(&tree.tree, &frozen);
+        AvlFrozenTree_get_many(&frozen, probe_ptrs.data(), probes.size(), IntNode_het_compare,
+                               nullptr, found.data());
+
+        for (std::size_t i = 0; i < probes.size(); ++i) {
+            REQUIRE(found[i] == AvlFrozenTree_get(&frozen, &probes[i], IntNode_het_compare,
+                                                  nullptr));
+        }
+
+        AvlFrozenTree_drop(&frozen);
+    }
+}
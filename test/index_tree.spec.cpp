@@ -0,0 +1,171 @@
+//  MIT License
+//
+//  Copyright (c) 2019 Gregory Meyer
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//  files (the "Software"), to deal in the Software without
+//  restriction, including without limitation the rights to use, copy,
+//  modify, merge, publish, distribute, sublicense, and/or sell copies
+//  of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice (including
+//  the next paragraph) shall be included in all copies or substantial
+//  portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+//  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+//  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+//  IN THE SOFTWARE.
+
+#include "bloodhound.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+constexpr std::size_t NUM_INSERTIONS = 512;
+
+namespace {
+
+struct Entry {
+    AvlIndexNode node;
+    int key;
+};
+
+int Entry_key(const AvlIndexNode *node) {
+    return reinterpret_cast<const Entry*>(node)->key;
+}
+
+int Entry_compare(const AvlIndexNode *lhs, const AvlIndexNode *rhs, void*) {
+    return (Entry_key(lhs) > Entry_key(rhs)) - (Entry_key(lhs) < Entry_key(rhs));
+}
+
+int Entry_het_compare(const void *lhs_v, const AvlIndexNode *rhs, void*) {
+    const int lhs = *static_cast<const int*>(lhs_v);
+
+    return (lhs > Entry_key(rhs)) - (lhs < Entry_key(rhs));
+}
+
+// height of a subtree, or -1 if its balance factors are wrong
+int checked_height(const std::vector<Entry> &entries, AvlIndex root) {
+    if (root == AVL_INDEX_NIL) {
+        return 0;
+    }
+
+    const AvlIndexNode &node = entries[root].node;
+    const int left = checked_height(entries, AvlIndexNode_left(&node));
+    const int right = checked_height(entries, AvlIndexNode_right(&node));
+
+    if (left < 0 || right < 0 || right - left != AvlIndexNode_balance_factor(&node)) {
+        return -1;
+    }
+
+    return ((left < right) ? right : left) + 1;
+}
+
+void push_keys(const std::vector<Entry> &entries, AvlIndex root, std::vector<int> &keys) {
+    if (root == AVL_INDEX_NIL) {
+        return;
+    }
+
+    push_keys(entries, AvlIndexNode_left(&entries[root].node), keys);
+    keys.push_back(entries[root].key);
+    push_keys(entries, AvlIndexNode_right(&entries[root].node), keys);
+}
+
+std::vector<int> keys_of(const std::vector<Entry> &entries, const AvlIndexTree &tree) {
+    std::vector<int> keys;
+    push_keys(entries, tree.root, keys);
+
+    return keys;
+}
+
+} // namespace
+
+TEST_CASE("AvlIndexNode is two 32-bit links") {
+    REQUIRE(sizeof(AvlIndex) * 8 >= 32);
+    REQUIRE(sizeof(AvlIndexNode) == 2 * sizeof(AvlIndex));
+}
+
+TEST_CASE("AvlIndexTree insertion and lookup") {
+    const auto urbg_ptr = make_urbg();
+    const std::vector<int> keys = rand_iota(NUM_INSERTIONS, *urbg_ptr);
+    std::vector<Entry> entries(keys.size() + 1);
+    AvlIndexTree tree;
+
+    AvlIndexTree_new(&tree, entries.data(), sizeof(Entry), Entry_compare, nullptr);
+    REQUIRE(tree.root == AVL_INDEX_NIL);
+
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        entries[i].key = keys[i];
+
+        REQUIRE(AvlIndexTree_insert(&tree, static_cast<AvlIndex>(i)) == AVL_INDEX_NIL);
+        REQUIRE(tree.len == i + 1);
+        REQUIRE(checked_height(entries, tree.root) >= 0);
+    }
+
+    REQUIRE(keys_of(entries, tree) == sorted(std::vector<int>(keys)));
+
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        REQUIRE(AvlIndexTree_get(&tree, &keys[i], Entry_het_compare, nullptr) == i);
+    }
+
+    const int missing = -1;
+    REQUIRE(AvlIndexTree_get(&tree, &missing, Entry_het_compare, nullptr) == AVL_INDEX_NIL);
+
+    // the spare entry replaces the node with the same key in place
+    const auto spare = static_cast<AvlIndex>(keys.size());
+    entries[spare].key = keys[0];
+
+    REQUIRE(AvlIndexTree_insert(&tree, spare) == 0);
+    REQUIRE(tree.len == keys.size());
+    REQUIRE(checked_height(entries, tree.root) >= 0);
+    REQUIRE(AvlIndexTree_get(&tree, &keys[0], Entry_het_compare, nullptr) == spare);
+    REQUIRE(keys_of(entries, tree) == sorted(std::vector<int>(keys)));
+
+    AvlIndexTree_clear(&tree);
+    REQUIRE(tree.len == 0);
+    REQUIRE(AvlIndexTree_get(&tree, &keys[1], Entry_het_compare, nullptr) == AVL_INDEX_NIL);
+}
+
+TEST_CASE("AvlIndexTree removal") {
+    const auto urbg_ptr = make_urbg();
+    const std::vector<int> keys = rand_iota(NUM_INSERTIONS, *urbg_ptr);
+    std::vector<Entry> entries(keys.size());
+    AvlIndexTree tree;
+
+    AvlIndexTree_new(&tree, entries.data(), sizeof(Entry), Entry_compare, nullptr);
+
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        entries[i].key = keys[i];
+        AvlIndexTree_insert(&tree, static_cast<AvlIndex>(i));
+    }
+
+    const int missing = static_cast<int>(NUM_INSERTIONS);
+    REQUIRE(AvlIndexTree_remove(&tree, &missing, Entry_het_compare, nullptr) == AVL_INDEX_NIL);
+
+    std::vector<int> remaining = sorted(std::vector<int>(keys));
+
+    for (int key : shuffled(std::vector<int>(keys), *urbg_ptr)) {
+        const AvlIndex removed = AvlIndexTree_remove(&tree, &key, Entry_het_compare, nullptr);
+
+        REQUIRE(removed != AVL_INDEX_NIL);
+        REQUIRE(entries[removed].key == key);
+        REQUIRE(checked_height(entries, tree.root) >= 0);
+
+        remaining.erase(std::find(remaining.begin(), remaining.end(), key));
+        REQUIRE(tree.len == remaining.size());
+        REQUIRE(keys_of(entries, tree) == remaining);
+    }
+
+    REQUIRE(tree.root == AVL_INDEX_NIL);
+}
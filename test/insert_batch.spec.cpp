@@ -0,0 +1,158 @@
+//  MIT License
+//
+//  Copyright (c) 2019 Gregory Meyer
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//  files (the "Software"), to deal in the Software without
+//  restriction, including without limitation the rights to use, copy,
+//  modify, merge, publish, distribute, sublicense, and/or sell copies
+//  of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice (including
+//  the next paragraph) shall be included in all copies or substantial
+//  portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+//  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+//  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+//  IN THE SOFTWARE.
+
+#include "int_node.h"
+#include "util.h"
+
+#include <cstddef>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+constexpr std::size_t NUM_INSERTIONS = 2048;
+
+static int counting_compare(const AvlNode *lhs, const AvlNode *rhs, void *count_v) {
+    ++*static_cast<std::size_t*>(count_v);
+
+    return IntNode_compare(lhs, rhs, nullptr);
+}
+
+static void push_key(void *keys_v, const AvlNode *node) {
+    static_cast<std::vector<int>*>(keys_v)->push_back(IntNode_key(node));
+}
+
+static std::vector<IntNode> make_nodes(const std::vector<int> &keys) {
+    std::vector<IntNode> nodes(keys.size());
+
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        nodes[i].key = keys[i];
+    }
+
+    return nodes;
+}
+
+static std::vector<AvlNode*> pointers_to(std::vector<IntNode> &nodes) {
+    std::vector<AvlNode*> pointers;
+
+    for (IntNode &node : nodes) {
+        pointers.push_back(&node.node);
+    }
+
+    return pointers;
+}
+
+static void check_batch(const std::vector<int> &keys) {
+    std::vector<IntNode> nodes = make_nodes(keys);
+    std::vector<AvlNode*> pointers = pointers_to(nodes);
+    std::vector<int> contained;
+    AvlTree tree;
+
+    AvlTree_new(&tree, IntNode_compare, nullptr, IntNode_delete, nullptr);
+    AvlTree_insert_batch(&tree, pointers.data(), pointers.size());
+
+    for (AvlNode *previous : pointers) {
+        REQUIRE_FALSE(previous);
+    }
+
+    REQUIRE(tree.len == keys.size());
+
+    AvlTree_traverse(&tree, push_key, &contained);
+    REQUIRE(contained == sorted(std::vector<int>(keys)));
+
+    AvlTree_drop(&tree);
+}
+
+TEST_CASE("sorted batch insert") {
+    check_batch(iota(NUM_INSERTIONS));
+}
+
+TEST_CASE("reverse sorted batch insert") {
+    check_batch(reversed(iota(NUM_INSERTIONS)));
+}
+
+TEST_CASE("random batch insert") {
+    const auto urbg_ptr = make_urbg();
+
+    check_batch(rand_iota(NUM_INSERTIONS, *urbg_ptr));
+}
+
+TEST_CASE("interleaved batches, then overwriting batch") {
+    const std::vector<int> evens = mapped(iota(NUM_INSERTIONS), [](int i) { return i * 2; });
+    const std::vector<int> odds = mapped(iota(NUM_INSERTIONS), [](int i) { return i * 2 + 1; });
+    std::vector<IntNode> even_nodes = make_nodes(evens);
+    std::vector<IntNode> odd_nodes = make_nodes(odds);
+    std::vector<IntNode> overwriting_nodes = make_nodes(evens);
+    std::vector<AvlNode*> even_pointers = pointers_to(even_nodes);
+    std::vector<AvlNode*> odd_pointers = pointers_to(odd_nodes);
+    std::vector<AvlNode*> overwriting_pointers = pointers_to(overwriting_nodes);
+    std::vector<int> contained;
+    AvlTree tree;
+
+    AvlTree_new(&tree, IntNode_compare, nullptr, IntNode_delete, nullptr);
+    AvlTree_insert_batch(&tree, even_pointers.data(), even_pointers.size());
+    AvlTree_insert_batch(&tree, odd_pointers.data(), odd_pointers.size());
+    AvlTree_insert_batch(&tree, overwriting_pointers.data(), overwriting_pointers.size());
+
+    for (std::size_t i = 0; i < NUM_INSERTIONS; ++i) {
+        REQUIRE(overwriting_pointers[i] == &even_nodes[i].node);
+    }
+
+    REQUIRE(tree.len == NUM_INSERTIONS * 2);
+
+    for (int i : evens) {
+        const AvlNode *const node = AvlTree_get(&tree, &i, IntNode_het_compare, nullptr);
+        REQUIRE(node == &overwriting_nodes[static_cast<std::size_t>(i / 2)].node);
+    }
+
+    AvlTree_traverse(&tree, push_key, &contained);
+    REQUIRE(contained == iota(NUM_INSERTIONS * 2));
+
+    AvlTree_drop(&tree);
+}
+
+TEST_CASE("sorted batch insert compares less than repeated insert") {
+    const std::vector<int> keys = iota(NUM_INSERTIONS);
+    std::vector<IntNode> batch_nodes = make_nodes(keys);
+    std::vector<IntNode> single_nodes = make_nodes(keys);
+    std::vector<AvlNode*> batch_pointers = pointers_to(batch_nodes);
+    std::size_t batch_comparisons = 0;
+    std::size_t single_comparisons = 0;
+    AvlTree batch;
+    AvlTree single;
+
+    AvlTree_new(&batch, counting_compare, &batch_comparisons, IntNode_delete, nullptr);
+    AvlTree_new(&single, counting_compare, &single_comparisons, IntNode_delete, nullptr);
+
+    AvlTree_insert_batch(&batch, batch_pointers.data(), batch_pointers.size());
+
+    for (IntNode &node : single_nodes) {
+        AvlTree_insert(&single, &node.node);
+    }
+
+    REQUIRE(batch_comparisons * 2 < single_comparisons);
+
+    AvlTree_drop(&batch);
+    AvlTree_drop(&single);
+}
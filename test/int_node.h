@@ -0,0 +1,162 @@
+//  MIT License
+//
+//  Copyright (c) 2019 Gregory Meyer
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//  files (the "Software"), to deal in the Software without
+//  restriction, including without limitation the rights to use, copy,
+//  modify, merge, publish, distribute, sublicense, and/or sell copies
+//  of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice (including
+//  the next paragraph) shall be included in all copies or substantial
+//  portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+//  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+//  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+//  IN THE SOFTWARE.
+
+#ifndef INT_NODE_H
+#define INT_NODE_H
+
+#include "bloodhound.h"
+
+#include <cstddef>
+#include <vector>
+
+// intrusive node for exercising the C API directly
+struct IntNode {
+    AvlNode node;
+    int key;
+};
+
+inline int IntNode_compare(const AvlNode *lhs_v, const AvlNode *rhs_v, void*) {
+    const int lhs = reinterpret_cast<const IntNode*>(lhs_v)->key;
+    const int rhs = reinterpret_cast<const IntNode*>(rhs_v)->key;
+
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+inline int IntNode_het_compare(const void *lhs_v, const AvlNode *rhs_v, void*) {
+    const int lhs = *static_cast<const int*>(lhs_v);
+    const int rhs = reinterpret_cast<const IntNode*>(rhs_v)->key;
+
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+inline void IntNode_delete(AvlNode*, void*) { }
+
+inline int IntNode_key(const AvlNode *node) {
+    return reinterpret_cast<const IntNode*>(node)->key;
+}
+
+// intrusive node for exercising ranked trees
+struct RankNode {
+    AvlRankNode node;
+    int key;
+};
+
+inline int RankNode_key(const AvlNode *node) {
+    return reinterpret_cast<const RankNode*>(node)->key;
+}
+
+inline int RankNode_compare(const AvlNode *lhs_v, const AvlNode *rhs_v, void*) {
+    const int lhs = RankNode_key(lhs_v);
+    const int rhs = RankNode_key(rhs_v);
+
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+inline int RankNode_het_compare(const void *lhs_v, const AvlNode *rhs_v, void*) {
+    const int lhs = *static_cast<const int*>(lhs_v);
+    const int rhs = RankNode_key(rhs_v);
+
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+// intrusive node for exercising persistent and concurrent trees
+struct PersistentIntNode {
+    AvlPersistentNode node;
+    int key;
+};
+
+inline int PersistentIntNode_key(const AvlNode *node) {
+    return reinterpret_cast<const PersistentIntNode*>(node)->key;
+}
+
+inline int PersistentIntNode_compare(const AvlNode *lhs_v, const AvlNode *rhs_v, void*) {
+    const int lhs = PersistentIntNode_key(lhs_v);
+    const int rhs = PersistentIntNode_key(rhs_v);
+
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+inline int PersistentIntNode_het_compare(const void *lhs_v, const AvlNode *rhs_v, void*) {
+    const int lhs = *static_cast<const int*>(lhs_v);
+    const int rhs = PersistentIntNode_key(rhs_v);
+
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+// height of a subtree, or -1 if its balance factors are wrong
+inline int checked_height(const AvlNode *root) {
+    if (!root) {
+        return 0;
+    }
+
+    const int left = checked_height(root->left);
+    const int right = checked_height(root->right);
+
+    if (left < 0 || right < 0 || right - left != root->balance_factor
+        || root->balance_factor < -1 || root->balance_factor > 1) {
+        return -1;
+    }
+
+    return ((left < right) ? right : left) + 1;
+}
+
+inline std::vector<int> keys_of(const AvlTree &tree) {
+    std::vector<int> keys;
+    AvlCursor cursor;
+
+    for (AvlCursor_first(&cursor, &tree); AvlCursor_get(&cursor); AvlCursor_next(&cursor)) {
+        keys.push_back(IntNode_key(AvlCursor_get(&cursor)));
+    }
+
+    return keys;
+}
+
+// AvlTree over nodes owned by a std::vector
+class IntTree {
+public:
+    explicit IntTree(const std::vector<int> &keys) : nodes_(keys.size()) {
+        AvlTree_new(&tree, IntNode_compare, nullptr, IntNode_delete, nullptr);
+
+        for (std::size_t i = 0; i < keys.size(); ++i) {
+            nodes_[i].key = keys[i];
+            AvlTree_insert(&tree, &nodes_[i].node);
+        }
+    }
+
+    IntTree(const IntTree &other) = delete;
+
+    ~IntTree() {
+        AvlTree_drop(&tree);
+    }
+
+    IntTree& operator=(const IntTree &other) = delete;
+
+    AvlTree tree;
+
+private:
+    std::vector<IntNode> nodes_;
+};
+
+#endif
@@ -0,0 +1,197 @@
+//  MIT License
+//
+//  Copyright (c) 2019 Gregory Meyer
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//  files (the "Software"), to deal in the Software without
+//  restriction, including without limitation the rights to use, copy,
+//  modify, merge, publish, distribute, sublicense, and/or sell copies
+//  of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice (including
+//  the next paragraph) shall be included in all copies or substantial
+//  portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+//  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+//  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+//  IN THE SOFTWARE.
+
+#include "int_node.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+constexpr std::size_t NUM_INSERTIONS = 512;
+
+static void count_delete(AvlNode*, void *count_v) {
+    ++*static_cast<std::size_t*>(count_v);
+}
+
+// owns its nodes and counts how many the tree hands to the deleter
+class CountingTree {
+public:
+    explicit CountingTree(const std::vector<int> &keys) : nodes_(keys.size()) {
+        AvlTree_new(&tree, IntNode_compare, nullptr, count_delete, &num_deleted);
+
+        for (std::size_t i = 0; i < keys.size(); ++i) {
+            nodes_[i].key = keys[i];
+            AvlTree_insert(&tree, &nodes_[i].node);
+        }
+    }
+
+    CountingTree(const CountingTree &other) = delete;
+
+    ~CountingTree() {
+        AvlTree_drop(&tree);
+    }
+
+    CountingTree& operator=(const CountingTree &other) = delete;
+
+    AvlTree tree;
+    std::size_t num_deleted = 0;
+
+private:
+    std::vector<IntNode> nodes_;
+};
+
+static std::vector<int> multiples(int factor, std::size_t n) {
+    return mapped(iota(n), [factor](int i) { return i * factor; });
+}
+
+TEST_CASE("split at each key, then join") {
+    const auto urbg_ptr = make_urbg();
+    IntTree tree(rand_iota(NUM_INSERTIONS, *urbg_ptr));
+
+    for (int i = 0; i < static_cast<int>(NUM_INSERTIONS); ++i) {
+        AvlTree right;
+        AvlNode *const found = AvlTree_split(&tree.tree, &i, IntNode_het_compare, nullptr,
+                                             &right);
+
+        REQUIRE(found);
+        REQUIRE(IntNode_key(found) == i);
+        REQUIRE(checked_height(tree.tree.root) >= 0);
+        REQUIRE(checked_height(right.root) >= 0);
+        REQUIRE(keys_of(tree.tree) == iota(static_cast<std::size_t>(i)));
+        REQUIRE(keys_of(right) == iota(NUM_INSERTIONS - static_cast<std::size_t>(i) - 1, i + 1));
+        REQUIRE(tree.tree.len == static_cast<std::size_t>(i));
+        REQUIRE(right.len == NUM_INSERTIONS - static_cast<std::size_t>(i) - 1);
+
+        AvlTree_join(&tree.tree, found, &right);
+
+        REQUIRE(checked_height(tree.tree.root) >= 0);
+        REQUIRE(keys_of(tree.tree) == iota(NUM_INSERTIONS));
+        REQUIRE(tree.tree.len == NUM_INSERTIONS);
+        REQUIRE(right.len == 0);
+        REQUIRE_FALSE(right.root);
+    }
+}
+
+TEST_CASE("split between keys, then join without pivot") {
+    const auto urbg_ptr = make_urbg();
+    IntTree tree(shuffled(multiples(2, NUM_INSERTIONS), *urbg_ptr));
+
+    for (int i = -1; i < static_cast<int>(NUM_INSERTIONS * 2); i += 2) {
+        AvlTree right;
+
+        REQUIRE_FALSE(AvlTree_split(&tree.tree, &i, IntNode_het_compare, nullptr, &right));
+        REQUIRE(checked_height(tree.tree.root) >= 0);
+        REQUIRE(checked_height(right.root) >= 0);
+        REQUIRE(tree.tree.len + right.len == NUM_INSERTIONS);
+        REQUIRE(tree.tree.len == static_cast<std::size_t>(i + 1) / 2);
+
+        AvlTree_join(&tree.tree, nullptr, &right);
+
+        REQUIRE(checked_height(tree.tree.root) >= 0);
+        REQUIRE(keys_of(tree.tree) == multiples(2, NUM_INSERTIONS));
+    }
+}
+
+TEST_CASE("join trees of very different heights") {
+    for (std::size_t small = 0; small < 16; ++small) {
+        std::vector<IntNode> pivots(2);
+        pivots[0].key = static_cast<int>(small);
+        pivots[1].key = static_cast<int>(NUM_INSERTIONS - small - 1);
+
+        // right and tiny must outlive the trees they are joined into
+        IntTree right(iota(NUM_INSERTIONS - small - 1, static_cast<int>(small) + 1));
+        IntTree left(iota(small));
+
+        AvlTree_join(&left.tree, &pivots[0].node, &right.tree);
+        REQUIRE(checked_height(left.tree.root) >= 0);
+        REQUIRE(keys_of(left.tree) == iota(NUM_INSERTIONS));
+
+        IntTree tiny(iota(small, static_cast<int>(NUM_INSERTIONS - small)));
+        IntTree big(iota(NUM_INSERTIONS - small - 1));
+
+        AvlTree_join(&big.tree, &pivots[1].node, &tiny.tree);
+        REQUIRE(checked_height(big.tree.root) >= 0);
+        REQUIRE(keys_of(big.tree) == iota(NUM_INSERTIONS));
+        REQUIRE(big.tree.len == NUM_INSERTIONS);
+    }
+}
+
+TEST_CASE("union, intersection, difference") {
+    const auto urbg_ptr = make_urbg();
+    const std::vector<int> twos = multiples(2, NUM_INSERTIONS);
+    const std::vector<int> threes = multiples(3, NUM_INSERTIONS / 4);
+    std::vector<int> expected;
+
+    SECTION("union") {
+        // other must outlive self, which takes ownership of its nodes
+        CountingTree other(shuffled(std::vector<int>(threes), *urbg_ptr));
+        CountingTree self(shuffled(std::vector<int>(twos), *urbg_ptr));
+
+        std::set_union(twos.begin(), twos.end(), threes.begin(), threes.end(),
+                       std::back_inserter(expected));
+        AvlTree_union(&self.tree, &other.tree);
+
+        REQUIRE(checked_height(self.tree.root) >= 0);
+        REQUIRE(keys_of(self.tree) == expected);
+        REQUIRE(self.tree.len == expected.size());
+        REQUIRE(self.num_deleted == 0);
+        REQUIRE(other.num_deleted == twos.size() + threes.size() - expected.size());
+        REQUIRE(other.tree.len == 0);
+    }
+
+    SECTION("intersection") {
+        CountingTree self(shuffled(std::vector<int>(twos), *urbg_ptr));
+        CountingTree other(shuffled(std::vector<int>(threes), *urbg_ptr));
+
+        std::set_intersection(twos.begin(), twos.end(), threes.begin(), threes.end(),
+                              std::back_inserter(expected));
+        AvlTree_intersection(&self.tree, &other.tree);
+
+        REQUIRE(checked_height(self.tree.root) >= 0);
+        REQUIRE(keys_of(self.tree) == expected);
+        REQUIRE(self.tree.len == expected.size());
+        REQUIRE(self.num_deleted == twos.size() - expected.size());
+        REQUIRE(other.num_deleted == threes.size());
+    }
+
+    SECTION("difference") {
+        CountingTree self(shuffled(std::vector<int>(twos), *urbg_ptr));
+        CountingTree other(shuffled(std::vector<int>(threes), *urbg_ptr));
+
+        std::set_difference(twos.begin(), twos.end(), threes.begin(), threes.end(),
+                            std::back_inserter(expected));
+        AvlTree_difference(&self.tree, &other.tree);
+
+        REQUIRE(checked_height(self.tree.root) >= 0);
+        REQUIRE(keys_of(self.tree) == expected);
+        REQUIRE(self.tree.len == expected.size());
+        REQUIRE(self.num_deleted == twos.size() - expected.size());
+        REQUIRE(other.num_deleted == threes.size());
+    }
+}
@@ -0,0 +1,248 @@
+//  MIT License
+//
+//  Copyright (c) 2019 Gregory Meyer
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//  files (the "Software"), to deal in the Software without
+//  restriction, including without limitation the rights to use, copy,
+//  modify, merge, publish, distribute, sublicense, and/or sell copies
+//  of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice (including
+//  the next paragraph) shall be included in all copies or substantial
+//  portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+//  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+//  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+//  IN THE SOFTWARE.
+
+#include "avl_multi_index.h"
+#include "int_node.h"
+#include "util.h"
+
+#include <cstddef>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+constexpr std::size_t NUM_RECORDS = 1024;
+
+namespace {
+
+struct Order {
+    int id;
+    AvlNode by_id;
+    int price;
+    AvlNode by_price;
+};
+
+int compare_ids(const void *lhs_v, const void *rhs_v, void*) {
+    const int lhs = static_cast<const Order*>(lhs_v)->id;
+    const int rhs = static_cast<const Order*>(rhs_v)->id;
+
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+int compare_prices(const void *lhs_v, const void *rhs_v, void*) {
+    const int lhs = static_cast<const Order*>(lhs_v)->price;
+    const int rhs = static_cast<const Order*>(rhs_v)->price;
+
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+int compare_id_key(const void *lhs_v, const AvlNode *rhs_v, void*) {
+    const int lhs = *static_cast<const int*>(lhs_v);
+    const int rhs = AVL_CONST_CONTAINER_OF(rhs_v, Order, by_id)->id;
+
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+int compare_price_key(const void *lhs_v, const AvlNode *rhs_v, void*) {
+    const int lhs = *static_cast<const int*>(lhs_v);
+    const int rhs = AVL_CONST_CONTAINER_OF(rhs_v, Order, by_price)->price;
+
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+void count_deleted(void *order_v, void *num_deleted_v) {
+    REQUIRE(static_cast<Order*>(order_v)->id >= 0);
+    ++*static_cast<std::size_t*>(num_deleted_v);
+}
+
+struct IdOf {
+    int operator()(const Order &order) const noexcept {
+        return order.id;
+    }
+};
+
+struct PriceOf {
+    int operator()(const Order &order) const noexcept {
+        return order.price;
+    }
+};
+
+using Orders = avl::MultiIndex<Order, avl::Index<Order, &Order::by_id, IdOf>,
+                               avl::Index<Order, &Order::by_price, PriceOf>>;
+
+std::vector<Order> make_orders() {
+    const auto urbg_ptr = make_urbg();
+    const std::vector<int> ids = rand_iota(NUM_RECORDS, *urbg_ptr);
+    const std::vector<int> prices = rand_iota(NUM_RECORDS, *urbg_ptr, 1000);
+    std::vector<Order> orders(NUM_RECORDS);
+
+    for (std::size_t i = 0; i < NUM_RECORDS; ++i) {
+        orders[i].id = ids[i];
+        orders[i].price = prices[i];
+    }
+
+    return orders;
+}
+
+} // namespace
+
+TEST_CASE("AVL_CONTAINER_OF") {
+    Order order;
+    const Order &const_order = order;
+
+    REQUIRE(AVL_CONTAINER_OF(&order.by_price, Order, by_price) == &order);
+    REQUIRE(AVL_CONST_CONTAINER_OF(&const_order.by_id, Order, by_id) == &order);
+}
+
+TEST_CASE("trees with offset share records") {
+    std::vector<Order> orders = make_orders();
+    std::size_t num_deleted = 0;
+    AvlTree by_id;
+    AvlTree by_price;
+
+    AvlTree_new_with_offset(&by_id, offsetof(Order, by_id), compare_ids, nullptr,
+                            count_deleted, &num_deleted);
+    AvlTree_new_with_offset(&by_price, offsetof(Order, by_price), compare_prices, nullptr,
+                            count_deleted, &num_deleted);
+
+    for (Order &order : orders) {
+        REQUIRE_FALSE(AvlTree_insert(&by_id, &order.by_id));
+        REQUIRE_FALSE(AvlTree_insert(&by_price, &order.by_price));
+    }
+
+    REQUIRE(checked_height(by_id.root) >= 0);
+    REQUIRE(checked_height(by_price.root) >= 0);
+
+    for (const Order &order : orders) {
+        REQUIRE(AvlTree_get(&by_id, &order.id, compare_id_key, nullptr) == &order.by_id);
+        REQUIRE(AvlTree_get(&by_price, &order.price, compare_price_key, nullptr)
+                == &order.by_price);
+    }
+
+    int expected = 1000;
+    AvlCursor cursor;
+
+    for (AvlCursor_first(&cursor, &by_price); AvlCursor_get(&cursor); AvlCursor_next(&cursor)) {
+        REQUIRE(AVL_CONST_CONTAINER_OF(AvlCursor_get(&cursor), Order, by_price)->price
+                == expected++);
+    }
+
+    // the right half must still find its containers once self is gone
+    AvlTree upper_ids;
+    const int pivot = static_cast<int>(NUM_RECORDS / 2);
+
+    REQUIRE(AvlTree_split(&by_id, &pivot, compare_id_key, nullptr, &upper_ids));
+    AvlTree_drop(&by_id);
+    REQUIRE(num_deleted == NUM_RECORDS / 2);
+
+    const int above_pivot = pivot + 1;
+    const AvlNode *const found = AvlTree_get(&upper_ids, &above_pivot, compare_id_key, nullptr);
+    REQUIRE(found);
+
+    Order replacement = *AVL_CONST_CONTAINER_OF(found, Order, by_id);
+    REQUIRE(AvlTree_insert(&upper_ids, &replacement.by_id) == found);
+    REQUIRE(upper_ids.len == NUM_RECORDS / 2 - 1);
+
+    AvlTree_drop(&upper_ids);
+    REQUIRE(num_deleted == NUM_RECORDS - 1);
+    AvlTree_drop(&by_price);
+    REQUIRE(num_deleted == 2 * NUM_RECORDS - 1);
+}
+
+TEST_CASE("multi index insert, find and remove") {
+    std::vector<Order> orders = make_orders();
+    Orders index;
+
+    for (Order &order : orders) {
+        const auto inserted = index.insert(order);
+
+        REQUIRE(inserted.second);
+        REQUIRE(inserted.first == &order);
+    }
+
+    REQUIRE(index.size() == NUM_RECORDS);
+
+    for (const Order &order : orders) {
+        REQUIRE(index.find<0>(order.id) == &order);
+        REQUIRE(index.find<1>(order.price) == &order);
+    }
+
+    REQUIRE_FALSE(index.find<0>(-1));
+    REQUIRE_FALSE(index.find<1>(0));
+
+    for (std::size_t i = 0; i < NUM_RECORDS; i += 2) {
+        index.remove(orders[i]);
+    }
+
+    REQUIRE(index.size() == NUM_RECORDS / 2);
+    REQUIRE(index.index<0>().len == NUM_RECORDS / 2);
+    REQUIRE(index.index<1>().len == NUM_RECORDS / 2);
+    REQUIRE(checked_height(index.index<0>().root) >= 0);
+    REQUIRE(checked_height(index.index<1>().root) >= 0);
+
+    for (std::size_t i = 0; i < NUM_RECORDS; ++i) {
+        const Order *const expected = (i % 2 == 0) ? nullptr : &orders[i];
+
+        REQUIRE(index.find<0>(orders[i].id) == expected);
+        REQUIRE(index.find<1>(orders[i].price) == expected);
+    }
+
+    int previous = -1;
+    AvlCursor cursor;
+
+    for (AvlCursor_first(&cursor, &index.index<1>()); AvlCursor_get(&cursor);
+         AvlCursor_next(&cursor)) {
+        const Order *const order = Orders::IndexAt<1>::container(AvlCursor_get(&cursor));
+
+        REQUIRE(order->price > previous);
+        previous = order->price;
+    }
+}
+
+TEST_CASE("multi index rejects a key taken in any index") {
+    std::vector<Order> orders(3);
+    Orders index;
+
+    orders[0].id = 1;
+    orders[0].price = 10;
+    orders[1].id = 2;
+    orders[1].price = 10;
+    orders[2].id = 1;
+    orders[2].price = 20;
+
+    REQUIRE(index.insert(orders[0]).second);
+
+    auto rejected = index.insert(orders[1]);
+    REQUIRE_FALSE(rejected.second);
+    REQUIRE(rejected.first == &orders[0]);
+
+    rejected = index.insert(orders[2]);
+    REQUIRE_FALSE(rejected.second);
+    REQUIRE(rejected.first == &orders[0]);
+
+    REQUIRE(index.size() == 1);
+    REQUIRE(index.index<1>().len == 1);
+    REQUIRE_FALSE(index.find<0>(2));
+    REQUIRE_FALSE(index.find<1>(20));
+}
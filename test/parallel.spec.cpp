@@ -0,0 +1,198 @@
+//  MIT License
+//
+//  Copyright (c) 2019 Gregory Meyer
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//  files (the "Software"), to deal in the Software without
+//  restriction, including without limitation the rights to use, copy,
+//  modify, merge, publish, distribute, sublicense, and/or sell copies
+//  of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice (including
+//  the next paragraph) shall be included in all copies or substantial
+//  portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+//  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+//  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+//  IN THE SOFTWARE.
+
+#include "bloodhound_parallel.h"
+#include "int_node.h"
+#include "util.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+constexpr std::size_t NUM_INSERTIONS = 1024;
+
+using PoolPtr = std::unique_ptr<AvlThreadPool, decltype(&AvlThreadPool_drop)>;
+
+static PoolPtr make_pool(std::size_t num_threads) {
+    return PoolPtr(AvlThreadPool_new(num_threads), AvlThreadPool_drop);
+}
+
+static std::vector<int> multiples(int factor, std::size_t n) {
+    return mapped(iota(n), [factor](int i) { return i * factor; });
+}
+
+static void atomic_count_delete(AvlNode*, void *count_v) {
+    ++*static_cast<std::atomic<std::size_t>*>(count_v);
+}
+
+static bool same_shape(const AvlNode *lhs, const AvlNode *rhs) {
+    if (!lhs || !rhs) {
+        return lhs == rhs;
+    }
+
+    return IntNode_key(lhs) == IntNode_key(rhs) && lhs->balance_factor == rhs->balance_factor
+           && same_shape(lhs->left, rhs->left) && same_shape(lhs->right, rhs->right);
+}
+
+TEST_CASE("parallel set operations match their sequential counterparts") {
+    const auto pool_ptr = make_pool(4);
+    const auto urbg_ptr = make_urbg();
+    const std::vector<int> self_keys = shuffled(multiples(2, NUM_INSERTIONS), *urbg_ptr);
+    const std::vector<int> other_keys = shuffled(multiples(3, NUM_INSERTIONS), *urbg_ptr);
+
+    std::vector<int> expected;
+    std::vector<int> self_sorted = sorted(std::vector<int>(self_keys));
+    std::vector<int> other_sorted = sorted(std::vector<int>(other_keys));
+
+    for (std::size_t grain_size : {std::size_t(0), std::size_t(1), std::size_t(64),
+                                   NUM_INSERTIONS * 4}) {
+        // other owns nodes that end up in self, so it must outlive it
+        IntTree other(other_keys);
+        IntTree self(self_keys);
+
+        SECTION("union, grain " + std::to_string(grain_size)) {
+            std::set_union(self_sorted.begin(), self_sorted.end(), other_sorted.begin(),
+                           other_sorted.end(), std::back_inserter(expected));
+            AvlTree_par_union(&self.tree, &other.tree, pool_ptr.get(), grain_size);
+        }
+
+        SECTION("intersection, grain " + std::to_string(grain_size)) {
+            std::set_intersection(self_sorted.begin(), self_sorted.end(), other_sorted.begin(),
+                                  other_sorted.end(), std::back_inserter(expected));
+            AvlTree_par_intersection(&self.tree, &other.tree, pool_ptr.get(), grain_size);
+        }
+
+        SECTION("difference, grain " + std::to_string(grain_size)) {
+            std::set_difference(self_sorted.begin(), self_sorted.end(), other_sorted.begin(),
+                                other_sorted.end(), std::back_inserter(expected));
+            AvlTree_par_difference(&self.tree, &other.tree, pool_ptr.get(), grain_size);
+        }
+
+        if (!expected.empty()) {
+            REQUIRE(checked_height(self.tree.root) >= 0);
+            REQUIRE(keys_of(self.tree) == expected);
+            REQUIRE(self.tree.len == expected.size());
+            REQUIRE_FALSE(other.tree.root);
+            REQUIRE(other.tree.len == 0);
+            expected.clear();
+        }
+    }
+}
+
+TEST_CASE("parallel set operations delete the same nodes") {
+    const auto pool_ptr = make_pool(3);
+    std::vector<IntNode> nodes(NUM_INSERTIONS * 2);
+    std::atomic<std::size_t> num_deleted(0);
+    AvlTree self;
+    AvlTree other;
+
+    AvlTree_new(&self, IntNode_compare, nullptr, atomic_count_delete, &num_deleted);
+    AvlTree_new(&other, IntNode_compare, nullptr, atomic_count_delete, &num_deleted);
+
+    for (std::size_t i = 0; i < NUM_INSERTIONS; ++i) {
+        nodes[i].key = static_cast<int>(i);
+        AvlTree_insert(&self, &nodes[i].node);
+
+        nodes[NUM_INSERTIONS + i].key = static_cast<int>(i * 2);
+        AvlTree_insert(&other, &nodes[NUM_INSERTIONS + i].node);
+    }
+
+    AvlTree_par_difference(&self, &other, pool_ptr.get(), 8);
+
+    REQUIRE(num_deleted == NUM_INSERTIONS + NUM_INSERTIONS / 2);
+    REQUIRE(self.len == NUM_INSERTIONS / 2);
+    REQUIRE(keys_of(self) == mapped(iota(NUM_INSERTIONS / 2), [](int i) { return i * 2 + 1; }));
+
+    AvlTree_drop(&self);
+    AvlTree_drop(&other);
+}
+
+TEST_CASE("parallel bulk build matches AvlTree_from_sorted") {
+    const auto pool_ptr = make_pool(0);
+
+    REQUIRE(AvlThreadPool_num_threads(pool_ptr.get()) > 0);
+
+    for (std::size_t n : {std::size_t(0), std::size_t(1), std::size_t(2), std::size_t(100),
+                          NUM_INSERTIONS, NUM_INSERTIONS * 16 + 3}) {
+        std::vector<IntNode> par_nodes(n);
+        std::vector<IntNode> seq_nodes(n);
+        std::vector<AvlNode*> par_ptrs(n);
+        std::vector<AvlNode*> seq_ptrs(n);
+
+        for (std::size_t i = 0; i < n; ++i) {
+            par_nodes[i].key = seq_nodes[i].key = static_cast<int>(i);
+            par_ptrs[i] = &par_nodes[i].node;
+            seq_ptrs[i] = &seq_nodes[i].node;
+        }
+
+        for (std::size_t grain_size : {std::size_t(0), std::size_t(1), std::size_t(256)}) {
+            AvlTree par;
+            AvlTree seq;
+
+            AvlTree_par_from_sorted(&par, par_ptrs.data(), n, IntNode_compare, nullptr,
+                                    IntNode_delete, nullptr, pool_ptr.get(), grain_size);
+            AvlTree_from_sorted(&seq, seq_ptrs.data(), n, IntNode_compare, nullptr,
+                                IntNode_delete, nullptr);
+
+            REQUIRE(par.len == n);
+            REQUIRE(checked_height(par.root) >= 0);
+            REQUIRE(same_shape(par.root, seq.root));
+
+            AvlTree_drop(&par);
+            AvlTree_drop(&seq);
+        }
+    }
+}
+
+TEST_CASE("one pool serves concurrent callers") {
+    const auto pool_ptr = make_pool(2);
+    std::vector<std::size_t> lens(4);
+    std::vector<std::thread> callers;
+
+    for (std::size_t i = 0; i < lens.size(); ++i) {
+        callers.emplace_back([&pool_ptr, &lens, i] {
+            IntTree other(multiples(3, NUM_INSERTIONS));
+            IntTree self(multiples(2, NUM_INSERTIONS));
+
+            AvlTree_par_intersection(&self.tree, &other.tree, pool_ptr.get(), 16);
+            lens[i] = self.tree.len;
+        });
+    }
+
+    for (std::thread &caller : callers) {
+        caller.join();
+    }
+
+    for (std::size_t len : lens) {
+        REQUIRE(len == (NUM_INSERTIONS * 2 + 5) / 6);
+    }
+}
@@ -0,0 +1,178 @@
+//  MIT License
+//
+//  Copyright (c) 2019 Gregory Meyer
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//  files (the "Software"), to deal in the Software without
+//  restriction, including without limitation the rights to use, copy,
+//  modify, merge, publish, distribute, sublicense, and/or sell copies
+//  of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice (including
+//  the next paragraph) shall be included in all copies or substantial
+//  portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+//  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+//  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+//  IN THE SOFTWARE.
+
+#include "bloodhound.h"
+#include "util.h"
+
+#include <cstddef>
+#include <set>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+constexpr std::size_t NUM_KEYS = 2048;
+
+namespace {
+
+struct Node {
+    AvlParentNode node;
+    int key;
+};
+
+int key_of(const AvlNode *node) {
+    return reinterpret_cast<const Node*>(node)->key;
+}
+
+int compare(const AvlNode *lhs, const AvlNode *rhs, void*) {
+    return (key_of(lhs) > key_of(rhs)) - (key_of(lhs) < key_of(rhs));
+}
+
+int het_compare(const void *lhs_v, const AvlNode *rhs, void*) {
+    const int lhs = *static_cast<const int*>(lhs_v);
+
+    return (lhs > key_of(rhs)) - (lhs < key_of(rhs));
+}
+
+void deleter(AvlNode*, void*) { }
+
+const AvlNode* parent_of(const AvlNode *node) {
+    return reinterpret_cast<const AvlParentNode*>(node)->parent;
+}
+
+// height of a subtree, or -1 if its balance factors or parent links are wrong
+int checked_height(const AvlNode *root) {
+    if (!root) {
+        return 0;
+    }
+
+    if ((root->left && parent_of(root->left) != root)
+        || (root->right && parent_of(root->right) != root)) {
+        return -1;
+    }
+
+    const int left = checked_height(root->left);
+    const int right = checked_height(root->right);
+
+    if (left < 0 || right < 0 || right - left != root->balance_factor) {
+        return -1;
+    }
+
+    return ((left < right) ? right : left) + 1;
+}
+
+void require_matches(const AvlParentTree &tree, const std::set<int> &expected) {
+    REQUIRE(tree.len == expected.size());
+    REQUIRE((!tree.root || !parent_of(tree.root)));
+    REQUIRE(checked_height(tree.root) >= 0);
+
+    std::vector<int> forward;
+    std::vector<int> backward;
+
+    for (const AvlNode *node = AvlParentTree_first(&tree); node; node = AvlParentNode_next(node)) {
+        forward.push_back(key_of(node));
+    }
+
+    for (const AvlNode *node = AvlParentTree_last(&tree); node; node = AvlParentNode_prev(node)) {
+        backward.push_back(key_of(node));
+    }
+
+    REQUIRE(forward == std::vector<int>(expected.begin(), expected.end()));
+    REQUIRE(backward == std::vector<int>(expected.rbegin(), expected.rend()));
+}
+
+} // namespace
+
+TEST_CASE("AvlParentTree") {
+    const auto urbg_ptr = make_urbg();
+    std::vector<Node> nodes(NUM_KEYS);
+    Node replacement;
+    std::set<int> expected;
+    AvlParentTree tree;
+
+    AvlParentTree_new(&tree, compare, nullptr, deleter, nullptr);
+    require_matches(tree, expected);
+
+    const std::vector<int> keys = rand_iota(NUM_KEYS, *urbg_ptr);
+
+    for (std::size_t i = 0; i < NUM_KEYS; ++i) {
+        nodes[i].key = keys[i];
+        REQUIRE_FALSE(AvlParentTree_insert(&tree, &nodes[i].node.node));
+        expected.insert(keys[i]);
+    }
+
+    require_matches(tree, expected);
+
+    SECTION("get") {
+        for (int key = -1; key <= static_cast<int>(NUM_KEYS); ++key) {
+            const AvlNode *const found = AvlParentTree_get(&tree, &key, het_compare, nullptr);
+
+            REQUIRE((found != nullptr) == (expected.count(key) == 1));
+            REQUIRE((!found || key_of(found) == key));
+        }
+    }
+
+    SECTION("insert replaces equal nodes") {
+        replacement.key = keys[0];
+        REQUIRE(AvlParentTree_insert(&tree, &replacement.node.node) == &nodes[0].node.node);
+        REQUIRE(AvlParentTree_get(&tree, &keys[0], het_compare, nullptr)
+                == &replacement.node.node);
+        require_matches(tree, expected);
+    }
+
+    SECTION("remove by key") {
+        for (int key : shuffled(iota(NUM_KEYS + 8), *urbg_ptr)) {
+            const AvlNode *const removed = AvlParentTree_remove(&tree, &key, het_compare, nullptr);
+
+            REQUIRE((removed != nullptr) == (expected.erase(key) == 1));
+        }
+
+        require_matches(tree, expected);
+    }
+
+    SECTION("remove by node") {
+        for (std::size_t i = 0; i < NUM_KEYS; ++i) {
+            AvlParentTree_remove_node(&tree, &nodes[i].node.node);
+            expected.erase(nodes[i].key);
+
+            if (i % 64 == 0) {
+                require_matches(tree, expected);
+            }
+        }
+
+        require_matches(tree, expected);
+        REQUIRE_FALSE(tree.root);
+    }
+
+    SECTION("remove by node in order") {
+        while (const AvlNode *const first = AvlParentTree_first(&tree)) {
+            expected.erase(key_of(first));
+            AvlParentTree_remove_node(&tree, const_cast<AvlNode*>(first));
+        }
+
+        require_matches(tree, expected);
+    }
+
+    AvlParentTree_drop(&tree);
+}
@@ -0,0 +1,204 @@
+//  MIT License
+//
+//  Copyright (c) 2019 Gregory Meyer
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//  files (the "Software"), to deal in the Software without
+//  restriction, including without limitation the rights to use, copy,
+//  modify, merge, publish, distribute, sublicense, and/or sell copies
+//  of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice (including
+//  the next paragraph) shall be included in all copies or substantial
+//  portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+//  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+//  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+//  IN THE SOFTWARE.
+
+#include "bloodhound.h"
+#include "int_node.h"
+#include "util.h"
+
+#include <cstddef>
+#include <set>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+constexpr int NUM_KEYS = 1024;
+constexpr int NUM_VERSIONS = 16;
+
+// tracks the nodes allocated for every version of a tree
+struct NodeCounts {
+    std::size_t num_live = 0;
+    std::size_t num_cloned = 0;
+};
+
+static AvlNode* make_node(int key, NodeCounts &counts) {
+    PersistentIntNode *const node = new PersistentIntNode;
+
+    node->key = key;
+    ++counts.num_live;
+
+    return &node->node.node;
+}
+
+static AvlNode* clone(const AvlNode *node, void *counts_v) {
+    NodeCounts &counts = *static_cast<NodeCounts*>(counts_v);
+
+    ++counts.num_cloned;
+
+    return make_node(PersistentIntNode_key(node), counts);
+}
+
+static void delete_node(AvlNode *node, void *counts_v) {
+    --static_cast<NodeCounts*>(counts_v)->num_live;
+    delete reinterpret_cast<PersistentIntNode*>(node);
+}
+
+static void new_tree(AvlPersistentTree &tree, NodeCounts &counts) {
+    AvlPersistentTree_new(&tree, PersistentIntNode_compare, nullptr, clone, &counts, delete_node,
+                          &counts);
+}
+
+static void push_key(void *keys_v, const AvlNode *node) {
+    static_cast<std::vector<int>*>(keys_v)->push_back(PersistentIntNode_key(node));
+}
+
+static std::vector<int> keys_of(const AvlPersistentTree &tree) {
+    std::vector<int> keys;
+
+    AvlPersistentTree_traverse(&tree, push_key, &keys);
+
+    return keys;
+}
+
+TEST_CASE("AvlPersistentTree without snapshots behaves like a set") {
+    const auto urbg_ptr = make_urbg();
+    NodeCounts counts;
+    AvlPersistentTree tree;
+    std::set<int> expected;
+
+    new_tree(tree, counts);
+
+    for (int key : rand_iota(NUM_KEYS, *urbg_ptr)) {
+        REQUIRE_FALSE(AvlPersistentTree_insert(&tree, make_node(key, counts)));
+        expected.insert(key);
+    }
+
+    REQUIRE(AvlPersistentTree_insert(&tree, make_node(0, counts)));
+    REQUIRE(checked_height(tree.root) >= 0);
+
+    for (int key : rand_iota(NUM_KEYS, *urbg_ptr)) {
+        if (key % 3 == 0) {
+            REQUIRE(AvlPersistentTree_remove(&tree, &key, PersistentIntNode_het_compare, nullptr));
+            REQUIRE_FALSE(AvlPersistentTree_remove(&tree, &key, PersistentIntNode_het_compare,
+                                                   nullptr));
+            expected.erase(key);
+            REQUIRE(checked_height(tree.root) >= 0);
+        }
+    }
+
+    for (int key = 0; key < NUM_KEYS; ++key) {
+        const AvlNode *const node =
+            AvlPersistentTree_get(&tree, &key, PersistentIntNode_het_compare, nullptr);
+
+        REQUIRE((node != nullptr) == (expected.count(key) == 1));
+    }
+
+    REQUIRE(keys_of(tree) == std::vector<int>(expected.begin(), expected.end()));
+    REQUIRE(tree.len == expected.size());
+    REQUIRE(counts.num_cloned == 0);
+
+    AvlPersistentTree_drop(&tree);
+    REQUIRE(counts.num_live == 0);
+}
+
+TEST_CASE("AvlPersistentTree snapshots are unaffected by later changes") {
+    const auto urbg_ptr = make_urbg();
+    NodeCounts counts;
+    AvlPersistentTree tree;
+    std::vector<AvlPersistentTree> versions(NUM_VERSIONS);
+    std::vector<std::set<int>> expected(NUM_VERSIONS);
+    std::set<int> contained;
+
+    new_tree(tree, counts);
+
+    for (int version = 0; version < NUM_VERSIONS; ++version) {
+        for (int i = 0; i < NUM_KEYS / 4; ++i) {
+            const int key = static_cast<int>((*urbg_ptr)() % NUM_KEYS);
+
+            if ((*urbg_ptr)() % 3 == 0) {
+                REQUIRE(AvlPersistentTree_remove(&tree, &key, PersistentIntNode_het_compare,
+                                                 nullptr)
+                        == static_cast<int>(contained.erase(key)));
+            } else {
+                REQUIRE(AvlPersistentTree_insert(&tree, make_node(key, counts))
+                        == !contained.insert(key).second);
+            }
+        }
+
+        REQUIRE(checked_height(tree.root) >= 0);
+        AvlPersistentTree_snapshot(&tree, &versions[version]);
+        expected[version] = contained;
+    }
+
+    for (int version = 0; version < NUM_VERSIONS; ++version) {
+        REQUIRE(checked_height(versions[version].root) >= 0);
+        REQUIRE(keys_of(versions[version])
+                == std::vector<int>(expected[version].begin(), expected[version].end()));
+        REQUIRE(versions[version].len == expected[version].size());
+    }
+
+    // dropping in an arbitrary order frees exactly the unshared nodes
+    for (int version : shuffled(iota(NUM_VERSIONS), *urbg_ptr)) {
+        AvlPersistentTree_drop(&versions[version]);
+    }
+
+    REQUIRE(keys_of(tree) == std::vector<int>(contained.begin(), contained.end()));
+    REQUIRE(counts.num_live == contained.size());
+
+    AvlPersistentTree_drop(&tree);
+    REQUIRE(counts.num_live == 0);
+}
+
+TEST_CASE("AvlPersistentTree only copies a path per change") {
+    NodeCounts counts;
+    AvlPersistentTree tree;
+    AvlPersistentTree snapshot;
+
+    new_tree(tree, counts);
+
+    for (int key : iota(NUM_KEYS)) {
+        AvlPersistentTree_insert(&tree, make_node(key * 2, counts));
+    }
+
+    const int height = checked_height(tree.root);
+
+    AvlPersistentTree_snapshot(&tree, &snapshot);
+
+    // with rotations, a removal may also copy a sibling per level
+    const int inserted = NUM_KEYS + 1;
+    AvlPersistentTree_insert(&tree, make_node(inserted, counts));
+    REQUIRE(counts.num_cloned <= static_cast<std::size_t>(height));
+
+    const int removed = NUM_KEYS + 2;
+    counts.num_cloned = 0;
+    REQUIRE(AvlPersistentTree_remove(&tree, &removed, PersistentIntNode_het_compare, nullptr));
+    REQUIRE(counts.num_cloned <= static_cast<std::size_t>(3 * height));
+
+    REQUIRE(AvlPersistentTree_get(&snapshot, &removed, PersistentIntNode_het_compare, nullptr));
+    REQUIRE(snapshot.len == static_cast<std::size_t>(NUM_KEYS));
+
+    AvlPersistentTree_drop(&snapshot);
+    AvlPersistentTree_drop(&tree);
+    REQUIRE(counts.num_live == 0);
+}
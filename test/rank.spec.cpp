@@ -0,0 +1,248 @@
+//  MIT License
+//
+//  Copyright (c) 2019 Gregory Meyer
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//  files (the "Software"), to deal in the Software without
+//  restriction, including without limitation the rights to use, copy,
+//  modify, merge, publish, distribute, sublicense, and/or sell copies
+//  of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice (including
+//  the next paragraph) shall be included in all copies or substantial
+//  portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+//  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+//  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+//  IN THE SOFTWARE.
+
+#include "int_node.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+constexpr std::size_t NUM_INSERTIONS = 512;
+
+namespace {
+
+AvlNode* RankNode_insert(const void *key_v, void *nodes_v) {
+    RankNode *&next = *static_cast<RankNode**>(nodes_v);
+    next->key = *static_cast<const int*>(key_v);
+
+    return &(next++)->node.node;
+}
+
+// number of nodes in a subtree, or -1 if any stored size is wrong
+long checked_size(const AvlNode *root) {
+    if (!root) {
+        return 0;
+    }
+
+    const long left = checked_size(root->left);
+    const long right = checked_size(root->right);
+    const auto size = static_cast<long>(reinterpret_cast<const AvlRankNode*>(root)->size);
+
+    if (left < 0 || right < 0 || size != left + right + 1) {
+        return -1;
+    }
+
+    return size;
+}
+
+// checks the whole tree, then every position with select and rank
+void require_ranks(const AvlTree &tree, const std::vector<int> &expected) {
+    REQUIRE(checked_height(tree.root) >= 0);
+    REQUIRE(checked_size(tree.root) == static_cast<long>(expected.size()));
+    REQUIRE(tree.len == expected.size());
+
+    for (std::size_t i = 0; i < expected.size(); ++i) {
+        const AvlNode *const selected = AvlTree_select(&tree, i);
+
+        REQUIRE(selected);
+        REQUIRE(RankNode_key(selected) == expected[i]);
+        REQUIRE(AvlTree_rank(&tree, &expected[i], RankNode_het_compare, nullptr) == i);
+    }
+
+    REQUIRE_FALSE(AvlTree_select(&tree, expected.size()));
+}
+
+class RankTree {
+public:
+    explicit RankTree(const std::vector<int> &keys) : nodes_(keys.size()) {
+        AvlTree_new_ranked(&tree, RankNode_compare, nullptr, IntNode_delete, nullptr);
+
+        for (std::size_t i = 0; i < keys.size(); ++i) {
+            nodes_[i].key = keys[i];
+            AvlTree_insert(&tree, &nodes_[i].node.node);
+        }
+    }
+
+    RankTree(const RankTree &other) = delete;
+
+    ~RankTree() {
+        AvlTree_drop(&tree);
+    }
+
+    RankTree& operator=(const RankTree &other) = delete;
+
+    AvlTree tree;
+
+private:
+    std::vector<RankNode> nodes_;
+};
+
+} // namespace
+
+TEST_CASE("ranked insertion and removal") {
+    const auto urbg_ptr = make_urbg();
+    const std::vector<int> keys = rand_iota(NUM_INSERTIONS, *urbg_ptr);
+    RankTree tree(keys);
+
+    require_ranks(tree.tree, iota(NUM_INSERTIONS));
+
+    const int missing = -1;
+    REQUIRE(AvlTree_rank(&tree.tree, &missing, RankNode_het_compare, nullptr) == 0);
+
+    std::vector<int> expected = iota(NUM_INSERTIONS);
+
+    for (int key : shuffled(std::vector<int>(keys), *urbg_ptr)) {
+        REQUIRE(AvlTree_remove(&tree.tree, &key, RankNode_het_compare, nullptr));
+        expected.erase(std::find(expected.begin(), expected.end(), key));
+
+        REQUIRE(checked_height(tree.tree.root) >= 0);
+        REQUIRE(checked_size(tree.tree.root) == static_cast<long>(expected.size()));
+
+        if (expected.size() % 64 == 0) {
+            require_ranks(tree.tree, expected);
+        }
+    }
+}
+
+TEST_CASE("ranked rank between keys") {
+    std::vector<RankNode> nodes(NUM_INSERTIONS);
+    std::vector<AvlNode*> ptrs(NUM_INSERTIONS);
+    AvlTree tree;
+
+    for (std::size_t i = 0; i < NUM_INSERTIONS; ++i) {
+        nodes[i].key = static_cast<int>(i * 2);
+        ptrs[i] = &nodes[i].node.node;
+    }
+
+    AvlTree_from_sorted_ranked(&tree, ptrs.data(), NUM_INSERTIONS, RankNode_compare, nullptr,
+                               IntNode_delete, nullptr);
+    require_ranks(tree, mapped(iota(NUM_INSERTIONS), [](int i) { return i * 2; }));
+
+    for (int i = -1; i < static_cast<int>(NUM_INSERTIONS * 2); i += 2) {
+        REQUIRE(AvlTree_rank(&tree, &i, RankNode_het_compare, nullptr)
+                == static_cast<std::size_t>(i + 1) / 2);
+    }
+
+    AvlTree_drop(&tree);
+}
+
+TEST_CASE("ranked get_or_insert, replacement and batches") {
+    const auto urbg_ptr = make_urbg();
+    std::vector<RankNode> nodes(NUM_INSERTIONS * 3);
+    RankNode *next = nodes.data();
+    AvlTree tree;
+
+    AvlTree_new_ranked(&tree, RankNode_compare, nullptr, IntNode_delete, nullptr);
+
+    for (int key : rand_iota(NUM_INSERTIONS, *urbg_ptr)) {
+        int inserted;
+
+        AvlTree_get_or_insert(&tree, &key, RankNode_het_compare, nullptr, RankNode_insert, &next,
+                              &inserted);
+        REQUIRE(inserted);
+    }
+
+    require_ranks(tree, iota(NUM_INSERTIONS));
+
+    // replace every node; sizes must carry over to the new nodes
+    for (int key : rand_iota(NUM_INSERTIONS, *urbg_ptr)) {
+        next->key = key;
+        REQUIRE(AvlTree_insert(&tree, &(next++)->node.node));
+    }
+
+    require_ranks(tree, iota(NUM_INSERTIONS));
+
+    // a sorted batch that both replaces and inserts
+    std::vector<AvlNode*> batch;
+
+    while (next != nodes.data() + nodes.size()) {
+        next->key = static_cast<int>(batch.size()) + static_cast<int>(NUM_INSERTIONS / 2);
+        batch.push_back(&(next++)->node.node);
+    }
+
+    AvlTree_insert_batch(&tree, batch.data(), batch.size());
+    require_ranks(tree, iota(NUM_INSERTIONS / 2 + batch.size()));
+
+    AvlTree_drop(&tree);
+}
+
+TEST_CASE("ranked split, join and set operations") {
+    const auto urbg_ptr = make_urbg();
+
+    SECTION("split at each key, then join") {
+        RankTree tree(rand_iota(NUM_INSERTIONS, *urbg_ptr));
+
+        for (int i = 0; i < static_cast<int>(NUM_INSERTIONS); i += 7) {
+            AvlTree right;
+            AvlNode *const found = AvlTree_split(&tree.tree, &i, RankNode_het_compare, nullptr,
+                                                 &right);
+
+            REQUIRE(found);
+            require_ranks(tree.tree, iota(static_cast<std::size_t>(i)));
+            require_ranks(right, iota(NUM_INSERTIONS - static_cast<std::size_t>(i) - 1, i + 1));
+
+            AvlTree_join(&tree.tree, found, &right);
+            require_ranks(tree.tree, iota(NUM_INSERTIONS));
+        }
+    }
+
+    const std::vector<int> twos = mapped(iota(NUM_INSERTIONS), [](int i) { return i * 2; });
+    const std::vector<int> threes = mapped(iota(NUM_INSERTIONS / 2), [](int i) { return i * 3; });
+    std::vector<int> expected;
+
+    SECTION("union") {
+        RankTree other(shuffled(std::vector<int>(threes), *urbg_ptr));
+        RankTree self(shuffled(std::vector<int>(twos), *urbg_ptr));
+
+        std::set_union(twos.begin(), twos.end(), threes.begin(), threes.end(),
+                       std::back_inserter(expected));
+        AvlTree_union(&self.tree, &other.tree);
+        require_ranks(self.tree, expected);
+    }
+
+    SECTION("intersection") {
+        RankTree self(shuffled(std::vector<int>(twos), *urbg_ptr));
+        RankTree other(shuffled(std::vector<int>(threes), *urbg_ptr));
+
+        std::set_intersection(twos.begin(), twos.end(), threes.begin(), threes.end(),
+                              std::back_inserter(expected));
+        AvlTree_intersection(&self.tree, &other.tree);
+        require_ranks(self.tree, expected);
+    }
+
+    SECTION("difference") {
+        RankTree self(shuffled(std::vector<int>(twos), *urbg_ptr));
+        RankTree other(shuffled(std::vector<int>(threes), *urbg_ptr));
+
+        std::set_difference(twos.begin(), twos.end(), threes.begin(), threes.end(),
+                            std::back_inserter(expected));
+        AvlTree_difference(&self.tree, &other.tree);
+        require_ranks(self.tree, expected);
+    }
+}
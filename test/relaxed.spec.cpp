@@ -0,0 +1,170 @@
+//  MIT License
+//
+//  Copyright (c) 2019 Gregory Meyer
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//  files (the "Software"), to deal in the Software without
+//  restriction, including without limitation the rights to use, copy,
+//  modify, merge, publish, distribute, sublicense, and/or sell copies
+//  of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice (including
+//  the next paragraph) shall be included in all copies or substantial
+//  portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+//  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+//  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+//  IN THE SOFTWARE.
+
+#include "int_node.h"
+#include "util.h"
+
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+constexpr std::size_t NUM_INSERTIONS = 4096;
+
+TEST_CASE("relaxed insertion and removal, then rebalance") {
+    const auto urbg_ptr = make_urbg();
+    const std::vector<int> keys = rand_iota(NUM_INSERTIONS, *urbg_ptr);
+    std::vector<IntNode> nodes(keys.size());
+    AvlTree tree;
+
+    AvlTree_new(&tree, IntNode_compare, nullptr, IntNode_delete, nullptr);
+    AvlTree_relax(&tree);
+
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        nodes[i].key = keys[i];
+        REQUIRE_FALSE(AvlTree_insert(&tree, &nodes[i].node));
+    }
+
+    REQUIRE(tree.len == NUM_INSERTIONS);
+    REQUIRE(keys_of(tree) == iota(NUM_INSERTIONS));
+
+    for (int key : keys) {
+        REQUIRE(AvlTree_get(&tree, &key, IntNode_het_compare, nullptr));
+    }
+
+    for (int key = 0; key < static_cast<int>(NUM_INSERTIONS); key += 2) {
+        REQUIRE(AvlTree_remove(&tree, &key, IntNode_het_compare, nullptr));
+        REQUIRE_FALSE(AvlTree_remove(&tree, &key, IntNode_het_compare, nullptr));
+    }
+
+    REQUIRE(tree.len == NUM_INSERTIONS / 2);
+    REQUIRE(keys_of(tree) == mapped(iota(NUM_INSERTIONS / 2), [](int i) { return i * 2 + 1; }));
+
+    AvlTree_rebalance(&tree);
+    REQUIRE_FALSE(tree.is_relaxed);
+    REQUIRE(checked_height(tree.root) >= 0);
+    REQUIRE(keys_of(tree) == mapped(iota(NUM_INSERTIONS / 2), [](int i) { return i * 2 + 1; }));
+
+    // writes rebalance as usual again
+    for (IntNode &node : nodes) {
+        if (node.key % 2 == 0) {
+            REQUIRE_FALSE(AvlTree_insert(&tree, &node.node));
+        }
+    }
+
+    REQUIRE(checked_height(tree.root) >= 0);
+    REQUIRE(keys_of(tree) == iota(NUM_INSERTIONS));
+
+    AvlTree_drop(&tree);
+}
+
+TEST_CASE("relaxed replacement") {
+    std::vector<IntNode> nodes(256);
+    std::vector<IntNode> replacements(nodes.size());
+    AvlTree tree;
+
+    AvlTree_new(&tree, IntNode_compare, nullptr, IntNode_delete, nullptr);
+
+    for (std::size_t i = 0; i < nodes.size(); ++i) {
+        nodes[i].key = static_cast<int>(i);
+        replacements[i].key = static_cast<int>(i);
+        AvlTree_insert(&tree, &nodes[i].node);
+    }
+
+    AvlTree_relax(&tree);
+
+    for (std::size_t i = 0; i < nodes.size(); ++i) {
+        REQUIRE(AvlTree_insert(&tree, &replacements[i].node) == &nodes[i].node);
+    }
+
+    REQUIRE(tree.len == nodes.size());
+    AvlTree_rebalance(&tree);
+    REQUIRE(checked_height(tree.root) >= 0);
+
+    for (int key = 0; key < static_cast<int>(nodes.size()); ++key) {
+        REQUIRE(AvlTree_get(&tree, &key, IntNode_het_compare, nullptr)
+                == &replacements[static_cast<std::size_t>(key)].node);
+    }
+
+    AvlTree_drop(&tree);
+}
+
+TEST_CASE("relaxed sorted insertion stays shallow enough for cursors") {
+    std::vector<IntNode> nodes(NUM_INSERTIONS);
+    AvlTree tree;
+
+    AvlTree_new(&tree, IntNode_compare, nullptr, IntNode_delete, nullptr);
+    AvlTree_relax(&tree);
+
+    for (std::size_t i = 0; i < nodes.size(); ++i) {
+        nodes[i].key = static_cast<int>(i);
+        AvlTree_insert(&tree, &nodes[i].node);
+
+        AvlCursor cursor;
+        AvlCursor_last(&cursor, &tree);
+        REQUIRE(AvlCursor_get(&cursor) == &nodes[i].node);
+    }
+
+    REQUIRE(keys_of(tree) == iota(NUM_INSERTIONS));
+
+    AvlTree_rebalance(&tree);
+    REQUIRE(checked_height(tree.root) >= 0);
+    AvlTree_drop(&tree);
+}
+
+TEST_CASE("relaxed rebalance in bounded steps") {
+    const auto urbg_ptr = make_urbg();
+    const std::vector<int> keys = rand_iota(NUM_INSERTIONS, *urbg_ptr);
+    std::vector<RankNode> nodes(keys.size());
+    AvlTree tree;
+
+    AvlTree_new_ranked(&tree, RankNode_compare, nullptr, IntNode_delete, nullptr);
+    AvlTree_relax(&tree);
+
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        nodes[i].key = keys[i];
+        AvlTree_insert(&tree, &nodes[i].node.node);
+    }
+
+    std::size_t num_steps = 1;
+
+    while (!AvlTree_rebalance_step(&tree, 64)) {
+        ++num_steps;
+        REQUIRE(num_steps <= NUM_INSERTIONS / 64);
+    }
+
+    REQUIRE(num_steps > 1);
+    REQUIRE(tree.is_relaxed);
+    REQUIRE(checked_height(tree.root) >= 0);
+    REQUIRE(tree.len == NUM_INSERTIONS);
+
+    for (std::size_t i = 0; i < NUM_INSERTIONS; ++i) {
+        const AvlNode *const node = AvlTree_select(&tree, i);
+
+        REQUIRE(node);
+        REQUIRE(RankNode_key(node) == static_cast<int>(i));
+    }
+
+    AvlTree_drop(&tree);
+}
@@ -0,0 +1,167 @@
+//  MIT License
+//
+//  Copyright (c) 2019 Gregory Meyer
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//  files (the "Software"), to deal in the Software without
+//  restriction, including without limitation the rights to use, copy,
+//  modify, merge, publish, distribute, sublicense, and/or sell copies
+//  of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice (including
+//  the next paragraph) shall be included in all copies or substantial
+//  portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+//  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+//  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+//  IN THE SOFTWARE.
+
+#include "int_node.h"
+
+#include <cstddef>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+namespace {
+
+// IntNodes at a fixed stride from the start of a page, so their layout
+// does not depend on where the allocator put the buffer
+struct Placed {
+    Placed(std::size_t n, std::size_t stride, std::size_t offset = 0)
+    : buffer(4096 + offset + stride * n) {
+        std::size_t base = reinterpret_cast<std::size_t>(buffer.data());
+        base = (base + 4095) / 4096 * 4096 + offset;
+
+        AvlTree_new(&tree, IntNode_compare, nullptr, IntNode_delete, nullptr);
+
+        for (std::size_t i = 0; i < n; ++i) {
+            IntNode *const node = reinterpret_cast<IntNode*>(base + stride * i);
+
+            node->key = static_cast<int>(i);
+            AvlTree_insert(&tree, &node->node);
+        }
+    }
+
+    ~Placed() {
+        AvlTree_drop(&tree);
+    }
+
+    AvlShapeReport report() const {
+        AvlShapeReport shape;
+
+        AvlTree_shape_report(&tree, &shape);
+
+        return shape;
+    }
+
+    std::vector<unsigned char> buffer;
+    AvlTree tree;
+};
+
+} // namespace
+
+TEST_CASE("AvlTree_shape_report") {
+    SECTION("empty tree") {
+        const Placed placed(0, 64);
+        const AvlShapeReport shape = placed.report();
+
+        REQUIRE(shape.len == 0);
+        REQUIRE(shape.height == 0);
+        REQUIRE(shape.depth_histogram[0] == 0);
+        REQUIRE(shape.total_depth == 0);
+        REQUIRE(shape.mean_depth == 0.0);
+        REQUIRE(shape.num_cache_lines == 0);
+        REQUIRE(shape.num_links == 0);
+        REQUIRE(shape.cache_line_size == 64);
+        REQUIRE(shape.page_size == 4096);
+    }
+
+    SECTION("perfect tree") {
+        const Placed placed(15, 64);
+        const AvlShapeReport shape = placed.report();
+
+        REQUIRE(shape.len == 15);
+        REQUIRE(shape.height == 4);
+        REQUIRE(shape.depth_histogram[0] == 1);
+        REQUIRE(shape.depth_histogram[1] == 2);
+        REQUIRE(shape.depth_histogram[2] == 4);
+        REQUIRE(shape.depth_histogram[3] == 8);
+        REQUIRE(shape.depth_histogram[4] == 0);
+        REQUIRE(shape.total_depth == 49);
+        REQUIRE(shape.mean_depth == Approx(49.0 / 15.0));
+        REQUIRE(shape.min_mean_depth == Approx(shape.mean_depth));
+    }
+
+    SECTION("unbalanced tree") {
+        std::vector<IntNode> chain(5);
+        Placed placed(16, 64);
+
+        AvlTree_relax(&placed.tree);
+
+        for (int key = 0; key < 16; ++key) {
+            AvlTree_remove(&placed.tree, &key, IntNode_het_compare, nullptr);
+        }
+
+        for (std::size_t i = 0; i < chain.size(); ++i) {
+            chain[i].key = static_cast<int>(i);
+            AvlTree_insert(&placed.tree, &chain[i].node);
+        }
+
+        const AvlShapeReport shape = placed.report();
+
+        REQUIRE(shape.len == 5);
+        REQUIRE(shape.height == 5);
+        REQUIRE(shape.total_depth == 15);
+        REQUIRE(shape.mean_depth == Approx(3.0));
+        REQUIRE(shape.min_mean_depth == Approx(11.0 / 5.0));
+
+        AvlTree_rebalance(&placed.tree);
+        REQUIRE(placed.report().height == 3);
+    }
+
+    SECTION("one node per cache line") {
+        const Placed placed(32, 64);
+        const AvlShapeReport shape = placed.report();
+
+        REQUIRE(shape.num_cache_lines == 32);
+        REQUIRE(shape.num_straddling_nodes == 0);
+        REQUIRE(shape.num_links == 31);
+        REQUIRE(shape.num_same_line_links == 0);
+        REQUIRE(shape.num_same_page_links == 31);
+    }
+
+    SECTION("two nodes per cache line") {
+        REQUIRE(sizeof(IntNode) <= 32);
+
+        const Placed placed(32, 32);
+        const AvlShapeReport shape = placed.report();
+
+        REQUIRE(shape.num_cache_lines == 16);
+        REQUIRE(shape.num_straddling_nodes == 0);
+        REQUIRE(shape.num_same_line_links > 0);
+        REQUIRE(shape.num_same_page_links == 31);
+    }
+
+    SECTION("one node per page") {
+        const Placed placed(8, 4096);
+        const AvlShapeReport shape = placed.report();
+
+        REQUIRE(shape.num_cache_lines == 8);
+        REQUIRE(shape.num_links == 7);
+        REQUIRE(shape.num_same_page_links == 0);
+    }
+
+    SECTION("node across a cache line boundary") {
+        const Placed placed(1, 64, 64 - sizeof(void*));
+
+        REQUIRE(placed.report().num_straddling_nodes == 1);
+    }
+}
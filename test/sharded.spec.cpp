@@ -0,0 +1,203 @@
+//  MIT License
+//
+//  Copyright (c) 2019 Gregory Meyer
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//  files (the "Software"), to deal in the Software without
+//  restriction, including without limitation the rights to use, copy,
+//  modify, merge, publish, distribute, sublicense, and/or sell copies
+//  of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice (including
+//  the next paragraph) shall be included in all copies or substantial
+//  portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+//  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+//  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+//  IN THE SOFTWARE.
+
+#include "bloodhound_sharded.h"
+#include "int_node.h"
+#include "util.h"
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+constexpr std::size_t NUM_SHARDS = 8;
+constexpr int NUM_KEYS = 4096;
+constexpr int NUM_WRITERS = 4;
+
+using ShardedPtr = std::unique_ptr<AvlShardedTree, decltype(&AvlShardedTree_drop)>;
+
+static void delete_rank_node(AvlNode *node, void *count_v) {
+    ++*static_cast<std::atomic<std::size_t>*>(count_v);
+    delete reinterpret_cast<RankNode*>(node);
+}
+
+static ShardedPtr make_sharded(std::atomic<std::size_t> &num_deleted) {
+    return ShardedPtr(AvlShardedTree_new(NUM_SHARDS, RankNode_compare, nullptr, delete_rank_node,
+                                         &num_deleted),
+                      AvlShardedTree_drop);
+}
+
+static bool insert_key(AvlShardedTree &tree, int key) {
+    RankNode *const node = new RankNode;
+
+    node->key = key;
+
+    return AvlShardedTree_insert(&tree, &node->node.node) != 0;
+}
+
+static bool contains(AvlShardedTree &tree, int key) {
+    const AvlNode *const node = AvlShardedTree_get(&tree, &key, RankNode_het_compare, nullptr);
+
+    return node && RankNode_key(node) == key;
+}
+
+static int push_key(void *keys_v, const AvlNode *node) {
+    static_cast<std::vector<int>*>(keys_v)->push_back(RankNode_key(node));
+
+    return 0;
+}
+
+static std::vector<int> keys_from(AvlShardedTree &tree, const int *key) {
+    std::vector<int> keys;
+
+    AvlShardedTree_traverse_from(&tree, key, key ? RankNode_het_compare : nullptr, nullptr,
+                                 push_key, &keys);
+
+    return keys;
+}
+
+TEST_CASE("AvlShardedTree spreads sequential inserts across shards") {
+    std::atomic<std::size_t> num_deleted(0);
+
+    {
+        const auto tree_ptr = make_sharded(num_deleted);
+
+        for (int key : iota(NUM_KEYS)) {
+            REQUIRE_FALSE(insert_key(*tree_ptr, key));
+        }
+
+        REQUIRE(AvlShardedTree_len(tree_ptr.get()) == static_cast<std::size_t>(NUM_KEYS));
+
+        for (std::size_t i = 0; i < NUM_SHARDS; ++i) {
+            REQUIRE(AvlShardedTree_shard_len(tree_ptr.get(), i) > 0);
+        }
+
+        REQUIRE(keys_from(*tree_ptr, nullptr) == iota(NUM_KEYS));
+
+        const int lower = NUM_KEYS / 3;
+        REQUIRE(keys_from(*tree_ptr, &lower) == iota(NUM_KEYS - lower, lower));
+
+        REQUIRE(insert_key(*tree_ptr, lower));
+        REQUIRE(num_deleted.load() == 1);
+    }
+
+    REQUIRE(num_deleted.load() == static_cast<std::size_t>(NUM_KEYS) + 1);
+}
+
+TEST_CASE("AvlShardedTree keeps removed boundaries until they move") {
+    const auto urbg_ptr = make_urbg();
+    std::atomic<std::size_t> num_deleted(0);
+
+    {
+        const auto tree_ptr = make_sharded(num_deleted);
+
+        for (int key : iota(NUM_KEYS)) {
+            insert_key(*tree_ptr, key);
+        }
+
+        // every other key, boundaries included, then refill
+        for (int key : shuffled(iota(NUM_KEYS), *urbg_ptr)) {
+            if (key % 2 == 0) {
+                REQUIRE(AvlShardedTree_remove(tree_ptr.get(), &key, RankNode_het_compare,
+                                              nullptr));
+                REQUIRE_FALSE(contains(*tree_ptr, key));
+            }
+        }
+
+        REQUIRE(AvlShardedTree_len(tree_ptr.get()) == static_cast<std::size_t>(NUM_KEYS) / 2);
+
+        for (int key = 0; key < NUM_KEYS; ++key) {
+            REQUIRE(contains(*tree_ptr, key) == (key % 2 != 0));
+        }
+
+        for (int key : shuffled(iota(NUM_KEYS), *urbg_ptr)) {
+            REQUIRE(insert_key(*tree_ptr, key) == (key % 2 != 0));
+        }
+
+        REQUIRE(keys_from(*tree_ptr, nullptr) == iota(NUM_KEYS));
+    }
+
+    REQUIRE(num_deleted.load() == static_cast<std::size_t>(NUM_KEYS) * 2);
+}
+
+TEST_CASE("AvlShardedTree handles concurrent writers and traversals") {
+    std::atomic<std::size_t> num_deleted(0);
+    std::atomic<std::size_t> num_failures(0);
+    const auto tree_ptr = make_sharded(num_deleted);
+    AvlShardedTree &tree = *tree_ptr;
+    std::vector<std::thread> threads;
+
+    // writer w owns the keys congruent to w, so each can check its own
+    for (int writer = 0; writer < NUM_WRITERS; ++writer) {
+        threads.emplace_back([&tree, &num_failures, writer] {
+            const auto urbg_ptr = make_urbg();
+            std::vector<int> keys;
+
+            for (int key = writer; key < NUM_KEYS * NUM_WRITERS; key += NUM_WRITERS) {
+                keys.push_back(key);
+            }
+
+            for (int round = 0; round < 4; ++round) {
+                for (int key : shuffled(std::vector<int>(keys), *urbg_ptr)) {
+                    num_failures += insert_key(tree, key);
+                }
+
+                for (int key : shuffled(std::vector<int>(keys), *urbg_ptr)) {
+                    num_failures += !contains(tree, key);
+                    num_failures += !AvlShardedTree_remove(&tree, &key, RankNode_het_compare,
+                                                           nullptr);
+                }
+            }
+
+            for (int key : keys) {
+                num_failures += insert_key(tree, key);
+            }
+        });
+    }
+
+    std::atomic<bool> is_done(false);
+    std::thread scanner([&tree, &num_failures, &is_done] {
+        while (!is_done.load()) {
+            const std::vector<int> keys = keys_from(tree, nullptr);
+
+            for (std::size_t i = 1; i < keys.size(); ++i) {
+                num_failures += keys[i - 1] >= keys[i];
+            }
+        }
+    });
+
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    is_done.store(true);
+    scanner.join();
+
+    REQUIRE(num_failures.load() == 0);
+    REQUIRE(keys_from(tree, nullptr) == iota(NUM_KEYS * NUM_WRITERS));
+}
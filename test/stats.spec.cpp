@@ -0,0 +1,155 @@
+//  MIT License
+//
+//  Copyright (c) 2019 Gregory Meyer
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//  files (the "Software"), to deal in the Software without
+//  restriction, including without limitation the rights to use, copy,
+//  modify, merge, publish, distribute, sublicense, and/or sell copies
+//  of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice (including
+//  the next paragraph) shall be included in all copies or substantial
+//  portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+//  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+//  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+//  IN THE SOFTWARE.
+
+#include "int_node.h"
+#include "util.h"
+
+#include <cstddef>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+namespace {
+
+AvlTreeStats stats_of(const IntTree &tree) {
+    AvlTreeStats stats;
+
+    AvlTree_stats(&tree.tree, &stats);
+
+    return stats;
+}
+
+} // namespace
+
+#ifdef BLOODHOUND_STATS
+
+TEST_CASE("AvlTree_stats") {
+    SECTION("empty tree") {
+        const IntTree tree({});
+        const AvlTreeStats stats = stats_of(tree);
+
+        REQUIRE(stats.num_comparisons == 0);
+        REQUIRE(stats.num_searches == 0);
+        REQUIRE(stats.num_rebalances == 0);
+    }
+
+    SECTION("single rotation") {
+        const IntTree tree({1, 2, 3});
+        const AvlTreeStats stats = stats_of(tree);
+
+        REQUIRE(stats.num_comparisons == 3);
+        REQUIRE(stats.num_searches == 3);
+        REQUIRE(stats.total_search_depth == 3);
+        REQUIRE(stats.max_search_depth == 2);
+        REQUIRE(stats.num_single_rotations == 1);
+        REQUIRE(stats.num_double_rotations == 0);
+        REQUIRE(stats.num_rebalances == 2);
+        REQUIRE(stats.total_rebalance_length == 3);
+        REQUIRE(stats.num_allocations == 0);
+    }
+
+    SECTION("double rotation") {
+        const IntTree tree({1, 3, 2});
+        const AvlTreeStats stats = stats_of(tree);
+
+        REQUIRE(stats.num_single_rotations == 0);
+        REQUIRE(stats.num_double_rotations == 1);
+    }
+
+    SECTION("lookups") {
+        IntTree tree({2, 1, 3});
+        const AvlTreeStats before = stats_of(tree);
+        AvlTreeStats lookups = AvlTreeStats();
+        const int root = 2;
+        const int missing = 4;
+
+        AvlTree_set_lookup_stats(&tree.tree, &lookups);
+        REQUIRE(AvlTree_get(&tree.tree, &root, IntNode_het_compare, nullptr));
+        REQUIRE_FALSE(AvlTree_get(&tree.tree, &missing, IntNode_het_compare, nullptr));
+
+        REQUIRE(lookups.num_comparisons == 3);
+        REQUIRE(lookups.num_searches == 2);
+        REQUIRE(lookups.total_search_depth == 3);
+        REQUIRE(lookups.max_search_depth == 2);
+        REQUIRE(lookups.num_rebalances == 0);
+
+        // lookups never write to the tree they search
+        const AvlTreeStats after = stats_of(tree);
+
+        REQUIRE(after.num_comparisons == before.num_comparisons);
+        REQUIRE(after.num_searches == before.num_searches);
+    }
+
+    SECTION("lookups without a sink") {
+        const IntTree tree({2, 1, 3});
+        const AvlTreeStats before = stats_of(tree);
+        const int root = 2;
+
+        REQUIRE(AvlTree_get(&tree.tree, &root, IntNode_het_compare, nullptr));
+        REQUIRE(stats_of(tree).num_searches == before.num_searches);
+    }
+
+    SECTION("removal") {
+        IntTree tree({2, 1, 3, 4});
+        const AvlTreeStats before = stats_of(tree);
+        const int key = 1;
+
+        REQUIRE(AvlTree_remove(&tree.tree, &key, IntNode_het_compare, nullptr));
+
+        const AvlTreeStats after = stats_of(tree);
+
+        REQUIRE(after.num_searches - before.num_searches == 1);
+        REQUIRE(after.num_single_rotations - before.num_single_rotations == 1);
+        REQUIRE(after.num_rebalances - before.num_rebalances == 1);
+    }
+
+    SECTION("random keys") {
+        const auto urbg_ptr = make_urbg();
+        const std::size_t n = 10000;
+        const IntTree tree(rand_iota(n, *urbg_ptr));
+        const AvlTreeStats stats = stats_of(tree);
+
+        REQUIRE(stats.num_searches == n);
+        REQUIRE(stats.num_comparisons == stats.total_search_depth);
+        REQUIRE(stats.max_search_depth <= 20); // 1.44 log2(n) + 1
+        REQUIRE(stats.num_rebalances == n - 1);
+        REQUIRE(stats.num_allocations == 0);
+    }
+}
+
+#else
+
+TEST_CASE("AvlTree_stats") {
+    const IntTree tree({1, 2, 3});
+    const AvlTreeStats stats = stats_of(tree);
+
+    REQUIRE(stats.num_comparisons == 0);
+    REQUIRE(stats.num_searches == 0);
+    REQUIRE(stats.max_search_depth == 0);
+    REQUIRE(stats.num_single_rotations == 0);
+    REQUIRE(stats.num_rebalances == 0);
+}
+
+#endif
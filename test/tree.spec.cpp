@@ -0,0 +1,202 @@
+//  MIT License
+//
+//  Copyright (c) 2019 Gregory Meyer
+//
+//  Permission is hereby granted, free of charge, to any person
+//  obtaining a copy of this software and associated documentation
+//  files (the "Software"), to deal in the Software without
+//  restriction, including without limitation the rights to use, copy,
+//  modify, merge, publish, distribute, sublicense, and/or sell copies
+//  of the Software, and to permit persons to whom the Software is
+//  furnished to do so, subject to the following conditions:
+//
+//  The above copyright notice and this permission notice (including
+//  the next paragraph) shall be included in all copies or substantial
+//  portions of the Software.
+//
+//  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+//  EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+//  MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+//  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS
+//  BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN
+//  ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+//  CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+//  IN THE SOFTWARE.
+
+#include "avl_tree.h"
+#include "int_node.h"
+#include "util.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+#include <catch2/catch.hpp>
+
+constexpr std::size_t NUM_INSERTIONS = 512;
+
+namespace {
+
+struct IntCompare {
+    int operator()(int lhs, const AvlNode *rhs_v) const noexcept {
+        const int rhs = IntNode_key(rhs_v);
+
+        return (lhs > rhs) - (lhs < rhs);
+    }
+};
+
+struct RankCompare {
+    int operator()(int lhs, const AvlNode *rhs_v) const noexcept {
+        const int rhs = RankNode_key(rhs_v);
+
+        return (lhs > rhs) - (lhs < rhs);
+    }
+};
+
+} // namespace
+
+TEST_CASE("avl::insert and avl::find") {
+    const auto urbg_ptr = make_urbg();
+    const std::vector<int> keys = rand_iota(NUM_INSERTIONS, *urbg_ptr);
+    std::vector<IntNode> nodes(keys.size());
+    AvlTree tree;
+
+    AvlTree_new(&tree, IntNode_compare, nullptr, IntNode_delete, nullptr);
+
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        nodes[i].key = keys[i];
+
+        REQUIRE_FALSE(avl::insert(tree, keys[i], &nodes[i].node, IntCompare()));
+        REQUIRE(checked_height(tree.root) >= 0);
+        REQUIRE(tree.len == i + 1);
+    }
+
+    REQUIRE(keys_of(tree) == sorted(std::vector<int>(keys)));
+
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        const AvlTree &const_tree = tree;
+
+        REQUIRE(avl::find(tree, keys[i], IntCompare()) == &nodes[i].node);
+        REQUIRE(avl::find(const_tree, keys[i], IntCompare()) == &nodes[i].node);
+    }
+
+    REQUIRE_FALSE(avl::find(tree, -1, IntCompare()));
+    REQUIRE_FALSE(avl::find(tree, static_cast<int>(NUM_INSERTIONS), IntCompare()));
+
+    // replacing keeps the shape and hands back the old node
+    IntNode replacement;
+    replacement.key = keys[0];
+
+    REQUIRE(avl::insert(tree, keys[0], &replacement.node, IntCompare()) == &nodes[0].node);
+    REQUIRE(tree.len == keys.size());
+    REQUIRE(checked_height(tree.root) >= 0);
+    REQUIRE(AvlTree_get(&tree, &keys[0], IntNode_het_compare, nullptr) == &replacement.node);
+
+    AvlTree_drop(&tree);
+}
+
+TEST_CASE("avl::get_or_insert") {
+    const auto urbg_ptr = make_urbg();
+    const std::vector<int> keys = rand_iota(NUM_INSERTIONS, *urbg_ptr);
+    std::vector<IntNode> nodes(keys.size());
+    AvlTree tree;
+
+    AvlTree_new(&tree, IntNode_compare, nullptr, IntNode_delete, nullptr);
+
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        const auto result = avl::get_or_insert(tree, keys[i], IntCompare(), [&] {
+            nodes[i].key = keys[i];
+
+            return &nodes[i].node;
+        });
+
+        REQUIRE(result.first == &nodes[i].node);
+        REQUIRE(result.second);
+    }
+
+    REQUIRE(checked_height(tree.root) >= 0);
+
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        const auto result = avl::get_or_insert(tree, keys[i], IntCompare(),
+                                               []() -> AvlNode* { throw std::logic_error("called"); });
+
+        REQUIRE(result.first == &nodes[i].node);
+        REQUIRE_FALSE(result.second);
+    }
+
+    // a throwing make() leaves the tree untouched
+    const int missing = static_cast<int>(NUM_INSERTIONS);
+
+    REQUIRE_THROWS_AS(avl::get_or_insert(tree, missing, IntCompare(),
+                                         []() -> AvlNode* { throw std::runtime_error("oom"); }),
+                      std::runtime_error);
+    REQUIRE(tree.len == keys.size());
+    REQUIRE(keys_of(tree) == sorted(std::vector<int>(keys)));
+
+    AvlTree_drop(&tree);
+}
+
+TEST_CASE("avl::remove on a tree built by the C API") {
+    const auto urbg_ptr = make_urbg();
+    const std::vector<int> keys = rand_iota(NUM_INSERTIONS, *urbg_ptr);
+    IntTree tree(keys);
+    std::vector<int> remaining = sorted(std::vector<int>(keys));
+
+    REQUIRE_FALSE(avl::remove(tree.tree, -1, IntCompare()));
+
+    for (int key : shuffled(std::vector<int>(keys), *urbg_ptr)) {
+        const AvlNode *const removed = avl::remove(tree.tree, key, IntCompare());
+
+        REQUIRE(removed);
+        REQUIRE(IntNode_key(removed) == key);
+        REQUIRE_FALSE(avl::find(tree.tree, key, IntCompare()));
+        REQUIRE(checked_height(tree.tree.root) >= 0);
+
+        remaining.erase(std::find(remaining.begin(), remaining.end(), key));
+        REQUIRE(tree.tree.len == remaining.size());
+
+        // the C API must still see a valid tree
+        if (!remaining.empty()) {
+            REQUIRE(AvlTree_get(&tree.tree, &remaining.front(), IntNode_het_compare, nullptr));
+        }
+    }
+
+    REQUIRE_FALSE(tree.tree.root);
+}
+
+TEST_CASE("avl_tree.h keeps ranked trees ranked") {
+    const auto urbg_ptr = make_urbg();
+    const std::vector<int> keys = rand_iota(NUM_INSERTIONS, *urbg_ptr);
+    std::vector<RankNode> nodes(keys.size());
+    AvlTree tree;
+
+    AvlTree_new_ranked(&tree, RankNode_compare, nullptr, IntNode_delete, nullptr);
+
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        nodes[i].key = keys[i];
+        REQUIRE_FALSE(avl::insert(tree, keys[i], &nodes[i].node.node, RankCompare()));
+    }
+
+    for (std::size_t i = 0; i < keys.size(); i += 2) {
+        REQUIRE(avl::remove(tree, keys[i], RankCompare()) == &nodes[i].node.node);
+    }
+
+    std::vector<int> expected;
+
+    for (std::size_t i = 1; i < keys.size(); i += 2) {
+        expected.push_back(keys[i]);
+    }
+
+    std::sort(expected.begin(), expected.end());
+    REQUIRE(tree.len == expected.size());
+
+    for (std::size_t i = 0; i < expected.size(); ++i) {
+        const AvlNode *const selected = AvlTree_select(&tree, i);
+
+        REQUIRE(selected);
+        REQUIRE(RankNode_key(selected) == expected[i]);
+    }
+
+    AvlTree_drop(&tree);
+}